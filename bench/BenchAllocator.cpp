@@ -0,0 +1,37 @@
+#include "LavaBench.h"
+#include "LavaIndexAllocator.h"
+
+#include <memory>
+
+//Steady state bindless churn: half the heap live, every frame frees and allocates a batch, frees retire
+//after 3 frames in flight.
+LAVA_BENCH("allocator/index_churn", [](LavaBenchContext&) -> LavaBenchBody {
+	struct State {
+		LavaIndexAllocator allocator;
+		std::vector<uint32_t> live;
+		LavaBenchRandom random;
+		uint64_t frame = 0;
+	};
+	const uint32_t capacity = 1u << 16;
+	const uint32_t batchSize = 256;
+
+	std::shared_ptr<State> state(new State());
+	state->allocator.Init(capacity, 3);
+	for (uint32_t i = 0; i < capacity / 2; i++) {
+		state->live.push_back(state->allocator.Allocate());
+	}
+
+	return [state, batchSize]() {
+		state->allocator.BeginFrame(++state->frame);
+		for (uint32_t i = 0; i < batchSize; i++) {
+			uint32_t slot = state->random.Next() % uint32_t(state->live.size());
+			state->allocator.Free(state->live[slot], state->frame);
+			state->live[slot] = state->live.back();
+			state->live.pop_back();
+		}
+		for (uint32_t i = 0; i < batchSize; i++) {
+			state->live.push_back(state->allocator.Allocate());
+		}
+		return uint64_t(2 * batchSize);
+	};
+});
@@ -0,0 +1,151 @@
+#include "LavaBench.h"
+#include "LavaAnimation.h"
+#include "LavaJobs.h"
+
+#include <math.h>
+#include <memory>
+
+static const uint32_t animationCharacterCount = 1024;
+
+//Humanoid sized skeleton, 64 joints: an 8 joint spine with four 14 joint limbs branching off it, two walk like clips
+//of different lengths every character blends between at its own times.
+struct AnimationBenchData {
+	LavaSkeleton skeleton;
+	LavaAnimationSamples samples[2];
+	LavaAnimationClip clips[2];
+	std::vector<LavaAnimationState> states;
+	std::vector<LavaAffineTransform> skinningMatrices;
+
+	AnimationBenchData()
+	{
+		const uint32_t spineCount = 8;
+		const uint32_t limbCount = 4;
+		const uint32_t limbJointCount = 14;
+		uint32_t jointCount = spineCount + limbCount * limbJointCount;
+		skeleton.parents.resize(jointCount);
+		skeleton.bindPose.Resize(jointCount);
+		for (uint32_t j = 0; j < spineCount; j++) {
+			skeleton.parents[j] = int32_t(j) - 1;
+			skeleton.bindPose.SetJoint(j, glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(0.f, j ? 0.1f : 1.f, 0.f), glm::vec3(1.f));
+		}
+		for (uint32_t limb = 0; limb < limbCount; limb++) {
+			glm::vec3 direction(limb % 2 ? 0.08f : -0.08f, limb < 2 ? -0.06f : 0.02f, 0.f);
+			for (uint32_t k = 0; k < limbJointCount; k++) {
+				uint32_t j = spineCount + limb * limbJointCount + k;
+				skeleton.parents[j] = k ? int32_t(j) - 1 : int32_t(limb < 2 ? 0 : spineCount - 2);
+				skeleton.bindPose.SetJoint(j, glm::angleAxis(0.05f * float(k), glm::vec3(0.f, 0.f, 1.f)), direction, glm::vec3(1.f));
+			}
+		}
+		skeleton.ComputeInverseBindTransforms();
+
+		LavaBuildSwayClip(skeleton, 0.6f, 1.f, 1, samples[0]);
+		LavaBuildSwayClip(skeleton, 0.3f, 0.4f, 2, samples[1]);
+		for (int i = 0; i < 2; i++) {
+			LavaCompressClip(samples[i], LavaClipCompressionSettings(), clips[i]);
+		}
+
+		LavaBenchRandom random;
+		states.resize(animationCharacterCount);
+		for (LavaAnimationState& state : states) {
+			state.clips[0] = &clips[0];
+			state.clips[1] = &clips[1];
+			state.times[0] = random.NextFloat(0.f, clips[0].GetDuration());
+			state.times[1] = random.NextFloat(0.f, clips[1].GetDuration());
+			state.blendWeight = random.NextFloat(0.f, 1.f);
+		}
+		skinningMatrices.resize(size_t(animationCharacterCount) * jointCount);
+	}
+
+	//Every character a frame further, so sampling doesn't hit the same keys each iteration.
+	void Advance()
+	{
+		for (LavaAnimationState& state : states) {
+			state.times[0] += 1.f / 60.f;
+			state.times[1] += 1.f / 60.f;
+		}
+	}
+};
+
+static std::shared_ptr<AnimationBenchData> GetAnimationBenchData()
+{
+	static std::shared_ptr<AnimationBenchData> data(new AnimationBenchData());
+	return data;
+}
+
+LAVA_BENCH("animation/compress_64_joints", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<AnimationBenchData> data = GetAnimationBenchData();
+	const LavaAnimationClip& clip = data->clips[0];
+	context.SetCounter("compression_ratio", double(LavaGetSamplesSize(data->samples[0])) / double(clip.GetSize()));
+	context.SetCounter("keys", double(clip.keyFrames.size()));
+	context.SetCounter("source_keys", double(clip.frameCount) * clip.jointCount * LAVA_CHANNEL_COUNT);
+	context.SetCounter("max_rotation_error", clip.maxRotationError);
+	context.SetCounter("max_translation_error", clip.maxTranslationError);
+	return [data]() {
+		LavaAnimationClip compressed;
+		LavaCompressClip(data->samples[0], LavaClipCompressionSettings(), compressed);
+		LavaBenchKeep(compressed.keyFrames.size());
+		return uint64_t(data->samples[0].frameCount) * data->samples[0].jointCount;
+	};
+});
+
+//Baseline: uncompressed array of structures samples, glm slerp per joint for sampling and blending.
+LAVA_BENCH("animation/characters_1k_uncompressed_aos", [](LavaBenchContext&) -> LavaBenchBody {
+	std::shared_ptr<AnimationBenchData> data = GetAnimationBenchData();
+	std::shared_ptr<std::vector<LavaAffineTransform>> modelTransforms(new std::vector<LavaAffineTransform>(data->skeleton.GetJointCount()));
+	return [data, modelTransforms]() {
+		data->Advance();
+		const LavaSkeleton& skeleton = data->skeleton;
+		uint32_t jointCount = skeleton.GetJointCount();
+		for (uint32_t c = 0; c < animationCharacterCount; c++) {
+			const LavaAnimationState& state = data->states[c];
+			uint32_t frames[2][2];
+			float alphas[2];
+			for (int layer = 0; layer < 2; layer++) {
+				const LavaAnimationSamples& samples = data->samples[layer];
+				float duration = float(samples.frameCount - 1) / samples.sampleRate;
+				float frame = fmodf(state.times[layer], duration) * samples.sampleRate;
+				frames[layer][0] = std::min(uint32_t(frame), samples.frameCount - 1);
+				frames[layer][1] = std::min(frames[layer][0] + 1, samples.frameCount - 1);
+				alphas[layer] = frame - float(frames[layer][0]);
+			}
+
+			LavaAffineTransform* skinning = &data->skinningMatrices[size_t(c) * jointCount];
+			for (uint32_t j = 0; j < jointCount; j++) {
+				glm::quat rotations[2];
+				glm::vec3 translations[2], scales[2];
+				for (int layer = 0; layer < 2; layer++) {
+					const LavaAnimationSamples& samples = data->samples[layer];
+					size_t a = size_t(frames[layer][0]) * jointCount + j;
+					size_t b = size_t(frames[layer][1]) * jointCount + j;
+					rotations[layer] = glm::slerp(samples.rotations[a], samples.rotations[b], alphas[layer]);
+					translations[layer] = glm::mix(samples.translations[a], samples.translations[b], alphas[layer]);
+					scales[layer] = glm::mix(samples.scales[a], samples.scales[b], alphas[layer]);
+				}
+				LavaAffineTransform local = ComposeTransform(glm::mix(translations[0], translations[1], state.blendWeight),
+					glm::slerp(rotations[0], rotations[1], state.blendWeight), glm::mix(scales[0], scales[1], state.blendWeight));
+				(*modelTransforms)[j] = skeleton.parents[j] < 0 ? local : MultiplyTransforms((*modelTransforms)[skeleton.parents[j]], local);
+				skinning[j] = MultiplyTransforms((*modelTransforms)[j], skeleton.inverseBindTransforms[j]);
+			}
+		}
+		return uint64_t(animationCharacterCount);
+	};
+});
+
+//items_per_second / 1000 is characters per ms.
+static LavaBenchBody AnimateCharactersBench(LavaBenchContext& context, bool threaded)
+{
+	if (threaded && !context.jobSystem)
+		return LavaBenchBody();
+	std::shared_ptr<AnimationBenchData> data = GetAnimationBenchData();
+	std::shared_ptr<LavaAnimationSystem> system(new LavaAnimationSystem());
+	system->Init(&data->skeleton, threaded ? context.jobSystem : nullptr);
+	context.SetCounter("joints", data->skeleton.GetJointCount());
+	return [data, system]() {
+		data->Advance();
+		system->Update(data->states.data(), animationCharacterCount, data->skinningMatrices.data());
+		return uint64_t(animationCharacterCount);
+	};
+}
+
+LAVA_BENCH("animation/characters_1k", [](LavaBenchContext& context) { return AnimateCharactersBench(context, false); });
+LAVA_BENCH("animation/characters_1k_threads", [](LavaBenchContext& context) { return AnimateCharactersBench(context, true); });
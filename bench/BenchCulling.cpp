@@ -0,0 +1,247 @@
+#include "LavaBench.h"
+#include "LavaCulling.h"
+#include "LavaBvh.h"
+#include "LavaOcclusion.h"
+
+#include <memory>
+#include <gtc/matrix_transform.hpp>
+
+static const uint32_t cullObjectCount = 100000;
+
+//Objects scattered through a 1000 unit cube around a camera at the origin looking down +z,
+//roughly a sixth of them end up inside the frustum.
+struct CullScene {
+	std::vector<glm::vec4> spheres;
+	std::vector<LavaAabb> boxes;
+	LavaCullingBounds bounds;
+	glm::mat4 viewProjection;
+	LavaFrustum frustum;
+	std::vector<uint32_t> visible;
+
+	CullScene(uint32_t objectCount)
+	{
+		LavaBenchRandom random;
+		spheres.resize(objectCount);
+		boxes.resize(objectCount);
+		bounds.Resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			glm::vec3 center(random.NextFloat(-500.f, 500.f), random.NextFloat(-500.f, 500.f), random.NextFloat(-500.f, 500.f));
+			float radius = random.NextFloat(0.5f, 4.f);
+			spheres[i] = glm::vec4(center, radius);
+			boxes[i].min = center - radius;
+			boxes[i].max = center + radius;
+			bounds.SetSphere(i, spheres[i]);
+			bounds.SetAabb(i, boxes[i].min, boxes[i].max);
+		}
+
+		glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 1000.f);
+		projection[1][1] *= -1.f;
+		viewProjection = projection * view;
+		frustum = ExtractFrustum(viewProjection);
+	}
+};
+
+static LavaBenchBody CullBoundsBench(LavaBenchContext& context, LavaCullShape shape, bool threaded, uint32_t objectCount = cullObjectCount)
+{
+	if (threaded && !context.jobSystem)
+		return LavaBenchBody();
+
+	std::shared_ptr<CullScene> scene(new CullScene(objectCount));
+	LavaJobSystem* jobSystem = threaded ? context.jobSystem : nullptr;
+	CullBounds(scene->frustum, scene->bounds, shape, jobSystem, scene->visible);
+	context.SetCounter("visible", double(scene->visible.size()));
+	return [scene, shape, jobSystem, objectCount]() {
+		CullBounds(scene->frustum, scene->bounds, shape, jobSystem, scene->visible);
+		return uint64_t(objectCount);
+	};
+}
+
+LAVA_BENCH("cull/spheres_100k", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_SPHERES, false); });
+LAVA_BENCH("cull/spheres_100k_jobs", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_SPHERES, true); });
+LAVA_BENCH("cull/aabbs_100k", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_AABBS, false); });
+LAVA_BENCH("cull/aabbs_100k_jobs", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_AABBS, true); });
+//Scene sized past the last level cache, the chunked job split has to pay for itself here.
+LAVA_BENCH("cull/spheres_1m_jobs", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_SPHERES, true, 1000000); });
+LAVA_BENCH("cull/aabbs_1m_jobs", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_AABBS, true, 1000000); });
+
+static LavaBenchBody BvhBuildBench(LavaBenchContext& context, uint32_t objectCount)
+{
+	std::shared_ptr<CullScene> scene(new CullScene(objectCount));
+	std::shared_ptr<LavaBvh> bvh(new LavaBvh());
+	LavaJobSystem* jobSystem = context.jobSystem;
+	bvh->Build(scene->boxes.data(), objectCount, jobSystem);
+	context.SetCounter("nodes", double(bvh->GetNodeCount()));
+	context.SetCounter("sah_cost", bvh->ComputeSahCost());
+	return [scene, bvh, jobSystem, objectCount]() {
+		bvh->Build(scene->boxes.data(), objectCount, jobSystem);
+		return uint64_t(objectCount);
+	};
+}
+
+static LavaBenchBody BvhCullBench(LavaBenchContext& context, uint32_t objectCount)
+{
+	std::shared_ptr<CullScene> scene(new CullScene(objectCount));
+	std::shared_ptr<LavaBvh> bvh(new LavaBvh());
+	bvh->Build(scene->boxes.data(), objectCount, context.jobSystem);
+	bvh->CullFrustum(scene->frustum, scene->visible);
+	context.SetCounter("visible", double(scene->visible.size()));
+	return [scene, bvh, objectCount]() {
+		bvh->CullFrustum(scene->frustum, scene->visible);
+		return uint64_t(objectCount);
+	};
+}
+
+//1% of the objects move every iteration and refit their paths. Rebuilds are disabled so only the refit is timed.
+static LavaBenchBody BvhRefitBench(LavaBenchContext& context, uint32_t objectCount)
+{
+	struct State {
+		CullScene scene;
+		LavaBvh bvh;
+		LavaBenchRandom random;
+		float offset = 0.f;
+
+		State(uint32_t objectCount) : scene(objectCount) {}
+	};
+	std::shared_ptr<State> state(new State(objectCount));
+	state->bvh.rebuildMovedFraction = 1e9f;
+	state->bvh.rebuildAreaGrowth = 1e9f;
+	state->bvh.Build(state->scene.boxes.data(), objectCount, context.jobSystem);
+	return [state, objectCount]() {
+		const uint32_t movedCount = objectCount / 100;
+		state->offset = -state->offset + 0.5f;
+		for (uint32_t i = 0; i < movedCount; i++) {
+			uint32_t object = state->random.Next() % objectCount;
+			LavaAabb box = state->scene.boxes[object];
+			box.min.y += state->offset;
+			box.max.y += state->offset;
+			state->bvh.UpdateObject(object, box);
+		}
+		state->bvh.Refit();
+		return uint64_t(movedCount);
+	};
+}
+
+//Mouse picks, 1024 rays from the camera through random points of the view. Items are rays.
+static LavaBenchBody BvhRaycastBench(LavaBenchContext& context, uint32_t objectCount)
+{
+	const uint32_t rayCount = 1024;
+	std::shared_ptr<CullScene> scene(new CullScene(objectCount));
+	std::shared_ptr<LavaBvh> bvh(new LavaBvh());
+	bvh->Build(scene->boxes.data(), objectCount, context.jobSystem);
+
+	std::shared_ptr<std::vector<glm::vec3>> directions(new std::vector<glm::vec3>(rayCount));
+	LavaBenchRandom random;
+	for (glm::vec3& direction : *directions) {
+		direction = glm::normalize(glm::vec3(random.NextFloat(-0.9f, 0.9f), random.NextFloat(-0.5f, 0.5f), 1.f));
+	}
+	auto castAll = [bvh, directions]() {
+		uint64_t hitCount = 0;
+		for (const glm::vec3& direction : *directions) {
+			LavaBvhHit hit;
+			hitCount += bvh->Raycast(glm::vec3(0.f), direction, 1000.f, hit);
+		}
+		return hitCount;
+	};
+	context.SetCounter("hits", double(castAll()));
+	return [castAll, rayCount]() {
+		LavaBenchKeep(castAll());
+		return uint64_t(rayCount);
+	};
+}
+
+//Gameplay style range queries, 1024 spheres of 20 units radius around random objects. Items are queries.
+static LavaBenchBody BvhQuerySphereBench(LavaBenchContext& context, uint32_t objectCount)
+{
+	const uint32_t queryCount = 1024;
+	std::shared_ptr<CullScene> scene(new CullScene(objectCount));
+	std::shared_ptr<LavaBvh> bvh(new LavaBvh());
+	bvh->Build(scene->boxes.data(), objectCount, context.jobSystem);
+
+	std::shared_ptr<std::vector<glm::vec3>> centers(new std::vector<glm::vec3>(queryCount));
+	LavaBenchRandom random;
+	for (glm::vec3& center : *centers) {
+		center = glm::vec3(scene->spheres[random.Next() % objectCount]);
+	}
+	auto queryAll = [scene, bvh, centers]() {
+		uint64_t foundCount = 0;
+		for (const glm::vec3& center : *centers) {
+			bvh->QuerySphere(center, 20.f, scene->visible);
+			foundCount += scene->visible.size();
+		}
+		return foundCount;
+	};
+	context.SetCounter("found_per_query", double(queryAll()) / queryCount);
+	return [queryAll, queryCount]() {
+		LavaBenchKeep(queryAll());
+		return uint64_t(queryCount);
+	};
+}
+
+LAVA_BENCH("bvh/build_100k", [](LavaBenchContext& context) { return BvhBuildBench(context, cullObjectCount); });
+LAVA_BENCH("bvh/build_1m", [](LavaBenchContext& context) { return BvhBuildBench(context, 1000000); });
+LAVA_BENCH("bvh/cull_frustum_100k", [](LavaBenchContext& context) { return BvhCullBench(context, cullObjectCount); });
+LAVA_BENCH("bvh/cull_frustum_1m", [](LavaBenchContext& context) { return BvhCullBench(context, 1000000); });
+//Flat single threaded AABB sweep over the same scenes, the baseline the BVH cull has to beat.
+LAVA_BENCH("bvh/cull_flat_100k", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_AABBS, false); });
+LAVA_BENCH("bvh/cull_flat_1m", [](LavaBenchContext& context) { return CullBoundsBench(context, LAVA_CULL_AABBS, false, 1000000); });
+LAVA_BENCH("bvh/refit_1pct_100k", [](LavaBenchContext& context) { return BvhRefitBench(context, cullObjectCount); });
+LAVA_BENCH("bvh/refit_1pct_1m", [](LavaBenchContext& context) { return BvhRefitBench(context, 1000000); });
+LAVA_BENCH("bvh/raycast_1k_100k", [](LavaBenchContext& context) { return BvhRaycastBench(context, cullObjectCount); });
+LAVA_BENCH("bvh/query_sphere_1k_100k", [](LavaBenchContext& context) { return BvhQuerySphereBench(context, cullObjectCount); });
+
+//64 large boxes in front of the camera rasterized into the 256x128 buffer the renderer uses,
+//then every object's bounds tested against the depth pyramid.
+LAVA_BENCH("occlusion/raster_64_test_100k", [](LavaBenchContext& context) -> LavaBenchBody {
+	struct State {
+		CullScene scene = CullScene(cullObjectCount);
+		LavaOcclusionCuller culler;
+		std::vector<glm::vec3> cubePositions;
+		std::vector<uint32_t> cubeIndices;
+		std::vector<glm::mat4> occluderWorlds;
+		std::vector<uint8_t> visible;
+	};
+	std::shared_ptr<State> state(new State());
+	for (uint32_t i = 0; i < 8; i++) {
+		state->cubePositions.push_back(glm::vec3(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f));
+	}
+	const uint32_t faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+	for (const uint32_t* face : faces) {
+		const uint32_t quad[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+		state->cubeIndices.insert(state->cubeIndices.end(), quad, quad + 6);
+	}
+
+	LavaBenchRandom random;
+	for (uint32_t i = 0; i < 64; i++) {
+		glm::vec3 position(random.NextFloat(-150.f, 150.f), random.NextFloat(-80.f, 80.f), random.NextFloat(60.f, 300.f));
+		glm::vec3 scale(random.NextFloat(5.f, 30.f), random.NextFloat(5.f, 30.f), random.NextFloat(1.f, 5.f));
+		state->occluderWorlds.push_back(glm::scale(glm::translate(glm::mat4(1.f), position), scale));
+	}
+	state->culler.Init(256, 128);
+	state->visible.resize(cullObjectCount);
+
+	LavaJobSystem* jobSystem = context.jobSystem;
+	auto run = [state, jobSystem]() {
+		state->culler.BeginFrame(state->scene.viewProjection);
+		for (const glm::mat4& world : state->occluderWorlds) {
+			LavaOccluder occluder;
+			occluder.positions = &state->cubePositions[0].x;
+			occluder.positionStride = sizeof(glm::vec3);
+			occluder.indices = state->cubeIndices.data();
+			occluder.indexCount = uint32_t(state->cubeIndices.size());
+			occluder.world = world;
+			state->culler.AddOccluder(occluder);
+		}
+		state->culler.Rasterize(jobSystem);
+		state->culler.TestVisibility(state->scene.boxes.data(), cullObjectCount, state->visible.data(), jobSystem);
+		return uint64_t(cullObjectCount);
+	};
+
+	run();
+	uint32_t visibleCount = 0;
+	for (uint8_t flag : state->visible) {
+		visibleCount += flag;
+	}
+	context.SetCounter("visible", double(visibleCount));
+	return run;
+});
@@ -0,0 +1,205 @@
+#include "LavaBench.h"
+#include "LavaScene.h"
+#include "LavaCulling.h"
+#include "LavaDrawList.h"
+#include "LavaJobs.h"
+
+#include <string.h>
+#include <memory>
+#include <gtc/matrix_transform.hpp>
+
+static const uint32_t frameObjectCount = 100000;
+
+//Same layout as LavaInstance, the renderer header pulls in GLFW.
+struct BenchInstance {
+	glm::vec4 transform[3];
+	uint32_t materialIndex;
+	float color[3];
+};
+
+//Cube grid with 3 units spacing like the renderer's instance grid. With parentCount > 0 the objects hang under
+//that many parent nodes instead, so moving a parent dirties its whole subtree.
+static float BuildBenchScene(LavaScene& scene, uint32_t objectCount, uint32_t parentCount)
+{
+	const float spacing = 3.f;
+	uint32_t side = 1;
+	while (side * side * side < objectCount)
+		side++;
+
+	std::vector<LavaNodeHandle> parents;
+	for (uint32_t i = 0; i < parentCount; i++) {
+		parents.push_back(scene.CreateNode());
+	}
+
+	float halfExtent = (side - 1) * spacing * 0.5f;
+	for (uint32_t i = 0; i < objectCount; i++) {
+		LavaNodeHandle node = scene.CreateNode(parents.empty() ? LAVA_INVALID_NODE : parents[i % parentCount]);
+		scene.SetPosition(node, glm::vec3((i % side) * spacing - halfExtent, ((i / side) % side) * spacing - halfExtent,
+			(i / (side * side)) * spacing - halfExtent));
+	}
+	return halfExtent * 1.7320508f + spacing;
+}
+
+static LavaBenchBody SceneUpdateBench(LavaBenchContext& context, uint32_t parentCount, uint32_t movedCount)
+{
+	struct State {
+		LavaScene scene;
+		LavaBenchRandom random;
+		uint32_t frame = 0;
+	};
+	std::shared_ptr<State> state(new State());
+	BuildBenchScene(state->scene, frameObjectCount, parentCount);
+	state->scene.Update(context.jobSystem);
+
+	//Parents are the first handles, with a hierarchy only they move.
+	uint32_t movableCount = parentCount ? parentCount : frameObjectCount;
+	LavaJobSystem* jobSystem = context.jobSystem;
+	return [state, movableCount, movedCount, jobSystem]() {
+		float angle = float(++state->frame) * 0.01f;
+		for (uint32_t i = 0; i < movedCount; i++) {
+			state->scene.SetRotation(state->random.Next() % movableCount, glm::angleAxis(angle, glm::vec3(0.f, 1.f, 0.f)));
+		}
+		state->scene.Update(jobSystem);
+		return uint64_t(state->scene.GetChangedNodes().size());
+	};
+}
+
+LAVA_BENCH("scene/update_100k_1pct", [](LavaBenchContext& context) { return SceneUpdateBench(context, 0, frameObjectCount / 100); });
+LAVA_BENCH("scene/update_100k_hierarchy", [](LavaBenchContext& context) { return SceneUpdateBench(context, 1000, 10); });
+
+//1M flat nodes with an exact changed fraction, every moved node is a distinct one spread evenly over the handles.
+//Shows where the dirty list walk stops paying off against a full level sweep.
+static LavaBenchBody SceneUpdateFractionBench(LavaBenchContext& context, uint32_t objectCount, uint32_t movedCount)
+{
+	struct State {
+		LavaScene scene;
+		uint32_t frame = 0;
+	};
+	std::shared_ptr<State> state(new State());
+	BuildBenchScene(state->scene, objectCount, 0);
+	state->scene.Update(context.jobSystem);
+
+	uint32_t stride = objectCount / movedCount;
+	LavaJobSystem* jobSystem = context.jobSystem;
+	return [state, movedCount, stride, jobSystem]() {
+		uint32_t frame = ++state->frame;
+		glm::quat rotation = glm::angleAxis(float(frame) * 0.01f, glm::vec3(0.f, 1.f, 0.f));
+		for (uint32_t i = 0; i < movedCount; i++) {
+			state->scene.SetRotation(i * stride + frame % stride, rotation);
+		}
+		state->scene.Update(jobSystem);
+		return uint64_t(state->scene.GetChangedNodes().size());
+	};
+}
+
+static struct SceneUpdateSweepRegistrar {
+	SceneUpdateSweepRegistrar()
+	{
+		const uint32_t objectCount = 1000000;
+		const struct {
+			const char* name;
+			uint32_t movedCount;
+		} sweeps[] = {
+			{ "scene/update_1m_0.1pct", objectCount / 1000 },
+			{ "scene/update_1m_1pct", objectCount / 100 },
+			{ "scene/update_1m_10pct", objectCount / 10 },
+			{ "scene/update_1m_100pct", objectCount },
+		};
+		for (const auto& sweep : sweeps) {
+			uint32_t movedCount = sweep.movedCount;
+			LavaRegisterBench(sweep.name, [objectCount, movedCount](LavaBenchContext& context) {
+				return SceneUpdateFractionBench(context, objectCount, movedCount);
+			});
+		}
+	}
+} sceneUpdateSweepRegistrar;
+
+//CPU side of one renderer frame without the device: moved nodes update, changed transforms go to the instance
+//data and culling bounds, orbit camera frustum cull, visible instance copy, per object draw list build and sort,
+//then both passes replayed into the counting command buffer.
+LAVA_BENCH("frame/cpu_100k", [](LavaBenchContext& context) -> LavaBenchBody {
+	struct State {
+		LavaScene scene;
+		std::vector<BenchInstance> instances;
+		std::vector<BenchInstance> instanceStream;
+		LavaCullingBounds cullingBounds;
+		std::vector<uint32_t> visibleInstances;
+		LavaDrawList drawList;
+		LavaBenchRandom random;
+		float sceneRadius = 0.f;
+		uint32_t frame = 0;
+	};
+	std::shared_ptr<State> state(new State());
+	state->sceneRadius = BuildBenchScene(state->scene, frameObjectCount, 0);
+	state->instances.resize(frameObjectCount);
+	state->instanceStream.resize(frameObjectCount);
+	state->cullingBounds.Resize(frameObjectCount);
+	for (uint32_t i = 0; i < frameObjectCount; i++) {
+		state->instances[i] = {};
+		state->instances[i].materialIndex = i % 8;
+	}
+
+	const glm::vec4 meshSphere(0.f, 0.f, 0.f, 1.2f);
+	LavaJobSystem* jobSystem = context.jobSystem;
+	auto run = [state, meshSphere, jobSystem]() {
+		State& frame = *state;
+		float time = float(++frame.frame) * 0.016f;
+		for (uint32_t i = 0; i < frameObjectCount / 100; i++) {
+			frame.scene.SetRotation(frame.random.Next() % frameObjectCount, glm::angleAxis(time, glm::vec3(0.f, 1.f, 0.f)));
+		}
+
+		frame.scene.Update(jobSystem);
+		for (LavaNodeHandle node : frame.scene.GetChangedNodes()) {
+			const LavaAffineTransform& world = frame.scene.GetWorldTransform(node);
+			memcpy(frame.instances[node].transform, world.rows, sizeof(frame.instances[node].transform));
+			frame.cullingBounds.SetSphere(node, TransformBoundingSphere(world, meshSphere));
+		}
+
+		//Orbit camera from LavaRenderer::GetCamera.
+		float distance = frame.sceneRadius;
+		glm::vec3 cameraPosition(sinf(time * 0.2f) * distance, 0.f, cosf(time * 0.2f) * distance);
+		glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.f), 1024.f / 768.f, 0.1f, distance + frame.sceneRadius * 2.f);
+		projection[1][1] *= -1.f;
+		LavaFrustum frustum = ExtractFrustum(projection * view);
+
+		CullBounds(frustum, frame.cullingBounds, LAVA_CULL_SPHERES, jobSystem, frame.visibleInstances);
+		uint32_t drawInstanceCount = uint32_t(frame.visibleInstances.size());
+		LavaParallelFor(jobSystem, drawInstanceCount, 4096, [&](uint32_t begin, uint32_t end, uint32_t) {
+			for (uint32_t i = begin; i < end; i++) {
+				frame.instanceStream[i] = frame.instances[frame.visibleInstances[i]];
+			}
+		});
+
+		frame.drawList.Reset();
+		float depthScale = 1.f / (3.f * frame.sceneRadius);
+		for (uint32_t drawPass = 0; drawPass <= 1; drawPass++) {
+			LavaDrawPacket packet = {};
+			packet.pipeline = VkPipeline(uintptr_t(drawPass + 1));
+			packet.vertexBuffers[0] = VkBuffer(uintptr_t(drawPass + 1));
+			packet.vertexBuffers[1] = VkBuffer(uintptr_t(3));
+			packet.indexBuffer = VkBuffer(uintptr_t(4));
+			packet.indexCount = 3 * 1000;
+			packet.instanceCount = 1;
+			for (uint32_t i = 0; i < drawInstanceCount; i++) {
+				const BenchInstance& instance = frame.instanceStream[i];
+				glm::vec3 position(instance.transform[0].w, instance.transform[1].w, instance.transform[2].w);
+				packet.firstInstance = i;
+				frame.drawList.Push(LavaMakeDrawKey(drawPass, drawPass, instance.materialIndex, 0,
+					LavaDepthBucket(glm::length(position - cameraPosition) * depthScale)), packet);
+			}
+		}
+		frame.drawList.Sort(jobSystem);
+
+		VkCommandBuffer commandBuffer = reinterpret_cast<VkCommandBuffer>(uintptr_t(1));
+		LavaDrawListStats stats = {};
+		frame.drawList.Submit(commandBuffer, 0, stats);
+		frame.drawList.Submit(commandBuffer, 1, stats);
+		return uint64_t(frameObjectCount);
+	};
+
+	//First frame pushes every node through the changed list.
+	run();
+	context.SetCounter("visible", double(state->visibleInstances.size()));
+	return run;
+});
@@ -0,0 +1,75 @@
+#include "LavaBench.h"
+#include "LavaMesh.h"
+
+#include <stdio.h>
+#include <memory>
+
+static bool FileExists(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file)
+		fclose(file);
+	return file != nullptr;
+}
+
+//Parse + weld of the whole obj, the startup cost of a mesh.
+LAVA_BENCH("mesh/load_obj_monkey", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::string path = context.AssetPath("monkey.obj");
+	if (!FileExists(path))
+		return LavaBenchBody();
+
+	Mesh mesh = LoadMesh(path.c_str());
+	context.SetCounter("vertices", double(mesh.vertices.size()));
+	context.SetCounter("indices", double(mesh.indices.size()));
+	return [path]() {
+		Mesh loaded = LoadMesh(path.c_str());
+		return uint64_t(loaded.indices.size());
+	};
+});
+
+//Unwelded face corners of the monkey, the input LoadMesh hands to the welder.
+LAVA_BENCH("mesh/weld_monkey", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::string path = context.AssetPath("monkey.obj");
+	if (!FileExists(path))
+		return LavaBenchBody();
+
+	Mesh source = LoadMesh(path.c_str());
+	std::shared_ptr<std::vector<Vertex>> corners(new std::vector<Vertex>());
+	for (uint32_t index : source.indices) {
+		corners->push_back(source.vertices[index]);
+	}
+	std::shared_ptr<Mesh> mesh(new Mesh());
+	return [corners, mesh]() {
+		WeldVertices(corners->data(), uint32_t(corners->size()), *mesh);
+		return uint64_t(corners->size());
+	};
+});
+
+//Two triangles per cell of a 256x256 grid, every vertex is shared by up to 6 corners.
+LAVA_BENCH("mesh/weld_grid_256", [](LavaBenchContext& context) -> LavaBenchBody {
+	const uint32_t side = 256;
+	std::shared_ptr<std::vector<Vertex>> corners(new std::vector<Vertex>());
+	auto gridVertex = [](uint32_t x, uint32_t y) {
+		Vertex vertex = {};
+		vertex.Position = { float(x), 0.f, float(y) };
+		vertex.Normal = { 0.f, 1.f, 0.f };
+		return vertex;
+	};
+	for (uint32_t y = 0; y < side; y++) {
+		for (uint32_t x = 0; x < side; x++) {
+			const uint32_t cornerX[6] = { 0, 1, 1, 0, 1, 0 };
+			const uint32_t cornerY[6] = { 0, 0, 1, 0, 1, 1 };
+			for (uint32_t c = 0; c < 6; c++) {
+				corners->push_back(gridVertex(x + cornerX[c], y + cornerY[c]));
+			}
+		}
+	}
+
+	std::shared_ptr<Mesh> mesh(new Mesh());
+	WeldVertices(corners->data(), uint32_t(corners->size()), *mesh);
+	context.SetCounter("vertices", double(mesh->vertices.size()));
+	return [corners, mesh]() {
+		WeldVertices(corners->data(), uint32_t(corners->size()), *mesh);
+		return uint64_t(corners->size());
+	};
+});
@@ -0,0 +1,37 @@
+#include "LavaBench.h"
+#include "LavaProfiler.h"
+
+//Cost of one CPU zone, recording into the thread's buffer and with no capture running. Skipped when the
+//profiler is compiled out.
+static const uint32_t benchZoneCount = 4096;
+
+LAVA_BENCH("profiler/zone_capturing", [](LavaBenchContext&) -> LavaBenchBody {
+#if LAVA_PROFILER
+	LavaProfilerNanosecondsPerTick(); //Calibration spin stays out of the timings
+	return []() {
+		LavaProfilerBeginCapture();
+		for (uint32_t i = 0; i < benchZoneCount; i++) {
+			LAVA_PROFILE_ZONE("Bench zone");
+			LavaBenchKeep(i);
+		}
+		LavaProfilerEndCapture();
+		return uint64_t(benchZoneCount);
+	};
+#else
+	return LavaBenchBody();
+#endif
+});
+
+LAVA_BENCH("profiler/zone_idle", [](LavaBenchContext&) -> LavaBenchBody {
+#if LAVA_PROFILER
+	return []() {
+		for (uint32_t i = 0; i < benchZoneCount; i++) {
+			LAVA_PROFILE_ZONE("Bench zone");
+			LavaBenchKeep(i);
+		}
+		return uint64_t(benchZoneCount);
+	};
+#else
+	return LavaBenchBody();
+#endif
+});
@@ -0,0 +1,73 @@
+#include "LavaBench.h"
+#include "LavaDrawList.h"
+
+#include <memory>
+
+static const uint32_t drawPacketCount = 100000;
+
+//Per object draws like the renderer's drawPerObject mode: a few pipelines and materials, the rest of the key is depth.
+static void PushBenchDraws(LavaDrawList& drawList, LavaBenchRandom& random)
+{
+	drawList.Reset();
+	for (uint32_t i = 0; i < drawPacketCount; i++) {
+		uint32_t pipeline = random.Next() % 4;
+		uint32_t material = random.Next() % 64;
+		uint32_t mesh = random.Next() % 16;
+
+		LavaDrawPacket packet = {};
+		packet.pipeline = VkPipeline(uintptr_t(pipeline + 1));
+		packet.vertexBuffers[0] = VkBuffer(uintptr_t(mesh + 1));
+		packet.vertexBuffers[1] = VkBuffer(uintptr_t(100));
+		packet.indexBuffer = VkBuffer(uintptr_t(mesh + 1));
+		packet.indexCount = 3 * 1000;
+		packet.instanceCount = 1;
+		packet.firstInstance = i;
+		drawList.Push(LavaMakeDrawKey(1, pipeline, material, mesh, LavaDepthBucket(random.NextFloat(0.f, 1.f))), packet);
+	}
+}
+
+LAVA_BENCH("record/drawlist_build_sort_100k", [](LavaBenchContext& context) -> LavaBenchBody {
+	struct State {
+		LavaDrawList drawList;
+		LavaBenchRandom random;
+	};
+	std::shared_ptr<State> state(new State());
+	LavaJobSystem* jobSystem = context.jobSystem;
+	return [state, jobSystem]() {
+		PushBenchDraws(state->drawList, state->random);
+		state->drawList.Sort(jobSystem);
+		return uint64_t(drawPacketCount);
+	};
+});
+
+//Replay of a sorted list through the state cache. Items are draws, the counter is recorded commands per draw.
+LAVA_BENCH("record/drawlist_submit_100k", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<LavaDrawList> drawList(new LavaDrawList());
+	LavaBenchRandom random;
+	PushBenchDraws(*drawList, random);
+	drawList->Sort(context.jobSystem);
+
+	VkCommandBuffer commandBuffer = reinterpret_cast<VkCommandBuffer>(uintptr_t(1));
+	LavaDrawListStats stats = {};
+	uint64_t commandsBefore = LavaBenchRecordedCommands();
+	drawList->Submit(commandBuffer, 1, stats);
+	context.SetCounter("commands_per_draw", double(LavaBenchRecordedCommands() - commandsBefore) / double(stats.draws));
+	context.SetCounter("pipeline_binds", double(stats.pipelineBinds));
+
+	return [drawList, commandBuffer]() {
+		LavaDrawListStats stats = {};
+		drawList->Submit(commandBuffer, 1, stats);
+		return uint64_t(stats.draws);
+	};
+});
+
+LAVA_BENCH("record/drawlist_hash_100k", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<LavaDrawList> drawList(new LavaDrawList());
+	LavaBenchRandom random;
+	PushBenchDraws(*drawList, random);
+	drawList->Sort(context.jobSystem);
+	return [drawList]() {
+		LavaBenchKeep(drawList->ComputeHash());
+		return uint64_t(drawPacketCount);
+	};
+});
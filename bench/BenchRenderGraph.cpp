@@ -0,0 +1,114 @@
+#include "LavaBench.h"
+#include "LavaRenderGraph.h"
+
+#include <memory>
+#include <string>
+
+//Deferred style frame: gbuffer, lighting, a bloom chain and post passes over transient images, plus a debug pass
+//nobody reads that gets culled. Built once so the repeated Compile() reuses its vectors, like the renderer.
+static void BuildBenchGraph(LavaRenderGraph& graph)
+{
+	std::function<void(VkCommandBuffer)> noCommands = [](VkCommandBuffer) {};
+	auto image = [](VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+		LavaGraphImageDesc desc = {};
+		desc.format = format;
+		desc.width = width;
+		desc.height = height;
+		desc.usage = usage;
+		desc.aspect = aspect;
+		return desc;
+	};
+	const VkImageUsageFlags colorUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+
+	LavaGraphResource swapchain = graph.ImportImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, LAVA_GRAPH_PRESENT);
+	LavaGraphResource depth = graph.CreateImage("depth", image(VK_FORMAT_D32_SFLOAT, width, height,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT));
+	LavaGraphResource albedo = graph.CreateImage("albedo", image(VK_FORMAT_R8G8B8A8_UNORM, width, height, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+	LavaGraphResource normals = graph.CreateImage("normals", image(VK_FORMAT_R16G16B16A16_SFLOAT, width, height, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+	LavaGraphResource hdr = graph.CreateImage("hdr", image(VK_FORMAT_R16G16B16A16_SFLOAT, width, height, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+
+	uint32_t prepass = graph.AddPass("depth prepass", noCommands);
+	graph.Write(prepass, depth, LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE);
+
+	uint32_t gbuffer = graph.AddPass("gbuffer", noCommands);
+	graph.Read(gbuffer, depth, LAVA_GRAPH_DEPTH_ATTACHMENT_READ);
+	graph.Write(gbuffer, albedo, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Write(gbuffer, normals, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+
+	uint32_t lighting = graph.AddPass("lighting", noCommands);
+	graph.Read(lighting, depth, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Read(lighting, albedo, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Read(lighting, normals, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(lighting, hdr, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+
+	uint32_t debugView = graph.AddPass("debug normals", noCommands);
+	graph.Read(debugView, normals, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(debugView, graph.CreateImage("debug", image(VK_FORMAT_R8G8B8A8_UNORM, width, height, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT)),
+		LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+
+	//Downsample chain then upsample back, each level is its own transient so early levels can alias late ones.
+	const uint32_t bloomLevels = 6;
+	std::vector<LavaGraphResource> down;
+	LavaGraphResource source = hdr;
+	for (uint32_t level = 0; level < bloomLevels; level++) {
+		std::string name = "bloom down " + std::to_string(level);
+		LavaGraphResource target = graph.CreateImage(name.c_str(), image(VK_FORMAT_R16G16B16A16_SFLOAT, width >> (level + 1), height >> (level + 1),
+			colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+		uint32_t pass = graph.AddPass(name.c_str(), noCommands);
+		graph.Read(pass, source, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+		graph.Write(pass, target, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+		down.push_back(target);
+		source = target;
+	}
+	for (uint32_t level = bloomLevels - 1; level > 0; level--) {
+		std::string name = "bloom up " + std::to_string(level);
+		LavaGraphResource target = graph.CreateImage(name.c_str(), image(VK_FORMAT_R16G16B16A16_SFLOAT, width >> level, height >> level,
+			colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+		uint32_t pass = graph.AddPass(name.c_str(), noCommands);
+		graph.Read(pass, source, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+		graph.Read(pass, down[level - 1], LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+		graph.Write(pass, target, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+		source = target;
+	}
+
+	LavaGraphResource ldr = graph.CreateImage("ldr", image(VK_FORMAT_R8G8B8A8_UNORM, width, height, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+	uint32_t tonemap = graph.AddPass("tonemap", noCommands);
+	graph.Read(tonemap, hdr, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Read(tonemap, source, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(tonemap, ldr, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+
+	uint32_t present = graph.AddPass("antialias", noCommands);
+	graph.Read(present, ldr, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(present, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+}
+
+//Pass culling, transient placement in the aliased heap and barrier derivation.
+LAVA_BENCH("graph/compile", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<LavaRenderGraph> graph(new LavaRenderGraph());
+	BuildBenchGraph(*graph);
+	graph->Compile();
+	context.SetCounter("passes", double(graph->GetSchedule().size()));
+	context.SetCounter("barriers", double(graph->GetBarriers().size()));
+	context.SetCounter("heap_mb", double(graph->GetTransientHeapSize()) / (1024.0 * 1024.0));
+	return [graph]() {
+		graph->Compile();
+		return uint64_t(graph->GetSchedule().size());
+	};
+});
+
+//Barrier batches and timestamps recorded into the counting command buffer, the passes themselves record nothing.
+LAVA_BENCH("graph/execute", [](LavaBenchContext&) -> LavaBenchBody {
+	std::shared_ptr<LavaRenderGraph> graph(new LavaRenderGraph());
+	BuildBenchGraph(*graph);
+	graph->Compile();
+	VkCommandBuffer commandBuffer = reinterpret_cast<VkCommandBuffer>(uintptr_t(1));
+	VkQueryPool timestampPool = VkQueryPool(uintptr_t(1));
+	return [graph, commandBuffer, timestampPool]() {
+		uint64_t commandsBefore = LavaBenchRecordedCommands();
+		graph->Execute(commandBuffer, timestampPool);
+		return LavaBenchRecordedCommands() - commandsBefore;
+	};
+});
@@ -0,0 +1,85 @@
+#include "LavaBench.h"
+#include "LavaImage.h"
+#include "LavaTextureCompression.h"
+
+#include <math.h>
+#include <algorithm>
+#include <memory>
+
+//Smooth gradients with a few sharp edges and some noise, so every encoder mode has something to fit.
+static void BuildBenchImage(LavaImage& image, uint32_t size)
+{
+	LavaBenchRandom random;
+	image.width = size;
+	image.height = size;
+	image.rgba.resize(size * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint8_t* pixel = &image.rgba[(y * size + x) * 4];
+			float u = float(x) / float(size);
+			float v = float(y) / float(size);
+			bool checker = ((x / 32) ^ (y / 32)) & 1;
+			int noise = int(random.Next() % 9) - 4;
+			pixel[0] = uint8_t(std::min(255, std::max(0, int(255.f * u) + noise)));
+			pixel[1] = uint8_t(std::min(255, std::max(0, int(127.5f + 127.5f * sinf(v * 12.f)) + noise)));
+			pixel[2] = checker ? 200 : 40;
+			pixel[3] = uint8_t(255.f * (1.f - v));
+		}
+	}
+}
+
+static LavaBenchBody CompressionBench(LavaBenchContext& context, LavaBlockFormat format, LavaCompressionQuality quality, uint32_t size)
+{
+	struct State {
+		LavaImage image;
+		std::vector<uint8_t> blocks;
+	};
+	std::shared_ptr<State> state(new State());
+	BuildBenchImage(state->image, size);
+
+	LavaCompressImage(state->image, format, quality, context.jobSystem, state->blocks);
+	LavaImage decoded;
+	LavaDecompressImage(state->blocks.data(), format, size, size, decoded);
+	context.SetCounter("psnr", LavaComputePsnr(state->image, decoded, LavaBlockChannelCount(format)));
+
+	uint64_t blockCount = uint64_t(size / 4) * (size / 4);
+	LavaJobSystem* jobSystem = context.jobSystem;
+	return [state, format, quality, jobSystem, blockCount]() {
+		LavaCompressImage(state->image, format, quality, jobSystem, state->blocks);
+		return blockCount;
+	};
+}
+
+LAVA_BENCH("texture/bc1_fast_512", [](LavaBenchContext& context) { return CompressionBench(context, LAVA_BLOCK_BC1, LAVA_COMPRESSION_FAST, 512); });
+LAVA_BENCH("texture/bc1_normal_512", [](LavaBenchContext& context) { return CompressionBench(context, LAVA_BLOCK_BC1, LAVA_COMPRESSION_NORMAL, 512); });
+LAVA_BENCH("texture/bc3_normal_256", [](LavaBenchContext& context) { return CompressionBench(context, LAVA_BLOCK_BC3, LAVA_COMPRESSION_NORMAL, 256); });
+LAVA_BENCH("texture/bc5_normal_256", [](LavaBenchContext& context) { return CompressionBench(context, LAVA_BLOCK_BC5, LAVA_COMPRESSION_NORMAL, 256); });
+LAVA_BENCH("texture/bc7_normal_256", [](LavaBenchContext& context) { return CompressionBench(context, LAVA_BLOCK_BC7, LAVA_COMPRESSION_NORMAL, 256); });
+
+//Same encode with each index search kernel forced, the default benches above use whatever the dispatcher picked.
+static LavaBenchBody CompressionKernelBench(LavaBenchContext& context, LavaCompressionKernel kernel)
+{
+	if (!LavaIsCompressionKernelSupported(kernel))
+		return LavaBenchBody();
+	LavaBenchBody body = CompressionBench(context, LAVA_BLOCK_BC7, LAVA_COMPRESSION_NORMAL, 256);
+	return [body, kernel]() {
+		LavaSetCompressionKernel(kernel);
+		uint64_t blockCount = body();
+		LavaSetCompressionKernel(LavaGetBestCompressionKernel());
+		return blockCount;
+	};
+}
+
+LAVA_BENCH("texture/bc7_normal_256_scalar", [](LavaBenchContext& context) { return CompressionKernelBench(context, LAVA_COMPRESSION_KERNEL_SCALAR); });
+LAVA_BENCH("texture/bc7_normal_256_sse2", [](LavaBenchContext& context) { return CompressionKernelBench(context, LAVA_COMPRESSION_KERNEL_SSE2); });
+LAVA_BENCH("texture/bc7_normal_256_avx2", [](LavaBenchContext& context) { return CompressionKernelBench(context, LAVA_COMPRESSION_KERNEL_AVX2); });
+
+LAVA_BENCH("texture/mip_chain_srgb_1024", [](LavaBenchContext&) -> LavaBenchBody {
+	std::shared_ptr<LavaImage> image(new LavaImage());
+	BuildBenchImage(*image, 1024);
+	std::shared_ptr<std::vector<LavaImage>> levels(new std::vector<LavaImage>());
+	return [image, levels]() {
+		LavaGenerateMipChain(*image, true, *levels);
+		return uint64_t(image->width) * image->height;
+	};
+});
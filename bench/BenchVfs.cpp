@@ -0,0 +1,158 @@
+#include "LavaBench.h"
+#include "LavaJobs.h"
+#include "LavaVfs.h"
+
+#include <stdio.h>
+#include <filesystem>
+#include <memory>
+
+//Small file heavy loading: 2048 files of 1 to 8 KB in 16 directories, text like so LZ4 roughly halves them.
+//Written once to the temp directory and left there, runs read page cached data, so this measures the cost per
+//file (opens, syscalls, copies) rather than the disk.
+static const uint32_t vfsBenchFileCount = 2048;
+
+struct VfsBenchData {
+	std::string directory;
+	std::string pack;
+	std::string compressedPack;
+	std::vector<std::string> paths; //Relative to the directory, the same names the packs use
+	uint64_t bytes = 0;
+};
+
+static bool WriteBenchFile(const std::string& path, const std::string& text)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	return fclose(file) == 0 && written;
+}
+
+static std::shared_ptr<VfsBenchData> GetVfsBenchData()
+{
+	static std::shared_ptr<VfsBenchData> data;
+	if (data)
+		return data;
+
+	std::shared_ptr<VfsBenchData> files(new VfsBenchData());
+	std::error_code error;
+	std::filesystem::path root = std::filesystem::temp_directory_path(error) / "lava_bench_vfs";
+	files->directory = (root / "files").string();
+	files->pack = (root / "files.lpk").string();
+	files->compressedPack = (root / "files_lz4.lpk").string();
+
+	const char* words[] = { "vertex", "index", "buffer", "lava", "shader", "mesh", "bounds", "frame", "queue", "pass", "0.125", "1024" };
+	LavaBenchRandom random;
+	LavaPackWriter pack;
+	LavaPackWriter compressedPack;
+	for (uint32_t i = 0; i < vfsBenchFileCount; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "dir%02u/file%04u.txt", i % 16, i);
+		std::filesystem::create_directories((std::filesystem::path(files->directory) / name).parent_path(), error);
+
+		std::string text;
+		size_t size = 1024 + random.Next() % (7 * 1024);
+		while (text.size() < size) {
+			text += words[random.Next() % (sizeof(words) / sizeof(words[0]))];
+			text += random.Next() % 8 ? ' ' : '\n';
+		}
+		if (!WriteBenchFile((std::filesystem::path(files->directory) / name).string(), text))
+			return nullptr;
+		pack.Add(name, text.data(), text.size(), false);
+		compressedPack.Add(name, text.data(), text.size(), true);
+		files->paths.push_back(name);
+		files->bytes += text.size();
+	}
+	if (!pack.Write(files->pack.c_str()) || !compressedPack.Write(files->compressedPack.c_str()))
+		return nullptr;
+	data = files;
+	return data;
+}
+
+//Every file of the set as one batch through the VFS, the way startup would request them.
+static LavaBenchBody VfsBatchBody(LavaBenchContext& context, std::shared_ptr<LavaVfs> vfs, std::shared_ptr<VfsBenchData> files)
+{
+	context.SetCounter("bytes", double(files->bytes));
+	return [vfs, files]() {
+		std::vector<LavaVfsRequest> requests(files->paths.size());
+		for (size_t i = 0; i < requests.size(); i++) {
+			requests[i] = { files->paths[i].c_str(), 0, {}, false };
+		}
+		vfs->Read(requests.data(), uint32_t(requests.size()));
+		uint64_t loaded = 0;
+		for (const LavaVfsRequest& request : requests) {
+			loaded += request.loaded;
+		}
+		return loaded;
+	};
+}
+
+//Baseline: what asset loading did before the VFS, fopen and fread one file after another.
+LAVA_BENCH("vfs/stdio_2048_files", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<VfsBenchData> files = GetVfsBenchData();
+	if (!files)
+		return LavaBenchBody();
+	context.SetCounter("bytes", double(files->bytes));
+	return [files]() {
+		uint64_t loaded = 0;
+		std::vector<uint8_t> data;
+		for (const std::string& name : files->paths) {
+			FILE* file = fopen((files->directory + "/" + name).c_str(), "rb");
+			if (!file)
+				continue;
+			fseek(file, 0, SEEK_END);
+			data.resize(size_t(ftell(file)));
+			fseek(file, 0, SEEK_SET);
+			loaded += fread(data.data(), 1, data.size(), file) == data.size();
+			fclose(file);
+		}
+		return loaded;
+	};
+});
+
+LAVA_BENCH("vfs/directory_threads_2048_files", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<VfsBenchData> files = GetVfsBenchData();
+	if (!files || !context.jobSystem)
+		return LavaBenchBody();
+	std::shared_ptr<LavaVfs> vfs(new LavaVfs());
+	vfs->Init(context.jobSystem, LAVA_VFS_THREADS);
+	vfs->MountDirectory(files->directory.c_str());
+	return VfsBatchBody(context, vfs, files);
+});
+
+//Skipped where the kernel or a sandbox doesn't allow io_uring.
+LAVA_BENCH("vfs/directory_io_uring_2048_files", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<VfsBenchData> files = GetVfsBenchData();
+	if (!files)
+		return LavaBenchBody();
+	std::shared_ptr<LavaVfs> vfs(new LavaVfs());
+	vfs->Init(context.jobSystem, LAVA_VFS_IO_URING);
+	if (vfs->GetBackend() != LAVA_VFS_IO_URING)
+		return LavaBenchBody();
+	vfs->MountDirectory(files->directory.c_str());
+	return VfsBatchBody(context, vfs, files);
+});
+
+LAVA_BENCH("vfs/pack_2048_files", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<VfsBenchData> files = GetVfsBenchData();
+	if (!files)
+		return LavaBenchBody();
+	std::shared_ptr<LavaVfs> vfs(new LavaVfs());
+	vfs->Init(context.jobSystem, LAVA_VFS_THREADS);
+	if (!vfs->MountPack(files->pack.c_str()))
+		return LavaBenchBody();
+	return VfsBatchBody(context, vfs, files);
+});
+
+LAVA_BENCH("vfs/pack_lz4_2048_files", [](LavaBenchContext& context) -> LavaBenchBody {
+	std::shared_ptr<VfsBenchData> files = GetVfsBenchData();
+	if (!files)
+		return LavaBenchBody();
+	std::shared_ptr<LavaVfs> vfs(new LavaVfs());
+	vfs->Init(context.jobSystem, LAVA_VFS_THREADS);
+	if (!vfs->MountPack(files->compressedPack.c_str()))
+		return LavaBenchBody();
+	std::error_code error;
+	context.SetCounter("pack_bytes", double(std::filesystem::file_size(files->compressedPack, error)));
+	return VfsBatchBody(context, vfs, files);
+});
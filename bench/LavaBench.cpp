@@ -0,0 +1,337 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "LavaBench.h"
+#include "LavaCore.h"
+#include "LavaJobs.h"
+#include "LavaNullVulkan.h"
+#include "LavaSimd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#ifndef LAVA_BENCH_ASSET_DIR
+#define LAVA_BENCH_ASSET_DIR "assets"
+#endif
+
+struct BenchEntry {
+	std::string name;
+	LavaBenchSetup setup;
+};
+
+static std::vector<BenchEntry>& GetRegistry()
+{
+	static std::vector<BenchEntry> registry;
+	return registry;
+}
+
+void LavaRegisterBench(const char* name, LavaBenchSetup setup)
+{
+	GetRegistry().push_back({ name, setup });
+}
+
+static volatile uint64_t benchSink = 0;
+
+void LavaBenchKeep(uint64_t value)
+{
+	benchSink = benchSink + value;
+}
+
+uint64_t LavaBenchRecordedCommands()
+{
+	return LavaNullVulkanGetStats().commands;
+}
+
+struct BenchSettings {
+	std::vector<std::string> filters; //Substring match, any of them
+	uint32_t repetitions = 10;
+	uint32_t warmupRepetitions = 1;
+	double minTime = 0.05; //Seconds per repetition, iterations are scaled up until one repetition takes this long
+	uint32_t threadCount = 0; //0: one per core
+	const char* jsonPath = nullptr;
+	bool list = false;
+	std::string assetDirectory = LAVA_BENCH_ASSET_DIR;
+};
+
+struct BenchResult {
+	std::string name;
+	uint64_t iterations; //Per repetition
+	std::vector<double> samples; //ns per iteration, one per repetition
+	double median, p10, p90, min, max, mean, stddev;
+	double itemsPerIteration;
+	std::vector<std::pair<std::string, double>> counters;
+};
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double RunIterations(const LavaBenchBody& body, uint64_t iterations, uint64_t& items)
+{
+	items = 0;
+	BenchClock::time_point begin = BenchClock::now();
+	for (uint64_t i = 0; i < iterations; i++) {
+		items += body();
+	}
+	return std::chrono::duration<double>(BenchClock::now() - begin).count();
+}
+
+//Linear interpolation between closest ranks, samples have to be sorted.
+static double Percentile(const std::vector<double>& samples, double fraction)
+{
+	double position = fraction * double(samples.size() - 1);
+	size_t lower = size_t(position);
+	size_t upper = std::min(lower + 1, samples.size() - 1);
+	return samples[lower] + (samples[upper] - samples[lower]) * (position - double(lower));
+}
+
+static bool MatchesFilter(const BenchSettings& settings, const std::string& name)
+{
+	if (settings.filters.empty())
+		return true;
+	for (const std::string& filter : settings.filters) {
+		if (name.find(filter) != std::string::npos)
+			return true;
+	}
+	return false;
+}
+
+static bool RunBench(const BenchEntry& entry, const BenchSettings& settings, LavaJobSystem* jobSystem, BenchResult& result)
+{
+	LavaBenchContext context;
+	context.jobSystem = jobSystem;
+	context.assetDirectory = settings.assetDirectory;
+	LavaBenchBody body = entry.setup(context);
+	if (!body)
+		return false;
+
+	//Calibrate: grow the iteration count until one repetition reaches the minimum time.
+	uint64_t iterations = 1;
+	uint64_t items = 0;
+	for (;;) {
+		double seconds = RunIterations(body, iterations, items);
+		if (seconds >= settings.minTime || iterations >= (1ull << 40))
+			break;
+		double scale = seconds > 0.0 ? settings.minTime / seconds * 1.2 : 10.0;
+		iterations = uint64_t(double(iterations) * std::min(std::max(scale, 1.5), 10.0)) + 1;
+	}
+
+	for (uint32_t i = 0; i < settings.warmupRepetitions; i++) {
+		RunIterations(body, iterations, items);
+	}
+
+	result.name = entry.name;
+	result.iterations = iterations;
+	result.samples.clear();
+	for (uint32_t i = 0; i < settings.repetitions; i++) {
+		double seconds = RunIterations(body, iterations, items);
+		result.samples.push_back(seconds * 1e9 / double(iterations));
+	}
+	result.itemsPerIteration = double(items) / double(iterations);
+	result.counters = context.counters;
+
+	std::vector<double> sorted = result.samples;
+	std::sort(sorted.begin(), sorted.end());
+	result.median = Percentile(sorted, 0.5);
+	result.p10 = Percentile(sorted, 0.1);
+	result.p90 = Percentile(sorted, 0.9);
+	result.min = sorted.front();
+	result.max = sorted.back();
+
+	double sum = 0.0;
+	for (double sample : sorted) {
+		sum += sample;
+	}
+	result.mean = sum / double(sorted.size());
+	double variance = 0.0;
+	for (double sample : sorted) {
+		variance += (sample - result.mean) * (sample - result.mean);
+	}
+	result.stddev = sorted.size() > 1 ? sqrt(variance / double(sorted.size() - 1)) : 0.0;
+	return true;
+}
+
+static std::string GetCpuName()
+{
+	std::ifstream cpuInfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuInfo, line)) {
+		if (line.compare(0, 10, "model name") == 0) {
+			size_t colon = line.find(':');
+			if (colon != std::string::npos)
+				return line.substr(line.find_first_not_of(" \t", colon + 1));
+		}
+	}
+	return "unknown";
+}
+
+static const char* GetSimdName()
+{
+#if defined(LAVA_SIMD_AVX2)
+	return "avx2";
+#elif defined(LAVA_SIMD_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+static std::string JsonEscape(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if (uint8_t(c) >= 0x20)
+			escaped += c;
+	}
+	return escaped;
+}
+
+static bool WriteJson(const char* path, const BenchSettings& settings, uint32_t threadCount, const std::vector<BenchResult>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\n  \"context\": {\n");
+	fprintf(file, "    \"cpu\": \"%s\",\n", JsonEscape(GetCpuName()).c_str());
+	fprintf(file, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "    \"threads\": %u,\n", threadCount);
+	fprintf(file, "    \"simd\": \"%s\",\n", GetSimdName());
+#ifdef NDEBUG
+	fprintf(file, "    \"build\": \"release\",\n");
+#else
+	fprintf(file, "    \"build\": \"debug\",\n");
+#endif
+	fprintf(file, "    \"repetitions\": %u,\n", settings.repetitions);
+	fprintf(file, "    \"min_time\": %g,\n", settings.minTime);
+	fprintf(file, "    \"unit\": \"ns\"\n  },\n  \"benchmarks\": [");
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		double itemsPerSecond = result.median > 0.0 ? result.itemsPerIteration * 1e9 / result.median : 0.0;
+		fprintf(file, "%s\n    {\n", i ? "," : "");
+		fprintf(file, "      \"name\": \"%s\",\n", JsonEscape(result.name).c_str());
+		fprintf(file, "      \"iterations\": %llu,\n", (unsigned long long)result.iterations);
+		fprintf(file, "      \"median\": %.3f, \"p10\": %.3f, \"p90\": %.3f,\n", result.median, result.p10, result.p90);
+		fprintf(file, "      \"min\": %.3f, \"max\": %.3f, \"mean\": %.3f, \"stddev\": %.3f,\n", result.min, result.max, result.mean, result.stddev);
+		fprintf(file, "      \"items_per_iteration\": %.3f, \"items_per_second\": %.1f,\n", result.itemsPerIteration, itemsPerSecond);
+		fprintf(file, "      \"counters\": {");
+		for (size_t c = 0; c < result.counters.size(); c++) {
+			//JSON has no infinity, identical images report an infinite PSNR
+			double value = result.counters[c].second;
+			fprintf(file, isfinite(value) ? "%s\"%s\": %g" : "%s\"%s\": null", c ? ", " : "", JsonEscape(result.counters[c].first).c_str(), value);
+		}
+		fprintf(file, "},\n      \"samples\": [");
+		for (size_t s = 0; s < result.samples.size(); s++) {
+			fprintf(file, "%s%.3f", s ? ", " : "", result.samples[s]);
+		}
+		fprintf(file, "]\n    }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+	fclose(file);
+	return true;
+}
+
+static void PrintTime(double nanoseconds)
+{
+	if (nanoseconds >= 1e6)
+		printf("%10.3f ms", nanoseconds * 1e-6);
+	else if (nanoseconds >= 1e3)
+		printf("%10.3f us", nanoseconds * 1e-3);
+	else
+		printf("%10.3f ns", nanoseconds);
+}
+
+static void PrintUsage()
+{
+	LAVA_PRINT("Usage: lava_bench [--filter text]... [--repetitions n] [--min-time seconds] [--threads n] [--assets dir] [--json path] [--list]");
+}
+
+static bool ParseArguments(int argc, char** argv, BenchSettings& settings)
+{
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--filter") && hasValue)
+			settings.filters.push_back(argv[++i]);
+		else if (!strcmp(argv[i], "--repetitions") && hasValue)
+			settings.repetitions = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--min-time") && hasValue)
+			settings.minTime = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && hasValue)
+			settings.threadCount = uint32_t(std::max(1, atoi(argv[++i])));
+		else if (!strcmp(argv[i], "--assets") && hasValue)
+			settings.assetDirectory = argv[++i];
+		else if (!strcmp(argv[i], "--json") && hasValue)
+			settings.jsonPath = argv[++i];
+		else if (!strcmp(argv[i], "--list"))
+			settings.list = true;
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!ParseArguments(argc, argv, settings)) {
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<BenchEntry> entries = GetRegistry();
+	std::sort(entries.begin(), entries.end(), [](const BenchEntry& a, const BenchEntry& b) { return a.name < b.name; });
+
+	if (settings.list) {
+		for (const BenchEntry& entry : entries) {
+			if (MatchesFilter(settings, entry.name))
+				LAVA_PRINT(entry.name);
+		}
+		return 0;
+	}
+
+	//Workers = threads - 1, the calling thread helps. One thread runs everything inline.
+	std::unique_ptr<LavaJobSystem> jobSystem;
+	if (settings.threadCount != 1)
+		jobSystem.reset(new LavaJobSystem(settings.threadCount ? settings.threadCount - 1 : ~0u));
+	uint32_t threadCount = jobSystem ? jobSystem->GetThreadCount() : 1;
+
+	printf("%s, %u threads, %s\n", GetCpuName().c_str(), threadCount, GetSimdName());
+	printf("%-40s %13s %13s %13s %14s\n", "benchmark", "median", "p10", "p90", "items/s");
+
+	std::vector<BenchResult> results;
+	for (const BenchEntry& entry : entries) {
+		if (!MatchesFilter(settings, entry.name))
+			continue;
+
+		BenchResult result;
+		if (!RunBench(entry, settings, jobSystem.get(), result)) {
+			printf("%-40s skipped\n", entry.name.c_str());
+			continue;
+		}
+
+		printf("%-40s ", result.name.c_str());
+		PrintTime(result.median);
+		PrintTime(result.p10);
+		PrintTime(result.p90);
+		printf(" %14.4g", result.median > 0.0 ? result.itemsPerIteration * 1e9 / result.median : 0.0);
+		for (const std::pair<std::string, double>& counter : result.counters) {
+			printf("  %s=%g", counter.first.c_str(), counter.second);
+		}
+		printf("\n");
+		fflush(stdout);
+		results.push_back(result);
+	}
+
+	if (settings.jsonPath && !WriteJson(settings.jsonPath, settings, threadCount, results)) {
+		LAVA_PRINT("Failed to write " << settings.jsonPath);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class LavaJobSystem;
+
+//One timed call of a benchmark, returns how many items it processed (triangles, objects, blocks...) for items/s.
+typedef std::function<uint64_t()> LavaBenchBody;
+
+//Handed to the setup of a benchmark. Setup runs once, untimed, and returns the body; an empty body skips the benchmark.
+struct LavaBenchContext {
+	LavaJobSystem* jobSystem; //Shared worker pool, null with --threads 1
+	std::string assetDirectory;
+	std::vector<std::pair<std::string, double>> counters; //Extra results reported next to the timings, e.g. PSNR
+
+	void SetCounter(const char* name, double value) { counters.push_back(std::make_pair(std::string(name), value)); }
+	std::string AssetPath(const char* file) const { return assetDirectory + "/" + file; }
+};
+
+typedef std::function<LavaBenchBody(LavaBenchContext&)> LavaBenchSetup;
+
+void LavaRegisterBench(const char* name, LavaBenchSetup setup);
+
+//Deterministic xorshift, every run benchmarks the same data.
+struct LavaBenchRandom {
+	uint32_t state = 0x9e3779b9u;
+
+	uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	float NextFloat(float min, float max) { return min + (max - min) * float(Next() >> 8) * (1.f / 16777216.f); }
+};
+
+//Keeps results the optimizer would otherwise throw away.
+void LavaBenchKeep(uint64_t value);
+
+struct LavaBenchRegistrar {
+	LavaBenchRegistrar(const char* name, LavaBenchSetup setup) { LavaRegisterBench(name, setup); }
+};
+
+#define LAVA_BENCH_CONCAT_(a, b) a##b
+#define LAVA_BENCH_CONCAT(a, b) LAVA_BENCH_CONCAT_(a, b)
+
+//LAVA_BENCH("group/name", [](LavaBenchContext& context) -> LavaBenchBody { setup; return [=]() { ...; return items; }; });
+#define LAVA_BENCH(name, ...) static LavaBenchRegistrar LAVA_BENCH_CONCAT(benchRegistrar, __LINE__)(name, __VA_ARGS__)
+
+//Commands recorded on the null driver since startup.
+uint64_t LavaBenchRecordedCommands();
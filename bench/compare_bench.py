@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compares two lava_bench --json outputs.
+
+A benchmark counts as a regression when its median got slower by more than the threshold and the
+p10-p90 ranges of both runs don't overlap, so one noisy repetition doesn't flag anything.
+Exits with 1 when there is at least one regression.
+
+    python3 bench/compare_bench.py base.json new.json [--threshold 0.05] [--filter cull/]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        data = json.load(file)
+    return data.get("context", {}), {bench["name"]: bench for bench in data["benchmarks"]}
+
+
+def format_time(ns):
+    if ns >= 1e6:
+        return "%.3f ms" % (ns * 1e-6)
+    if ns >= 1e3:
+        return "%.3f us" % (ns * 1e-3)
+    return "%.1f ns" % ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two lava_bench JSON results")
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative median change that counts, default 0.05")
+    parser.add_argument("--filter", action="append", default=[], help="only benchmarks containing this text, repeatable")
+    args = parser.parse_args()
+
+    base_context, base = load(args.base)
+    new_context, new = load(args.new)
+    for key in ("cpu", "threads", "simd", "build"):
+        if base_context.get(key) != new_context.get(key):
+            print("warning: %s differs: %s vs %s" % (key, base_context.get(key), new_context.get(key)))
+
+    names = [name for name in sorted(set(base) | set(new)) if not args.filter or any(f in name for f in args.filter)]
+    regressions = 0
+    print("%-40s %12s %12s %9s" % ("benchmark", "base", "new", "change"))
+    for name in names:
+        if name not in base or name not in new:
+            print("%-40s %s" % (name, "only in new" if name in new else "only in base"))
+            continue
+
+        old_bench, new_bench = base[name], new[name]
+        change = new_bench["median"] / old_bench["median"] - 1.0 if old_bench["median"] > 0 else 0.0
+        status = ""
+        if change > args.threshold and new_bench["p10"] > old_bench["p90"]:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold and new_bench["p90"] < old_bench["p10"]:
+            status = "improved"
+        elif abs(change) > args.threshold:
+            status = "noisy"
+
+        print("%-40s %12s %12s %+8.1f%% %s" % (name, format_time(old_bench["median"]), format_time(new_bench["median"]), change * 100.0, status))
+
+    if regressions:
+        print("%d regression(s) over %.0f%%" % (regressions, args.threshold * 100.0))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,3 +1,6 @@
-D:/VulkanSDK/1.2.131.2/Bin32/glslc.exe shader.vert -o vert.spv
-D:/VulkanSDK/1.2.131.2/Bin32/glslc.exe shader.frag -o frag.spv
+@echo off
+rem Every stage to shaders/*.spv, the same command the Visual Studio project runs for each shader.
+for %%f in ("%~dp0*.glsl") do (
+	D:\VulkanSDK\1.2.131.2\Bin\glslangValidator "%%f" -V -o "%~dp0%%~nf.spv" || exit /b 1
+)
 pause
\ No newline at end of file
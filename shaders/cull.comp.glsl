@@ -0,0 +1,110 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 64) in;
+
+struct MeshLod {
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	float maxDistance;
+};
+
+struct Mesh {
+	MeshLod lods[4];
+	uint lodCount;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+struct ObjectData {
+	vec4 boundingSphere;
+	uint meshIndex;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+//Same layout as VkDrawIndexedIndirectCommand
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+//All of these alias the storage buffer array of the bindless set.
+layout(set=0, binding=0) readonly buffer CullViewBuffer {
+	vec4 frustumPlanes[6];
+	vec4 cameraPosition;
+} cullViews[];
+
+layout(set=0, binding=0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffers[];
+
+layout(set=0, binding=0) readonly buffer MeshBuffer {
+	Mesh meshes[];
+} meshBuffers[];
+
+layout(set=0, binding=0) writeonly buffer DrawCommandBuffer {
+	DrawCommand commands[];
+} commandBuffers[];
+
+layout(set=0, binding=0) buffer DrawCountBuffer {
+	uint drawCount;
+} countBuffers[];
+
+layout(push_constant) uniform CullConstants {
+	uint viewBuffer;
+	uint objectBuffer;
+	uint meshBuffer;
+	uint commandBuffer;
+	uint countBuffer;
+	uint objectCount;
+	uint compact;
+} cull;
+
+bool IsVisible(vec4 sphere) {
+	for (int i = 0; i < 6; i++) {
+		vec4 plane = cullViews[cull.viewBuffer].frustumPlanes[i];
+		if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w)
+			return false;
+	}
+	return true;
+}
+
+void main() {
+	uint objectIndex = gl_GlobalInvocationID.x;
+	if (objectIndex >= cull.objectCount)
+		return;
+
+	ObjectData object = objectBuffers[cull.objectBuffer].objects[objectIndex];
+	bool visible = IsVisible(object.boundingSphere);
+
+	//Without draw count support every object owns a slot, culled ones draw zero instances.
+	if (!visible && cull.compact != 0)
+		return;
+
+	Mesh mesh = meshBuffers[cull.meshBuffer].meshes[object.meshIndex];
+	vec3 cameraPosition = cullViews[cull.viewBuffer].cameraPosition.xyz;
+	float distance = max(length(object.boundingSphere.xyz - cameraPosition) - object.boundingSphere.w, 0.0);
+
+	uint lod = 0;
+	while (lod + 1 < mesh.lodCount && distance > mesh.lods[lod].maxDistance)
+		lod++;
+
+	uint slot = objectIndex;
+	if (cull.compact != 0)
+		slot = atomicAdd(countBuffers[cull.countBuffer].drawCount, 1);
+
+	DrawCommand command;
+	command.indexCount = mesh.lods[lod].indexCount;
+	command.instanceCount = visible ? 1 : 0;
+	command.firstIndex = mesh.lods[lod].firstIndex;
+	command.vertexOffset = mesh.lods[lod].vertexOffset;
+	command.firstInstance = objectIndex; //Selects the transform in the instance stream
+	commandBuffers[cull.commandBuffer].commands[slot] = command;
+}
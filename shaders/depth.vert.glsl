@@ -0,0 +1,28 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+//Depth prepass: position only stream plus the instance transform, same math as triangle.vert so the main pass can test EQUAL.
+layout(set=0, binding=0) readonly buffer FrameBuffer {
+	mat4 viewProjection;
+} frameBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+	uint frameBuffer;
+	uint materialBuffer;
+} draw;
+
+layout(location=0) in vec3 position;
+
+//Per instance stream, binding 1
+layout(location=3) in vec4 instanceRow0;
+layout(location=4) in vec4 instanceRow1;
+layout(location=5) in vec4 instanceRow2;
+
+invariant gl_Position;
+
+void main(){
+	mat4 model = transpose(mat4(instanceRow0, instanceRow1, instanceRow2, vec4(0,0,0,1)));
+	vec4 worldPos = model * vec4(position,1.0);
+
+	gl_Position = frameBuffers[draw.frameBuffer].viewProjection * worldPos;
+}
@@ -0,0 +1,12 @@
+#version 450
+
+layout(location=0) in vec2 corner;
+layout(location=1) in vec4 color;
+
+layout(location=0) out vec4 outputColor;
+
+//Additive, a soft round spot fading out over the particle's life.
+void main(){
+	float falloff = max(1.0 - dot(corner, corner), 0.0);
+	outputColor = vec4(color.rgb * color.a * falloff, 0.0);
+}
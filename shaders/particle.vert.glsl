@@ -0,0 +1,78 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+//One camera facing quad per instance, the instance picks the particle from the list simulate just compacted.
+struct Particle {
+	vec3 position;
+	float age;
+	vec3 velocity;
+	uint seed;
+};
+
+layout(set=0, binding=0) readonly buffer FrameBuffer {
+	mat4 viewProjection;
+} frameBuffers[];
+
+layout(set=0, binding=0) readonly buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(set=0, binding=0) readonly buffer IndexBuffer {
+	uint indices[];
+} indexBuffers[];
+
+//Rewritten every frame, so recorded command buffers stay valid.
+layout(set=0, binding=0) readonly buffer StepBuffer {
+	uint emitRequest;
+	uint current; //Alive list emitted into and simulated this frame, survivors go to the other one
+	float deltaTime;
+} stepBuffers[];
+
+layout(push_constant) uniform ParticleConstants {
+	uint particleBuffer;
+	uint deadBuffer;
+	uint aliveBuffer; //Both alive lists, list i starts at i * capacity
+	uint counterBuffer;
+	uint stepBuffer;
+	uint frameBuffer;
+	uint capacity;
+	uint padding;
+	float emitterX, emitterY, emitterZ;
+	float emitterSpeed;
+	float emitterSpread;
+	float gravity;
+	float floorHeight;
+	float minLifetime;
+	float maxLifetime;
+	float quadScaleX, quadScaleY;
+} constants;
+
+layout(location=0) out vec2 corner;
+layout(location=1) out vec4 color;
+
+//Same as LavaParticleHash
+uint Hash(uint value) {
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float Lifetime(uint seed) {
+	uint hash = Hash(Hash(Hash(Hash(seed))));
+	return constants.minLifetime + (constants.maxLifetime - constants.minLifetime) * float(hash >> 8) * (1.0 / 16777216.0);
+}
+
+const vec2 corners[6] = vec2[6](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main(){
+	uint particleIndex = indexBuffers[constants.aliveBuffer].indices[(stepBuffers[constants.stepBuffer].current ^ 1) * constants.capacity + gl_InstanceIndex];
+	Particle particle = particleBuffers[constants.particleBuffer].particles[particleIndex];
+
+	//Offset in clip space before the divide, so the quad shrinks with distance like the geometry around it.
+	corner = corners[gl_VertexIndex];
+	vec4 center = frameBuffers[constants.frameBuffer].viewProjection * vec4(particle.position, 1.0);
+	gl_Position = center + vec4(corner * vec2(constants.quadScaleX, constants.quadScaleY), 0.0, 0.0);
+
+	float fade = clamp(particle.age / Lifetime(particle.seed), 0.0, 1.0);
+	color = vec4(mix(vec3(1.0, 0.8, 0.3), vec3(0.8, 0.1, 0.05), fade), 1.0 - fade);
+}
@@ -0,0 +1,91 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+//Clamps this frame's emission to the free slots and writes the indirect dispatches of emit and simulate,
+//so the particle count never goes through the CPU.
+layout(local_size_x = 1) in;
+
+struct Particle {
+	vec3 position;
+	float age;
+	vec3 velocity;
+	uint seed;
+};
+
+//Same layout as VkDrawIndirectCommand and VkDispatchIndirectCommand
+struct DrawCommand {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+};
+
+struct DispatchCommand {
+	uint x;
+	uint y;
+	uint z;
+};
+
+//All of these alias the storage buffer array of the bindless set.
+layout(set=0, binding=0) buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(set=0, binding=0) buffer IndexBuffer {
+	uint indices[];
+} indexBuffers[];
+
+//The draw's instance count is the length of the list simulate compacts into.
+layout(set=0, binding=0) buffer CounterBuffer {
+	DrawCommand draw;
+	DispatchCommand emitDispatch;
+	DispatchCommand simulateDispatch;
+	uint aliveCount;
+	uint deadCount;
+	uint emitCount;
+	uint emittedCount;
+} counterBuffers[];
+
+//Rewritten every frame, so recorded command buffers stay valid.
+layout(set=0, binding=0) readonly buffer StepBuffer {
+	uint emitRequest;
+	uint current; //Alive list emitted into and simulated this frame, survivors go to the other one
+	float deltaTime;
+} stepBuffers[];
+
+layout(push_constant) uniform ParticleConstants {
+	uint particleBuffer;
+	uint deadBuffer;
+	uint aliveBuffer; //Both alive lists, list i starts at i * capacity
+	uint counterBuffer;
+	uint stepBuffer;
+	uint frameBuffer;
+	uint capacity;
+	uint padding;
+	float emitterX, emitterY, emitterZ;
+	float emitterSpeed;
+	float emitterSpread;
+	float gravity;
+	float floorHeight;
+	float minLifetime;
+	float maxLifetime;
+	float quadScaleX, quadScaleY;
+} constants;
+
+void main() {
+	uint emitCount = min(stepBuffers[constants.stepBuffer].emitRequest, counterBuffers[constants.counterBuffer].deadCount);
+
+	//Emit pops the top emitCount entries of the dead list and appends behind the alive ones, both counts
+	//already include them, emit works out its offsets backwards.
+	counterBuffers[constants.counterBuffer].deadCount -= emitCount;
+	counterBuffers[constants.counterBuffer].emitCount = emitCount;
+	counterBuffers[constants.counterBuffer].emittedCount += emitCount;
+
+	//Last frame's survivors are the list simulated this frame. Simulate counts its survivors into the draw from scratch.
+	uint aliveCount = counterBuffers[constants.counterBuffer].draw.instanceCount + emitCount;
+	counterBuffers[constants.counterBuffer].aliveCount = aliveCount;
+	counterBuffers[constants.counterBuffer].draw.instanceCount = 0;
+
+	counterBuffers[constants.counterBuffer].emitDispatch = DispatchCommand((emitCount + 63) / 64, 1, 1);
+	counterBuffers[constants.counterBuffer].simulateDispatch = DispatchCommand((aliveCount + 63) / 64, 1, 1);
+}
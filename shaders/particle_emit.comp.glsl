@@ -0,0 +1,115 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 64) in;
+
+struct Particle {
+	vec3 position;
+	float age;
+	vec3 velocity;
+	uint seed;
+};
+
+//Same layout as VkDrawIndirectCommand and VkDispatchIndirectCommand
+struct DrawCommand {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+};
+
+struct DispatchCommand {
+	uint x;
+	uint y;
+	uint z;
+};
+
+//All of these alias the storage buffer array of the bindless set.
+layout(set=0, binding=0) buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(set=0, binding=0) buffer IndexBuffer {
+	uint indices[];
+} indexBuffers[];
+
+//The draw's instance count is the length of the list simulate compacts into.
+layout(set=0, binding=0) buffer CounterBuffer {
+	DrawCommand draw;
+	DispatchCommand emitDispatch;
+	DispatchCommand simulateDispatch;
+	uint aliveCount;
+	uint deadCount;
+	uint emitCount;
+	uint emittedCount;
+} counterBuffers[];
+
+//Rewritten every frame, so recorded command buffers stay valid.
+layout(set=0, binding=0) readonly buffer StepBuffer {
+	uint emitRequest;
+	uint current; //Alive list emitted into and simulated this frame, survivors go to the other one
+	float deltaTime;
+} stepBuffers[];
+
+layout(push_constant) uniform ParticleConstants {
+	uint particleBuffer;
+	uint deadBuffer;
+	uint aliveBuffer; //Both alive lists, list i starts at i * capacity
+	uint counterBuffer;
+	uint stepBuffer;
+	uint frameBuffer;
+	uint capacity;
+	uint padding;
+	float emitterX, emitterY, emitterZ;
+	float emitterSpeed;
+	float emitterSpread;
+	float gravity;
+	float floorHeight;
+	float minLifetime;
+	float maxLifetime;
+	float quadScaleX, quadScaleY;
+} constants;
+
+//Same as LavaParticleHash
+uint Hash(uint value) {
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float HashToUnit(uint hash) {
+	return float(hash >> 8) * (1.0 / 16777216.0);
+}
+
+//Same as LavaEmitParticle, everything follows from the seed.
+Particle Emit(uint seed) {
+	uint hash0 = Hash(seed);
+	uint hash1 = Hash(hash0);
+	uint hash2 = Hash(hash1);
+	float speed = constants.emitterSpeed * (0.75 + 0.5 * HashToUnit(hash2));
+
+	Particle particle;
+	particle.position = vec3(constants.emitterX, constants.emitterY, constants.emitterZ);
+	particle.age = 0.0;
+	particle.velocity = vec3((2.0 * HashToUnit(hash0) - 1.0) * constants.emitterSpread, 1.0,
+		(2.0 * HashToUnit(hash1) - 1.0) * constants.emitterSpread) * speed;
+	particle.seed = seed;
+	return particle;
+}
+
+void main() {
+	uint emitIndex = gl_GlobalInvocationID.x;
+	uint emitCount = counterBuffers[constants.counterBuffer].emitCount;
+	if (emitIndex >= emitCount)
+		return;
+
+	//The begin pass already counted this frame's particles in, every thread owns one slot, no atomics.
+	uint current = stepBuffers[constants.stepBuffer].current;
+	uint deadCount = counterBuffers[constants.counterBuffer].deadCount;
+	uint aliveCount = counterBuffers[constants.counterBuffer].aliveCount;
+	uint firstSeed = counterBuffers[constants.counterBuffer].emittedCount - emitCount;
+
+	uint particleIndex = indexBuffers[constants.deadBuffer].indices[deadCount + emitIndex];
+	particleBuffers[constants.particleBuffer].particles[particleIndex] = Emit(firstSeed + emitIndex);
+	indexBuffers[constants.aliveBuffer].indices[current * constants.capacity + aliveCount - emitCount + emitIndex] = particleIndex;
+}
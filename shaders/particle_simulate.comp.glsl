@@ -0,0 +1,120 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+//Moves every alive particle and compacts: survivors are appended to the other alive list, counted in the
+//instance count of the indirect draw, the rest go back on the dead list.
+layout(local_size_x = 64) in;
+
+struct Particle {
+	vec3 position;
+	float age;
+	vec3 velocity;
+	uint seed;
+};
+
+//Same layout as VkDrawIndirectCommand and VkDispatchIndirectCommand
+struct DrawCommand {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+};
+
+struct DispatchCommand {
+	uint x;
+	uint y;
+	uint z;
+};
+
+//All of these alias the storage buffer array of the bindless set.
+layout(set=0, binding=0) buffer ParticleBuffer {
+	Particle particles[];
+} particleBuffers[];
+
+layout(set=0, binding=0) buffer IndexBuffer {
+	uint indices[];
+} indexBuffers[];
+
+//The draw's instance count is the length of the list simulate compacts into.
+layout(set=0, binding=0) buffer CounterBuffer {
+	DrawCommand draw;
+	DispatchCommand emitDispatch;
+	DispatchCommand simulateDispatch;
+	uint aliveCount;
+	uint deadCount;
+	uint emitCount;
+	uint emittedCount;
+} counterBuffers[];
+
+//Rewritten every frame, so recorded command buffers stay valid.
+layout(set=0, binding=0) readonly buffer StepBuffer {
+	uint emitRequest;
+	uint current; //Alive list emitted into and simulated this frame, survivors go to the other one
+	float deltaTime;
+} stepBuffers[];
+
+layout(push_constant) uniform ParticleConstants {
+	uint particleBuffer;
+	uint deadBuffer;
+	uint aliveBuffer; //Both alive lists, list i starts at i * capacity
+	uint counterBuffer;
+	uint stepBuffer;
+	uint frameBuffer;
+	uint capacity;
+	uint padding;
+	float emitterX, emitterY, emitterZ;
+	float emitterSpeed;
+	float emitterSpread;
+	float gravity;
+	float floorHeight;
+	float minLifetime;
+	float maxLifetime;
+	float quadScaleX, quadScaleY;
+} constants;
+
+//Same as LavaParticleHash
+uint Hash(uint value) {
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float HashToUnit(uint hash) {
+	return float(hash >> 8) * (1.0 / 16777216.0);
+}
+
+float Lifetime(uint seed) {
+	uint hash = Hash(Hash(Hash(Hash(seed))));
+	return constants.minLifetime + (constants.maxLifetime - constants.minLifetime) * HashToUnit(hash);
+}
+
+void main() {
+	uint aliveIndex = gl_GlobalInvocationID.x;
+	uint current = stepBuffers[constants.stepBuffer].current;
+	float deltaTime = stepBuffers[constants.stepBuffer].deltaTime;
+	if (aliveIndex >= counterBuffers[constants.counterBuffer].aliveCount)
+		return;
+
+	//Same step as LavaSimulateParticle
+	uint particleIndex = indexBuffers[constants.aliveBuffer].indices[current * constants.capacity + aliveIndex];
+	Particle particle = particleBuffers[constants.particleBuffer].particles[particleIndex];
+	particle.velocity.y += constants.gravity * deltaTime;
+	particle.position += particle.velocity * deltaTime;
+	if (particle.position.y < constants.floorHeight) {
+		particle.position.y = constants.floorHeight;
+		particle.velocity.y = -0.5 * particle.velocity.y;
+		particle.velocity.x *= 0.8;
+		particle.velocity.z *= 0.8;
+	}
+	particle.age += deltaTime;
+	particleBuffers[constants.particleBuffer].particles[particleIndex] = particle;
+
+	if (particle.age < Lifetime(particle.seed)) {
+		uint slot = atomicAdd(counterBuffers[constants.counterBuffer].draw.instanceCount, 1);
+		indexBuffers[constants.aliveBuffer].indices[(current ^ 1) * constants.capacity + slot] = particleIndex;
+	}
+	else {
+		uint slot = atomicAdd(counterBuffers[constants.counterBuffer].deadCount, 1);
+		indexBuffers[constants.deadBuffer].indices[slot] = particleIndex;
+	}
+}
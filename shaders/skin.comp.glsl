@@ -0,0 +1,83 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 64) in;
+
+//Same layout as LavaSkinWeights
+struct SkinWeights {
+	uint joints; //4 joint indices, 8 bits each
+	float weights[4];
+};
+
+//Rows of an affine transform, same layout as LavaAffineTransform
+struct SkinMatrix {
+	vec4 rows[3];
+};
+
+//All of these alias the storage buffer array of the bindless set. Vertices are 6 floats, position then normal,
+//positions 3, so the float arrays match the vertex streams without vec3 padding.
+layout(set=0, binding=0) readonly buffer VertexBuffer {
+	float vertices[];
+} vertexBuffers[];
+
+layout(set=0, binding=0) readonly buffer WeightBuffer {
+	SkinWeights weights[];
+} weightBuffers[];
+
+layout(set=0, binding=0) readonly buffer MatrixBuffer {
+	SkinMatrix matrices[];
+} matrixBuffers[];
+
+layout(set=0, binding=0) writeonly buffer OutputBuffer {
+	float values[];
+} outputBuffers[];
+
+layout(push_constant) uniform SkinConstants {
+	uint vertexBuffer;
+	uint weightBuffer;
+	uint matrixBuffer;
+	uint outputBuffer;
+	uint positionBuffer; //~0u without a depth prepass
+	uint vertexCount;
+} skin;
+
+void main() {
+	uint vertexIndex = gl_GlobalInvocationID.x;
+	if (vertexIndex >= skin.vertexCount)
+		return;
+
+	//Linear blend skinning: the weighted sum of the joint matrices, applied once.
+	SkinWeights weights = weightBuffers[skin.weightBuffer].weights[vertexIndex];
+	vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+	for (uint k = 0; k < 4; k++) {
+		SkinMatrix matrix = matrixBuffers[skin.matrixBuffer].matrices[(weights.joints >> (8 * k)) & 0xff];
+		for (int i = 0; i < 3; i++) {
+			rows[i] += matrix.rows[i] * weights.weights[k];
+		}
+	}
+
+	uint base = vertexIndex * 6;
+	vec4 position = vec4(vertexBuffers[skin.vertexBuffer].vertices[base + 0], vertexBuffers[skin.vertexBuffer].vertices[base + 1],
+		vertexBuffers[skin.vertexBuffer].vertices[base + 2], 1.0);
+	vec3 normal = vec3(vertexBuffers[skin.vertexBuffer].vertices[base + 3], vertexBuffers[skin.vertexBuffer].vertices[base + 4],
+		vertexBuffers[skin.vertexBuffer].vertices[base + 5]);
+
+	vec3 skinnedPosition = vec3(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position));
+	vec3 skinnedNormal = vec3(dot(rows[0].xyz, normal), dot(rows[1].xyz, normal), dot(rows[2].xyz, normal));
+	float normalLength = length(skinnedNormal);
+	skinnedNormal = normalLength > 0.0 ? skinnedNormal / normalLength : skinnedNormal;
+
+	outputBuffers[skin.outputBuffer].values[base + 0] = skinnedPosition.x;
+	outputBuffers[skin.outputBuffer].values[base + 1] = skinnedPosition.y;
+	outputBuffers[skin.outputBuffer].values[base + 2] = skinnedPosition.z;
+	outputBuffers[skin.outputBuffer].values[base + 3] = skinnedNormal.x;
+	outputBuffers[skin.outputBuffer].values[base + 4] = skinnedNormal.y;
+	outputBuffers[skin.outputBuffer].values[base + 5] = skinnedNormal.z;
+
+	//Same floats as the full stream, so the prepass depth matches the main pass for the EQUAL test.
+	if (skin.positionBuffer != ~0u) {
+		outputBuffers[skin.positionBuffer].values[vertexIndex * 3 + 0] = skinnedPosition.x;
+		outputBuffers[skin.positionBuffer].values[vertexIndex * 3 + 1] = skinnedPosition.y;
+		outputBuffers[skin.positionBuffer].values[vertexIndex * 3 + 2] = skinnedPosition.z;
+	}
+}
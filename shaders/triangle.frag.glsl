@@ -1,14 +1,44 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct Material {
+	vec4 baseColor;
+	uint albedoTexture;
+	uint albedoSampler;
+	float uvScale;
+	uint padding;
+};
+
+//Bindless set, every storage buffer of the renderer lives in this array.
+layout(set=0, binding=0) readonly buffer MaterialBuffer {
+	Material materials[];
+} materialBuffers[];
+
+layout(set=0, binding=1) uniform texture2D textures[];
+layout(set=0, binding=2) uniform sampler samplers[];
+
+layout(push_constant) uniform DrawConstants {
+	uint frameBuffer;
+	uint materialBuffer;
+} draw;
 
 layout(location=0) out vec4 outputColor;
 layout(location=0) in vec4 color;
 layout(location=1) in vec4 pos;
 layout(location=2) in vec3 pass_normal;
+layout(location=3) flat in uint pass_material;
 
 void main(){
+	Material material = materialBuffers[draw.materialBuffer].materials[pass_material];
 	vec3 lightPos = vec3(0,2,2);
 	vec3 norm = normalize(pass_normal);
 	vec3 lightDir = normalize(lightPos-pos.xyz);
 	float diffuse = max(dot(norm,lightDir),0.0);
-	outputColor = vec4(vec3(1.0)*diffuse*2.,1.0);
-}
\ No newline at end of file
+	vec3 albedo = material.baseColor.rgb;
+	if (material.albedoTexture != 0xffffffffu) {
+		//Streamed texture, the view only covers resident levels so sampling just gets blurrier until finer mips arrive.
+		vec2 uv = pos.xz * material.uvScale;
+		albedo *= texture(sampler2D(textures[nonuniformEXT(material.albedoTexture)], samplers[nonuniformEXT(material.albedoSampler)]), uv).rgb;
+	}
+	outputColor = vec4(albedo*color.rgb*diffuse*2.,material.baseColor.a);
+}
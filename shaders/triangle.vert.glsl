@@ -1,11 +1,15 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-//const vec3 vertices[3] = vec3[]
-//(
-//	vec3(0,0.5,0),
-//	vec3(0.5,-0.5,0),
-//	vec3(-0.5,-0.1,0)
-//);
+//Per frame data lives in a bindless buffer, so recorded command buffers don't depend on the camera.
+layout(set=0, binding=0) readonly buffer FrameBuffer {
+	mat4 viewProjection;
+} frameBuffers[];
+
+layout(push_constant) uniform DrawConstants {
+	uint frameBuffer;
+	uint materialBuffer;
+} draw;
 
 layout(location=0) in vec3 position;
 
@@ -13,13 +17,29 @@ layout(location=1) in vec3 normal;
 
 layout(location=2) in vec3 texcoord;
 
+//Per instance stream, binding 1
+layout(location=3) in vec4 instanceRow0;
+layout(location=4) in vec4 instanceRow1;
+layout(location=5) in vec4 instanceRow2;
+layout(location=6) in uint instanceMaterial;
+layout(location=7) in vec3 instanceColor;
+
 layout(location=0) out vec4 color;
 layout(location=1) out vec4 pos;
 layout(location=2) out vec3 pass_normal;
+layout(location=3) flat out uint pass_material;
+
+//Has to match depth.vert bit for bit for the EQUAL depth test after the prepass
+invariant gl_Position;
 
 void main(){
-	gl_Position = vec4(position+vec3(0,0,-.25),1.0);
-	color = vec4(normal*0.5+0.5,1.0); //normal unpack
-	pos = vec4(position,1.0);
-	pass_normal = normal;
-}
\ No newline at end of file
+	//Rows of an affine transform, GLSL matrices are column major so transpose back
+	mat4 model = transpose(mat4(instanceRow0, instanceRow1, instanceRow2, vec4(0,0,0,1)));
+	vec4 worldPos = model * vec4(position,1.0);
+
+	gl_Position = frameBuffers[draw.frameBuffer].viewProjection * worldPos;
+	color = vec4(instanceColor,1.0);
+	pos = worldPos;
+	pass_normal = mat3(model) * normal;
+	pass_material = instanceMaterial;
+}
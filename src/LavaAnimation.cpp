@@ -0,0 +1,951 @@
+#include "LavaAnimation.h"
+#include "LavaJobs.h"
+#include "LavaSimd.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+static const float sqrtHalf = 0.70710678f;
+
+void LavaPose::Resize(uint32_t jointCount)
+{
+	count = jointCount;
+	uint32_t paddedCount = (jointCount + 7) & ~7u;
+
+	rotationX.assign(paddedCount, 0.f);
+	rotationY.assign(paddedCount, 0.f);
+	rotationZ.assign(paddedCount, 0.f);
+	rotationW.assign(paddedCount, 1.f);
+	translationX.assign(paddedCount, 0.f);
+	translationY.assign(paddedCount, 0.f);
+	translationZ.assign(paddedCount, 0.f);
+	scaleX.assign(paddedCount, 1.f);
+	scaleY.assign(paddedCount, 1.f);
+	scaleZ.assign(paddedCount, 1.f);
+}
+
+void LavaPose::SetJoint(uint32_t joint, const glm::quat& rotation, const glm::vec3& translation, const glm::vec3& scale)
+{
+	rotationX[joint] = rotation.x;
+	rotationY[joint] = rotation.y;
+	rotationZ[joint] = rotation.z;
+	rotationW[joint] = rotation.w;
+	translationX[joint] = translation.x;
+	translationY[joint] = translation.y;
+	translationZ[joint] = translation.z;
+	scaleX[joint] = scale.x;
+	scaleY[joint] = scale.y;
+	scaleZ[joint] = scale.z;
+}
+
+static LavaAffineTransform InvertTransform(const LavaAffineTransform& transform)
+{
+	glm::mat4 matrix(1.f);
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 4; j++) {
+			matrix[j][i] = transform.rows[i][j];
+		}
+	}
+	glm::mat4 inverse = glm::inverse(matrix);
+
+	LavaAffineTransform result;
+	for (int i = 0; i < 3; i++) {
+		result.rows[i] = glm::vec4(inverse[0][i], inverse[1][i], inverse[2][i], inverse[3][i]);
+	}
+	return result;
+}
+
+void LavaSkeleton::ComputeInverseBindTransforms()
+{
+	uint32_t jointCount = GetJointCount();
+	std::vector<LavaAffineTransform> modelTransforms(jointCount);
+	inverseBindTransforms.resize(jointCount);
+	for (uint32_t j = 0; j < jointCount; j++) {
+		assert(parents[j] < int32_t(j));
+		LavaAffineTransform local = ComposeTransform(bindPose.GetTranslation(j), bindPose.GetRotation(j), bindPose.GetScale(j));
+		modelTransforms[j] = parents[j] < 0 ? local : MultiplyTransforms(modelTransforms[parents[j]], local);
+		inverseBindTransforms[j] = InvertTransform(modelTransforms[j]);
+	}
+}
+
+//Smallest three: the largest component is dropped and rebuilt from the unit length, it is made positive so its sign
+//doesn't need storing. The other three are within +-sqrt(1/2), 15 bits each. The top bits of the first two values hold
+//which component was dropped.
+static void EncodeRotation(const glm::quat& rotation, uint16_t* key)
+{
+	float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; i++) {
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+	float sign = components[largest] < 0.f ? -1.f : 1.f;
+
+	for (uint32_t i = 0, k = 0; i < 4; i++) {
+		if (i == largest)
+			continue;
+		float normalized = (components[i] * sign / sqrtHalf + 1.f) * 0.5f;
+		key[k++] = uint16_t(std::min(std::max(normalized * 32767.f + 0.5f, 0.f), 32767.f));
+	}
+	key[0] |= uint16_t((largest & 1) << 15);
+	key[1] |= uint16_t((largest >> 1) << 15);
+}
+
+static glm::quat DecodeRotation(const uint16_t* key)
+{
+	uint32_t largest = (key[0] >> 15) | ((key[1] >> 15) << 1);
+	float smallest[3];
+	float sumSquares = 0.f;
+	for (uint32_t k = 0; k < 3; k++) {
+		smallest[k] = (float(key[k] & 0x7fff) * (2.f / 32767.f) - 1.f) * sqrtHalf;
+		sumSquares += smallest[k] * smallest[k];
+	}
+
+	float components[4];
+	for (uint32_t i = 0, k = 0; i < 4; i++) {
+		components[i] = i == largest ? sqrtf(std::max(1.f - sumSquares, 0.f)) : smallest[k++];
+	}
+	return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+static glm::vec3 DecodeVector(const uint16_t* key, const float* rangeMin, const float* rangeStep)
+{
+	glm::vec3 value;
+	for (int i = 0; i < 3; i++) {
+		value[i] = rangeMin[i] + float(key[i]) * rangeStep[i];
+	}
+	return value;
+}
+
+//Same arithmetic as the pose kernels, so the errors measured while compressing are the ones playback has.
+static glm::quat InterpolateRotation(const glm::quat& a, glm::quat b, float alpha)
+{
+	if (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.f)
+		b = -b;
+	glm::quat result(a.w + (b.w - a.w) * alpha, a.x + (b.x - a.x) * alpha, a.y + (b.y - a.y) * alpha, a.z + (b.z - a.z) * alpha);
+	float inverseLength = 1.f / sqrtf(result.x * result.x + result.y * result.y + result.z * result.z + result.w * result.w);
+	return result * inverseLength;
+}
+
+//Angle of the rotation between the two. Through atan2 of the difference, acos of the dot product has no precision
+//left at the small angles the tolerances are about.
+static float RotationError(const glm::quat& a, const glm::quat& b)
+{
+	glm::quat difference = glm::conjugate(a) * b;
+	return 2.f * atan2f(glm::length(glm::vec3(difference.x, difference.y, difference.z)), fabsf(difference.w));
+}
+
+//One channel of one joint as a curve over the source frames.
+struct ClipTrackFit {
+	uint32_t frameCount;
+	bool rotation;
+	std::vector<glm::vec4> source; //Rotations as xyzw
+	std::vector<uint16_t> quantized; //3 per frame
+	std::vector<glm::vec4> decoded;
+	float rangeMin[3];
+	float rangeStep[3];
+
+	glm::vec4 Interpolate(uint32_t a, uint32_t b, uint32_t frame) const
+	{
+		float alpha = float(frame - a) / float(b - a);
+		if (rotation) {
+			glm::quat result = InterpolateRotation(glm::quat(decoded[a].w, decoded[a].x, decoded[a].y, decoded[a].z),
+				glm::quat(decoded[b].w, decoded[b].x, decoded[b].y, decoded[b].z), alpha);
+			return glm::vec4(result.x, result.y, result.z, result.w);
+		}
+		return decoded[a] + (decoded[b] - decoded[a]) * alpha;
+	}
+
+	float Error(const glm::vec4& value, uint32_t frame) const
+	{
+		const glm::vec4& original = source[frame];
+		if (rotation)
+			return RotationError(glm::quat(value.w, value.x, value.y, value.z), glm::quat(original.w, original.x, original.y, original.z));
+		return glm::length(glm::vec3(value) - glm::vec3(original));
+	}
+};
+
+static void QuantizeTrack(ClipTrackFit& fit)
+{
+	fit.quantized.resize(fit.frameCount * 3);
+	fit.decoded.resize(fit.frameCount);
+	if (fit.rotation) {
+		for (uint32_t f = 0; f < fit.frameCount; f++) {
+			const glm::vec4& value = fit.source[f];
+			EncodeRotation(glm::quat(value.w, value.x, value.y, value.z), &fit.quantized[f * 3]);
+			glm::quat decoded = DecodeRotation(&fit.quantized[f * 3]);
+			fit.decoded[f] = glm::vec4(decoded.x, decoded.y, decoded.z, decoded.w);
+		}
+		return;
+	}
+
+	glm::vec3 minValue(FLT_MAX), maxValue(-FLT_MAX);
+	for (uint32_t f = 0; f < fit.frameCount; f++) {
+		minValue = glm::min(minValue, glm::vec3(fit.source[f]));
+		maxValue = glm::max(maxValue, glm::vec3(fit.source[f]));
+	}
+	for (int i = 0; i < 3; i++) {
+		fit.rangeMin[i] = minValue[i];
+		fit.rangeStep[i] = (maxValue[i] - minValue[i]) / 65535.f;
+	}
+	for (uint32_t f = 0; f < fit.frameCount; f++) {
+		for (int i = 0; i < 3; i++) {
+			float steps = fit.rangeStep[i] > 0.f ? (fit.source[f][i] - minValue[i]) / fit.rangeStep[i] : 0.f;
+			fit.quantized[f * 3 + i] = uint16_t(std::min(std::max(steps + 0.5f, 0.f), 65535.f));
+		}
+		fit.decoded[f] = glm::vec4(DecodeVector(&fit.quantized[f * 3], fit.rangeMin, fit.rangeStep), 0.f);
+	}
+}
+
+//Keys a linear fit through the quantized values needs to stay within tolerance at every source frame. Segments
+//between two keys are split at their worst frame until no frame is off by more, Douglas-Peucker over the track.
+//Returns the largest error left.
+static float FitTrack(const ClipTrackFit& fit, float tolerance, std::vector<uint8_t>& keep)
+{
+	uint32_t last = fit.frameCount - 1;
+	keep.assign(fit.frameCount, 0);
+	keep[0] = 1;
+
+	bool constant = true;
+	for (uint32_t f = 0; f < fit.frameCount && constant; f++) {
+		constant = fit.Error(fit.decoded[0], f) <= tolerance;
+	}
+	if (constant) {
+		float maxError = 0.f;
+		for (uint32_t f = 0; f < fit.frameCount; f++) {
+			maxError = std::max(maxError, fit.Error(fit.decoded[0], f));
+		}
+		return maxError;
+	}
+
+	keep[last] = 1;
+	std::vector<std::pair<uint32_t, uint32_t>> segments = { { 0, last } };
+	while (!segments.empty()) {
+		std::pair<uint32_t, uint32_t> segment = segments.back();
+		segments.pop_back();
+
+		uint32_t worstFrame = 0;
+		float worstError = tolerance;
+		for (uint32_t f = segment.first + 1; f < segment.second; f++) {
+			float error = fit.Error(fit.Interpolate(segment.first, segment.second, f), f);
+			if (error > worstError) {
+				worstError = error;
+				worstFrame = f;
+			}
+		}
+		if (worstFrame) {
+			keep[worstFrame] = 1;
+			segments.push_back({ segment.first, worstFrame });
+			segments.push_back({ worstFrame, segment.second });
+		}
+	}
+
+	//Keys themselves are only off by their quantization, which the fit can't remove.
+	float maxError = 0.f;
+	for (uint32_t a = 0, b = 1; b <= last; b++) {
+		if (!keep[b])
+			continue;
+		for (uint32_t f = a; f <= b; f++) {
+			maxError = std::max(maxError, fit.Error(fit.Interpolate(a, b, f), f));
+		}
+		a = b;
+	}
+	return maxError;
+}
+
+bool LavaCompressClip(const LavaAnimationSamples& samples, const LavaClipCompressionSettings& settings, LavaAnimationClip& clip)
+{
+	size_t sampleCount = size_t(samples.frameCount) * samples.jointCount;
+	if (!samples.frameCount || samples.frameCount > 65536 || !samples.jointCount || samples.sampleRate <= 0.f ||
+		samples.rotations.size() != sampleCount || samples.translations.size() != sampleCount || samples.scales.size() != sampleCount) {
+		fprintf(stderr, "Animation samples are empty, too long or inconsistent\n");
+		return false;
+	}
+
+	clip = LavaAnimationClip();
+	clip.sampleRate = samples.sampleRate;
+	clip.frameCount = samples.frameCount;
+	clip.jointCount = samples.jointCount;
+	clip.tracks.resize(size_t(samples.jointCount) * LAVA_CHANNEL_COUNT);
+	uint32_t paddedCount = (samples.jointCount + 7) & ~7u;
+	for (int i = 0; i < 6; i++) {
+		clip.rangeMin[i].assign(paddedCount, 0.f);
+		clip.rangeStep[i].assign(paddedCount, 0.f);
+	}
+
+	const float tolerances[LAVA_CHANNEL_COUNT] = { settings.rotationTolerance, settings.translationTolerance, settings.scaleTolerance };
+	float* maxErrors[LAVA_CHANNEL_COUNT] = { &clip.maxRotationError, &clip.maxTranslationError, &clip.maxScaleError };
+	ClipTrackFit fit;
+	fit.frameCount = samples.frameCount;
+	fit.source.resize(samples.frameCount);
+	std::vector<uint8_t> keep;
+	for (uint32_t j = 0; j < samples.jointCount; j++) {
+		for (uint32_t channel = 0; channel < LAVA_CHANNEL_COUNT; channel++) {
+			for (uint32_t f = 0; f < samples.frameCount; f++) {
+				size_t sample = size_t(f) * samples.jointCount + j;
+				if (channel == LAVA_CHANNEL_ROTATION) {
+					const glm::quat& rotation = samples.rotations[sample];
+					fit.source[f] = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+				}
+				else {
+					fit.source[f] = glm::vec4(channel == LAVA_CHANNEL_TRANSLATION ? samples.translations[sample] : samples.scales[sample], 0.f);
+				}
+			}
+			fit.rotation = channel == LAVA_CHANNEL_ROTATION;
+			QuantizeTrack(fit);
+			*maxErrors[channel] = std::max(*maxErrors[channel], FitTrack(fit, tolerances[channel], keep));
+			for (uint32_t i = 0; i < 3 && !fit.rotation; i++) {
+				clip.rangeMin[(channel - LAVA_CHANNEL_TRANSLATION) * 3 + i][j] = fit.rangeMin[i];
+				clip.rangeStep[(channel - LAVA_CHANNEL_TRANSLATION) * 3 + i][j] = fit.rangeStep[i];
+			}
+
+			LavaAnimationTrack& track = clip.tracks[j * LAVA_CHANNEL_COUNT + channel];
+			track.firstKey = uint32_t(clip.keyFrames.size());
+			for (uint32_t f = 0; f < samples.frameCount; f++) {
+				if (!keep[f])
+					continue;
+				clip.keyFrames.push_back(uint16_t(f));
+				clip.keyValues.insert(clip.keyValues.end(), &fit.quantized[f * 3], &fit.quantized[f * 3] + 3);
+			}
+			track.keyCount = uint32_t(clip.keyFrames.size()) - track.firstKey;
+			clip.maxKeyCount = std::max(clip.maxKeyCount, track.keyCount);
+		}
+	}
+	return true;
+}
+
+size_t LavaAnimationClip::GetSize() const
+{
+	return sizeof(LavaAnimationClip) + tracks.size() * sizeof(LavaAnimationTrack) + (keyFrames.size() + keyValues.size()) * sizeof(uint16_t) +
+		12 * rangeMin[0].size() * sizeof(float);
+}
+
+size_t LavaGetSamplesSize(const LavaAnimationSamples& samples)
+{
+	return sizeof(LavaAnimationSamples) + samples.rotations.size() * sizeof(glm::quat) + (samples.translations.size() + samples.scales.size()) * sizeof(glm::vec3);
+}
+
+//out = nlerp(a, b) for rotations and lerp for translations and scales, alphas holds the factor per channel and joint:
+//rotations in [0, padded), translations in [padded, 2 * padded), scales after. b rotations on the far side of a are
+//flipped first, so every joint takes the short way.
+static void InterpolatePosesScalar(const LavaPose& a, const LavaPose& b, const float* alphas, LavaPose& out, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = a.GetPaddedCount();
+	const float* translationAlphas = alphas + paddedCount;
+	const float* scaleAlphas = alphas + 2 * paddedCount;
+	for (uint32_t i = begin; i < end; i++) {
+		float ax = a.rotationX[i], ay = a.rotationY[i], az = a.rotationZ[i], aw = a.rotationW[i];
+		float bx = b.rotationX[i], by = b.rotationY[i], bz = b.rotationZ[i], bw = b.rotationW[i];
+		if (ax * bx + ay * by + az * bz + aw * bw < 0.f) {
+			bx = -bx;
+			by = -by;
+			bz = -bz;
+			bw = -bw;
+		}
+		float t = alphas[i];
+		float x = ax + (bx - ax) * t;
+		float y = ay + (by - ay) * t;
+		float z = az + (bz - az) * t;
+		float w = aw + (bw - aw) * t;
+		float inverseLength = 1.f / sqrtf(x * x + y * y + z * z + w * w);
+		out.rotationX[i] = x * inverseLength;
+		out.rotationY[i] = y * inverseLength;
+		out.rotationZ[i] = z * inverseLength;
+		out.rotationW[i] = w * inverseLength;
+
+		t = translationAlphas[i];
+		out.translationX[i] = a.translationX[i] + (b.translationX[i] - a.translationX[i]) * t;
+		out.translationY[i] = a.translationY[i] + (b.translationY[i] - a.translationY[i]) * t;
+		out.translationZ[i] = a.translationZ[i] + (b.translationZ[i] - a.translationZ[i]) * t;
+
+		t = scaleAlphas[i];
+		out.scaleX[i] = a.scaleX[i] + (b.scaleX[i] - a.scaleX[i]) * t;
+		out.scaleY[i] = a.scaleY[i] + (b.scaleY[i] - a.scaleY[i]) * t;
+		out.scaleZ[i] = a.scaleZ[i] + (b.scaleZ[i] - a.scaleZ[i]) * t;
+	}
+}
+
+#if defined(LAVA_SIMD_AVX2)
+static inline __m256 LerpAvx2(__m256 a, __m256 b, __m256 t)
+{
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+static void InterpolatePosesAvx2(const LavaPose& a, const LavaPose& b, const float* alphas, LavaPose& out, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = a.GetPaddedCount();
+	const float* translationAlphas = alphas + paddedCount;
+	const float* scaleAlphas = alphas + 2 * paddedCount;
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 ax = _mm256_loadu_ps(&a.rotationX[i]);
+		__m256 ay = _mm256_loadu_ps(&a.rotationY[i]);
+		__m256 az = _mm256_loadu_ps(&a.rotationZ[i]);
+		__m256 aw = _mm256_loadu_ps(&a.rotationW[i]);
+		__m256 bx = _mm256_loadu_ps(&b.rotationX[i]);
+		__m256 by = _mm256_loadu_ps(&b.rotationY[i]);
+		__m256 bz = _mm256_loadu_ps(&b.rotationZ[i]);
+		__m256 bw = _mm256_loadu_ps(&b.rotationW[i]);
+
+		//Sign of the dot product xored into b flips the joints that would take the long way.
+		__m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz)), _mm256_mul_ps(aw, bw));
+		__m256 flip = _mm256_and_ps(dot, signMask);
+		__m256 t = _mm256_loadu_ps(alphas + i);
+		__m256 x = LerpAvx2(ax, _mm256_xor_ps(bx, flip), t);
+		__m256 y = LerpAvx2(ay, _mm256_xor_ps(by, flip), t);
+		__m256 z = LerpAvx2(az, _mm256_xor_ps(bz, flip), t);
+		__m256 w = LerpAvx2(aw, _mm256_xor_ps(bw, flip), t);
+		__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)), _mm256_mul_ps(w, w));
+		__m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+		_mm256_storeu_ps(&out.rotationX[i], _mm256_mul_ps(x, inverseLength));
+		_mm256_storeu_ps(&out.rotationY[i], _mm256_mul_ps(y, inverseLength));
+		_mm256_storeu_ps(&out.rotationZ[i], _mm256_mul_ps(z, inverseLength));
+		_mm256_storeu_ps(&out.rotationW[i], _mm256_mul_ps(w, inverseLength));
+
+		t = _mm256_loadu_ps(translationAlphas + i);
+		_mm256_storeu_ps(&out.translationX[i], LerpAvx2(_mm256_loadu_ps(&a.translationX[i]), _mm256_loadu_ps(&b.translationX[i]), t));
+		_mm256_storeu_ps(&out.translationY[i], LerpAvx2(_mm256_loadu_ps(&a.translationY[i]), _mm256_loadu_ps(&b.translationY[i]), t));
+		_mm256_storeu_ps(&out.translationZ[i], LerpAvx2(_mm256_loadu_ps(&a.translationZ[i]), _mm256_loadu_ps(&b.translationZ[i]), t));
+
+		t = _mm256_loadu_ps(scaleAlphas + i);
+		_mm256_storeu_ps(&out.scaleX[i], LerpAvx2(_mm256_loadu_ps(&a.scaleX[i]), _mm256_loadu_ps(&b.scaleX[i]), t));
+		_mm256_storeu_ps(&out.scaleY[i], LerpAvx2(_mm256_loadu_ps(&a.scaleY[i]), _mm256_loadu_ps(&b.scaleY[i]), t));
+		_mm256_storeu_ps(&out.scaleZ[i], LerpAvx2(_mm256_loadu_ps(&a.scaleZ[i]), _mm256_loadu_ps(&b.scaleZ[i]), t));
+	}
+
+	InterpolatePosesScalar(a, b, alphas, out, i, end);
+}
+#elif defined(LAVA_SIMD_SSE2)
+static inline __m128 LerpSse2(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+static void InterpolatePosesSse2(const LavaPose& a, const LavaPose& b, const float* alphas, LavaPose& out, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = a.GetPaddedCount();
+	const float* translationAlphas = alphas + paddedCount;
+	const float* scaleAlphas = alphas + 2 * paddedCount;
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 one = _mm_set1_ps(1.f);
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 ax = _mm_loadu_ps(&a.rotationX[i]);
+		__m128 ay = _mm_loadu_ps(&a.rotationY[i]);
+		__m128 az = _mm_loadu_ps(&a.rotationZ[i]);
+		__m128 aw = _mm_loadu_ps(&a.rotationW[i]);
+		__m128 bx = _mm_loadu_ps(&b.rotationX[i]);
+		__m128 by = _mm_loadu_ps(&b.rotationY[i]);
+		__m128 bz = _mm_loadu_ps(&b.rotationZ[i]);
+		__m128 bw = _mm_loadu_ps(&b.rotationW[i]);
+
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+		__m128 flip = _mm_and_ps(dot, signMask);
+		__m128 t = _mm_loadu_ps(alphas + i);
+		__m128 x = LerpSse2(ax, _mm_xor_ps(bx, flip), t);
+		__m128 y = LerpSse2(ay, _mm_xor_ps(by, flip), t);
+		__m128 z = LerpSse2(az, _mm_xor_ps(bz, flip), t);
+		__m128 w = LerpSse2(aw, _mm_xor_ps(bw, flip), t);
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), _mm_mul_ps(w, w));
+		__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+		_mm_storeu_ps(&out.rotationX[i], _mm_mul_ps(x, inverseLength));
+		_mm_storeu_ps(&out.rotationY[i], _mm_mul_ps(y, inverseLength));
+		_mm_storeu_ps(&out.rotationZ[i], _mm_mul_ps(z, inverseLength));
+		_mm_storeu_ps(&out.rotationW[i], _mm_mul_ps(w, inverseLength));
+
+		t = _mm_loadu_ps(translationAlphas + i);
+		_mm_storeu_ps(&out.translationX[i], LerpSse2(_mm_loadu_ps(&a.translationX[i]), _mm_loadu_ps(&b.translationX[i]), t));
+		_mm_storeu_ps(&out.translationY[i], LerpSse2(_mm_loadu_ps(&a.translationY[i]), _mm_loadu_ps(&b.translationY[i]), t));
+		_mm_storeu_ps(&out.translationZ[i], LerpSse2(_mm_loadu_ps(&a.translationZ[i]), _mm_loadu_ps(&b.translationZ[i]), t));
+
+		t = _mm_loadu_ps(scaleAlphas + i);
+		_mm_storeu_ps(&out.scaleX[i], LerpSse2(_mm_loadu_ps(&a.scaleX[i]), _mm_loadu_ps(&b.scaleX[i]), t));
+		_mm_storeu_ps(&out.scaleY[i], LerpSse2(_mm_loadu_ps(&a.scaleY[i]), _mm_loadu_ps(&b.scaleY[i]), t));
+		_mm_storeu_ps(&out.scaleZ[i], LerpSse2(_mm_loadu_ps(&a.scaleZ[i]), _mm_loadu_ps(&b.scaleZ[i]), t));
+	}
+
+	InterpolatePosesScalar(a, b, alphas, out, i, end);
+}
+#endif
+
+static void InterpolatePoses(const LavaPose& a, const LavaPose& b, const float* alphas, LavaPose& out)
+{
+	assert(a.GetPaddedCount() == b.GetPaddedCount() && a.GetPaddedCount() == out.GetPaddedCount());
+#if defined(LAVA_SIMD_AVX2)
+	InterpolatePosesAvx2(a, b, alphas, out, 0, a.GetPaddedCount());
+#elif defined(LAVA_SIMD_SSE2)
+	InterpolatePosesSse2(a, b, alphas, out, 0, a.GetPaddedCount());
+#else
+	InterpolatePosesScalar(a, b, alphas, out, 0, a.GetPaddedCount());
+#endif
+}
+
+//Raw keys in structure of arrays form: value k of a channel's key for padded joint j at (channel * 3 + k) * padded + j.
+static void DecodeKeysScalar(const uint16_t* keys, const LavaAnimationClip& clip, LavaPose& pose, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	float* vectors[6] = { pose.translationX.data(), pose.translationY.data(), pose.translationZ.data(), pose.scaleX.data(), pose.scaleY.data(), pose.scaleZ.data() };
+	for (uint32_t i = begin; i < end; i++) {
+		uint16_t rotationKey[3] = { keys[i], keys[paddedCount + i], keys[2 * paddedCount + i] };
+		glm::quat rotation = DecodeRotation(rotationKey);
+		pose.rotationX[i] = rotation.x;
+		pose.rotationY[i] = rotation.y;
+		pose.rotationZ[i] = rotation.z;
+		pose.rotationW[i] = rotation.w;
+		for (uint32_t c = 0; c < 6; c++) {
+			vectors[c][i] = clip.rangeMin[c][i] + float(keys[(3 + c) * paddedCount + i]) * clip.rangeStep[c][i];
+		}
+	}
+}
+
+//Rows of the local affine matrices, 12 arrays of padded floats. Same matrix as ComposeTransform.
+static void LocalTransformsScalar(const LavaPose& pose, float* rows, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	for (uint32_t i = begin; i < end; i++) {
+		float x = pose.rotationX[i], y = pose.rotationY[i], z = pose.rotationZ[i], w = pose.rotationW[i];
+		float x2 = x + x, y2 = y + y, z2 = z + z;
+		float xx = x * x2, yy = y * y2, zz = z * z2;
+		float xy = x * y2, xz = x * z2, yz = y * z2;
+		float wx = w * x2, wy = w * y2, wz = w * z2;
+		float sx = pose.scaleX[i], sy = pose.scaleY[i], sz = pose.scaleZ[i];
+		rows[0 * paddedCount + i] = (1.f - (yy + zz)) * sx;
+		rows[1 * paddedCount + i] = (xy - wz) * sy;
+		rows[2 * paddedCount + i] = (xz + wy) * sz;
+		rows[3 * paddedCount + i] = pose.translationX[i];
+		rows[4 * paddedCount + i] = (xy + wz) * sx;
+		rows[5 * paddedCount + i] = (1.f - (xx + zz)) * sy;
+		rows[6 * paddedCount + i] = (yz - wx) * sz;
+		rows[7 * paddedCount + i] = pose.translationY[i];
+		rows[8 * paddedCount + i] = (xz - wy) * sx;
+		rows[9 * paddedCount + i] = (yz + wx) * sy;
+		rows[10 * paddedCount + i] = (1.f - (xx + yy)) * sz;
+		rows[11 * paddedCount + i] = pose.translationZ[i];
+	}
+}
+
+#if defined(LAVA_SIMD_AVX2)
+static inline __m256 LoadKeysAvx2(const uint16_t* keys)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys))));
+}
+
+static void DecodeKeysAvx2(const uint16_t* keys, const LavaAnimationClip& clip, LavaPose& pose, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	float* vectors[6] = { pose.translationX.data(), pose.translationY.data(), pose.translationZ.data(), pose.scaleX.data(), pose.scaleY.data(), pose.scaleZ.data() };
+	const __m256i valueMask = _mm256_set1_epi32(0x7fff);
+	const __m256 keyScale = _mm256_set1_ps(2.f / 32767.f);
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 half = _mm256_set1_ps(sqrtHalf);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256i key0 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)));
+		__m256i key1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + paddedCount + i)));
+		__m256i key2 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 2 * paddedCount + i)));
+		__m256i largest = _mm256_or_si256(_mm256_srli_epi32(key0, 15), _mm256_slli_epi32(_mm256_srli_epi32(key1, 15), 1));
+
+		__m256 s0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(key0, valueMask)), keyScale), one), half);
+		__m256 s1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(key1, valueMask)), keyScale), one), half);
+		__m256 s2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(key2, valueMask)), keyScale), one), half);
+		__m256 sumSquares = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s0, s0), _mm256_mul_ps(s1, s1)), _mm256_mul_ps(s2, s2));
+		__m256 dropped = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(one, sumSquares), _mm256_setzero_ps()));
+
+		//Components before the dropped one keep their place, the ones after it move up one.
+		__m256 isX = _mm256_castsi256_ps(_mm256_cmpeq_epi32(largest, _mm256_setzero_si256()));
+		__m256 isY = _mm256_castsi256_ps(_mm256_cmpeq_epi32(largest, _mm256_set1_epi32(1)));
+		__m256 isZ = _mm256_castsi256_ps(_mm256_cmpeq_epi32(largest, _mm256_set1_epi32(2)));
+		__m256 isW = _mm256_castsi256_ps(_mm256_cmpeq_epi32(largest, _mm256_set1_epi32(3)));
+		_mm256_storeu_ps(&pose.rotationX[i], _mm256_blendv_ps(s0, dropped, isX));
+		_mm256_storeu_ps(&pose.rotationY[i], _mm256_blendv_ps(_mm256_blendv_ps(s1, s0, isX), dropped, isY));
+		_mm256_storeu_ps(&pose.rotationZ[i], _mm256_blendv_ps(_mm256_blendv_ps(s2, s1, _mm256_or_ps(isX, isY)), dropped, isZ));
+		_mm256_storeu_ps(&pose.rotationW[i], _mm256_blendv_ps(s2, dropped, isW));
+
+		for (uint32_t c = 0; c < 6; c++) {
+			__m256 value = _mm256_add_ps(_mm256_loadu_ps(&clip.rangeMin[c][i]), _mm256_mul_ps(LoadKeysAvx2(keys + (3 + c) * paddedCount + i), _mm256_loadu_ps(&clip.rangeStep[c][i])));
+			_mm256_storeu_ps(vectors[c] + i, value);
+		}
+	}
+
+	DecodeKeysScalar(keys, clip, pose, i, end);
+}
+
+static void LocalTransformsAvx2(const LavaPose& pose, float* rows, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&pose.rotationX[i]);
+		__m256 y = _mm256_loadu_ps(&pose.rotationY[i]);
+		__m256 z = _mm256_loadu_ps(&pose.rotationZ[i]);
+		__m256 w = _mm256_loadu_ps(&pose.rotationW[i]);
+		__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+		__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+		__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+		__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+		__m256 sx = _mm256_loadu_ps(&pose.scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&pose.scaleY[i]);
+		__m256 sz = _mm256_loadu_ps(&pose.scaleZ[i]);
+		_mm256_storeu_ps(rows + 0 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx));
+		_mm256_storeu_ps(rows + 1 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy));
+		_mm256_storeu_ps(rows + 2 * paddedCount + i, _mm256_mul_ps(_mm256_add_ps(xz, wy), sz));
+		_mm256_storeu_ps(rows + 3 * paddedCount + i, _mm256_loadu_ps(&pose.translationX[i]));
+		_mm256_storeu_ps(rows + 4 * paddedCount + i, _mm256_mul_ps(_mm256_add_ps(xy, wz), sx));
+		_mm256_storeu_ps(rows + 5 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy));
+		_mm256_storeu_ps(rows + 6 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz));
+		_mm256_storeu_ps(rows + 7 * paddedCount + i, _mm256_loadu_ps(&pose.translationY[i]));
+		_mm256_storeu_ps(rows + 8 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx));
+		_mm256_storeu_ps(rows + 9 * paddedCount + i, _mm256_mul_ps(_mm256_add_ps(yz, wx), sy));
+		_mm256_storeu_ps(rows + 10 * paddedCount + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz));
+		_mm256_storeu_ps(rows + 11 * paddedCount + i, _mm256_loadu_ps(&pose.translationZ[i]));
+	}
+
+	LocalTransformsScalar(pose, rows, i, end);
+}
+#elif defined(LAVA_SIMD_SSE2)
+static inline __m128i LoadKeysSse2(const uint16_t* keys)
+{
+	return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(keys)), _mm_setzero_si128());
+}
+
+//No blendv before SSE4.1, selects are and/andnot/or.
+static inline __m128 SelectSse2(__m128 a, __m128 b, __m128 mask)
+{
+	return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+}
+
+static void DecodeKeysSse2(const uint16_t* keys, const LavaAnimationClip& clip, LavaPose& pose, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	float* vectors[6] = { pose.translationX.data(), pose.translationY.data(), pose.translationZ.data(), pose.scaleX.data(), pose.scaleY.data(), pose.scaleZ.data() };
+	const __m128i valueMask = _mm_set1_epi32(0x7fff);
+	const __m128 keyScale = _mm_set1_ps(2.f / 32767.f);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(sqrtHalf);
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128i key0 = LoadKeysSse2(keys + i);
+		__m128i key1 = LoadKeysSse2(keys + paddedCount + i);
+		__m128i key2 = LoadKeysSse2(keys + 2 * paddedCount + i);
+		__m128i largest = _mm_or_si128(_mm_srli_epi32(key0, 15), _mm_slli_epi32(_mm_srli_epi32(key1, 15), 1));
+
+		__m128 s0 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(key0, valueMask)), keyScale), one), half);
+		__m128 s1 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(key1, valueMask)), keyScale), one), half);
+		__m128 s2 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(key2, valueMask)), keyScale), one), half);
+		__m128 sumSquares = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s0, s0), _mm_mul_ps(s1, s1)), _mm_mul_ps(s2, s2));
+		__m128 dropped = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, sumSquares), _mm_setzero_ps()));
+
+		__m128 isX = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+		__m128 isY = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+		__m128 isZ = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+		__m128 isW = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+		_mm_storeu_ps(&pose.rotationX[i], SelectSse2(s0, dropped, isX));
+		_mm_storeu_ps(&pose.rotationY[i], SelectSse2(SelectSse2(s1, s0, isX), dropped, isY));
+		_mm_storeu_ps(&pose.rotationZ[i], SelectSse2(SelectSse2(s2, s1, _mm_or_ps(isX, isY)), dropped, isZ));
+		_mm_storeu_ps(&pose.rotationW[i], SelectSse2(s2, dropped, isW));
+
+		for (uint32_t c = 0; c < 6; c++) {
+			__m128 key = _mm_cvtepi32_ps(LoadKeysSse2(keys + (3 + c) * paddedCount + i));
+			_mm_storeu_ps(vectors[c] + i, _mm_add_ps(_mm_loadu_ps(&clip.rangeMin[c][i]), _mm_mul_ps(key, _mm_loadu_ps(&clip.rangeStep[c][i]))));
+		}
+	}
+
+	DecodeKeysScalar(keys, clip, pose, i, end);
+}
+
+static void LocalTransformsSse2(const LavaPose& pose, float* rows, uint32_t begin, uint32_t end)
+{
+	uint32_t paddedCount = pose.GetPaddedCount();
+	const __m128 one = _mm_set1_ps(1.f);
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&pose.rotationX[i]);
+		__m128 y = _mm_loadu_ps(&pose.rotationY[i]);
+		__m128 z = _mm_loadu_ps(&pose.rotationZ[i]);
+		__m128 w = _mm_loadu_ps(&pose.rotationW[i]);
+		__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+		__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+		__m128 sx = _mm_loadu_ps(&pose.scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&pose.scaleY[i]);
+		__m128 sz = _mm_loadu_ps(&pose.scaleZ[i]);
+		_mm_storeu_ps(rows + 0 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx));
+		_mm_storeu_ps(rows + 1 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(xy, wz), sy));
+		_mm_storeu_ps(rows + 2 * paddedCount + i, _mm_mul_ps(_mm_add_ps(xz, wy), sz));
+		_mm_storeu_ps(rows + 3 * paddedCount + i, _mm_loadu_ps(&pose.translationX[i]));
+		_mm_storeu_ps(rows + 4 * paddedCount + i, _mm_mul_ps(_mm_add_ps(xy, wz), sx));
+		_mm_storeu_ps(rows + 5 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy));
+		_mm_storeu_ps(rows + 6 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(yz, wx), sz));
+		_mm_storeu_ps(rows + 7 * paddedCount + i, _mm_loadu_ps(&pose.translationY[i]));
+		_mm_storeu_ps(rows + 8 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(xz, wy), sx));
+		_mm_storeu_ps(rows + 9 * paddedCount + i, _mm_mul_ps(_mm_add_ps(yz, wx), sy));
+		_mm_storeu_ps(rows + 10 * paddedCount + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz));
+		_mm_storeu_ps(rows + 11 * paddedCount + i, _mm_loadu_ps(&pose.translationZ[i]));
+	}
+
+	LocalTransformsScalar(pose, rows, i, end);
+}
+#endif
+
+static void DecodeKeys(const uint16_t* keys, const LavaAnimationClip& clip, LavaPose& pose)
+{
+#if defined(LAVA_SIMD_AVX2)
+	DecodeKeysAvx2(keys, clip, pose, 0, pose.GetPaddedCount());
+#elif defined(LAVA_SIMD_SSE2)
+	DecodeKeysSse2(keys, clip, pose, 0, pose.GetPaddedCount());
+#else
+	DecodeKeysScalar(keys, clip, pose, 0, pose.GetPaddedCount());
+#endif
+}
+
+static void LocalTransforms(const LavaPose& pose, float* rows)
+{
+#if defined(LAVA_SIMD_AVX2)
+	LocalTransformsAvx2(pose, rows, 0, pose.GetPaddedCount());
+#elif defined(LAVA_SIMD_SSE2)
+	LocalTransformsSse2(pose, rows, 0, pose.GetPaddedCount());
+#else
+	LocalTransformsScalar(pose, rows, 0, pose.GetPaddedCount());
+#endif
+}
+
+void LavaSampleClip(const LavaAnimationClip& clip, float time, LavaAnimationScratch& scratch, LavaPose& pose)
+{
+	if (pose.count != clip.jointCount)
+		pose.Resize(clip.jointCount);
+	if (scratch.nextKeys.count != clip.jointCount)
+		scratch.nextKeys.Resize(clip.jointCount);
+	uint32_t paddedCount = pose.GetPaddedCount();
+	scratch.alphas.resize(paddedCount * LAVA_CHANNEL_COUNT);
+	scratch.keys[0].resize(paddedCount * LAVA_CHANNEL_COUNT * 3);
+	scratch.keys[1].resize(paddedCount * LAVA_CHANNEL_COUNT * 3);
+
+	float duration = clip.GetDuration();
+	float frame = 0.f;
+	if (duration > 0.f) {
+		float wrapped = fmodf(time, duration);
+		wrapped = wrapped < 0.f ? wrapped + duration : wrapped;
+		frame = std::min(wrapped * clip.sampleRate, float(clip.frameCount - 1));
+	}
+	uint16_t wholeFrame = uint16_t(frame);
+	uint32_t searchStep = 1;
+	while (searchStep * 2 < clip.maxKeyCount)
+		searchStep *= 2;
+
+	//Only the lookup is per track, it copies the raw keys around the frame out for the kernels.
+	uint16_t* keys = scratch.keys[0].data();
+	uint16_t* nextKeys = scratch.keys[1].data();
+	for (uint32_t j = 0; j < clip.jointCount; j++) {
+		for (uint32_t channel = 0; channel < LAVA_CHANNEL_COUNT; channel++) {
+			const LavaAnimationTrack& track = clip.tracks[j * LAVA_CHANNEL_COUNT + channel];
+			const uint16_t* frames = &clip.keyFrames[track.firstKey];
+			uint32_t key = 0;
+			float alpha = 0.f;
+			if (track.keyCount > 1) {
+				//Last segment starting at or before the frame. Branchless with the same steps for every track, key
+				//positions differ per track and time, a branching search mispredicts on most steps.
+				uint32_t lastSegment = track.keyCount - 2;
+				for (uint32_t step = searchStep; step; step >>= 1) {
+					uint32_t probe = std::min(key + step, lastSegment);
+					key = frames[probe] <= wholeFrame ? probe : key;
+				}
+				alpha = std::min((frame - float(frames[key])) / float(frames[key + 1] - frames[key]), 1.f);
+			}
+			uint32_t nextKey = std::min(key + 1, track.keyCount - 1);
+
+			scratch.alphas[channel * paddedCount + j] = alpha;
+			const uint16_t* values = &clip.keyValues[size_t(track.firstKey + key) * 3];
+			const uint16_t* nextValues = &clip.keyValues[size_t(track.firstKey + nextKey) * 3];
+			for (uint32_t k = 0; k < 3; k++) {
+				keys[(channel * 3 + k) * paddedCount + j] = values[k];
+				nextKeys[(channel * 3 + k) * paddedCount + j] = nextValues[k];
+			}
+		}
+	}
+
+	DecodeKeys(keys, clip, pose);
+	DecodeKeys(nextKeys, clip, scratch.nextKeys);
+	InterpolatePoses(pose, scratch.nextKeys, scratch.alphas.data(), pose);
+}
+
+void LavaBlendPoses(const LavaPose& a, const LavaPose& b, float weight, LavaAnimationScratch& scratch, LavaPose& out)
+{
+	if (out.count != a.count)
+		out.Resize(a.count);
+	scratch.alphas.assign(a.GetPaddedCount() * LAVA_CHANNEL_COUNT, weight);
+	InterpolatePoses(a, b, scratch.alphas.data(), out);
+}
+
+void LavaComputeSkinningMatrices(const LavaSkeleton& skeleton, const LavaPose& pose, LavaAnimationScratch& scratch, LavaAffineTransform* skinningMatrices)
+{
+	uint32_t jointCount = skeleton.GetJointCount();
+	uint32_t paddedCount = pose.GetPaddedCount();
+	assert(pose.count == jointCount);
+	scratch.localTransforms.resize(size_t(paddedCount) * 12);
+	scratch.modelTransforms.resize(jointCount);
+	const float* rows = scratch.localTransforms.data();
+	LocalTransforms(pose, scratch.localTransforms.data());
+
+	for (uint32_t j = 0; j < jointCount; j++) {
+		LavaAffineTransform local;
+		for (int r = 0; r < 3; r++) {
+			local.rows[r] = glm::vec4(rows[(r * 4) * paddedCount + j], rows[(r * 4 + 1) * paddedCount + j], rows[(r * 4 + 2) * paddedCount + j], rows[(r * 4 + 3) * paddedCount + j]);
+		}
+		int32_t parent = skeleton.parents[j];
+		scratch.modelTransforms[j] = parent < 0 ? local : MultiplyTransforms(scratch.modelTransforms[parent], local);
+		skinningMatrices[j] = MultiplyTransforms(scratch.modelTransforms[j], skeleton.inverseBindTransforms[j]);
+	}
+}
+
+void LavaAnimationSystem::Init(const LavaSkeleton* animatedSkeleton, LavaJobSystem* animationJobSystem)
+{
+	skeleton = animatedSkeleton;
+	jobSystem = animationJobSystem;
+}
+
+void LavaAnimationSystem::Update(const LavaAnimationState* states, uint32_t characterCount, LavaAffineTransform* skinningMatrices)
+{
+	if (!characterCount)
+		return;
+
+	//A few chunks per thread, each with its own scratch, so uneven clips still balance.
+	uint32_t chunkCount = std::min(characterCount, (jobSystem ? jobSystem->GetThreadCount() : 1) * 4);
+	uint32_t chunkSize = (characterCount + chunkCount - 1) / chunkCount;
+	chunkCount = (characterCount + chunkSize - 1) / chunkSize;
+	if (scratch.size() < chunkCount)
+		scratch.resize(chunkCount);
+
+	uint32_t jointCount = skeleton->GetJointCount();
+	LavaParallelFor(jobSystem, characterCount, chunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+		LavaAnimationScratch& chunkScratch = scratch[chunk];
+		for (uint32_t i = begin; i < end; i++) {
+			const LavaAnimationState& state = states[i];
+			assert(state.clips[0] && state.clips[0]->jointCount == jointCount);
+			LavaPose& pose = chunkScratch.layers[0];
+			LavaSampleClip(*state.clips[0], state.times[0], chunkScratch, pose);
+			if (state.clips[1] && state.blendWeight > 0.f) {
+				LavaSampleClip(*state.clips[1], state.times[1], chunkScratch, chunkScratch.layers[1]);
+				LavaBlendPoses(pose, chunkScratch.layers[1], state.blendWeight, chunkScratch, pose);
+			}
+			LavaComputeSkinningMatrices(*skeleton, pose, chunkScratch, skinningMatrices + size_t(i) * jointCount);
+		}
+	});
+}
+
+void LavaSkinVertices(const Vertex* vertices, const LavaSkinWeights* weights, uint32_t vertexCount,
+	const LavaAffineTransform* skinningMatrices, Vertex* skinnedVertices)
+{
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		//Linear blend skinning: the weighted sum of the joint matrices, applied once.
+		glm::vec4 rows[3] = { glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f) };
+		for (uint32_t k = 0; k < 4; k++) {
+			float weight = weights[v].weights[k];
+			const LavaAffineTransform& matrix = skinningMatrices[(weights[v].joints >> (8 * k)) & 0xff];
+			for (int i = 0; i < 3; i++) {
+				rows[i] += matrix.rows[i] * weight;
+			}
+		}
+
+		const Vertex& vertex = vertices[v];
+		glm::vec4 position(vertex.Position.x, vertex.Position.y, vertex.Position.z, 1.f);
+		glm::vec3 normal(vertex.Normal.x, vertex.Normal.y, vertex.Normal.z);
+		glm::vec3 skinnedNormal(glm::dot(glm::vec3(rows[0]), normal), glm::dot(glm::vec3(rows[1]), normal), glm::dot(glm::vec3(rows[2]), normal));
+		float normalLength = glm::length(skinnedNormal);
+		skinnedNormal = normalLength > 0.f ? skinnedNormal / normalLength : skinnedNormal;
+
+		Vertex& skinned = skinnedVertices[v];
+		skinned.Position = { glm::dot(rows[0], position), glm::dot(rows[1], position), glm::dot(rows[2], position) };
+		skinned.Normal = { skinnedNormal.x, skinnedNormal.y, skinnedNormal.z };
+	}
+}
+
+void LavaBuildChainSkeleton(const glm::vec3& start, const glm::vec3& end, uint32_t jointCount, LavaSkeleton& skeleton)
+{
+	assert(jointCount > 0 && jointCount <= LAVA_MAX_SKIN_JOINTS);
+	glm::vec3 segment = jointCount > 1 ? (end - start) / float(jointCount - 1) : glm::vec3(0.f);
+	skeleton.parents.resize(jointCount);
+	skeleton.bindPose.Resize(jointCount);
+	for (uint32_t j = 0; j < jointCount; j++) {
+		skeleton.parents[j] = int32_t(j) - 1;
+		skeleton.bindPose.SetJoint(j, glm::quat(1.f, 0.f, 0.f, 0.f), j ? segment : start, glm::vec3(1.f));
+	}
+	skeleton.ComputeInverseBindTransforms();
+}
+
+void LavaComputeChainWeights(const LavaSkeleton& skeleton, const glm::vec3& start, const glm::vec3& end,
+	const Vertex* vertices, uint32_t vertexCount, LavaSkinWeights* weights)
+{
+	uint32_t jointCount = skeleton.GetJointCount();
+	glm::vec3 axis = end - start;
+	float axisLengthSquared = glm::dot(axis, axis);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		weights[v] = {};
+		if (jointCount < 2 || axisLengthSquared <= 0.f) {
+			weights[v].weights[0] = 1.f;
+			continue;
+		}
+
+		glm::vec3 position(vertices[v].Position.x, vertices[v].Position.y, vertices[v].Position.z);
+		float along = glm::clamp(glm::dot(position - start, axis) / axisLengthSquared, 0.f, 1.f) * float(jointCount - 1);
+		uint32_t joint = std::min(uint32_t(along), jointCount - 2);
+		float fraction = along - float(joint);
+		weights[v].joints = joint | ((joint + 1) << 8);
+		weights[v].weights[0] = 1.f - fraction;
+		weights[v].weights[1] = fraction;
+	}
+}
+
+void LavaBuildSwayClip(const LavaSkeleton& skeleton, float amplitude, float frequency, uint32_t seed, LavaAnimationSamples& samples)
+{
+	const float twoPi = 6.28318531f;
+	uint32_t jointCount = skeleton.GetJointCount();
+	samples.sampleRate = 30.f;
+	samples.jointCount = jointCount;
+	samples.frameCount = std::max(2u, uint32_t(samples.sampleRate / frequency + 0.5f) + 1);
+	size_t sampleCount = size_t(samples.frameCount) * jointCount;
+	samples.rotations.resize(sampleCount);
+	samples.translations.resize(sampleCount);
+	samples.scales.resize(sampleCount);
+
+	//The root bobs by a fraction of the average bone length, so the clip fits any skeleton size.
+	float reach = 0.f;
+	for (uint32_t j = 1; j < jointCount; j++) {
+		reach += glm::length(skeleton.bindPose.GetTranslation(j)) / float(jointCount - 1);
+	}
+
+	//Whole periods of every harmonic over the clip, the last frame matches the first and the loop is seamless.
+	for (uint32_t f = 0; f < samples.frameCount; f++) {
+		float cycle = twoPi * float(f) / float(samples.frameCount - 1);
+		for (uint32_t j = 0; j < jointCount; j++) {
+			uint32_t hash = (seed * 747796405u) ^ (j * 2891336453u);
+			hash = (hash ^ (hash >> 16)) * 0x45d9f3bu;
+			float phase = float(hash & 0xffff) / 65536.f * twoPi;
+
+			glm::quat swing = glm::angleAxis(amplitude * sinf(cycle + phase), glm::vec3(1.f, 0.f, 0.f)) *
+				glm::angleAxis(0.5f * amplitude * sinf(2.f * cycle + phase), glm::vec3(0.f, 0.f, 1.f));
+			glm::vec3 translation = skeleton.bindPose.GetTranslation(j);
+			glm::vec3 scale = skeleton.bindPose.GetScale(j);
+			if (j == 0)
+				translation.y += 0.25f * reach * sinf(2.f * cycle);
+			if (j % 4 == 3)
+				scale *= 1.f + 0.05f * sinf(cycle + phase);
+
+			size_t sample = size_t(f) * jointCount + j;
+			samples.rotations[sample] = skeleton.bindPose.GetRotation(j) * swing;
+			samples.translations[sample] = translation;
+			samples.scales[sample] = scale;
+		}
+	}
+}
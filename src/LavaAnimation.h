@@ -0,0 +1,162 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaMesh.h"
+#include "LavaScene.h"
+
+#include <vector>
+
+class LavaJobSystem;
+
+//Skin weights address joints with 8 bits.
+const uint32_t LAVA_MAX_SKIN_JOINTS = 256;
+
+//Local joint transforms in structure of arrays form. Arrays are padded to a multiple of 8 joints, so the SIMD kernels
+//run over whole registers without a scalar tail. Lanes past count hold no joint.
+struct LavaPose {
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> translationX, translationY, translationZ;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	uint32_t count = 0;
+
+	void Resize(uint32_t jointCount);
+	void SetJoint(uint32_t joint, const glm::quat& rotation, const glm::vec3& translation, const glm::vec3& scale);
+	glm::quat GetRotation(uint32_t joint) const { return glm::quat(rotationW[joint], rotationX[joint], rotationY[joint], rotationZ[joint]); }
+	glm::vec3 GetTranslation(uint32_t joint) const { return glm::vec3(translationX[joint], translationY[joint], translationZ[joint]); }
+	glm::vec3 GetScale(uint32_t joint) const { return glm::vec3(scaleX[joint], scaleY[joint], scaleZ[joint]); }
+	uint32_t GetPaddedCount() const { return uint32_t(rotationW.size()); }
+};
+
+//Joints are stored parents first, so model space transforms come out of one pass in joint order.
+struct LavaSkeleton {
+	std::vector<int32_t> parents; //-1 for roots
+	LavaPose bindPose;
+	std::vector<LavaAffineTransform> inverseBindTransforms; //Model space to joint space in the bind pose
+
+	uint32_t GetJointCount() const { return uint32_t(parents.size()); }
+	void ComputeInverseBindTransforms();
+};
+
+//Uncompressed clip at a fixed sample rate, what a DCC export or procedural generator hands over.
+//Per channel arrays are frame major: frame * jointCount + joint.
+struct LavaAnimationSamples {
+	float sampleRate = 30.f;
+	uint32_t frameCount = 0;
+	uint32_t jointCount = 0;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> translations;
+	std::vector<glm::vec3> scales;
+};
+
+//Largest error a track may have at any source frame, after key reduction and quantization together.
+struct LavaClipCompressionSettings {
+	float rotationTolerance = 0.001f; //Radians
+	float translationTolerance = 0.0001f; //Units
+	float scaleTolerance = 0.0001f;
+};
+
+enum LavaAnimationChannel {
+	LAVA_CHANNEL_ROTATION,
+	LAVA_CHANNEL_TRANSLATION,
+	LAVA_CHANNEL_SCALE,
+	LAVA_CHANNEL_COUNT
+};
+
+//Keys [firstKey, firstKey + keyCount) of one channel of one joint.
+struct LavaAnimationTrack {
+	uint32_t firstKey;
+	uint32_t keyCount;
+};
+
+//Compressed clip. Every track keeps only the keys linear interpolation needs to stay within the tolerances,
+//rotations are stored as the smallest three components at 15 bits each, 6 bytes per key.
+struct LavaAnimationClip {
+	float sampleRate = 30.f;
+	uint32_t frameCount = 0;
+	uint32_t jointCount = 0;
+	std::vector<LavaAnimationTrack> tracks; //jointCount * LAVA_CHANNEL_COUNT, joint major
+	std::vector<uint16_t> keyFrames; //Source frame of each key, ascending within a track
+	std::vector<uint16_t> keyValues; //3 per key
+	uint32_t maxKeyCount = 0; //Of the longest track, bounds the key search
+	//Translation and scale keys are 16 bit steps over the track's range, a key decodes to rangeMin + key * rangeStep.
+	//Components 0-2 are translation xyz, 3-5 scale xyz, each padded like LavaPose so the decode kernel loads them directly.
+	std::vector<float> rangeMin[6];
+	std::vector<float> rangeStep[6];
+
+	//Measured against the source samples while compressing
+	float maxRotationError = 0.f;
+	float maxTranslationError = 0.f;
+	float maxScaleError = 0.f;
+
+	float GetDuration() const { return frameCount > 1 ? float(frameCount - 1) / sampleRate : 0.f; }
+	size_t GetSize() const;
+};
+
+bool LavaCompressClip(const LavaAnimationSamples& samples, const LavaClipCompressionSettings& settings, LavaAnimationClip& clip);
+size_t LavaGetSamplesSize(const LavaAnimationSamples& samples);
+
+//Per thread temporaries of sampling and skinning, reused so animating doesn't allocate.
+struct LavaAnimationScratch {
+	std::vector<uint16_t> keys[2]; //Keys before and after the sample time, 9 values per padded joint
+	LavaPose nextKeys;
+	LavaPose layers[2];
+	std::vector<float> alphas; //Interpolation factor per channel and padded joint
+	std::vector<float> localTransforms; //12 rows of affine matrices per padded joint
+	std::vector<LavaAffineTransform> modelTransforms;
+};
+
+//Pose of a looping clip at time seconds. Key lookup is scalar per track, decoding and interpolating the keys runs over
+//8 joints at once with AVX2, 4 with SSE2.
+void LavaSampleClip(const LavaAnimationClip& clip, float time, LavaAnimationScratch& scratch, LavaPose& pose);
+//Normalized lerp towards b by weight, with the shortest path for every rotation. out may alias a or b.
+void LavaBlendPoses(const LavaPose& a, const LavaPose& b, float weight, LavaAnimationScratch& scratch, LavaPose& out);
+//Local pose to the model space transforms times the inverse bind, what the skinning shader multiplies vertices with.
+//Local matrices are built with the SIMD kernels, the walk down the hierarchy is scalar.
+void LavaComputeSkinningMatrices(const LavaSkeleton& skeleton, const LavaPose& pose, LavaAnimationScratch& scratch, LavaAffineTransform* skinningMatrices);
+
+//What a character plays: clips[0] at times[0], blended towards clips[1] by blendWeight. clips[1] may be null.
+struct LavaAnimationState {
+	const LavaAnimationClip* clips[2];
+	float times[2];
+	float blendWeight;
+};
+
+//Samples, blends and skins characters sharing one skeleton, characters spread over the job system.
+//Skinning matrices of character i start at i * jointCount.
+class LavaAnimationSystem {
+public:
+	void Init(const LavaSkeleton* skeleton, LavaJobSystem* jobSystem);
+	void Update(const LavaAnimationState* states, uint32_t characterCount, LavaAffineTransform* skinningMatrices);
+
+private:
+	const LavaSkeleton* skeleton = nullptr;
+	LavaJobSystem* jobSystem = nullptr;
+	std::vector<LavaAnimationScratch> scratch; //One per chunk of characters
+};
+
+//GPU layouts below mirror the structs in skin.comp.glsl, std430.
+struct LavaSkinWeights {
+	uint32_t joints; //4 joint indices, 8 bits each, lowest byte first
+	float weights[4]; //Sum to 1
+};
+
+struct LavaSkinConstants {
+	uint32_t vertexBuffer; //Bind pose vertices
+	uint32_t weightBuffer;
+	uint32_t matrixBuffer;
+	uint32_t outputBuffer; //Skinned vertices, same layout as the bind pose
+	uint32_t positionBuffer; //Skinned positions for the depth prepass, LAVA_BINDLESS_INVALID_INDEX without one
+	uint32_t vertexCount;
+};
+
+//Scalar reference of what skin.comp does.
+void LavaSkinVertices(const Vertex* vertices, const LavaSkinWeights* weights, uint32_t vertexCount,
+	const LavaAffineTransform* skinningMatrices, Vertex* skinnedVertices);
+
+//Procedural content for meshes and benchmarks without authored skins.
+//Chain of joints from start to end, each child one segment further along.
+void LavaBuildChainSkeleton(const glm::vec3& start, const glm::vec3& end, uint32_t jointCount, LavaSkeleton& skeleton);
+//Every vertex between the two chain joints it lies between along the chain, linear falloff.
+void LavaComputeChainWeights(const LavaSkeleton& skeleton, const glm::vec3& start, const glm::vec3& end,
+	const Vertex* vertices, uint32_t vertexCount, LavaSkinWeights* weights);
+//Looping sway around the bind pose, every joint swinging on its own phase by up to amplitude radians.
+void LavaBuildSwayClip(const LavaSkeleton& skeleton, float amplitude, float frequency, uint32_t seed, LavaAnimationSamples& samples);
@@ -0,0 +1,177 @@
+#include "LavaBindless.h"
+#include <algorithm>
+
+static const VkDescriptorType descriptorTypes[LAVA_BINDLESS_TYPE_COUNT] = {
+	VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	VK_DESCRIPTOR_TYPE_SAMPLER
+};
+
+bool LavaBindlessHeap::IsSupported(const VkPhysicalDeviceFeatures& coreFeatures, const VkPhysicalDeviceVulkan12Features& features)
+{
+	//Indices come from push constants and buffers, dynamically uniform indexing is a core feature of its own.
+	return coreFeatures.shaderStorageBufferArrayDynamicIndexing &&
+		coreFeatures.shaderSampledImageArrayDynamicIndexing &&
+		features.descriptorIndexing &&
+		features.runtimeDescriptorArray &&
+		features.descriptorBindingPartiallyBound &&
+		features.descriptorBindingStorageBufferUpdateAfterBind &&
+		features.descriptorBindingSampledImageUpdateAfterBind &&
+		features.shaderSampledImageArrayNonUniformIndexing &&
+		features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+void LavaBindlessHeap::Create(VkDevice activeDevice, VkPhysicalDevice physicalDevice, uint32_t framesInFlight)
+{
+	device = activeDevice;
+
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	//Desired sizes, clamped by what the driver allows in a single update-after-bind set.
+	uint32_t capacities[LAVA_BINDLESS_TYPE_COUNT] = {};
+	capacities[LAVA_BINDLESS_STORAGE_BUFFER] = std::min(4096u, std::min(indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers));
+	capacities[LAVA_BINDLESS_SAMPLED_IMAGE] = std::min(16384u, std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages));
+	capacities[LAVA_BINDLESS_SAMPLER] = std::min(256u, std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers));
+
+	VkDescriptorSetLayoutBinding bindings[LAVA_BINDLESS_TYPE_COUNT] = {};
+	VkDescriptorBindingFlags bindingFlags[LAVA_BINDLESS_TYPE_COUNT] = {};
+	VkDescriptorPoolSize poolSizes[LAVA_BINDLESS_TYPE_COUNT] = {};
+
+	for (uint32_t i = 0; i < LAVA_BINDLESS_TYPE_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = descriptorTypes[i];
+		bindings[i].descriptorCount = capacities[i];
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+		//Partially bound: unused slots may stay empty. Update after bind: register while the set is bound in flight.
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+		poolSizes[i].type = descriptorTypes[i];
+		poolSizes[i].descriptorCount = capacities[i];
+
+		allocators[i].Init(capacities[i], framesInFlight);
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = LAVA_BINDLESS_TYPE_COUNT;
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutCreateInfo.bindingCount = LAVA_BINDLESS_TYPE_COUNT;
+	layoutCreateInfo.pBindings = bindings;
+
+	LAVA_ASSERT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout));
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = LAVA_BINDLESS_TYPE_COUNT;
+	poolCreateInfo.pPoolSizes = poolSizes;
+
+	LAVA_ASSERT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &pool));
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = pool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &setLayout;
+
+	LAVA_ASSERT(vkAllocateDescriptorSets(device, &allocateInfo, &set));
+}
+
+void LavaBindlessHeap::Destroy()
+{
+	//Set is freed with the pool
+	vkDestroyDescriptorPool(device, pool, 0);
+	vkDestroyDescriptorSetLayout(device, setLayout, 0);
+	pool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+}
+
+uint32_t LavaBindlessHeap::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	uint32_t index = allocators[LAVA_BINDLESS_STORAGE_BUFFER].Allocate();
+	UpdateBuffer(index, buffer, offset, range);
+	return index;
+}
+
+uint32_t LavaBindlessHeap::RegisterImage(VkImageView imageView, VkImageLayout layout)
+{
+	uint32_t index = allocators[LAVA_BINDLESS_SAMPLED_IMAGE].Allocate();
+	UpdateImage(index, imageView, layout);
+	return index;
+}
+
+uint32_t LavaBindlessHeap::RegisterSampler(VkSampler sampler)
+{
+	uint32_t index = allocators[LAVA_BINDLESS_SAMPLER].Allocate();
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = sampler;
+	WriteDescriptor(LAVA_BINDLESS_SAMPLER, index, nullptr, &imageInfo);
+	return index;
+}
+
+void LavaBindlessHeap::UpdateBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+	WriteDescriptor(LAVA_BINDLESS_STORAGE_BUFFER, index, &bufferInfo, nullptr);
+}
+
+void LavaBindlessHeap::UpdateImage(uint32_t index, VkImageView imageView, VkImageLayout layout)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = layout;
+	WriteDescriptor(LAVA_BINDLESS_SAMPLED_IMAGE, index, nullptr, &imageInfo);
+}
+
+void LavaBindlessHeap::Release(LavaBindlessType type, uint32_t index)
+{
+	//Descriptor is left as is, partially bound lets the slot go stale until it is handed out again.
+	allocators[type].Free(index, currentFrame);
+}
+
+void LavaBindlessHeap::BeginFrame(uint64_t frame)
+{
+	currentFrame = frame;
+	for (uint32_t i = 0; i < LAVA_BINDLESS_TYPE_COUNT; i++) {
+		allocators[i].BeginFrame(frame);
+	}
+}
+
+void LavaBindlessHeap::WriteDescriptor(LavaBindlessType type, uint32_t index, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo)
+{
+	if (index == LAVA_BINDLESS_INVALID_INDEX)
+		return;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = type;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = descriptorTypes[type];
+	write.pBufferInfo = bufferInfo;
+	write.pImageInfo = imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
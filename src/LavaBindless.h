@@ -0,0 +1,47 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaIndexAllocator.h"
+
+//Binding slots of the bindless set. Shaders declare unbounded arrays at the same bindings.
+enum LavaBindlessType {
+	LAVA_BINDLESS_STORAGE_BUFFER = 0,
+	LAVA_BINDLESS_SAMPLED_IMAGE = 1,
+	LAVA_BINDLESS_SAMPLER = 2,
+	LAVA_BINDLESS_TYPE_COUNT
+};
+
+//One big update-after-bind descriptor set for the whole renderer. Resources get a stable index on register
+//and shaders reach them through indices passed in push constants or buffers, so nothing gets bound per draw.
+class LavaBindlessHeap {
+public:
+	static bool IsSupported(const VkPhysicalDeviceFeatures& coreFeatures, const VkPhysicalDeviceVulkan12Features& features);
+
+	void Create(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight);
+	void Destroy();
+
+	uint32_t RegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	uint32_t RegisterImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	uint32_t RegisterSampler(VkSampler sampler);
+
+	//Re-point an existing slot, index stays the same for shaders.
+	void UpdateBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void UpdateImage(uint32_t index, VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	void Release(LavaBindlessType type, uint32_t index);
+	void BeginFrame(uint64_t frame);
+
+	VkDescriptorSetLayout GetLayout() const { return setLayout; }
+	VkDescriptorSet GetSet() const { return set; }
+	uint32_t GetCapacity(LavaBindlessType type) const { return allocators[type].GetCapacity(); }
+
+private:
+	void WriteDescriptor(LavaBindlessType type, uint32_t index, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	LavaIndexAllocator allocators[LAVA_BINDLESS_TYPE_COUNT];
+	uint64_t currentFrame = 0;
+};
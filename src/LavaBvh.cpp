@@ -0,0 +1,657 @@
+#include "LavaBvh.h"
+
+#include <algorithm>
+#include <float.h>
+
+static const uint32_t bvhBinCount = 16;
+static const uint32_t bvhMinLeafSize = 4; //Ranges this small become leaves without trying to split
+static const uint32_t bvhMaxLeafSize = 8;
+static const uint32_t bvhTaskThreshold = 4096; //Subtrees above this are built as separate jobs
+static const uint32_t bvhParallelBinThreshold = 64 * 1024; //Ranges above this are binned in parallel chunks
+static const float bvhTraversalCost = 1.f;
+static const uint32_t bvhMaxSahDepth = 64; //Deeper ranges are split at the centroid median, which at most adds log2 of the range
+
+static LavaAabb EmptyAabb()
+{
+	LavaAabb aabb;
+	aabb.min = glm::vec3(FLT_MAX);
+	aabb.max = glm::vec3(-FLT_MAX);
+	return aabb;
+}
+
+static void Grow(LavaAabb& aabb, const LavaAabb& other)
+{
+	aabb.min = glm::min(aabb.min, other.min);
+	aabb.max = glm::max(aabb.max, other.max);
+}
+
+static float SurfaceArea(const LavaAabb& aabb)
+{
+	glm::vec3 extent = aabb.max - aabb.min;
+	if (extent.x < 0.f)
+		return 0.f;
+	return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static LavaAabb NodeBounds(const LavaBvhNode& node)
+{
+	LavaAabb aabb;
+	aabb.min = node.boundsMin;
+	aabb.max = node.boundsMax;
+	return aabb;
+}
+
+struct LavaBvh::BuildContext {
+	Tree* tree;
+	const LavaAabb* bounds;
+	std::vector<glm::vec3> centroids;
+	LavaJobSystem* jobSystem;
+	std::atomic<uint32_t> nodeCounter{ 0 };
+	std::atomic<uint32_t> depth{ 0 };
+	LavaJobCounter counter;
+};
+
+//Per axis bins over the centroid bounds of a range.
+struct LavaBvhBins {
+	LavaAabb binBounds[3][bvhBinCount];
+	uint32_t binCounts[3][bvhBinCount];
+};
+
+static void ComputeRangeBounds(const LavaAabb* bounds, const glm::vec3* centroids, const uint32_t* primitives, uint32_t count,
+	LavaJobSystem* jobSystem, LavaAabb& rangeBounds, LavaAabb& centroidBounds)
+{
+	rangeBounds = EmptyAabb();
+	centroidBounds = EmptyAabb();
+	if (count < bvhParallelBinThreshold || !jobSystem) {
+		for (uint32_t i = 0; i < count; i++) {
+			Grow(rangeBounds, bounds[primitives[i]]);
+			centroidBounds.min = glm::min(centroidBounds.min, centroids[primitives[i]]);
+			centroidBounds.max = glm::max(centroidBounds.max, centroids[primitives[i]]);
+		}
+		return;
+	}
+
+	uint32_t chunkSize = bvhParallelBinThreshold / 4;
+	std::vector<LavaAabb> chunkBounds((count + chunkSize - 1) / chunkSize * 2, EmptyAabb());
+	jobSystem->ParallelFor(count, chunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+		LavaAabb& chunkRange = chunkBounds[chunk * 2];
+		LavaAabb& chunkCentroids = chunkBounds[chunk * 2 + 1];
+		for (uint32_t i = begin; i < end; i++) {
+			Grow(chunkRange, bounds[primitives[i]]);
+			chunkCentroids.min = glm::min(chunkCentroids.min, centroids[primitives[i]]);
+			chunkCentroids.max = glm::max(chunkCentroids.max, centroids[primitives[i]]);
+		}
+	});
+
+	for (size_t i = 0; i < chunkBounds.size(); i += 2) {
+		Grow(rangeBounds, chunkBounds[i]);
+		Grow(centroidBounds, chunkBounds[i + 1]);
+	}
+}
+
+static uint32_t BinIndex(float centroid, float binMin, float binScale)
+{
+	int bin = int((centroid - binMin) * binScale);
+	return uint32_t(std::min(std::max(bin, 0), int(bvhBinCount) - 1));
+}
+
+static void FillBins(const LavaAabb* bounds, const glm::vec3* centroids, const uint32_t* primitives, uint32_t begin, uint32_t end,
+	const LavaAabb& centroidBounds, const glm::vec3& binScale, LavaBvhBins& bins)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		for (uint32_t bin = 0; bin < bvhBinCount; bin++) {
+			bins.binBounds[axis][bin] = EmptyAabb();
+			bins.binCounts[axis][bin] = 0;
+		}
+	}
+
+	for (uint32_t i = begin; i < end; i++) {
+		uint32_t primitive = primitives[i];
+		for (int axis = 0; axis < 3; axis++) {
+			uint32_t bin = BinIndex(centroids[primitive][axis], centroidBounds.min[axis], binScale[axis]);
+			Grow(bins.binBounds[axis][bin], bounds[primitive]);
+			bins.binCounts[axis][bin]++;
+		}
+	}
+}
+
+void LavaBvh::BuildNode(BuildContext& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+	Tree& tree = *context.tree;
+	uint32_t* primitives = tree.primitives.data() + first;
+
+	LavaAabb rangeBounds, centroidBounds;
+	ComputeRangeBounds(context.bounds, context.centroids.data(), primitives, count, context.jobSystem, rangeBounds, centroidBounds);
+
+	LavaBvhNode& node = tree.nodes[nodeIndex];
+	node.boundsMin = rangeBounds.min;
+	node.boundsMax = rangeBounds.max;
+	node.firstPrimitive = first;
+	node.primitiveCount = count;
+	node.leftChild = 0;
+
+	//Best split over all axes and bin boundaries by SAH.
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	glm::vec3 centroidExtent = centroidBounds.max - centroidBounds.min;
+	if (depth < bvhMaxSahDepth && count > bvhMinLeafSize && (centroidExtent.x > 0.f || centroidExtent.y > 0.f || centroidExtent.z > 0.f)) {
+		glm::vec3 binScale;
+		for (int axis = 0; axis < 3; axis++) {
+			binScale[axis] = centroidExtent[axis] > 0.f ? float(bvhBinCount) / centroidExtent[axis] : 0.f;
+		}
+
+		LavaBvhBins bins;
+		if (count < bvhParallelBinThreshold || !context.jobSystem) {
+			FillBins(context.bounds, context.centroids.data(), primitives, 0, count, centroidBounds, binScale, bins);
+		}
+		else {
+			uint32_t chunkSize = bvhParallelBinThreshold / 4;
+			std::vector<LavaBvhBins> chunkBins((count + chunkSize - 1) / chunkSize);
+			context.jobSystem->ParallelFor(count, chunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+				FillBins(context.bounds, context.centroids.data(), primitives, begin, end, centroidBounds, binScale, chunkBins[chunk]);
+			});
+
+			bins = chunkBins[0];
+			for (size_t chunk = 1; chunk < chunkBins.size(); chunk++) {
+				for (int axis = 0; axis < 3; axis++) {
+					for (uint32_t bin = 0; bin < bvhBinCount; bin++) {
+						Grow(bins.binBounds[axis][bin], chunkBins[chunk].binBounds[axis][bin]);
+						bins.binCounts[axis][bin] += chunkBins[chunk].binCounts[axis][bin];
+					}
+				}
+			}
+		}
+
+		float parentArea = SurfaceArea(rangeBounds);
+		for (int axis = 0; axis < 3; axis++) {
+			if (centroidExtent[axis] <= 0.f)
+				continue;
+
+			//Sweep from the right to get the right side of every split, then from the left to evaluate.
+			float rightAreas[bvhBinCount];
+			uint32_t rightCounts[bvhBinCount];
+			LavaAabb right = EmptyAabb();
+			uint32_t rightCount = 0;
+			for (uint32_t bin = bvhBinCount - 1; bin > 0; bin--) {
+				Grow(right, bins.binBounds[axis][bin]);
+				rightCount += bins.binCounts[axis][bin];
+				rightAreas[bin] = SurfaceArea(right);
+				rightCounts[bin] = rightCount;
+			}
+
+			LavaAabb left = EmptyAabb();
+			uint32_t leftCount = 0;
+			for (uint32_t split = 1; split < bvhBinCount; split++) {
+				Grow(left, bins.binBounds[axis][split - 1]);
+				leftCount += bins.binCounts[axis][split - 1];
+				if (leftCount == 0 || rightCounts[split] == 0)
+					continue;
+
+				float cost = bvhTraversalCost + (SurfaceArea(left) * leftCount + rightAreas[split] * rightCounts[split]) / parentArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		uint32_t middle = 0;
+		if (bestAxis >= 0 && (bestCost < float(count) || count > bvhMaxLeafSize)) {
+			float binMin = centroidBounds.min[bestAxis];
+			float scale = binScale[bestAxis];
+			const glm::vec3* centroids = context.centroids.data();
+			uint32_t* split = std::partition(primitives, primitives + count, [&](uint32_t primitive) {
+				return BinIndex(centroids[primitive][bestAxis], binMin, scale) < bestSplit;
+			});
+			middle = uint32_t(split - primitives);
+		}
+
+		if (middle > 0 && middle < count) {
+			uint32_t leftChild = context.nodeCounter.fetch_add(2);
+			node.leftChild = leftChild;
+			tree.nodes[leftChild].parent = nodeIndex;
+			tree.nodes[leftChild + 1].parent = nodeIndex;
+
+			//Big right halves go to the job system, the left half continues on this thread.
+			uint32_t rightCount = count - middle;
+			if (context.jobSystem && rightCount > bvhTaskThreshold) {
+				BuildContext* sharedContext = &context;
+				context.jobSystem->Submit([sharedContext, leftChild, first, middle, rightCount, depth]() {
+					BuildNode(*sharedContext, leftChild + 1, first + middle, rightCount, depth + 1);
+				}, &context.counter);
+			}
+			else {
+				BuildNode(context, leftChild + 1, first + middle, rightCount, depth + 1);
+			}
+			BuildNode(context, leftChild, first, middle, depth + 1);
+			return;
+		}
+	}
+
+	//Leaf. Too many objects still get split in half, at the centroid median past the SAH depth limit
+	//and by index for identical centroids.
+	if (count > bvhMaxLeafSize) {
+		uint32_t middle = count / 2;
+		int axis = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : centroidExtent.y >= centroidExtent.z ? 1 : 2;
+		if (centroidExtent[axis] > 0.f) {
+			const glm::vec3* centroids = context.centroids.data();
+			std::nth_element(primitives, primitives + middle, primitives + count, [&](uint32_t a, uint32_t b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+		}
+
+		uint32_t leftChild = context.nodeCounter.fetch_add(2);
+		node.leftChild = leftChild;
+		tree.nodes[leftChild].parent = nodeIndex;
+		tree.nodes[leftChild + 1].parent = nodeIndex;
+		BuildNode(context, leftChild, first, middle, depth + 1);
+		BuildNode(context, leftChild + 1, first + middle, count - middle, depth + 1);
+		return;
+	}
+
+	uint32_t deepest = context.depth.load();
+	while (depth > deepest && !context.depth.compare_exchange_weak(deepest, depth)) {
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		tree.primitiveLeaves[primitives[i]] = nodeIndex;
+	}
+}
+
+void LavaBvh::BuildTree(Tree& tree, const LavaAabb* bounds, uint32_t objectCount, LavaJobSystem* jobSystem)
+{
+	tree.nodes.resize(objectCount > 0 ? objectCount * 2 - 1 : 1);
+	tree.primitives.resize(objectCount);
+	tree.primitiveLeaves.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		tree.primitives[i] = i;
+	}
+
+	BuildContext context;
+	context.tree = &tree;
+	context.bounds = bounds;
+	context.centroids.resize(objectCount);
+	context.jobSystem = jobSystem;
+	LavaParallelFor(jobSystem, objectCount, 16 * 1024, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			context.centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+		}
+	});
+
+	context.nodeCounter = 1;
+	tree.nodes[0].parent = ~0u;
+	if (objectCount > 0) {
+		BuildNode(context, 0, 0, objectCount, 0);
+	}
+	else {
+		tree.nodes[0] = {};
+		tree.nodes[0].parent = ~0u;
+	}
+	if (jobSystem)
+		jobSystem->Wait(context.counter);
+
+	tree.nodeCount = context.nodeCounter.load();
+	tree.depth = context.depth.load();
+	assert(tree.depth < LAVA_BVH_STACK_SIZE); //Refits keep the topology, so this holds until the next build
+	tree.rootArea = SurfaceArea(NodeBounds(tree.nodes[0]));
+}
+
+LavaBvh::~LavaBvh()
+{
+	if (rebuilding)
+		jobSystem->Wait(rebuildCounter);
+}
+
+void LavaBvh::Build(const LavaAabb* bounds, uint32_t objectCount, LavaJobSystem* buildJobSystem)
+{
+	if (rebuilding) {
+		jobSystem->Wait(rebuildCounter);
+		rebuilding = false;
+	}
+
+	jobSystem = buildJobSystem;
+	objectBounds.assign(bounds, bounds + objectCount);
+	pendingRefits.clear();
+	movedSinceBuild = 0;
+	BuildTree(*current, objectBounds.data(), objectCount, jobSystem);
+}
+
+void LavaBvh::UpdateObject(uint32_t object, const LavaAabb& bounds)
+{
+	objectBounds[object] = bounds;
+	pendingRefits.push_back(object);
+	if (rebuilding)
+		movedDuringRebuild.push_back(object);
+}
+
+void LavaBvh::RefitPath(uint32_t leaf)
+{
+	std::vector<LavaBvhNode>& nodes = current->nodes;
+	const uint32_t* primitives = current->primitives.data();
+
+	for (uint32_t nodeIndex = leaf; nodeIndex != ~0u; nodeIndex = nodes[nodeIndex].parent) {
+		LavaBvhNode& node = nodes[nodeIndex];
+		LavaAabb bounds = EmptyAabb();
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				Grow(bounds, objectBounds[primitives[node.firstPrimitive + i]]);
+			}
+		}
+		else {
+			bounds = NodeBounds(nodes[node.leftChild]);
+			Grow(bounds, NodeBounds(nodes[node.leftChild + 1]));
+		}
+
+		//Unchanged bounds mean everything above is still right.
+		if (bounds.min == node.boundsMin && bounds.max == node.boundsMax)
+			return;
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+}
+
+void LavaBvh::RefitAll()
+{
+	//Children are always allocated after their parent, so reverse order is bottom up.
+	std::vector<LavaBvhNode>& nodes = current->nodes;
+	const uint32_t* primitives = current->primitives.data();
+	for (uint32_t nodeIndex = current->nodeCount; nodeIndex-- > 0;) {
+		LavaBvhNode& node = nodes[nodeIndex];
+		LavaAabb bounds = EmptyAabb();
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				Grow(bounds, objectBounds[primitives[node.firstPrimitive + i]]);
+			}
+		}
+		else {
+			bounds = NodeBounds(nodes[node.leftChild]);
+			Grow(bounds, NodeBounds(nodes[node.leftChild + 1]));
+		}
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+	pendingRefits.clear();
+}
+
+void LavaBvh::Refit()
+{
+	if (rebuilding && rebuildCounter.pending.load() == 0)
+		FinishRebuild();
+
+	movedSinceBuild += uint32_t(pendingRefits.size());
+	if (pendingRefits.size() > objectBounds.size() / 8) {
+		RefitAll();
+	}
+	else {
+		for (uint32_t object : pendingRefits) {
+			RefitPath(current->primitiveLeaves[object]);
+		}
+		pendingRefits.clear();
+	}
+
+	bool degraded = movedSinceBuild > uint32_t(rebuildMovedFraction * objectBounds.size()) ||
+		SurfaceArea(NodeBounds(current->nodes[0])) > current->rootArea * rebuildAreaGrowth;
+	if (degraded && !rebuilding)
+		StartRebuild();
+}
+
+void LavaBvh::StartRebuild()
+{
+	movedSinceBuild = 0;
+	if (!jobSystem || jobSystem->GetThreadCount() == 1) {
+		BuildTree(*current, objectBounds.data(), uint32_t(objectBounds.size()), jobSystem);
+		return;
+	}
+
+	rebuilding = true;
+	rebuildBounds = objectBounds;
+	movedDuringRebuild.clear();
+	if (!rebuildTree)
+		rebuildTree.reset(new Tree());
+
+	Tree* tree = rebuildTree.get();
+	const LavaAabb* bounds = rebuildBounds.data();
+	uint32_t objectCount = uint32_t(rebuildBounds.size());
+	LavaJobSystem* buildJobSystem = jobSystem;
+	jobSystem->Submit([tree, bounds, objectCount, buildJobSystem]() {
+		BuildTree(*tree, bounds, objectCount, buildJobSystem);
+	}, &rebuildCounter);
+}
+
+void LavaBvh::FinishRebuild()
+{
+	rebuilding = false;
+	std::swap(current, rebuildTree);
+
+	//The new tree was built from the snapshot, anything that moved since then still needs its path refitted.
+	pendingRefits.insert(pendingRefits.end(), movedDuringRebuild.begin(), movedDuringRebuild.end());
+	movedDuringRebuild.clear();
+}
+
+//Plane test with the corner furthest along the normal (outside check) and the nearest one (fully inside check).
+static int ClassifyAabb(const LavaFrustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t& planeMask)
+{
+	bool inside = true;
+	for (int p = 0; p < 6; p++) {
+		if (!(planeMask & (1u << p)))
+			continue;
+
+		const glm::vec4& plane = frustum.planes[p];
+		glm::vec3 positive(plane.x > 0.f ? boundsMax.x : boundsMin.x, plane.y > 0.f ? boundsMax.y : boundsMin.y, plane.z > 0.f ? boundsMax.z : boundsMin.z);
+		glm::vec3 negative(plane.x > 0.f ? boundsMin.x : boundsMax.x, plane.y > 0.f ? boundsMin.y : boundsMax.y, plane.z > 0.f ? boundsMin.z : boundsMax.z);
+		if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.f)
+			return -1;
+		if (plane.x * negative.x + plane.y * negative.y + plane.z * negative.z + plane.w >= 0.f)
+			planeMask &= ~(1u << p); //Fully in front, children don't need this plane
+		else
+			inside = false;
+	}
+	return inside ? 1 : 0;
+}
+
+void LavaBvh::CullFrustum(const LavaFrustum& frustum, std::vector<uint32_t>& visibleObjects) const
+{
+	visibleObjects.clear();
+	if (objectBounds.empty())
+		return;
+
+	const LavaBvhNode* nodes = current->nodes.data();
+	const uint32_t* primitives = current->primitives.data();
+
+	struct StackEntry {
+		uint32_t node;
+		uint32_t planeMask;
+	};
+	StackEntry stack[LAVA_BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, 0x3f };
+
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		const LavaBvhNode& node = nodes[entry.node];
+
+		uint32_t planeMask = entry.planeMask;
+		int classification = ClassifyAabb(frustum, node.boundsMin, node.boundsMax, planeMask);
+		if (classification < 0)
+			continue;
+
+		if (classification > 0) {
+			visibleObjects.insert(visibleObjects.end(), primitives + node.firstPrimitive, primitives + node.firstPrimitive + node.primitiveCount);
+			continue;
+		}
+
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				uint32_t object = primitives[node.firstPrimitive + i];
+				uint32_t objectMask = planeMask;
+				if (ClassifyAabb(frustum, objectBounds[object].min, objectBounds[object].max, objectMask) >= 0)
+					visibleObjects.push_back(object);
+			}
+			continue;
+		}
+
+		stack[stackSize++] = { node.leftChild + 1, planeMask };
+		stack[stackSize++] = { node.leftChild, planeMask };
+	}
+}
+
+static bool IntersectRayAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	float maxDistance, float& entryDistance)
+{
+	glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+	glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+	glm::vec3 nearT = glm::min(t0, t1);
+	glm::vec3 farT = glm::max(t0, t1);
+	float entry = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.f));
+	float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+	entryDistance = entry;
+	return entry <= exit;
+}
+
+bool LavaBvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, LavaBvhHit& hit) const
+{
+	if (objectBounds.empty())
+		return false;
+
+	const LavaBvhNode* nodes = current->nodes.data();
+	const uint32_t* primitives = current->primitives.data();
+	glm::vec3 inverseDirection = 1.f / direction;
+
+	hit.object = ~0u;
+	hit.distance = maxDistance;
+
+	uint32_t stack[LAVA_BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	float entry;
+	if (IntersectRayAabb(origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, hit.distance, entry))
+		stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const LavaBvhNode& node = nodes[stack[--stackSize]];
+
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				uint32_t object = primitives[node.firstPrimitive + i];
+				if (IntersectRayAabb(origin, inverseDirection, objectBounds[object].min, objectBounds[object].max, hit.distance, entry) &&
+					entry < hit.distance) {
+					hit.object = object;
+					hit.distance = entry;
+				}
+			}
+			continue;
+		}
+
+		//Visit the nearer child first so the hit distance shrinks early and prunes the other side.
+		float leftEntry, rightEntry;
+		const LavaBvhNode& left = nodes[node.leftChild];
+		const LavaBvhNode& right = nodes[node.leftChild + 1];
+		bool hitLeft = IntersectRayAabb(origin, inverseDirection, left.boundsMin, left.boundsMax, hit.distance, leftEntry);
+		bool hitRight = IntersectRayAabb(origin, inverseDirection, right.boundsMin, right.boundsMax, hit.distance, rightEntry);
+		if (hitLeft && hitRight) {
+			bool leftFirst = leftEntry <= rightEntry;
+			stack[stackSize++] = leftFirst ? node.leftChild + 1 : node.leftChild;
+			stack[stackSize++] = leftFirst ? node.leftChild : node.leftChild + 1;
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = node.leftChild;
+		}
+		else if (hitRight) {
+			stack[stackSize++] = node.leftChild + 1;
+		}
+	}
+
+	return hit.object != ~0u;
+}
+
+void LavaBvh::QueryBox(const LavaAabb& box, std::vector<uint32_t>& objects) const
+{
+	objects.clear();
+	if (objectBounds.empty())
+		return;
+
+	const LavaBvhNode* nodes = current->nodes.data();
+	const uint32_t* primitives = current->primitives.data();
+
+	auto overlaps = [&box](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		return glm::all(glm::lessThanEqual(boundsMin, box.max)) && glm::all(glm::greaterThanEqual(boundsMax, box.min));
+	};
+
+	uint32_t stack[LAVA_BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const LavaBvhNode& node = nodes[stack[--stackSize]];
+		if (!overlaps(node.boundsMin, node.boundsMax))
+			continue;
+
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				uint32_t object = primitives[node.firstPrimitive + i];
+				if (overlaps(objectBounds[object].min, objectBounds[object].max))
+					objects.push_back(object);
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.leftChild + 1;
+		stack[stackSize++] = node.leftChild;
+	}
+}
+
+void LavaBvh::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const
+{
+	objects.clear();
+	if (objectBounds.empty())
+		return;
+
+	const LavaBvhNode* nodes = current->nodes.data();
+	const uint32_t* primitives = current->primitives.data();
+	float radiusSquared = radius * radius;
+
+	auto overlaps = [&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 closest = glm::clamp(center, boundsMin, boundsMax);
+		glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) <= radiusSquared;
+	};
+
+	uint32_t stack[LAVA_BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const LavaBvhNode& node = nodes[stack[--stackSize]];
+		if (!overlaps(node.boundsMin, node.boundsMax))
+			continue;
+
+		if (node.leftChild == 0) {
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				uint32_t object = primitives[node.firstPrimitive + i];
+				if (overlaps(objectBounds[object].min, objectBounds[object].max))
+					objects.push_back(object);
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.leftChild + 1;
+		stack[stackSize++] = node.leftChild;
+	}
+}
+
+float LavaBvh::ComputeSahCost() const
+{
+	if (objectBounds.empty())
+		return 0.f;
+
+	const LavaBvhNode* nodes = current->nodes.data();
+	float rootArea = SurfaceArea(NodeBounds(nodes[0]));
+	if (rootArea <= 0.f)
+		return 0.f;
+
+	float cost = 0.f;
+	for (uint32_t i = 0; i < current->nodeCount; i++) {
+		float area = SurfaceArea(NodeBounds(nodes[i])) / rootArea;
+		cost += nodes[i].leftChild == 0 ? area * nodes[i].primitiveCount : area * bvhTraversalCost;
+	}
+	return cost;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaCulling.h"
+#include "LavaJobs.h"
+
+#include <memory>
+#include <vector>
+
+//Traversal stack entries, a tree of depth d needs at most d + 1. Builds switch to median splits well before this.
+const uint32_t LAVA_BVH_STACK_SIZE = 128;
+
+struct LavaAabb {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+//Internal nodes have both children next to each other at leftChild, leaves have leftChild 0.
+//Every node covers a contiguous run of the primitive index list, so a fully visible subtree is emitted without visiting it.
+struct LavaBvhNode {
+	glm::vec3 boundsMin;
+	uint32_t leftChild;
+	glm::vec3 boundsMax;
+	uint32_t parent;
+	uint32_t firstPrimitive;
+	uint32_t primitiveCount;
+	uint32_t padding[2];
+};
+
+struct LavaBvhHit {
+	uint32_t object;
+	float distance;
+};
+
+//BVH over object bounds. Built with binned SAH, subtrees and large binning passes go to the job system.
+//Moving objects refit just the path to the root, and once the tree has degraded enough a rebuild runs
+//in the background and gets swapped in by a later Refit().
+class LavaBvh {
+public:
+	LavaBvh() = default;
+	~LavaBvh();
+
+	LavaBvh(const LavaBvh&) = delete;
+	LavaBvh& operator=(const LavaBvh&) = delete;
+
+	void Build(const LavaAabb* bounds, uint32_t objectCount, LavaJobSystem* jobSystem);
+
+	void UpdateObject(uint32_t object, const LavaAabb& bounds);
+	void Refit();
+	void RefitAll(); //Every node bottom up, cheaper than the incremental path when most objects moved
+
+	void CullFrustum(const LavaFrustum& frustum, std::vector<uint32_t>& visibleObjects) const;
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, LavaBvhHit& hit) const; //Closest object bounds hit
+	void QueryBox(const LavaAabb& box, std::vector<uint32_t>& objects) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const;
+
+	float ComputeSahCost() const;
+	uint32_t GetNodeCount() const { return current->nodeCount; }
+	uint32_t GetDepth() const { return current->depth; } //Deepest leaf, the root is depth 0
+	uint32_t GetObjectCount() const { return uint32_t(objectBounds.size()); }
+	bool IsRebuilding() const { return rebuilding; }
+
+	//Rebuild once this fraction of the objects moved since the last build, or the root grew this much in area.
+	float rebuildMovedFraction = 0.25f;
+	float rebuildAreaGrowth = 1.5f;
+
+private:
+	struct Tree {
+		std::vector<LavaBvhNode> nodes;
+		std::vector<uint32_t> primitives;
+		std::vector<uint32_t> primitiveLeaves; //Object -> leaf holding it
+		uint32_t nodeCount = 0;
+		uint32_t depth = 0;
+		float rootArea = 0.f;
+	};
+
+	struct BuildContext;
+
+	static void BuildTree(Tree& tree, const LavaAabb* bounds, uint32_t objectCount, LavaJobSystem* jobSystem);
+	static void BuildNode(BuildContext& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+
+	void RefitPath(uint32_t leaf);
+	void StartRebuild();
+	void FinishRebuild();
+
+private:
+	std::unique_ptr<Tree> current = std::unique_ptr<Tree>(new Tree());
+	std::vector<LavaAabb> objectBounds;
+	std::vector<uint32_t> pendingRefits;
+	uint32_t movedSinceBuild = 0;
+	LavaJobSystem* jobSystem = nullptr;
+
+	//Background rebuild state, the worker builds from a snapshot of the bounds.
+	std::unique_ptr<Tree> rebuildTree;
+	std::vector<LavaAabb> rebuildBounds;
+	std::vector<uint32_t> movedDuringRebuild;
+	LavaJobCounter rebuildCounter;
+	bool rebuilding = false;
+};
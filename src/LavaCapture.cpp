@@ -0,0 +1,395 @@
+#include "LavaCapture.h"
+
+#include <chrono>
+#include <string.h>
+
+static double CaptureNowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LavaCaptureWriter::~LavaCaptureWriter()
+{
+	Close();
+}
+
+bool LavaCaptureWriter::Open(const char* path, const LavaCaptureFileHeader& header)
+{
+	Close();
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	LavaCaptureFileHeader fileHeader = header;
+	fileHeader.magic = LAVA_CAPTURE_MAGIC;
+	fileHeader.version = LAVA_CAPTURE_VERSION;
+	fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+
+	frameCount = 0;
+	captureBeginMs = CaptureNowMs();
+	bufferIds.clear();
+	bufferCount = 0;
+	pipelineIds.clear();
+	hasPreviousStream = false;
+	hasPreviousDrawList = false;
+	return true;
+}
+
+void LavaCaptureWriter::Close()
+{
+	if (!file)
+		return;
+
+	Flush();
+	fclose(file);
+	file = nullptr;
+}
+
+void LavaCaptureWriter::BeginRecord(LavaCaptureRecordType type)
+{
+	recordBegin = data.size();
+	LavaCaptureRecordHeader header = { uint32_t(type), 0 };
+	Write(&header, sizeof(header));
+}
+
+void LavaCaptureWriter::EndRecord()
+{
+	size_t size = data.size() - recordBegin - sizeof(LavaCaptureRecordHeader);
+	assert(size <= UINT32_MAX);
+	uint32_t recordSize = uint32_t(size);
+	memcpy(&data[recordBegin + offsetof(LavaCaptureRecordHeader, size)], &recordSize, sizeof(recordSize));
+}
+
+void LavaCaptureWriter::Write(const void* bytes, size_t size)
+{
+	const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+	data.insert(data.end(), begin, begin + size);
+}
+
+void LavaCaptureWriter::Flush()
+{
+	if (!data.empty())
+		fwrite(data.data(), 1, data.size(), file);
+	data.clear();
+}
+
+uint32_t LavaCaptureWriter::GetId(const std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle) const
+{
+	auto it = ids.find(handle);
+	return it != ids.end() ? it->second : LAVA_CAPTURE_INVALID_ID;
+}
+
+uint32_t LavaCaptureWriter::AddBuffer(VkBuffer buffer, uint64_t size, VkBufferUsageFlags usage, const char* name, uint32_t flags)
+{
+	if (!file)
+		return LAVA_CAPTURE_INVALID_ID;
+
+	LavaCaptureBuffer desc = { bufferCount++, uint32_t(usage), size, flags, 0 };
+	bufferIds[uint64_t(buffer)] = desc.id;
+	BeginRecord(LAVA_CAPTURE_BUFFER);
+	Write(&desc, sizeof(desc));
+	Write(name, strlen(name));
+	EndRecord();
+	return desc.id;
+}
+
+void LavaCaptureWriter::AliasBuffer(VkBuffer alias, VkBuffer buffer)
+{
+	if (!file)
+		return;
+
+	uint32_t id = GetId(bufferIds, uint64_t(buffer));
+	assert(id != LAVA_CAPTURE_INVALID_ID && "Alias of a buffer the capture doesn't know");
+	bufferIds[uint64_t(alias)] = id;
+}
+
+uint32_t LavaCaptureWriter::AddPipeline(VkPipeline pipeline, uint32_t pass, const char* name)
+{
+	if (!file)
+		return LAVA_CAPTURE_INVALID_ID;
+
+	LavaCapturePipeline desc = { uint32_t(pipelineIds.size()), pass };
+	pipelineIds[uint64_t(pipeline)] = desc.id;
+	BeginRecord(LAVA_CAPTURE_PIPELINE);
+	Write(&desc, sizeof(desc));
+	Write(name, strlen(name));
+	EndRecord();
+	return desc.id;
+}
+
+void LavaCaptureWriter::Upload(VkBuffer buffer, uint64_t offset, const void* bytes, uint64_t size)
+{
+	if (!file)
+		return;
+
+	uint32_t id = GetId(bufferIds, uint64_t(buffer));
+	assert(id != LAVA_CAPTURE_INVALID_ID && "Upload to a buffer the capture doesn't know");
+	uint32_t padding = 0;
+	BeginRecord(LAVA_CAPTURE_UPLOAD);
+	Write(&id, sizeof(id));
+	Write(&padding, sizeof(padding));
+	Write(&offset, sizeof(offset));
+	Write(bytes, size_t(size));
+	EndRecord();
+
+	//Setup uploads can be large, don't hold them until the first frame.
+	if (!inFrame)
+		Flush();
+}
+
+void LavaCaptureWriter::BeginFrame(uint64_t frameIndex, const glm::mat4& viewProjection)
+{
+	if (!file)
+		return;
+
+	Flush();
+	LavaCaptureFrame frame = {};
+	frame.frameIndex = frameIndex;
+	frame.timeMs = CaptureNowMs() - captureBeginMs;
+	frame.viewProjection = viewProjection;
+	BeginRecord(LAVA_CAPTURE_FRAME_BEGIN);
+	frameBegin = data.size();
+	Write(&frame, sizeof(frame));
+	EndRecord();
+	inFrame = true;
+}
+
+void LavaCaptureWriter::Transform(LavaNodeHandle node, const LavaAffineTransform& transform)
+{
+	if (file)
+		transforms.push_back(std::make_pair(node, transform));
+}
+
+void LavaCaptureWriter::InstanceStream(const uint32_t* nodes, uint32_t count)
+{
+	if (!file)
+		return;
+
+	if (hasPreviousStream && previousStream.size() == count && memcmp(previousStream.data(), nodes, count * sizeof(uint32_t)) == 0) {
+		BeginRecord(LAVA_CAPTURE_INSTANCE_STREAM_REPEAT);
+		EndRecord();
+		return;
+	}
+
+	previousStream.assign(nodes, nodes + count);
+	hasPreviousStream = true;
+	BeginRecord(LAVA_CAPTURE_INSTANCE_STREAM);
+	Write(&count, sizeof(count));
+	Write(nodes, count * sizeof(uint32_t));
+	EndRecord();
+}
+
+void LavaCaptureWriter::DrawList(const LavaDrawList& drawList)
+{
+	if (!file)
+		return;
+
+	uint32_t count = drawList.GetPacketCount();
+	packets.resize(count);
+	bool repeat = hasPreviousDrawList && previousKeys.size() == count;
+	for (uint32_t i = 0; i < count; i++) {
+		const LavaDrawPacket& packet = drawList.GetSortedPacket(i);
+		LavaCapturePacket& capturePacket = packets[i];
+		capturePacket.pipeline = GetId(pipelineIds, uint64_t(packet.pipeline));
+		capturePacket.vertexBuffers[0] = GetId(bufferIds, uint64_t(packet.vertexBuffers[0]));
+		capturePacket.vertexBuffers[1] = GetId(bufferIds, uint64_t(packet.vertexBuffers[1]));
+		capturePacket.indexBuffer = GetId(bufferIds, uint64_t(packet.indexBuffer));
+		capturePacket.indexCount = packet.indexCount;
+		capturePacket.instanceCount = packet.instanceCount;
+		capturePacket.firstIndex = packet.firstIndex;
+		capturePacket.vertexOffset = packet.vertexOffset;
+		capturePacket.firstInstance = packet.firstInstance;
+		repeat = repeat && previousKeys[i] == drawList.GetSortedKey(i) && memcmp(&previousPackets[i], &capturePacket, sizeof(LavaCapturePacket)) == 0;
+	}
+
+	if (repeat) {
+		BeginRecord(LAVA_CAPTURE_DRAW_LIST_REPEAT);
+		EndRecord();
+		return;
+	}
+
+	previousKeys.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		previousKeys[i] = drawList.GetSortedKey(i);
+	}
+	previousPackets.swap(packets);
+	hasPreviousDrawList = true;
+
+	BeginRecord(LAVA_CAPTURE_DRAW_LIST);
+	Write(&count, sizeof(count));
+	Write(previousKeys.data(), count * sizeof(uint64_t));
+	Write(previousPackets.data(), count * sizeof(LavaCapturePacket));
+	EndRecord();
+}
+
+void LavaCaptureWriter::EndFrame(double cpuFrameMs)
+{
+	if (!file)
+		return;
+
+	if (!transforms.empty()) {
+		uint32_t count = uint32_t(transforms.size());
+		BeginRecord(LAVA_CAPTURE_TRANSFORMS);
+		Write(&count, sizeof(count));
+		Write(transforms.data(), count * sizeof(transforms[0]));
+		EndRecord();
+		transforms.clear();
+	}
+
+	memcpy(&data[frameBegin + offsetof(LavaCaptureFrame, cpuFrameMs)], &cpuFrameMs, sizeof(double));
+	BeginRecord(LAVA_CAPTURE_FRAME_END);
+	EndRecord();
+	Flush();
+	frameCount++;
+	inFrame = false;
+}
+
+//Bounds checked cursor over one record payload.
+struct CaptureCursor {
+	const uint8_t* data;
+	size_t size;
+	size_t offset;
+
+	bool Read(void* destination, size_t bytes)
+	{
+		if (size - offset < bytes)
+			return false;
+		memcpy(destination, data + offset, bytes);
+		offset += bytes;
+		return true;
+	}
+
+	template<typename T>
+	bool ReadArray(std::vector<T>& values, uint32_t count)
+	{
+		if ((size - offset) / sizeof(T) < count)
+			return false;
+		values.resize(count);
+		return Read(values.data(), count * sizeof(T));
+	}
+};
+
+bool LavaCaptureReader::Load(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	std::vector<uint8_t> bytes;
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (fileSize > 0) {
+		bytes.resize(size_t(fileSize));
+		bytes.resize(fread(bytes.data(), 1, bytes.size(), file));
+	}
+	fclose(file);
+
+	if (bytes.size() < sizeof(LavaCaptureFileHeader))
+		return false;
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (header.magic != LAVA_CAPTURE_MAGIC || header.version != LAVA_CAPTURE_VERSION)
+		return false;
+	//Every instance is uploaded in the capture, so the instance data can't be larger than the file.
+	if (header.instanceCount && (header.instanceStride < sizeof(LavaAffineTransform)
+		|| uint64_t(header.instanceCount) * header.instanceStride > bytes.size()))
+		return false;
+
+	buffers.clear();
+	pipelines.clear();
+	uploads.clear();
+	frames.clear();
+	instanceStreams.clear();
+	drawLists.clear();
+
+	//A capture cut short by a crash still replays up to the last complete frame.
+	LavaCaptureFrameData* frame = nullptr;
+	size_t offset = sizeof(LavaCaptureFileHeader);
+	while (bytes.size() - offset >= sizeof(LavaCaptureRecordHeader)) {
+		LavaCaptureRecordHeader record;
+		memcpy(&record, bytes.data() + offset, sizeof(record));
+		offset += sizeof(record);
+		if (bytes.size() - offset < record.size)
+			break;
+		CaptureCursor cursor = { bytes.data() + offset, record.size, 0 };
+		offset += record.size;
+
+		bool valid = true;
+		uint32_t count = 0;
+		switch (record.type) {
+		case LAVA_CAPTURE_BUFFER: {
+			LavaCaptureResourceBuffer buffer;
+			valid = cursor.Read(&buffer.desc, sizeof(buffer.desc)) && buffer.desc.id == buffers.size();
+			buffer.name.assign(reinterpret_cast<const char*>(cursor.data + cursor.offset), cursor.size - cursor.offset);
+			buffers.push_back(buffer);
+			break;
+		}
+		case LAVA_CAPTURE_PIPELINE: {
+			LavaCaptureResourcePipeline pipeline;
+			valid = cursor.Read(&pipeline.desc, sizeof(pipeline.desc)) && pipeline.desc.id == pipelines.size();
+			pipeline.name.assign(reinterpret_cast<const char*>(cursor.data + cursor.offset), cursor.size - cursor.offset);
+			pipelines.push_back(pipeline);
+			break;
+		}
+		case LAVA_CAPTURE_UPLOAD: {
+			LavaCaptureUpload upload;
+			uint32_t padding;
+			valid = cursor.Read(&upload.buffer, sizeof(upload.buffer)) && cursor.Read(&padding, sizeof(padding)) && cursor.Read(&upload.offset, sizeof(upload.offset))
+				&& upload.buffer < buffers.size() && upload.offset <= buffers[upload.buffer].desc.size
+				&& cursor.size - cursor.offset <= buffers[upload.buffer].desc.size - upload.offset;
+			upload.data.assign(cursor.data + cursor.offset, cursor.data + cursor.size);
+			(frame ? frame->uploads : uploads).push_back(std::move(upload));
+			break;
+		}
+		case LAVA_CAPTURE_FRAME_BEGIN:
+			frames.emplace_back();
+			frame = &frames.back();
+			frame->instanceStream = LAVA_CAPTURE_INVALID_ID;
+			frame->drawList = LAVA_CAPTURE_INVALID_ID;
+			valid = cursor.Read(&frame->frame, sizeof(LavaCaptureFrame));
+			break;
+		case LAVA_CAPTURE_TRANSFORMS:
+			valid = frame && cursor.Read(&count, sizeof(count)) && cursor.ReadArray(frame->transforms, count);
+			break;
+		case LAVA_CAPTURE_INSTANCE_STREAM:
+			instanceStreams.emplace_back();
+			valid = frame && cursor.Read(&count, sizeof(count)) && cursor.ReadArray(instanceStreams.back(), count)
+				&& count <= header.instanceCount;
+			for (uint32_t i = 0; valid && i < count; i++) {
+				valid = instanceStreams.back()[i] < header.instanceCount;
+			}
+			if (valid)
+				frame->instanceStream = uint32_t(instanceStreams.size() - 1);
+			break;
+		case LAVA_CAPTURE_INSTANCE_STREAM_REPEAT:
+			valid = frame && !instanceStreams.empty();
+			if (valid)
+				frame->instanceStream = uint32_t(instanceStreams.size() - 1);
+			break;
+		case LAVA_CAPTURE_DRAW_LIST:
+			drawLists.emplace_back();
+			valid = frame && cursor.Read(&count, sizeof(count)) && cursor.ReadArray(drawLists.back().keys, count)
+				&& cursor.ReadArray(drawLists.back().packets, count);
+			if (valid)
+				frame->drawList = uint32_t(drawLists.size() - 1);
+			break;
+		case LAVA_CAPTURE_DRAW_LIST_REPEAT:
+			valid = frame && !drawLists.empty();
+			if (valid)
+				frame->drawList = uint32_t(drawLists.size() - 1);
+			break;
+		case LAVA_CAPTURE_FRAME_END:
+			valid = frame != nullptr;
+			frame = nullptr;
+			break;
+		default:
+			break; //Newer record types are skipped
+		}
+		if (!valid)
+			return false;
+	}
+
+	if (frame)
+		frames.pop_back();
+	return true;
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaDrawList.h"
+#include "LavaScene.h"
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Binary capture of the renderer's frame work above the command buffer: buffers and pipelines by description,
+//uploads, and per frame the camera, the transforms that changed, the instance stream and the sorted draw
+//packets. Handles are replaced by capture ids, so a replay can map them onto whatever device it runs on.
+//The file is a header followed by records, each one a LavaCaptureRecordHeader and its payload.
+const uint32_t LAVA_CAPTURE_MAGIC = 0x5041434c; //"LCAP"
+const uint32_t LAVA_CAPTURE_VERSION = 1;
+const uint32_t LAVA_CAPTURE_INVALID_ID = ~0u;
+
+enum LavaCaptureRecordType : uint32_t {
+	LAVA_CAPTURE_BUFFER, //LavaCaptureBuffer, then the name
+	LAVA_CAPTURE_PIPELINE, //LavaCapturePipeline, then the name
+	LAVA_CAPTURE_UPLOAD, //Buffer id, offset, then the bytes
+	LAVA_CAPTURE_FRAME_BEGIN, //LavaCaptureFrame
+	LAVA_CAPTURE_TRANSFORMS, //Count, then std::pair<LavaNodeHandle, LavaAffineTransform> array
+	LAVA_CAPTURE_INSTANCE_STREAM, //Count, then the node of every instance stream slot
+	LAVA_CAPTURE_INSTANCE_STREAM_REPEAT, //Same stream as the previous frame
+	LAVA_CAPTURE_DRAW_LIST, //Count, then sorted keys and LavaCapturePacket pairs
+	LAVA_CAPTURE_DRAW_LIST_REPEAT, //Same packets as the previous frame
+	LAVA_CAPTURE_FRAME_END,
+};
+
+struct LavaCaptureFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t passCount; //Draw list passes, Submit() runs once per pass
+	uint32_t instanceCount;
+	uint32_t instanceStride;
+	uint32_t flags; //LAVA_CAPTURE_FLAG_*
+};
+
+const uint32_t LAVA_CAPTURE_FLAG_CACHED_COMMAND_BUFFERS = 1 << 0; //Draw lists were hashed every frame
+const uint32_t LAVA_CAPTURE_FLAG_GPU_DRIVEN = 1 << 1; //No draw lists, the GPU culls and draws
+
+struct LavaCaptureRecordHeader {
+	uint32_t type;
+	uint32_t size; //Payload bytes
+};
+
+struct LavaCaptureBuffer {
+	uint32_t id;
+	uint32_t usage; //VkBufferUsageFlags
+	uint64_t size;
+	uint32_t flags; //LAVA_CAPTURE_BUFFER_*
+	uint32_t padding;
+};
+
+//Holds the per instance data, transforms land in it and the instance stream is gathered into it.
+const uint32_t LAVA_CAPTURE_BUFFER_INSTANCES = 1 << 0;
+
+struct LavaCapturePipeline {
+	uint32_t id;
+	uint32_t pass;
+};
+
+struct LavaCaptureFrame {
+	uint64_t frameIndex;
+	double timeMs; //Since the capture started, replays at recorded pacing wait for it
+	double cpuFrameMs; //Measured while capturing
+	glm::mat4 viewProjection;
+};
+
+//LavaDrawPacket with capture ids instead of handles.
+struct LavaCapturePacket {
+	uint32_t pipeline;
+	uint32_t vertexBuffers[2];
+	uint32_t indexBuffer;
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+//Frame records go to a memory buffer and reach the file in one write at EndFrame, the render thread
+//never waits on a partial write.
+class LavaCaptureWriter {
+public:
+	~LavaCaptureWriter();
+
+	bool Open(const char* path, const LavaCaptureFileHeader& header);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+	uint32_t GetFrameCount() const { return frameCount; }
+
+	uint32_t AddBuffer(VkBuffer buffer, uint64_t size, VkBufferUsageFlags usage, const char* name, uint32_t flags = 0);
+	//Another handle of an added buffer, e.g. a per frame copy. Draws through it are captured as draws through the buffer.
+	void AliasBuffer(VkBuffer alias, VkBuffer buffer);
+	uint32_t AddPipeline(VkPipeline pipeline, uint32_t pass, const char* name);
+	void Upload(VkBuffer buffer, uint64_t offset, const void* data, uint64_t size);
+
+	void BeginFrame(uint64_t frameIndex, const glm::mat4& viewProjection);
+	void Transform(LavaNodeHandle node, const LavaAffineTransform& transform);
+	void InstanceStream(const uint32_t* nodes, uint32_t count);
+	void DrawList(const LavaDrawList& drawList);
+	void EndFrame(double cpuFrameMs);
+
+private:
+	void BeginRecord(LavaCaptureRecordType type);
+	void EndRecord();
+	void Write(const void* data, size_t size);
+	void Flush();
+	uint32_t GetId(const std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle) const;
+
+private:
+	FILE* file = nullptr;
+	std::vector<uint8_t> data;
+	size_t recordBegin = 0;
+	uint32_t frameCount = 0;
+	size_t frameBegin = 0; //Of the frame record, cpuFrameMs is patched in at EndFrame
+	bool inFrame = false;
+	double captureBeginMs = 0.0;
+
+	std::unordered_map<uint64_t, uint32_t> bufferIds;
+	uint32_t bufferCount = 0; //Aliases share an id, bufferIds can hold more handles than that
+	std::unordered_map<uint64_t, uint32_t> pipelineIds;
+
+	//Changed transforms are batched into one record per frame, they may arrive before BeginFrame.
+	std::vector<std::pair<LavaNodeHandle, LavaAffineTransform>> transforms;
+	std::vector<uint32_t> previousStream;
+	bool hasPreviousStream = false;
+	std::vector<uint64_t> previousKeys;
+	std::vector<LavaCapturePacket> previousPackets;
+	std::vector<LavaCapturePacket> packets;
+	bool hasPreviousDrawList = false;
+};
+
+struct LavaCaptureResourceBuffer {
+	LavaCaptureBuffer desc;
+	std::string name;
+};
+
+struct LavaCaptureResourcePipeline {
+	LavaCapturePipeline desc;
+	std::string name;
+};
+
+struct LavaCaptureUpload {
+	uint32_t buffer;
+	uint64_t offset;
+	std::vector<uint8_t> data;
+};
+
+struct LavaCaptureDrawList {
+	std::vector<uint64_t> keys; //Sorted
+	std::vector<LavaCapturePacket> packets;
+};
+
+//One frame of work. Repeat records resolve to the index of the previous stream or draw list, so a long
+//static capture stays small in memory too.
+struct LavaCaptureFrameData {
+	LavaCaptureFrame frame;
+	std::vector<std::pair<LavaNodeHandle, LavaAffineTransform>> transforms;
+	std::vector<LavaCaptureUpload> uploads;
+	uint32_t instanceStream; //LAVA_CAPTURE_INVALID_ID when the stream is every instance in order
+	uint32_t drawList; //LAVA_CAPTURE_INVALID_ID without CPU draws
+};
+
+//Reads the whole capture up front, replays shouldn't measure file IO.
+class LavaCaptureReader {
+public:
+	bool Load(const char* path);
+
+	const LavaCaptureFileHeader& GetHeader() const { return header; }
+	const std::vector<LavaCaptureResourceBuffer>& GetBuffers() const { return buffers; }
+	const std::vector<LavaCaptureResourcePipeline>& GetPipelines() const { return pipelines; }
+	const std::vector<LavaCaptureUpload>& GetUploads() const { return uploads; } //Made before the first frame
+	const std::vector<LavaCaptureFrameData>& GetFrames() const { return frames; }
+	const std::vector<uint32_t>& GetInstanceStream(uint32_t stream) const { return instanceStreams[stream]; }
+	const LavaCaptureDrawList& GetDrawList(uint32_t drawList) const { return drawLists[drawList]; }
+
+private:
+	LavaCaptureFileHeader header = {};
+	std::vector<LavaCaptureResourceBuffer> buffers;
+	std::vector<LavaCaptureResourcePipeline> pipelines;
+	std::vector<LavaCaptureUpload> uploads;
+	std::vector<LavaCaptureFrameData> frames;
+	std::vector<std::vector<uint32_t>> instanceStreams;
+	std::vector<LavaCaptureDrawList> drawLists;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <stdint.h>
+#include <iostream>
+
+#include <vulkan/vulkan.h>
+
+//Vulkan clip space: depth in [0,1]
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm.hpp>
+
+#define LAVA_ASSERT(call) \
+			{ \
+				VkResult result = call; \
+				assert(result == VK_SUCCESS); \
+				(void)result; \
+			}
+
+#define LAVA_PRINT(s) std::cout<<s<<std::endl
+
+//64 bit hash mixing for state hashes, not for anything persistent.
+inline uint64_t LavaHashCombine(uint64_t hash, uint64_t value)
+{
+	hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	return hash * 0xff51afd7ed558ccdull;
+}
@@ -0,0 +1,358 @@
+#include "LavaCulling.h"
+#include "LavaJobs.h"
+#include "LavaSimd.h"
+
+#include <float.h>
+#include <string.h>
+
+//Objects per job, multiple of 8 so chunks line up with the AVX2 kernel.
+static const uint32_t cullChunkSize = 16 * 1024;
+
+LavaFrustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	//Gribb-Hartmann, rows of the clip matrix. glm is column major so row i is m[*][i].
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	LavaFrustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[2]; //Depth is [0,1] in Vulkan, so near is z >= 0
+	frustum.planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++) {
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	}
+	return frustum;
+}
+
+bool IsSphereVisible(const LavaFrustum& frustum, const glm::vec4& sphere)
+{
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4& plane = frustum.planes[i];
+		if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w < -sphere.w)
+			return false;
+	}
+	return true;
+}
+
+uint32_t SelectLod(const LavaGpuMesh& mesh, const glm::vec4& sphere, const glm::vec3& cameraPosition)
+{
+	float distance = glm::max(glm::length(glm::vec3(sphere) - cameraPosition) - sphere.w, 0.f);
+	uint32_t lod = 0;
+	while (lod + 1 < mesh.lodCount && distance > mesh.lods[lod].maxDistance)
+		lod++;
+	return lod;
+}
+
+void CullObjectsReference(const LavaCullView& view, const LavaObjectData* objects, uint32_t objectCount,
+	const LavaGpuMesh* meshes, std::vector<LavaVisibleObject>& visibleObjects)
+{
+	visibleObjects.clear();
+	glm::vec3 cameraPosition = glm::vec3(view.cameraPosition);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		const LavaObjectData& object = objects[i];
+		if (!IsSphereVisible(view.frustum, object.boundingSphere))
+			continue;
+
+		LavaVisibleObject visible;
+		visible.objectIndex = i;
+		visible.lod = SelectLod(meshes[object.meshIndex], object.boundingSphere, cameraPosition);
+		visibleObjects.push_back(visible);
+	}
+}
+
+void LavaCullingBounds::Resize(uint32_t objectCount)
+{
+	count = objectCount;
+	uint32_t paddedCount = (objectCount + 7) & ~7u;
+
+	//Padding: negative infinite radius and inside out boxes fail every plane test.
+	centerX.assign(paddedCount, 0.f);
+	centerY.assign(paddedCount, 0.f);
+	centerZ.assign(paddedCount, 0.f);
+	radius.assign(paddedCount, -FLT_MAX);
+	minX.assign(paddedCount, FLT_MAX);
+	minY.assign(paddedCount, FLT_MAX);
+	minZ.assign(paddedCount, FLT_MAX);
+	maxX.assign(paddedCount, -FLT_MAX);
+	maxY.assign(paddedCount, -FLT_MAX);
+	maxZ.assign(paddedCount, -FLT_MAX);
+}
+
+void LavaCullingBounds::SetSphere(uint32_t index, const glm::vec4& sphere)
+{
+	centerX[index] = sphere.x;
+	centerY[index] = sphere.y;
+	centerZ[index] = sphere.z;
+	radius[index] = sphere.w;
+}
+
+void LavaCullingBounds::SetAabb(uint32_t index, const glm::vec3& minCorner, const glm::vec3& maxCorner)
+{
+	minX[index] = minCorner.x;
+	minY[index] = minCorner.y;
+	minZ[index] = minCorner.z;
+	maxX[index] = maxCorner.x;
+	maxY[index] = maxCorner.y;
+	maxZ[index] = maxCorner.z;
+}
+
+//Corner of the box furthest along the plane normal, per plane. If that one is behind the plane the whole box is.
+struct LavaPositiveVertexArrays {
+	const float* x[6];
+	const float* y[6];
+	const float* z[6];
+};
+
+static LavaPositiveVertexArrays SelectPositiveVertexArrays(const LavaFrustum& frustum, const LavaCullingBounds& bounds)
+{
+	LavaPositiveVertexArrays arrays;
+	for (int p = 0; p < 6; p++) {
+		arrays.x[p] = frustum.planes[p].x > 0.f ? bounds.maxX.data() : bounds.minX.data();
+		arrays.y[p] = frustum.planes[p].y > 0.f ? bounds.maxY.data() : bounds.minY.data();
+		arrays.z[p] = frustum.planes[p].z > 0.f ? bounds.maxZ.data() : bounds.minZ.data();
+	}
+	return arrays;
+}
+
+static uint32_t CullSpheresScalar(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t i = begin; i < end; i++) {
+		bool visible = true;
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+			visible = visible && distance >= -bounds.radius[i];
+		}
+		outIndices[visibleCount] = i;
+		visibleCount += visible ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+static uint32_t CullAabbsScalar(const LavaFrustum& frustum, const LavaPositiveVertexArrays& arrays, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t i = begin; i < end; i++) {
+		bool visible = true;
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = plane.x * arrays.x[p][i] + plane.y * arrays.y[p][i] + plane.z * arrays.z[p][i] + plane.w;
+			visible = visible && distance >= 0.f;
+		}
+		outIndices[visibleCount] = i;
+		visibleCount += visible ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+#if defined(LAVA_SIMD_AVX2)
+static uint32_t CullSpheresAvx2(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+
+	uint32_t visibleCount = 0;
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&bounds.centerX[i]);
+		__m256 y = _mm256_loadu_ps(&bounds.centerY[i]);
+		__m256 z = _mm256_loadu_ps(&bounds.centerZ[i]);
+		__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&bounds.radius[i]), signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			//Same evaluation order as the scalar path so both agree bit for bit.
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		unsigned int mask = unsigned(_mm256_movemask_ps(inside));
+		while (mask) {
+			outIndices[visibleCount++] = i + LavaCountTrailingZeros(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount + CullSpheresScalar(frustum, bounds, i, end, outIndices + visibleCount);
+}
+
+static uint32_t CullAabbsAvx2(const LavaFrustum& frustum, const LavaPositiveVertexArrays& arrays, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	uint32_t visibleCount = 0;
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(planeX[p], _mm256_loadu_ps(arrays.x[p] + i)),
+				_mm256_mul_ps(planeY[p], _mm256_loadu_ps(arrays.y[p] + i))),
+				_mm256_mul_ps(planeZ[p], _mm256_loadu_ps(arrays.z[p] + i))), planeW[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+		}
+
+		unsigned int mask = unsigned(_mm256_movemask_ps(inside));
+		while (mask) {
+			outIndices[visibleCount++] = i + LavaCountTrailingZeros(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount + CullAabbsScalar(frustum, arrays, i, end, outIndices + visibleCount);
+}
+#elif defined(LAVA_SIMD_SSE2)
+static uint32_t CullSpheresSse2(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 signMask = _mm_set1_ps(-0.f);
+
+	uint32_t visibleCount = 0;
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 y = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 z = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(&bounds.radius[i]), signMask);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_mul_ps(planeZ[p], z)), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		unsigned int mask = unsigned(_mm_movemask_ps(inside));
+		while (mask) {
+			outIndices[visibleCount++] = i + LavaCountTrailingZeros(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount + CullSpheresScalar(frustum, bounds, i, end, outIndices + visibleCount);
+}
+
+static uint32_t CullAabbsSse2(const LavaFrustum& frustum, const LavaPositiveVertexArrays& arrays, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t visibleCount = 0;
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(planeX[p], _mm_loadu_ps(arrays.x[p] + i)),
+				_mm_mul_ps(planeY[p], _mm_loadu_ps(arrays.y[p] + i))),
+				_mm_mul_ps(planeZ[p], _mm_loadu_ps(arrays.z[p] + i))), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+
+		unsigned int mask = unsigned(_mm_movemask_ps(inside));
+		while (mask) {
+			outIndices[visibleCount++] = i + LavaCountTrailingZeros(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount + CullAabbsScalar(frustum, arrays, i, end, outIndices + visibleCount);
+}
+#endif
+
+uint32_t CullSpheres(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+#if defined(LAVA_SIMD_AVX2)
+	return CullSpheresAvx2(frustum, bounds, begin, end, outIndices);
+#elif defined(LAVA_SIMD_SSE2)
+	return CullSpheresSse2(frustum, bounds, begin, end, outIndices);
+#else
+	return CullSpheresScalar(frustum, bounds, begin, end, outIndices);
+#endif
+}
+
+uint32_t CullAabbs(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices)
+{
+	LavaPositiveVertexArrays arrays = SelectPositiveVertexArrays(frustum, bounds);
+#if defined(LAVA_SIMD_AVX2)
+	return CullAabbsAvx2(frustum, arrays, begin, end, outIndices);
+#elif defined(LAVA_SIMD_SSE2)
+	return CullAabbsSse2(frustum, arrays, begin, end, outIndices);
+#else
+	return CullAabbsScalar(frustum, arrays, begin, end, outIndices);
+#endif
+}
+
+void CullBounds(const LavaFrustum& frustum, const LavaCullingBounds& bounds, LavaCullShape shape,
+	LavaJobSystem* jobSystem, std::vector<uint32_t>& visibleIndices)
+{
+	//Chunks write to their own region of a scratch list first, reused between calls so culling doesn't allocate.
+	static thread_local std::vector<uint32_t> scratch;
+	static thread_local std::vector<uint32_t> chunkCounts;
+	static thread_local std::vector<uint32_t> chunkOffsets;
+
+	uint32_t paddedCount = bounds.GetPaddedCount();
+	uint32_t chunkCount = (paddedCount + cullChunkSize - 1) / cullChunkSize;
+	if (scratch.size() < paddedCount)
+		scratch.resize(paddedCount);
+	chunkCounts.assign(chunkCount, 0);
+	chunkOffsets.resize(chunkCount);
+
+	//The jobs run on other threads, so they get the data pointers rather than their own thread_local lists.
+	uint32_t* scratchData = scratch.data();
+	uint32_t* chunkCountData = chunkCounts.data();
+	uint32_t* chunkOffsetData = chunkOffsets.data();
+	LavaParallelFor(jobSystem, paddedCount, cullChunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+		chunkCountData[chunk] = shape == LAVA_CULL_SPHERES ?
+			CullSpheres(frustum, bounds, begin, end, scratchData + begin) :
+			CullAabbs(frustum, bounds, begin, end, scratchData + begin);
+	});
+
+	//Prefix sum over chunk counts, then every chunk copies its visible run to the final offset.
+	uint32_t visibleCount = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+		chunkOffsetData[chunk] = visibleCount;
+		visibleCount += chunkCounts[chunk];
+	}
+
+	visibleIndices.resize(visibleCount);
+	uint32_t* visibleData = visibleIndices.data();
+	LavaParallelFor(jobSystem, chunkCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t chunk = begin; chunk < end; chunk++) {
+			memcpy(visibleData + chunkOffsetData[chunk], scratchData + chunk * cullChunkSize, chunkCountData[chunk] * sizeof(uint32_t));
+		}
+	});
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <vector>
+
+class LavaJobSystem;
+
+const uint32_t LAVA_MAX_MESH_LODS = 4;
+
+//Plane i is (normal.xyz, distance), inside when dot(normal, p) + distance >= 0.
+//Order: left, right, bottom, top, near, far.
+struct LavaFrustum {
+	glm::vec4 planes[6];
+};
+
+//GPU layouts below mirror the structs in cull.comp.glsl, std430.
+struct LavaMeshLod {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	float maxDistance; //LOD is picked while the sphere is closer than this
+};
+
+struct LavaGpuMesh {
+	LavaMeshLod lods[LAVA_MAX_MESH_LODS];
+	uint32_t lodCount;
+	uint32_t padding[3];
+};
+
+struct LavaObjectData {
+	glm::vec4 boundingSphere; //World space center xyz, radius w
+	uint32_t meshIndex;
+	uint32_t padding[3];
+};
+
+struct LavaCullView {
+	LavaFrustum frustum;
+	glm::vec4 cameraPosition;
+};
+
+//Bindless indices and counts for the cull dispatch.
+struct LavaCullConstants {
+	uint32_t viewBuffer;
+	uint32_t objectBuffer;
+	uint32_t meshBuffer;
+	uint32_t commandBuffer;
+	uint32_t countBuffer;
+	uint32_t objectCount;
+	uint32_t compact; //0: one command slot per object, culled ones get instanceCount 0
+};
+
+struct LavaVisibleObject {
+	uint32_t objectIndex;
+	uint32_t lod;
+};
+
+LavaFrustum ExtractFrustum(const glm::mat4& viewProjection);
+bool IsSphereVisible(const LavaFrustum& frustum, const glm::vec4& sphere);
+uint32_t SelectLod(const LavaGpuMesh& mesh, const glm::vec4& sphere, const glm::vec3& cameraPosition);
+
+//Scalar reference of what cull.comp does, used to validate the GPU results.
+void CullObjectsReference(const LavaCullView& view, const LavaObjectData* objects, uint32_t objectCount,
+	const LavaGpuMesh* meshes, std::vector<LavaVisibleObject>& visibleObjects);
+
+enum LavaCullShape {
+	LAVA_CULL_SPHERES,
+	LAVA_CULL_AABBS
+};
+
+//Object bounds in structure of arrays form for the CPU culler. Arrays are padded to a multiple of 8
+//with entries that are never visible, so the SIMD kernels don't need a scalar tail over the whole set.
+struct LavaCullingBounds {
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	uint32_t count = 0;
+
+	void Resize(uint32_t objectCount);
+	void SetSphere(uint32_t index, const glm::vec4& sphere);
+	void SetAabb(uint32_t index, const glm::vec3& minCorner, const glm::vec3& maxCorner);
+	uint32_t GetPaddedCount() const { return uint32_t(radius.size()); }
+};
+
+//Test [begin,end) against the 6 planes and write the visible indices to outIndices, returns how many were written.
+//AVX2 or SSE2 kernels are picked at compile time, scalar otherwise.
+uint32_t CullSpheres(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices);
+uint32_t CullAabbs(const LavaFrustum& frustum, const LavaCullingBounds& bounds, uint32_t begin, uint32_t end, uint32_t* outIndices);
+
+//Runs the kernels over chunks on the worker threads, then gathers a compact visible index list in object order.
+void CullBounds(const LavaFrustum& frustum, const LavaCullingBounds& bounds, LavaCullShape shape,
+	LavaJobSystem* jobSystem, std::vector<uint32_t>& visibleIndices);
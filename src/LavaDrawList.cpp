@@ -0,0 +1,136 @@
+#include "LavaDrawList.h"
+#include "LavaJobs.h"
+
+#include <algorithm>
+
+static const uint32_t drawSortChunkSize = 16 * 1024; //Keys per histogram/scatter job
+static const uint32_t drawSortRadix = 256;
+
+uint32_t LavaDepthBucket(float normalizedDepth)
+{
+	const uint32_t maxBucket = (1u << LAVA_DRAW_KEY_DEPTH_BITS) - 1;
+	float depth = std::min(std::max(normalizedDepth, 0.f), 1.f);
+	return uint32_t(depth * float(maxBucket));
+}
+
+void LavaDrawList::Reset()
+{
+	keys.clear();
+	order.clear();
+	packets.clear();
+}
+
+void LavaDrawList::Push(uint64_t key, const LavaDrawPacket& packet)
+{
+	order.push_back(uint32_t(packets.size()));
+	keys.push_back(key);
+	packets.push_back(packet);
+}
+
+//LSD radix sort on 8 bit digits. Each digit pass counts per chunk, then every chunk scatters into its own
+//precomputed ranges, so chunks run in parallel and the sort stays stable. Digits equal in every key are skipped,
+//which with packed keys is usually most of them.
+void LavaDrawList::Sort(LavaJobSystem* jobSystem)
+{
+	uint32_t count = uint32_t(keys.size());
+	if (count < 2)
+		return;
+
+	uint64_t varyingBits = 0;
+	for (uint32_t i = 1; i < count; i++) {
+		varyingBits |= keys[i] ^ keys[0];
+	}
+
+	scratchKeys.resize(count);
+	scratchOrder.resize(count);
+	uint32_t chunkCount = (count + drawSortChunkSize - 1) / drawSortChunkSize;
+	chunkHistograms.resize(size_t(chunkCount) * drawSortRadix);
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		if (((varyingBits >> shift) & 0xff) == 0)
+			continue;
+
+		LavaParallelFor(jobSystem, count, drawSortChunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+			uint32_t* histogram = &chunkHistograms[size_t(chunk) * drawSortRadix];
+			std::fill(histogram, histogram + drawSortRadix, 0u);
+			for (uint32_t i = begin; i < end; i++) {
+				histogram[(keys[i] >> shift) & 0xff]++;
+			}
+		});
+
+		//Exclusive prefix over digit then chunk: chunk c writes digit d right after chunk c - 1 did.
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < drawSortRadix; digit++) {
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+				uint32_t& bucket = chunkHistograms[size_t(chunk) * drawSortRadix + digit];
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+		}
+
+		LavaParallelFor(jobSystem, count, drawSortChunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+			uint32_t* offsets = &chunkHistograms[size_t(chunk) * drawSortRadix];
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t target = offsets[(keys[i] >> shift) & 0xff]++;
+				scratchKeys[target] = keys[i];
+				scratchOrder[target] = order[i];
+			}
+		});
+
+		keys.swap(scratchKeys);
+		order.swap(scratchOrder);
+	}
+}
+
+void LavaDrawList::Submit(VkCommandBuffer commandBuffer, uint32_t pass, LavaDrawListStats& stats) const
+{
+	//Pass is the top field, so its packets are one contiguous run of the sorted keys.
+	const uint32_t passShift = 64 - LAVA_DRAW_KEY_PASS_BITS;
+	auto first = std::lower_bound(keys.begin(), keys.end(), uint64_t(pass) << passShift);
+	auto last = pass + 1 < (1u << LAVA_DRAW_KEY_PASS_BITS) ? std::lower_bound(first, keys.end(), uint64_t(pass + 1) << passShift) : keys.end();
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkBuffer boundVertexBuffers[2] = {};
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	for (size_t i = size_t(first - keys.begin()); i < size_t(last - keys.begin()); i++) {
+		const LavaDrawPacket& packet = packets[order[i]];
+		if (packet.pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+			boundPipeline = packet.pipeline;
+			stats.pipelineBinds++;
+		}
+		if (packet.vertexBuffers[0] != boundVertexBuffers[0] || packet.vertexBuffers[1] != boundVertexBuffers[1]) {
+			VkDeviceSize offsets[] = { 0, 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, packet.vertexBuffers, offsets);
+			boundVertexBuffers[0] = packet.vertexBuffers[0];
+			boundVertexBuffers[1] = packet.vertexBuffers[1];
+			stats.vertexBufferBinds++;
+		}
+		if (packet.indexBuffer != boundIndexBuffer) {
+			vkCmdBindIndexBuffer(commandBuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			boundIndexBuffer = packet.indexBuffer;
+			stats.indexBufferBinds++;
+		}
+
+		vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, packet.vertexOffset, packet.firstInstance);
+		stats.draws++;
+	}
+}
+
+uint64_t LavaDrawList::ComputeHash() const
+{
+	uint64_t hash = LavaHashCombine(0, keys.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		const LavaDrawPacket& packet = packets[order[i]];
+		hash = LavaHashCombine(hash, keys[i]);
+		hash = LavaHashCombine(hash, uint64_t(packet.pipeline));
+		hash = LavaHashCombine(hash, uint64_t(packet.vertexBuffers[0]));
+		hash = LavaHashCombine(hash, uint64_t(packet.vertexBuffers[1]));
+		hash = LavaHashCombine(hash, uint64_t(packet.indexBuffer));
+		hash = LavaHashCombine(hash, (uint64_t(packet.indexCount) << 32) | packet.instanceCount);
+		hash = LavaHashCombine(hash, (uint64_t(packet.firstIndex) << 32) | uint32_t(packet.vertexOffset));
+		hash = LavaHashCombine(hash, packet.firstInstance);
+	}
+	return hash;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <vector>
+
+class LavaJobSystem;
+
+//Sort key fields from most to least significant, sorting by key groups draws by pass, then state changes by cost.
+const uint32_t LAVA_DRAW_KEY_PASS_BITS = 4;
+const uint32_t LAVA_DRAW_KEY_PIPELINE_BITS = 10;
+const uint32_t LAVA_DRAW_KEY_MATERIAL_BITS = 16;
+const uint32_t LAVA_DRAW_KEY_MESH_BITS = 16;
+const uint32_t LAVA_DRAW_KEY_DEPTH_BITS = 18;
+
+inline uint64_t LavaMakeDrawKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket)
+{
+	uint64_t key = pass & ((1u << LAVA_DRAW_KEY_PASS_BITS) - 1);
+	key = (key << LAVA_DRAW_KEY_PIPELINE_BITS) | (pipeline & ((1u << LAVA_DRAW_KEY_PIPELINE_BITS) - 1));
+	key = (key << LAVA_DRAW_KEY_MATERIAL_BITS) | (material & ((1u << LAVA_DRAW_KEY_MATERIAL_BITS) - 1));
+	key = (key << LAVA_DRAW_KEY_MESH_BITS) | (mesh & ((1u << LAVA_DRAW_KEY_MESH_BITS) - 1));
+	key = (key << LAVA_DRAW_KEY_DEPTH_BITS) | (depthBucket & ((1u << LAVA_DRAW_KEY_DEPTH_BITS) - 1));
+	return key;
+}
+
+inline uint32_t LavaDrawKeyPass(uint64_t key)
+{
+	return uint32_t(key >> (64 - LAVA_DRAW_KEY_PASS_BITS));
+}
+
+//Quantizes a normalized depth (0 near, 1 far) into the key, so opaque draws go front to back.
+uint32_t LavaDepthBucket(float normalizedDepth);
+
+//Everything a draw binds, state is compared by handle when replaying.
+struct LavaDrawPacket {
+	VkPipeline pipeline;
+	VkBuffer vertexBuffers[2]; //Mesh stream, instance stream
+	VkBuffer indexBuffer;
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct LavaDrawListStats {
+	uint32_t draws;
+	uint32_t pipelineBinds;
+	uint32_t vertexBufferBinds;
+	uint32_t indexBufferBinds;
+};
+
+//Per frame draw submission: packets are pushed in any order, radix sorted by key and replayed with
+//a state cache so only binds that actually change something get recorded.
+class LavaDrawList {
+public:
+	void Reset();
+	void Push(uint64_t key, const LavaDrawPacket& packet);
+	void Sort(LavaJobSystem* jobSystem);
+
+	//Records the packets of one pass in key order. Stats are accumulated, not reset.
+	void Submit(VkCommandBuffer commandBuffer, uint32_t pass, LavaDrawListStats& stats) const;
+
+	//Hash of the sorted keys and everything the packets record, equal hashes replay to the same commands.
+	uint64_t ComputeHash() const;
+
+	uint32_t GetPacketCount() const { return uint32_t(keys.size()); }
+	uint64_t GetSortedKey(uint32_t i) const { return keys[i]; }
+	const LavaDrawPacket& GetSortedPacket(uint32_t i) const { return packets[order[i]]; }
+
+private:
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order; //Sorted position -> packet
+	std::vector<LavaDrawPacket> packets;
+
+	std::vector<uint64_t> scratchKeys;
+	std::vector<uint32_t> scratchOrder;
+	std::vector<uint32_t> chunkHistograms; //Per chunk, 256 counts of the current digit
+};
@@ -0,0 +1,165 @@
+#include "LavaGpuProfiler.h"
+#include <algorithm>
+
+#if LAVA_PROFILER
+
+static const uint32_t gpuProfilerInvalidZone = ~0u;
+
+void LavaGpuProfiler::Init(VkDevice activeDevice, VkPhysicalDevice physicalDevice, VkQueue activeQueue, uint32_t queueFamilyIndex, uint32_t framesInFlight, uint32_t maxZones)
+{
+	device = activeDevice;
+	queue = activeQueue;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, 0);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+	if (validBits == 0) {
+		LAVA_PRINT("Timestamps not supported on the graphics queue, no GPU profiler zones");
+		return;
+	}
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	queryCount = maxZones * 2;
+	frameCount = std::max(1u, framesInFlight);
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = queryCount * frameCount + 1; //Last query is the calibration timestamp
+	LAVA_ASSERT(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+	VkCommandPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+	LAVA_ASSERT(vkCreateCommandPool(device, &poolCreateInfo, nullptr, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+	LAVA_ASSERT(vkAllocateCommandBuffers(device, &allocateInfo, &calibrationCommandBuffer));
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	LAVA_ASSERT(vkCreateFence(device, &fenceCreateInfo, nullptr, &calibrationFence));
+
+	zones.resize(frameCount);
+	results.resize(queryCount);
+	Calibrate();
+}
+
+void LavaGpuProfiler::Destroy()
+{
+	if (!queryPool)
+		return;
+
+	vkDestroyFence(device, calibrationFence, 0);
+	vkDestroyCommandPool(device, commandPool, 0);
+	vkDestroyQueryPool(device, queryPool, 0);
+	queryPool = VK_NULL_HANDLE;
+}
+
+void LavaGpuProfiler::Calibrate()
+{
+	if (!queryPool)
+		return;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	LAVA_ASSERT(vkBeginCommandBuffer(calibrationCommandBuffer, &beginInfo));
+	uint32_t calibrationQuery = queryCount * frameCount;
+	vkCmdResetQueryPool(calibrationCommandBuffer, queryPool, calibrationQuery, 1);
+	vkCmdWriteTimestamp(calibrationCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, calibrationQuery);
+	LAVA_ASSERT(vkEndCommandBuffer(calibrationCommandBuffer));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &calibrationCommandBuffer;
+
+	//Queue is idle here, the timestamp lands somewhere between submit and the fence wait returning.
+	uint64_t submitTicks = LavaProfilerTicks();
+	LAVA_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, calibrationFence));
+	LAVA_ASSERT(vkWaitForFences(device, 1, &calibrationFence, VK_TRUE, UINT64_MAX));
+	uint64_t signalTicks = LavaProfilerTicks();
+	LAVA_ASSERT(vkResetFences(device, 1, &calibrationFence));
+
+	uint64_t timestamp = 0;
+	LAVA_ASSERT(vkGetQueryPoolResults(device, queryPool, calibrationQuery, 1, sizeof(uint64_t), &timestamp, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+	calibrationGpu = timestamp & timestampMask;
+	calibrationCpu = submitTicks + (signalTicks - submitTicks) / 2;
+}
+
+void LavaGpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint64_t frame)
+{
+	currentRange = uint32_t(frame % frameCount);
+	zones[currentRange].clear();
+	if (queryPool)
+		vkCmdResetQueryPool(commandBuffer, queryPool, currentRange * queryCount, queryCount);
+}
+
+uint32_t LavaGpuProfiler::BeginZone(VkCommandBuffer commandBuffer, const char* name)
+{
+	std::vector<Zone>& frameZones = zones[currentRange];
+	if (!queryPool || (frameZones.size() + 1) * 2 > queryCount)
+		return gpuProfilerInvalidZone;
+
+	Zone zone = { name, uint32_t(frameZones.size()) * 2 };
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, currentRange * queryCount + zone.beginQuery);
+	frameZones.push_back(zone);
+	return uint32_t(frameZones.size() - 1);
+}
+
+void LavaGpuProfiler::EndZone(VkCommandBuffer commandBuffer, uint32_t zone)
+{
+	if (zone == gpuProfilerInvalidZone)
+		return;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currentRange * queryCount + zones[currentRange][zone].beginQuery + 1);
+}
+
+void LavaGpuProfiler::Collect(uint64_t frame)
+{
+	uint32_t range = uint32_t(frame % frameCount);
+	if (!queryPool || zones[range].empty() || !LavaProfilerIsCapturing())
+		return;
+
+	uint32_t usedQueries = uint32_t(zones[range].size()) * 2;
+	LAVA_ASSERT(vkGetQueryPoolResults(device, queryPool, range * queryCount, usedQueries, usedQueries * sizeof(uint64_t), results.data(), sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+	for (const Zone& zone : zones[range]) {
+		LavaProfilerRecordGpu(zone.name, GpuToCpuTicks(results[zone.beginQuery]), GpuToCpuTicks(results[zone.beginQuery + 1]));
+	}
+}
+
+void LavaGpuProfiler::RecordSequence(const char* const* names, const uint64_t* timestamps, uint32_t zoneCount) const
+{
+	if (!LavaProfilerIsCapturing())
+		return;
+
+	for (uint32_t i = 0; i < zoneCount; i++) {
+		LavaProfilerRecordGpu(names[i], GpuToCpuTicks(timestamps[i]), GpuToCpuTicks(timestamps[i + 1]));
+	}
+}
+
+uint64_t LavaGpuProfiler::GpuToCpuTicks(uint64_t timestamp) const
+{
+	//Difference in the valid bits handles a wrapped counter.
+	int64_t gpuTicks = int64_t((timestamp - calibrationGpu) & timestampMask);
+	if (uint64_t(gpuTicks) > timestampMask / 2)
+		gpuTicks -= int64_t(timestampMask) + 1;
+
+	double nanoseconds = double(gpuTicks) * timestampPeriod;
+	return calibrationCpu + int64_t(nanoseconds / LavaProfilerNanosecondsPerTick());
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaProfiler.h"
+
+#include <vector>
+
+#if LAVA_PROFILER
+
+//GPU zones from timestamp queries, mapped onto the CPU profiler timeline so both show up in one trace.
+//Zones are recorded into a command buffer between BeginFrame and the end of the frame and read back by Collect
+//once that frame has finished on the GPU. Every frame in flight has its own queries, frame N uses range
+//N % framesInFlight. A replayed command buffer reports the zones it was recorded with.
+class LavaGpuProfiler {
+public:
+	void Init(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue queue, uint32_t queueFamilyIndex, uint32_t framesInFlight = 1, uint32_t maxZones = 64);
+	void Destroy();
+	bool IsSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+	//Pairs a GPU timestamp with the CPU clock: the timestamp is taken by a tiny submit and matched to the middle of
+	//the CPU time around it. The clocks drift apart, so calibrate again whenever a capture starts.
+	void Calibrate();
+
+	void BeginFrame(VkCommandBuffer commandBuffer, uint64_t frame);
+	uint32_t BeginZone(VkCommandBuffer commandBuffer, const char* name);
+	void EndZone(VkCommandBuffer commandBuffer, uint32_t zone);
+	void Collect(uint64_t frame);
+
+	//Timestamps someone else wrote, e.g. the render graph: timestamps i and i + 1 bracket zone i.
+	void RecordSequence(const char* const* names, const uint64_t* timestamps, uint32_t zoneCount) const;
+	uint64_t GpuToCpuTicks(uint64_t timestamp) const;
+
+private:
+	struct Zone {
+		const char* name;
+		uint32_t beginQuery;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer calibrationCommandBuffer = VK_NULL_HANDLE;
+	VkFence calibrationFence = VK_NULL_HANDLE;
+	uint32_t queryCount = 0; //Per frame in flight
+	uint32_t frameCount = 1;
+	uint32_t currentRange = 0; //Of the frame being recorded
+	uint64_t timestampMask = ~0ull;
+	float timestampPeriod = 1.f; //Nanoseconds per GPU tick
+
+	uint64_t calibrationGpu = 0; //Timestamp and CPU ticks taken at the same moment
+	uint64_t calibrationCpu = 0;
+
+	std::vector<std::vector<Zone>> zones; //Per frame in flight
+	std::vector<uint64_t> results;
+};
+
+//Writes the begin timestamp now and the end timestamp when the scope closes.
+struct LavaGpuProfileZone {
+	LavaGpuProfiler& profiler;
+	VkCommandBuffer commandBuffer;
+	uint32_t zone;
+
+	LavaGpuProfileZone(LavaGpuProfiler& gpuProfiler, VkCommandBuffer zoneCommandBuffer, const char* name)
+		: profiler(gpuProfiler), commandBuffer(zoneCommandBuffer), zone(gpuProfiler.BeginZone(zoneCommandBuffer, name)) {}
+	~LavaGpuProfileZone() { profiler.EndZone(commandBuffer, zone); }
+};
+
+#define LAVA_PROFILE_GPU_ZONE(profiler, commandBuffer, name) LavaGpuProfileZone LAVA_PROFILE_CONCAT(gpuProfileZone, __LINE__)(profiler, commandBuffer, name)
+
+#else
+
+#define LAVA_PROFILE_GPU_ZONE(profiler, commandBuffer, name)
+
+#endif
@@ -0,0 +1,519 @@
+#include "LavaImage.h"
+#include "LavaProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data.resize(size > 0 ? size_t(size) : 0);
+	bool ok = size > 0 && fread(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return ok;
+}
+
+static bool HasExtension(const char* path, const char* extension)
+{
+	size_t pathLength = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if (pathLength < extensionLength)
+		return false;
+	for (size_t i = 0; i < extensionLength; i++) {
+		if (tolower(path[pathLength - extensionLength + i]) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+bool LavaLoadImage(const char* path, LavaImage& image)
+{
+	std::vector<uint8_t> data;
+	if (!ReadFile(path, data)) {
+		LAVA_PRINT("Can't read image " << path);
+		return false;
+	}
+
+	bool loaded = false;
+	if (HasExtension(path, ".tga"))
+		loaded = LavaLoadTga(data.data(), data.size(), image);
+	else if (HasExtension(path, ".png"))
+		loaded = LavaLoadPng(data.data(), data.size(), image);
+
+	if (!loaded)
+		LAVA_PRINT("Unsupported image " << path << ", expected an 8 bit .tga or .png");
+	return loaded;
+}
+
+bool LavaLoadTga(const uint8_t* data, size_t size, LavaImage& image)
+{
+	const size_t headerSize = 18;
+	if (size < headerSize)
+		return false;
+
+	uint32_t idLength = data[0];
+	uint32_t colorMapType = data[1];
+	uint32_t imageType = data[2];
+	uint32_t width = data[12] | (data[13] << 8);
+	uint32_t height = data[14] | (data[15] << 8);
+	uint32_t bitsPerPixel = data[16];
+	bool topDown = (data[17] & 0x20) != 0;
+
+	//2/10 truecolor, 3/11 grayscale, +8 is RLE. Color mapped images aren't supported.
+	bool rle = imageType == 10 || imageType == 11;
+	bool gray = imageType == 3 || imageType == 11;
+	if (colorMapType != 0 || (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11))
+		return false;
+	if (gray ? bitsPerPixel != 8 : bitsPerPixel != 24 && bitsPerPixel != 32)
+		return false;
+	if (width == 0 || height == 0)
+		return false;
+
+	uint32_t bytesPerPixel = bitsPerPixel / 8;
+	size_t offset = headerSize + idLength;
+	uint32_t pixelCount = width * height;
+	std::vector<uint8_t> pixels(size_t(pixelCount) * bytesPerPixel);
+
+	if (rle) {
+		//Packets: header bit 7 set repeats one pixel, clear copies the following pixels. Count is low 7 bits + 1.
+		uint32_t written = 0;
+		while (written < pixelCount) {
+			if (offset >= size)
+				return false;
+			uint8_t packet = data[offset++];
+			uint32_t count = std::min((packet & 0x7fu) + 1, pixelCount - written);
+			size_t packetBytes = (packet & 0x80) ? bytesPerPixel : size_t(count) * bytesPerPixel;
+			if (offset + packetBytes > size)
+				return false;
+			for (uint32_t i = 0; i < count; i++) {
+				const uint8_t* source = data + offset + ((packet & 0x80) ? 0 : i * bytesPerPixel);
+				memcpy(&pixels[size_t(written + i) * bytesPerPixel], source, bytesPerPixel);
+			}
+			offset += packetBytes;
+			written += count;
+		}
+	}
+	else {
+		if (offset + pixels.size() > size)
+			return false;
+		memcpy(pixels.data(), data + offset, pixels.size());
+	}
+
+	image.width = width;
+	image.height = height;
+	image.rgba.resize(size_t(pixelCount) * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t sourceRow = topDown ? y : height - 1 - y;
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t* source = &pixels[(size_t(sourceRow) * width + x) * bytesPerPixel];
+			uint8_t* target = &image.rgba[(size_t(y) * width + x) * 4];
+			if (gray) {
+				target[0] = target[1] = target[2] = source[0];
+				target[3] = 255;
+			}
+			else {
+				//Stored BGR(A)
+				target[0] = source[2];
+				target[1] = source[1];
+				target[2] = source[0];
+				target[3] = bytesPerPixel == 4 ? source[3] : 255;
+			}
+		}
+	}
+	return true;
+}
+
+//Minimal inflate (RFC 1951) for PNG image data. Decodes Huffman codes a bit at a time, which is plenty for an offline tool.
+struct LavaInflateState {
+	const uint8_t* data;
+	size_t size;
+	size_t offset;
+	uint32_t bitBuffer;
+	uint32_t bitCount;
+	bool overrun;
+
+	uint32_t Bits(uint32_t count)
+	{
+		while (bitCount < count) {
+			if (offset >= size) {
+				overrun = true;
+				return 0;
+			}
+			bitBuffer |= uint32_t(data[offset++]) << bitCount;
+			bitCount += 8;
+		}
+		uint32_t value = bitBuffer & ((1u << count) - 1);
+		bitBuffer >>= count;
+		bitCount -= count;
+		return value;
+	}
+};
+
+struct LavaHuffman {
+	uint16_t counts[16]; //Codes per length
+	uint16_t symbols[288]; //Ordered by code
+};
+
+static void BuildHuffman(LavaHuffman& huffman, const uint8_t* lengths, uint32_t symbolCount)
+{
+	memset(huffman.counts, 0, sizeof(huffman.counts));
+	for (uint32_t symbol = 0; symbol < symbolCount; symbol++) {
+		huffman.counts[lengths[symbol]]++;
+	}
+	huffman.counts[0] = 0;
+
+	uint16_t offsets[16];
+	offsets[1] = 0;
+	for (uint32_t length = 1; length < 15; length++) {
+		offsets[length + 1] = offsets[length] + huffman.counts[length];
+	}
+	for (uint32_t symbol = 0; symbol < symbolCount; symbol++) {
+		if (lengths[symbol] != 0)
+			huffman.symbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+	}
+}
+
+//Canonical codes: walk lengths from short to long until the code falls in the range of the current length.
+static int DecodeSymbol(LavaInflateState& state, const LavaHuffman& huffman)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for (uint32_t length = 1; length < 16; length++) {
+		code |= int(state.Bits(1));
+		int count = huffman.counts[length];
+		if (code - count < first)
+			return huffman.symbols[index + (code - first)];
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static bool InflateBlock(LavaInflateState& state, const LavaHuffman& lengthCodes, const LavaHuffman& distanceCodes, std::vector<uint8_t>& output)
+{
+	static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	for (;;) {
+		int symbol = DecodeSymbol(state, lengthCodes);
+		if (symbol < 0 || state.overrun)
+			return false;
+		if (symbol < 256) {
+			output.push_back(uint8_t(symbol));
+			continue;
+		}
+		if (symbol == 256)
+			return true;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		uint32_t length = lengthBase[symbol] + state.Bits(lengthExtra[symbol]);
+
+		int distanceSymbol = DecodeSymbol(state, distanceCodes);
+		if (distanceSymbol < 0 || distanceSymbol >= 30)
+			return false;
+		size_t distance = distanceBase[distanceSymbol] + state.Bits(distanceExtra[distanceSymbol]);
+		if (distance > output.size())
+			return false;
+
+		//Byte by byte, the copy may overlap what it writes.
+		size_t source = output.size() - distance;
+		for (uint32_t i = 0; i < length; i++) {
+			output.push_back(output[source + i]);
+		}
+	}
+}
+
+static bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+	LavaInflateState state = { data, size, 0, 0, 0, false };
+	LavaHuffman lengthCodes;
+	LavaHuffman distanceCodes;
+
+	bool last = false;
+	while (!last) {
+		last = state.Bits(1) != 0;
+		uint32_t type = state.Bits(2);
+		if (state.overrun)
+			return false;
+
+		if (type == 0) {
+			//Stored: byte aligned LEN, NLEN, then raw bytes.
+			state.bitBuffer = 0;
+			state.bitCount = 0;
+			if (state.offset + 4 > size)
+				return false;
+			uint32_t length = data[state.offset] | (data[state.offset + 1] << 8);
+			uint32_t inverted = data[state.offset + 2] | (data[state.offset + 3] << 8);
+			state.offset += 4;
+			if ((length ^ 0xffff) != inverted || state.offset + length > size)
+				return false;
+			output.insert(output.end(), data + state.offset, data + state.offset + length);
+			state.offset += length;
+		}
+		else if (type == 1) {
+			uint8_t lengths[288 + 30];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+			BuildHuffman(lengthCodes, lengths, 288);
+			BuildHuffman(distanceCodes, lengths + 288, 30);
+			if (!InflateBlock(state, lengthCodes, distanceCodes, output))
+				return false;
+		}
+		else if (type == 2) {
+			static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			uint32_t lengthCount = state.Bits(5) + 257;
+			uint32_t distanceCount = state.Bits(5) + 1;
+			uint32_t codeLengthCount = state.Bits(4) + 4;
+			if (lengthCount > 286 || distanceCount > 30)
+				return false;
+
+			uint8_t codeLengths[19] = {};
+			for (uint32_t i = 0; i < codeLengthCount; i++) {
+				codeLengths[codeLengthOrder[i]] = uint8_t(state.Bits(3));
+			}
+			LavaHuffman codeLengthCodes;
+			BuildHuffman(codeLengthCodes, codeLengths, 19);
+
+			//Literal/length and distance code lengths share one run length coded sequence.
+			uint8_t lengths[288 + 30] = {};
+			uint32_t count = 0;
+			while (count < lengthCount + distanceCount) {
+				int symbol = DecodeSymbol(state, codeLengthCodes);
+				if (symbol < 0 || state.overrun)
+					return false;
+				if (symbol < 16) {
+					lengths[count++] = uint8_t(symbol);
+					continue;
+				}
+
+				uint8_t repeated = 0;
+				uint32_t repeat = 0;
+				if (symbol == 16) {
+					if (count == 0)
+						return false;
+					repeated = lengths[count - 1];
+					repeat = 3 + state.Bits(2);
+				}
+				else if (symbol == 17) {
+					repeat = 3 + state.Bits(3);
+				}
+				else {
+					repeat = 11 + state.Bits(7);
+				}
+				if (count + repeat > lengthCount + distanceCount)
+					return false;
+				memset(lengths + count, repeated, repeat);
+				count += repeat;
+			}
+
+			BuildHuffman(lengthCodes, lengths, lengthCount);
+			BuildHuffman(distanceCodes, lengths + lengthCount, distanceCount);
+			if (!InflateBlock(state, lengthCodes, distanceCodes, output))
+				return false;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t ReadBigEndian(const uint8_t* data)
+{
+	return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+static uint8_t Paeth(uint8_t left, uint8_t up, uint8_t upLeft)
+{
+	int estimate = int(left) + int(up) - int(upLeft);
+	int distanceLeft = abs(estimate - int(left));
+	int distanceUp = abs(estimate - int(up));
+	int distanceUpLeft = abs(estimate - int(upLeft));
+	if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+		return left;
+	return distanceUp <= distanceUpLeft ? up : upLeft;
+}
+
+bool LavaLoadPng(const uint8_t* data, size_t size, LavaImage& image)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	if (size < 8 || memcmp(data, signature, 8) != 0)
+		return false;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t colorType = 0;
+	std::vector<uint8_t> compressed;
+	uint8_t palette[256][4] = {};
+	uint32_t paletteSize = 0;
+
+	size_t offset = 8;
+	bool hasHeader = false;
+	while (offset + 12 <= size) {
+		uint32_t length = ReadBigEndian(data + offset);
+		const uint8_t* type = data + offset + 4;
+		const uint8_t* chunk = data + offset + 8;
+		if (offset + 12 + size_t(length) > size)
+			return false;
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+			width = ReadBigEndian(chunk);
+			height = ReadBigEndian(chunk + 4);
+			uint32_t bitDepth = chunk[8];
+			colorType = chunk[9];
+			uint32_t interlace = chunk[12];
+			//16 bit, sub byte depths and Adam7 aren't needed for our source art.
+			if (bitDepth != 8 || interlace != 0 || width == 0 || height == 0)
+				return false;
+			if (colorType != 0 && colorType != 2 && colorType != 3 && colorType != 4 && colorType != 6)
+				return false;
+			hasHeader = true;
+		}
+		else if (memcmp(type, "PLTE", 4) == 0) {
+			paletteSize = std::min(length / 3, 256u);
+			for (uint32_t i = 0; i < paletteSize; i++) {
+				palette[i][0] = chunk[i * 3];
+				palette[i][1] = chunk[i * 3 + 1];
+				palette[i][2] = chunk[i * 3 + 2];
+				palette[i][3] = 255;
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0 && colorType == 3) {
+			for (uint32_t i = 0; i < std::min(length, 256u); i++) {
+				palette[i][3] = chunk[i];
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0) {
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0) {
+			break;
+		}
+		offset += 12 + size_t(length);
+	}
+
+	//zlib stream: 2 byte header, deflate data, adler32 which we don't check.
+	std::vector<uint8_t> filtered;
+	if (!hasHeader || compressed.size() < 2 || (compressed[0] & 0x0f) != 8 || (compressed[1] & 0x20) != 0)
+		return false;
+	if (!Inflate(compressed.data() + 2, compressed.size() - 2, filtered))
+		return false;
+
+	static const uint32_t channelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	uint32_t channels = channelCounts[colorType];
+	size_t stride = size_t(width) * channels;
+	if (filtered.size() < (stride + 1) * height)
+		return false;
+
+	//Undo the per row filters in place, previous row is already reconstructed.
+	std::vector<uint8_t> pixels(stride * height);
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t filter = filtered[y * (stride + 1)];
+		const uint8_t* source = &filtered[y * (stride + 1) + 1];
+		uint8_t* row = &pixels[y * stride];
+		const uint8_t* previous = y > 0 ? &pixels[(y - 1) * stride] : nullptr;
+		for (size_t x = 0; x < stride; x++) {
+			uint8_t left = x >= channels ? row[x - channels] : 0;
+			uint8_t up = previous ? previous[x] : 0;
+			uint8_t upLeft = previous && x >= channels ? previous[x - channels] : 0;
+			uint8_t predictor = 0;
+			switch (filter) {
+			case 0: predictor = 0; break;
+			case 1: predictor = left; break;
+			case 2: predictor = up; break;
+			case 3: predictor = uint8_t((int(left) + int(up)) / 2); break;
+			case 4: predictor = Paeth(left, up, upLeft); break;
+			default: return false;
+			}
+			row[x] = uint8_t(source[x] + predictor);
+		}
+	}
+
+	image.width = width;
+	image.height = height;
+	image.rgba.resize(size_t(width) * height * 4);
+	for (size_t i = 0; i < size_t(width) * height; i++) {
+		const uint8_t* source = &pixels[i * channels];
+		uint8_t* target = &image.rgba[i * 4];
+		switch (colorType) {
+		case 0: target[0] = target[1] = target[2] = source[0]; target[3] = 255; break;
+		case 2: target[0] = source[0]; target[1] = source[1]; target[2] = source[2]; target[3] = 255; break;
+		case 3: memcpy(target, palette[source[0]], 4); break;
+		case 4: target[0] = target[1] = target[2] = source[0]; target[3] = source[1]; break;
+		case 6: memcpy(target, source, 4); break;
+		}
+	}
+	return true;
+}
+
+static float SrgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+void LavaGenerateMipChain(const LavaImage& source, bool srgb, std::vector<LavaImage>& levels)
+{
+	LAVA_PROFILE_ZONE("Generate mips");
+	float toLinear[256];
+	for (uint32_t i = 0; i < 256; i++) {
+		toLinear[i] = srgb ? SrgbToLinear(float(i) / 255.f) : float(i) / 255.f;
+	}
+
+	levels.clear();
+	levels.push_back(source);
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const LavaImage& parent = levels.back();
+		LavaImage level;
+		level.width = std::max(1u, parent.width / 2);
+		level.height = std::max(1u, parent.height / 2);
+		level.rgba.resize(size_t(level.width) * level.height * 4);
+
+		//Odd sizes drop the last row/column, clamping keeps 1 texel wide axes working.
+		for (uint32_t y = 0; y < level.height; y++) {
+			uint32_t y0 = std::min(y * 2, parent.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, parent.height - 1);
+			for (uint32_t x = 0; x < level.width; x++) {
+				uint32_t x0 = std::min(x * 2, parent.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, parent.width - 1);
+				const uint8_t* texels[4] = {
+					&parent.rgba[(size_t(y0) * parent.width + x0) * 4], &parent.rgba[(size_t(y0) * parent.width + x1) * 4],
+					&parent.rgba[(size_t(y1) * parent.width + x0) * 4], &parent.rgba[(size_t(y1) * parent.width + x1) * 4]
+				};
+
+				uint8_t* target = &level.rgba[(size_t(y) * level.width + x) * 4];
+				for (uint32_t channel = 0; channel < 3; channel++) {
+					float sum = 0.f;
+					for (const uint8_t* texel : texels) {
+						sum += toLinear[texel[channel]];
+					}
+					float value = srgb ? LinearToSrgb(sum * 0.25f) : sum * 0.25f;
+					target[channel] = uint8_t(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+				}
+				target[3] = uint8_t((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			}
+		}
+		levels.push_back(std::move(level));
+	}
+}
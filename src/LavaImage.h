@@ -0,0 +1,19 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <vector>
+
+//8 bit RGBA, rows top to bottom. Sources with fewer channels are expanded (gray to rgb, alpha 255).
+struct LavaImage {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> rgba;
+};
+
+//Picked by extension: .tga (raw/RLE, 8/24/32 bit) or .png (8 bit gray/rgb/palette, with or without alpha).
+bool LavaLoadImage(const char* path, LavaImage& image);
+bool LavaLoadTga(const uint8_t* data, size_t size, LavaImage& image);
+bool LavaLoadPng(const uint8_t* data, size_t size, LavaImage& image);
+
+//Full chain down to 1x1 with a 2x2 box filter, levels[0] is the source. sRGB color is averaged in linear space.
+void LavaGenerateMipChain(const LavaImage& source, bool srgb, std::vector<LavaImage>& levels);
@@ -0,0 +1,46 @@
+#include "LavaIndexAllocator.h"
+#include <assert.h>
+#include <algorithm>
+
+void LavaIndexAllocator::Init(uint32_t indexCapacity, uint32_t frameCount)
+{
+	capacity = indexCapacity;
+	framesInFlight = std::max(1u, frameCount);
+	next = 0;
+	liveCount = 0;
+	freeList.clear();
+	pending.clear();
+}
+
+uint32_t LavaIndexAllocator::Allocate()
+{
+	uint32_t index = LAVA_BINDLESS_INVALID_INDEX;
+	if (!freeList.empty()) {
+		index = freeList.back();
+		freeList.pop_back();
+	}
+	else if (next < capacity) {
+		index = next++;
+	}
+
+	assert(index != LAVA_BINDLESS_INVALID_INDEX && "Bindless heap is full");
+	if (index != LAVA_BINDLESS_INVALID_INDEX)
+		liveCount++;
+	return index;
+}
+
+void LavaIndexAllocator::Free(uint32_t index, uint64_t frame)
+{
+	assert(index < next);
+	pending.push_back({ frame, index });
+	liveCount--;
+}
+
+void LavaIndexAllocator::BeginFrame(uint64_t frame)
+{
+	//Pending list is ordered by frame, so stop at the first entry that may still be in use.
+	while (!pending.empty() && pending.front().frame + framesInFlight <= frame) {
+		freeList.push_back(pending.front().index);
+		pending.pop_front();
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+#include <deque>
+
+const uint32_t LAVA_BINDLESS_INVALID_INDEX = ~0u;
+
+//Hands out stable slot indices. A freed index goes to a pending list and only returns to the free list
+//once every frame that could still reference it has retired on the GPU.
+class LavaIndexAllocator {
+public:
+	void Init(uint32_t capacity, uint32_t framesInFlight);
+	uint32_t Allocate();
+	void Free(uint32_t index, uint64_t frame);
+	void BeginFrame(uint64_t frame);
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetLiveCount() const { return liveCount; }
+
+private:
+	struct PendingIndex {
+		uint64_t frame;
+		uint32_t index;
+	};
+
+	std::vector<uint32_t> freeList;
+	std::deque<PendingIndex> pending;
+	uint32_t capacity = 0;
+	uint32_t next = 0; //Indices below this have been handed out at least once
+	uint32_t liveCount = 0;
+	uint32_t framesInFlight = 1;
+};
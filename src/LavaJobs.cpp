@@ -0,0 +1,123 @@
+#include "LavaJobs.h"
+#include "LavaProfiler.h"
+
+LavaJobSystem::LavaJobSystem(uint32_t workerCount)
+{
+	if (workerCount == ~0u) {
+		uint32_t cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 0;
+	}
+
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.emplace_back(&LavaJobSystem::WorkerLoop, this);
+	}
+}
+
+LavaJobSystem::~LavaJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		quit = true;
+	}
+	queueCondition.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void LavaJobSystem::Submit(std::function<void()> job, LavaJobCounter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1);
+
+	//No workers: run inline, Wait() then has nothing left to do.
+	if (workers.empty()) {
+		Job inlineJob = { std::move(job), counter };
+		RunJob(inlineJob);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back({ std::move(job), counter });
+	}
+	queueCondition.notify_one();
+}
+
+void LavaJobSystem::Wait(LavaJobCounter& counter)
+{
+	while (counter.pending.load() > 0) {
+		if (!TryRunJob())
+			std::this_thread::yield();
+	}
+}
+
+void LavaJobSystem::ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& function)
+{
+	if (count == 0)
+		return;
+
+	chunkSize = chunkSize > 0 ? chunkSize : 1;
+	uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	//Helpers and the caller pull chunk indices from one atomic, so uneven chunks balance themselves.
+	std::atomic<uint32_t> nextChunk{ 0 };
+	auto runChunks = [&]() {
+		for (uint32_t chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1)) {
+			uint32_t begin = chunk * chunkSize;
+			uint32_t end = begin + chunkSize < count ? begin + chunkSize : count;
+			function(begin, end, chunk);
+		}
+	};
+
+	LavaJobCounter counter;
+	uint32_t helperCount = chunkCount - 1 < uint32_t(workers.size()) ? chunkCount - 1 : uint32_t(workers.size());
+	for (uint32_t i = 0; i < helperCount; i++) {
+		Submit(runChunks, &counter);
+	}
+
+	runChunks();
+	Wait(counter);
+}
+
+void LavaJobSystem::WorkerLoop()
+{
+	LAVA_PROFILE_THREAD("Job worker");
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]() { return quit || !queue.empty(); });
+			if (quit && queue.empty())
+				return;
+
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+		RunJob(job);
+	}
+}
+
+bool LavaJobSystem::TryRunJob()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (queue.empty())
+			return false;
+
+		job = std::move(queue.front());
+		queue.pop_front();
+	}
+	RunJob(job);
+	return true;
+}
+
+void LavaJobSystem::RunJob(Job& job)
+{
+	LAVA_PROFILE_ZONE("Job");
+	job.function();
+	if (job.counter)
+		job.counter->pending.fetch_sub(1);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Counts jobs in flight, Wait() on it until they are all done.
+struct LavaJobCounter {
+	std::atomic<uint32_t> pending{ 0 };
+};
+
+//Fixed pool of worker threads pulling from one shared queue. Waiting threads help run jobs instead of blocking,
+//so nested ParallelFor/Wait calls from inside jobs don't deadlock.
+class LavaJobSystem {
+public:
+	explicit LavaJobSystem(uint32_t workerCount = ~0u); //Default: one worker per core, minus the calling thread
+	~LavaJobSystem();
+
+	LavaJobSystem(const LavaJobSystem&) = delete;
+	LavaJobSystem& operator=(const LavaJobSystem&) = delete;
+
+	void Submit(std::function<void()> job, LavaJobCounter* counter = nullptr);
+	void Wait(LavaJobCounter& counter);
+
+	//Splits [0,count) in chunks of chunkSize and runs function(begin, end, chunkIndex) on them, blocking until done.
+	void ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& function);
+
+	//Worker threads plus the calling thread.
+	uint32_t GetThreadCount() const { return uint32_t(workers.size()) + 1; }
+
+private:
+	struct Job {
+		std::function<void()> function;
+		LavaJobCounter* counter;
+	};
+
+	void WorkerLoop();
+	bool TryRunJob();
+	void RunJob(Job& job);
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<Job> queue;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool quit = false;
+};
+
+//Runs serially when no job system is given, so CPU modules work without threads too.
+inline void LavaParallelFor(LavaJobSystem* jobSystem, uint32_t count, uint32_t chunkSize,
+	const std::function<void(uint32_t, uint32_t, uint32_t)>& function)
+{
+	if (jobSystem) {
+		jobSystem->ParallelFor(count, chunkSize, function);
+		return;
+	}
+
+	for (uint32_t begin = 0, chunk = 0; begin < count; begin += chunkSize, chunk++) {
+		function(begin, begin + chunkSize < count ? begin + chunkSize : count, chunk);
+	}
+}
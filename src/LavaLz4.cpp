@@ -0,0 +1,141 @@
+#include "LavaLz4.h"
+
+#include <string.h>
+#include <vector>
+
+static const size_t lz4MinMatch = 4;
+static const size_t lz4LastLiterals = 5; //A block ends with at least this many literals
+static const size_t lz4MatchLimit = 12; //and its last match starts at least this far from the end
+static const size_t lz4MaxOffset = 65535;
+static const uint32_t lz4HashBits = 12;
+
+size_t LavaLz4CompressBound(size_t sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+//Lengths past the token's 4 bits continue in bytes of 255 and a final remainder.
+static bool WriteLength(uint8_t*& out, const uint8_t* outEnd, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		if (out == outEnd)
+			return false;
+		*out++ = 255;
+	}
+	if (out == outEnd)
+		return false;
+	*out++ = uint8_t(length);
+	return true;
+}
+
+static bool WriteSequence(uint8_t*& out, const uint8_t* outEnd, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	if (out == outEnd)
+		return false;
+	size_t matchCode = matchLength ? matchLength - lz4MinMatch : 0;
+	*out++ = uint8_t((literalCount < 15 ? literalCount : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+	if (literalCount >= 15 && !WriteLength(out, outEnd, literalCount - 15))
+		return false;
+	if (size_t(outEnd - out) < literalCount)
+		return false;
+	if (literalCount)
+		memcpy(out, literals, literalCount);
+	out += literalCount;
+	if (!matchLength)
+		return true;
+
+	if (outEnd - out < 2)
+		return false;
+	*out++ = uint8_t(offset);
+	*out++ = uint8_t(offset >> 8);
+	return matchCode < 15 || WriteLength(out, outEnd, matchCode - 15);
+}
+
+size_t LavaLz4Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t capacity)
+{
+	uint8_t* out = destination;
+	const uint8_t* outEnd = destination + capacity;
+	std::vector<uint32_t> table(size_t(1) << lz4HashBits, 0);
+
+	size_t anchor = 0;
+	for (size_t i = 0; i + lz4MatchLimit <= sourceSize;) {
+		uint32_t sequence;
+		memcpy(&sequence, source + i, sizeof(sequence));
+		uint32_t hash = (sequence * 2654435761u) >> (32 - lz4HashBits);
+		size_t candidate = table[hash];
+		table[hash] = uint32_t(i);
+		if (candidate >= i || i - candidate > lz4MaxOffset || memcmp(source + candidate, source + i, lz4MinMatch) != 0) {
+			i++;
+			continue;
+		}
+
+		size_t length = lz4MinMatch;
+		size_t maxLength = sourceSize - lz4LastLiterals - i;
+		while (length < maxLength && source[candidate + length] == source[i + length])
+			length++;
+		if (!WriteSequence(out, outEnd, source + anchor, i - anchor, i - candidate, length))
+			return 0;
+		i += length;
+		anchor = i;
+	}
+
+	if (!WriteSequence(out, outEnd, source + anchor, sourceSize - anchor, 0, 0))
+		return 0;
+	return size_t(out - destination);
+}
+
+static bool ReadLength(const uint8_t*& in, const uint8_t* inEnd, size_t& length)
+{
+	uint8_t byte;
+	do {
+		if (in == inEnd)
+			return false;
+		byte = *in++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool LavaLz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize)
+{
+	const uint8_t* in = source;
+	const uint8_t* inEnd = source + sourceSize;
+	uint8_t* out = destination;
+	uint8_t* outEnd = destination + destinationSize;
+
+	while (in < inEnd) {
+		uint8_t token = *in++;
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLength(in, inEnd, literalCount))
+			return false;
+		if (literalCount > size_t(inEnd - in) || literalCount > size_t(outEnd - out))
+			return false;
+		if (literalCount)
+			memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+		if (in == inEnd)
+			break; //Last sequence, literals only
+
+		if (inEnd - in < 2)
+			return false;
+		size_t offset = size_t(in[0]) | size_t(in[1]) << 8;
+		in += 2;
+		if (offset == 0 || offset > size_t(out - destination))
+			return false;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(in, inEnd, matchLength))
+			return false;
+		matchLength += lz4MinMatch;
+		if (matchLength > size_t(outEnd - out))
+			return false;
+
+		//Byte by byte, a match may overlap the bytes it produces.
+		const uint8_t* match = out - offset;
+		for (size_t i = 0; i < matchLength; i++) {
+			out[i] = match[i];
+		}
+		out += matchLength;
+	}
+	return out == outEnd;
+}
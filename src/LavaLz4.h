@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+//LZ4 block format, greedy single pass compression with a small hash table. Fast enough to expand data on load,
+//any LZ4 block decoder reads the output.
+size_t LavaLz4CompressBound(size_t sourceSize);
+
+//Returns the compressed size, 0 when it doesn't fit into capacity.
+size_t LavaLz4Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t capacity);
+
+//False on malformed input or when the output isn't exactly destinationSize bytes. Never reads or writes out of bounds.
+bool LavaLz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize);
@@ -0,0 +1,154 @@
+#include "LavaMesh.h"
+#include "LavaProfiler.h"
+#include "LavaOcclusion.h"
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+#include <unordered_map>
+#include <istream>
+#include <float.h>
+#include <string.h>
+
+struct VertexHasher {
+	size_t operator()(const Vertex& vertex) const {
+		//FNV-1a over the raw floats, welding only merges bit exact duplicates anyway.
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return hash;
+	}
+};
+
+struct VertexEqual {
+	bool operator()(const Vertex& a, const Vertex& b) const {
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+//Obj indexes positions and normals separately, weld identical pairs so the index buffer actually shares vertices.
+static Mesh BuildMesh(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes)
+{
+	std::vector<Vertex> corners;
+	for (const tinyobj::shape_t& shape : shapes) {
+		for (const tinyobj::index_t& index : shape.mesh.indices) {
+			Vertex vertex = {};
+			vertex.Position = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+
+			vertex.Normal = {
+				attrib.normals[3 * index.normal_index + 0],
+				attrib.normals[3 * index.normal_index + 1],
+				attrib.normals[3 * index.normal_index + 2]
+			};
+			corners.push_back(vertex);
+		}
+	}
+
+	Mesh outputMesh;
+	WeldVertices(corners.data(), uint32_t(corners.size()), outputMesh);
+	return outputMesh;
+}
+
+Mesh LoadMesh(const char* path) {
+	LAVA_PROFILE_ZONE("LoadMesh");
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path)) {
+		throw std::runtime_error(warn + err);
+	}
+	return BuildMesh(attrib, shapes);
+}
+
+//Read only stream over the caller's bytes, tinyobj parses from an istream without copying them first.
+struct MemoryStreamBuffer : std::streambuf {
+	MemoryStreamBuffer(const void* data, size_t size)
+	{
+		char* begin = const_cast<char*>(static_cast<const char*>(data));
+		setg(begin, begin, begin + size);
+	}
+};
+
+Mesh LoadMeshFromMemory(const void* data, size_t size) {
+	LAVA_PROFILE_ZONE("LoadMesh");
+	MemoryStreamBuffer buffer(data, size);
+	std::istream stream(&buffer);
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream)) {
+		throw std::runtime_error(warn + err);
+	}
+	return BuildMesh(attrib, shapes);
+}
+
+void WeldVertices(const Vertex* corners, uint32_t cornerCount, Mesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.resize(cornerCount);
+
+	std::unordered_map<Vertex, uint32_t, VertexHasher, VertexEqual> uniqueVertices;
+	uniqueVertices.reserve(cornerCount);
+	for (uint32_t i = 0; i < cornerCount; i++) {
+		auto inserted = uniqueVertices.insert({ corners[i], uint32_t(mesh.vertices.size()) });
+		if (inserted.second)
+			mesh.vertices.push_back(corners[i]);
+		mesh.indices[i] = inserted.first->second;
+	}
+}
+
+glm::vec4 ComputeBoundingSphere(const Mesh& mesh)
+{
+	glm::vec3 minPosition(FLT_MAX), maxPosition(-FLT_MAX);
+	for (const Vertex& vertex : mesh.vertices) {
+		glm::vec3 position(vertex.Position.x, vertex.Position.y, vertex.Position.z);
+		minPosition = glm::min(minPosition, position);
+		maxPosition = glm::max(maxPosition, position);
+	}
+
+	glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+	float radius = 0.f;
+	for (const Vertex& vertex : mesh.vertices) {
+		glm::vec3 position(vertex.Position.x, vertex.Position.y, vertex.Position.z);
+		radius = std::max(radius, glm::length(position - center));
+	}
+	return glm::vec4(center, radius);
+}
+
+Mesh BuildClusteredLod(const Mesh& mesh, uint32_t gridResolution)
+{
+	Mesh lod;
+	if (mesh.vertices.empty())
+		return lod;
+
+	std::vector<glm::vec3> positions;
+	BuildOccluderLod(&mesh.vertices[0].Position.x, sizeof(Vertex), uint32_t(mesh.vertices.size()), mesh.indices.data(), uint32_t(mesh.indices.size()),
+		gridResolution, positions, lod.indices);
+
+	//Cross products are twice the triangle area, summing them weights the faces by size.
+	std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.f));
+	for (size_t i = 0; i + 2 < lod.indices.size(); i += 3) {
+		glm::vec3 a = positions[lod.indices[i]];
+		glm::vec3 faceNormal = glm::cross(positions[lod.indices[i + 1]] - a, positions[lod.indices[i + 2]] - a);
+		for (size_t k = 0; k < 3; k++) {
+			normals[lod.indices[i + k]] += faceNormal;
+		}
+	}
+
+	lod.vertices.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++) {
+		float length = glm::length(normals[i]);
+		glm::vec3 normal = length > 0.f ? normals[i] / length : glm::vec3(0.f, 1.f, 0.f);
+		lod.vertices[i].Position = { positions[i].x, positions[i].y, positions[i].z };
+		lod.vertices[i].Normal = { normal.x, normal.y, normal.z };
+	}
+	return lod;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <vector>
+
+struct Vec3 {
+	float x, y, z;
+};
+
+struct Vertex {
+	Vec3 Position;
+	Vec3 Normal;
+};
+
+struct Mesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+//Obj positions and normals, one vertex per face corner, welded. Throws on parse errors.
+Mesh LoadMesh(const char* path);
+//Same from obj text already in memory, e.g. read through the VFS. Material libraries aren't followed.
+Mesh LoadMeshFromMemory(const void* data, size_t size);
+
+//Merges bit exact duplicate vertices, corner i of the input becomes index i of the mesh.
+void WeldVertices(const Vertex* corners, uint32_t cornerCount, Mesh& mesh);
+
+//Center of the position bounds and the farthest vertex from it.
+glm::vec4 ComputeBoundingSphere(const Mesh& mesh);
+
+//Vertex clustering LOD for distant draws, same clusters as BuildOccluderLod. Normals are the area weighted
+//face normals of the LOD's own triangles.
+Mesh BuildClusteredLod(const Mesh& mesh, uint32_t gridResolution);
@@ -0,0 +1,974 @@
+#include "LavaNullVulkan.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+enum LavaNullObjectType {
+	LAVA_NULL_INSTANCE,
+	LAVA_NULL_DEVICE,
+	LAVA_NULL_QUEUE,
+	LAVA_NULL_MEMORY,
+	LAVA_NULL_BUFFER,
+	LAVA_NULL_IMAGE,
+	LAVA_NULL_IMAGE_VIEW,
+	LAVA_NULL_SAMPLER,
+	LAVA_NULL_FENCE,
+	LAVA_NULL_SEMAPHORE,
+	LAVA_NULL_QUERY_POOL,
+	LAVA_NULL_SHADER_MODULE,
+	LAVA_NULL_PIPELINE,
+	LAVA_NULL_PIPELINE_LAYOUT,
+	LAVA_NULL_DESCRIPTOR_SET_LAYOUT,
+	LAVA_NULL_DESCRIPTOR_POOL,
+	LAVA_NULL_DESCRIPTOR_SET,
+	LAVA_NULL_RENDER_PASS,
+	LAVA_NULL_FRAMEBUFFER,
+	LAVA_NULL_COMMAND_POOL,
+	LAVA_NULL_COMMAND_BUFFER,
+	LAVA_NULL_OBJECT_TYPE_COUNT
+};
+
+static const char* objectTypeNames[LAVA_NULL_OBJECT_TYPE_COUNT] = {
+	"instance", "device", "queue", "memory", "buffer", "image", "image view", "sampler", "fence", "semaphore", "query pool",
+	"shader module", "pipeline", "pipeline layout", "descriptor set layout", "descriptor pool", "descriptor set", "render pass",
+	"framebuffer", "command pool", "command buffer"
+};
+
+struct NullObject {
+	LavaNullObjectType type;
+	uint64_t parent; //Pool of command buffers and descriptor sets, freed with it
+	VkDeviceSize size; //Buffers, images and memory
+	void* data; //Memory, allocated on first map
+	bool signaled; //Fences
+};
+
+//Handles count up from a non zero base, so a destroyed handle is never handed out again and stays detectable.
+struct NullDriver {
+	std::mutex mutex;
+	std::unordered_map<uint64_t, NullObject> objects;
+	uint64_t nextHandle = 0x1000;
+};
+
+static NullDriver& GetDriver()
+{
+	static NullDriver driver;
+	return driver;
+}
+
+//Startup creates objects from several threads, the counters are atomic for the same reason the object map is locked.
+struct NullStats {
+	std::atomic<uint64_t> calls{ 0 };
+	std::atomic<uint64_t> commands{ 0 };
+	std::atomic<uint64_t> draws{ 0 };
+	std::atomic<uint64_t> dispatches{ 0 };
+	std::atomic<uint64_t> barriers{ 0 };
+	std::atomic<uint64_t> submits{ 0 };
+	std::atomic<uint64_t> createdObjects{ 0 };
+	std::atomic<uint64_t> liveObjects{ 0 };
+	std::atomic<uint64_t> allocatedBytes{ 0 };
+	std::atomic<uint64_t> invalidHandles{ 0 };
+};
+
+static NullStats stats;
+
+struct NullCallCounter;
+static NullCallCounter* callCounters = nullptr;
+
+struct NullCallCounter {
+	const char* name;
+	std::atomic<uint64_t> count;
+	NullCallCounter* next;
+
+	NullCallCounter(const char* entryName) : name(entryName), count(0)
+	{
+		std::lock_guard<std::mutex> lock(GetDriver().mutex);
+		next = callCounters;
+		callCounters = this;
+	}
+};
+
+#define LAVA_NULL_CALL(entry) static NullCallCounter entry##Counter(#entry); entry##Counter.count++; stats.calls++
+#define LAVA_NULL_COMMAND(entry) LAVA_NULL_CALL(entry); stats.commands++
+
+const LavaNullVulkanStats& LavaNullVulkanGetStats()
+{
+	static LavaNullVulkanStats snapshot;
+	snapshot = { stats.calls, stats.commands, stats.draws, stats.dispatches, stats.barriers, stats.submits,
+		stats.createdObjects, stats.liveObjects, stats.allocatedBytes, stats.invalidHandles };
+	return snapshot;
+}
+
+void LavaNullVulkanPrintCalls(uint64_t frameCount)
+{
+	std::vector<NullCallCounter*> counters;
+	{
+		std::lock_guard<std::mutex> lock(GetDriver().mutex);
+		for (NullCallCounter* counter = callCounters; counter; counter = counter->next) {
+			counters.push_back(counter);
+		}
+	}
+	std::sort(counters.begin(), counters.end(), [](const NullCallCounter* a, const NullCallCounter* b) { return a->count > b->count; });
+
+	double frames = double(std::max<uint64_t>(1, frameCount));
+	for (NullCallCounter* counter : counters) {
+		LAVA_PRINT("  " << counter->name << ": " << double(counter->count) / frames);
+	}
+}
+
+template<typename Handle>
+static Handle CreateObject(LavaNullObjectType type, VkDeviceSize size = 0, uint64_t parent = 0)
+{
+	NullDriver& driver = GetDriver();
+	std::lock_guard<std::mutex> lock(driver.mutex);
+	uint64_t handle = driver.nextHandle;
+	driver.nextHandle += 0x10;
+	driver.objects[handle] = { type, parent, size, nullptr, false };
+	stats.createdObjects++;
+	stats.liveObjects++;
+	return (Handle)(uintptr_t)handle;
+}
+
+static void FreeObject(NullObject& object)
+{
+	if (object.type == LAVA_NULL_MEMORY)
+		stats.allocatedBytes -= object.size;
+	free(object.data);
+	stats.liveObjects--;
+}
+
+//Null handles are valid to destroy, anything else must be live and of the right type.
+template<typename Handle>
+static void DestroyObject(LavaNullObjectType type, Handle handle, const char* entry)
+{
+	if (!handle)
+		return;
+
+	NullDriver& driver = GetDriver();
+	std::lock_guard<std::mutex> lock(driver.mutex);
+	auto object = driver.objects.find(uint64_t(uintptr_t(handle)));
+	if (object == driver.objects.end() || object->second.type != type) {
+		stats.invalidHandles++;
+		LAVA_PRINT("Null device: " << entry << " on unknown " << objectTypeNames[type] << " " << (void*)handle);
+		return;
+	}
+	FreeObject(object->second);
+	driver.objects.erase(object);
+
+	//Pools take their command buffers and descriptor sets with them.
+	if (type == LAVA_NULL_COMMAND_POOL || type == LAVA_NULL_DESCRIPTOR_POOL) {
+		for (auto child = driver.objects.begin(); child != driver.objects.end();) {
+			if (child->second.parent == uint64_t(uintptr_t(handle))) {
+				FreeObject(child->second);
+				child = driver.objects.erase(child);
+			}
+			else
+				++child;
+		}
+	}
+}
+
+template<typename Handle>
+static NullObject* FindObject(LavaNullObjectType type, Handle handle)
+{
+	NullDriver& driver = GetDriver();
+	auto object = driver.objects.find(uint64_t(uintptr_t(handle)));
+	if (object == driver.objects.end() || object->second.type != type) {
+		stats.invalidHandles++;
+		return nullptr;
+	}
+	return &object->second;
+}
+
+//Objects still alive when their device or instance goes away are leaks in the engine, reported by type.
+static void ReportLeaks(bool instanceLevel)
+{
+	NullDriver& driver = GetDriver();
+	std::lock_guard<std::mutex> lock(driver.mutex);
+	uint32_t leaks[LAVA_NULL_OBJECT_TYPE_COUNT] = {};
+	for (auto object = driver.objects.begin(); object != driver.objects.end();) {
+		bool deviceObject = object->second.type != LAVA_NULL_INSTANCE && object->second.type != LAVA_NULL_DEVICE;
+		if (deviceObject || instanceLevel) {
+			if (object->second.type != LAVA_NULL_QUEUE && object->second.type != LAVA_NULL_COMMAND_BUFFER && object->second.type != LAVA_NULL_DESCRIPTOR_SET)
+				leaks[object->second.type]++;
+			FreeObject(object->second);
+			object = driver.objects.erase(object);
+		}
+		else
+			++object;
+	}
+	for (uint32_t i = 0; i < LAVA_NULL_OBJECT_TYPE_COUNT; i++) {
+		if (leaks[i])
+			LAVA_PRINT("Null device: " << leaks[i] << " " << objectTypeNames[i] << " objects leaked");
+	}
+}
+
+//Writes min(count, available) items, VK_INCOMPLETE when the caller's array was too small.
+template<typename T>
+static VkResult Enumerate(const T* items, uint32_t itemCount, uint32_t* count, T* output)
+{
+	if (!output) {
+		*count = itemCount;
+		return VK_SUCCESS;
+	}
+	uint32_t written = std::min(*count, itemCount);
+	for (uint32_t i = 0; i < written; i++) {
+		output[i] = items[i];
+	}
+	*count = written;
+	return written < itemCount ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+extern "C" {
+
+//Instance and physical device. One CPU type device with one queue family that does everything.
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount, VkLayerProperties*)
+{
+	LAVA_NULL_CALL(vkEnumerateInstanceLayerProperties);
+	*pPropertyCount = 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char*, uint32_t* pPropertyCount, VkExtensionProperties*)
+{
+	LAVA_NULL_CALL(vkEnumerateInstanceExtensionProperties);
+	*pPropertyCount = 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkInstance* pInstance)
+{
+	LAVA_NULL_CALL(vkCreateInstance);
+	if (pCreateInfo->enabledLayerCount)
+		return VK_ERROR_LAYER_NOT_PRESENT;
+	if (pCreateInfo->enabledExtensionCount)
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	*pInstance = CreateObject<VkInstance>(LAVA_NULL_INSTANCE);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyInstance);
+	DestroyObject(LAVA_NULL_INSTANCE, instance, "vkDestroyInstance");
+	ReportLeaks(true);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance, const char*)
+{
+	LAVA_NULL_CALL(vkGetInstanceProcAddr);
+	return nullptr; //No extensions
+}
+
+//The physical device has no state, any non null handle works.
+static const VkPhysicalDevice nullPhysicalDevice = (VkPhysicalDevice)(uintptr_t)0x10;
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance, uint32_t* pPhysicalDeviceCount, VkPhysicalDevice* pPhysicalDevices)
+{
+	LAVA_NULL_CALL(vkEnumeratePhysicalDevices);
+	return Enumerate(&nullPhysicalDevice, 1, pPhysicalDeviceCount, pPhysicalDevices);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceProperties);
+	*pProperties = {};
+	pProperties->apiVersion = VK_API_VERSION_1_2;
+	pProperties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+	strcpy(pProperties->deviceName, "Lava null device");
+	pProperties->limits.timestampPeriod = 1.f;
+	pProperties->limits.timestampComputeAndGraphics = VK_TRUE;
+	pProperties->limits.maxPushConstantsSize = 256;
+	pProperties->limits.maxImageDimension2D = 16384;
+	pProperties->limits.maxBoundDescriptorSets = 8;
+	pProperties->limits.maxComputeWorkGroupCount[0] = 65535;
+	pProperties->limits.maxComputeWorkGroupCount[1] = 65535;
+	pProperties->limits.maxComputeWorkGroupCount[2] = 65535;
+	pProperties->limits.maxDrawIndirectCount = ~0u;
+	pProperties->limits.minStorageBufferOffsetAlignment = 16;
+	pProperties->limits.minUniformBufferOffsetAlignment = 16;
+	pProperties->limits.nonCoherentAtomSize = 64;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2* pProperties)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceProperties2);
+	vkGetPhysicalDeviceProperties(physicalDevice, &pProperties->properties);
+	for (VkBaseOutStructure* next = (VkBaseOutStructure*)pProperties->pNext; next; next = next->pNext) {
+		if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES) {
+			VkPhysicalDeviceDescriptorIndexingProperties* indexing = (VkPhysicalDeviceDescriptorIndexingProperties*)next;
+			indexing->maxUpdateAfterBindDescriptorsInAllPools = 1u << 20;
+			indexing->maxPerStageDescriptorUpdateAfterBindSamplers = 1u << 20;
+			indexing->maxPerStageDescriptorUpdateAfterBindStorageBuffers = 1u << 20;
+			indexing->maxPerStageDescriptorUpdateAfterBindSampledImages = 1u << 20;
+			indexing->maxPerStageUpdateAfterBindResources = 1u << 20;
+			indexing->maxDescriptorSetUpdateAfterBindSamplers = 1u << 20;
+			indexing->maxDescriptorSetUpdateAfterBindStorageBuffers = 1u << 20;
+			indexing->maxDescriptorSetUpdateAfterBindSampledImages = 1u << 20;
+		}
+	}
+}
+
+//Every feature is supported, the structs are VkBool32 arrays after their header.
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures2(VkPhysicalDevice, VkPhysicalDeviceFeatures2* pFeatures)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceFeatures2);
+	VkBool32* features = reinterpret_cast<VkBool32*>(&pFeatures->features);
+	std::fill(features, features + sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32), VK_TRUE);
+	for (VkBaseOutStructure* next = (VkBaseOutStructure*)pFeatures->pNext; next; next = next->pNext) {
+		if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES) {
+			VkPhysicalDeviceVulkan12Features* features12 = (VkPhysicalDeviceVulkan12Features*)next;
+			VkBool32* begin = &features12->samplerMirrorClampToEdge;
+			std::fill(begin, reinterpret_cast<VkBool32*>(features12 + 1), VK_TRUE);
+		}
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat, VkFormatProperties* pFormatProperties)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceFormatProperties);
+	pFormatProperties->linearTilingFeatures = 0x7fffffff;
+	pFormatProperties->optimalTilingFeatures = 0x7fffffff;
+	pFormatProperties->bufferFeatures = 0x7fffffff;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t* pQueueFamilyPropertyCount,
+	VkQueueFamilyProperties* pQueueFamilyProperties)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceQueueFamilyProperties);
+	//Graphics, then a compute only family like discrete GPUs have for async compute.
+	VkQueueFamilyProperties families[2] = {};
+	families[0].queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+	families[0].queueCount = 1;
+	families[0].timestampValidBits = 64;
+	families[0].minImageTransferGranularity = { 1, 1, 1 };
+	families[1] = families[0];
+	families[1].queueFlags = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+	Enumerate(families, 2, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+}
+
+//Unified memory like a software driver: one heap, one type that is everything.
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceMemoryProperties);
+	*pMemoryProperties = {};
+	pMemoryProperties->memoryTypeCount = 1;
+	pMemoryProperties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	pMemoryProperties->memoryTypes[0].heapIndex = 0;
+	pMemoryProperties->memoryHeapCount = 1;
+	pMemoryProperties->memoryHeaps[0].size = 16ull << 30;
+	pMemoryProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+//No surface support, the renderer runs headless on the null device.
+VKAPI_ATTR void VKAPI_CALL vkDestroySurfaceKHR(VkInstance, VkSurfaceKHR, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroySurfaceKHR);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice, uint32_t, VkSurfaceKHR, VkBool32* pSupported)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceSurfaceSupportKHR);
+	*pSupported = VK_FALSE;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice, VkSurfaceKHR, VkSurfaceCapabilitiesKHR*)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t*, VkSurfaceFormatKHR*)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceSurfaceFormatsKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t*, VkPresentModeKHR*)
+{
+	LAVA_NULL_CALL(vkGetPhysicalDeviceSurfacePresentModesKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+//Device and queue.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkDevice* pDevice)
+{
+	LAVA_NULL_CALL(vkCreateDevice);
+	if (pCreateInfo->enabledExtensionCount)
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	*pDevice = CreateObject<VkDevice>(LAVA_NULL_DEVICE);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyDevice);
+	DestroyObject(LAVA_NULL_DEVICE, device, "vkDestroyDevice");
+	ReportLeaks(false);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue* pQueue)
+{
+	LAVA_NULL_CALL(vkGetDeviceQueue);
+	*pQueue = CreateObject<VkQueue>(LAVA_NULL_QUEUE);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice)
+{
+	LAVA_NULL_CALL(vkDeviceWaitIdle);
+	return VK_SUCCESS;
+}
+
+//Work is done the moment it is submitted, the fence is signaled right away.
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
+{
+	LAVA_NULL_CALL(vkQueueSubmit);
+	for (uint32_t i = 0; i < submitCount; i++) {
+		stats.submits += pSubmits[i].commandBufferCount;
+	}
+	if (fence) {
+		std::lock_guard<std::mutex> lock(GetDriver().mutex);
+		if (NullObject* object = FindObject(LAVA_NULL_FENCE, fence))
+			object->signaled = true;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkFence* pFence)
+{
+	LAVA_NULL_CALL(vkCreateFence);
+	*pFence = CreateObject<VkFence>(LAVA_NULL_FENCE);
+	if (pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) {
+		std::lock_guard<std::mutex> lock(GetDriver().mutex);
+		FindObject(LAVA_NULL_FENCE, *pFence)->signaled = true;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence fence, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyFence);
+	DestroyObject(LAVA_NULL_FENCE, fence, "vkDestroyFence");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, uint32_t fenceCount, const VkFence* pFences)
+{
+	LAVA_NULL_CALL(vkResetFences);
+	std::lock_guard<std::mutex> lock(GetDriver().mutex);
+	for (uint32_t i = 0; i < fenceCount; i++) {
+		if (NullObject* object = FindObject(LAVA_NULL_FENCE, pFences[i]))
+			object->signaled = false;
+	}
+	return VK_SUCCESS;
+}
+
+//A fence that was never submitted would hang a real device, here it times out.
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t)
+{
+	LAVA_NULL_CALL(vkWaitForFences);
+	std::lock_guard<std::mutex> lock(GetDriver().mutex);
+	uint32_t signaledCount = 0;
+	for (uint32_t i = 0; i < fenceCount; i++) {
+		NullObject* object = FindObject(LAVA_NULL_FENCE, pFences[i]);
+		signaledCount += object && object->signaled;
+	}
+	bool done = waitAll ? signaledCount == fenceCount : signaledCount > 0;
+	return done ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore* pSemaphore)
+{
+	LAVA_NULL_CALL(vkCreateSemaphore);
+	*pSemaphore = CreateObject<VkSemaphore>(LAVA_NULL_SEMAPHORE);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroySemaphore);
+	DestroyObject(LAVA_NULL_SEMAPHORE, semaphore, "vkDestroySemaphore");
+}
+
+//Swapchains need a surface, which the null device never has.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice, const VkSwapchainCreateInfoKHR*, const VkAllocationCallbacks*, VkSwapchainKHR*)
+{
+	LAVA_NULL_CALL(vkCreateSwapchainKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice, VkSwapchainKHR, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroySwapchainKHR);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice, VkSwapchainKHR, uint32_t*, VkImage*)
+{
+	LAVA_NULL_CALL(vkGetSwapchainImagesKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice, VkSwapchainKHR, uint64_t, VkSemaphore, VkFence, uint32_t*)
+{
+	LAVA_NULL_CALL(vkAcquireNextImageKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue, const VkPresentInfoKHR*)
+{
+	LAVA_NULL_CALL(vkQueuePresentKHR);
+	return VK_ERROR_SURFACE_LOST_KHR;
+}
+
+//Memory. Backing store is only allocated when the memory is mapped, device local use costs nothing.
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* pMemory)
+{
+	LAVA_NULL_CALL(vkAllocateMemory);
+	if (pAllocateInfo->memoryTypeIndex != 0)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	*pMemory = CreateObject<VkDeviceMemory>(LAVA_NULL_MEMORY, pAllocateInfo->allocationSize);
+	stats.allocatedBytes += pAllocateInfo->allocationSize;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkFreeMemory);
+	DestroyObject(LAVA_NULL_MEMORY, memory, "vkFreeMemory");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** ppData)
+{
+	LAVA_NULL_CALL(vkMapMemory);
+	std::lock_guard<std::mutex> lock(GetDriver().mutex);
+	NullObject* object = FindObject(LAVA_NULL_MEMORY, memory);
+	if (!object)
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	if (!object->data)
+		object->data = calloc(1, size_t(object->size));
+	if (!object->data)
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	*ppData = static_cast<uint8_t*>(object->data) + offset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory)
+{
+	LAVA_NULL_CALL(vkUnmapMemory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+{
+	LAVA_NULL_CALL(vkBindBufferMemory);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+	LAVA_NULL_CALL(vkBindImageMemory);
+	return VK_SUCCESS;
+}
+
+static void GetMemoryRequirements(LavaNullObjectType type, uint64_t handle, VkMemoryRequirements* pMemoryRequirements)
+{
+	std::lock_guard<std::mutex> lock(GetDriver().mutex);
+	NullObject* object = FindObject(type, handle);
+	pMemoryRequirements->alignment = type == LAVA_NULL_IMAGE ? 4096 : 256;
+	pMemoryRequirements->size = object ? (std::max<VkDeviceSize>(1, object->size) + pMemoryRequirements->alignment - 1) & ~(pMemoryRequirements->alignment - 1) : 0;
+	pMemoryRequirements->memoryTypeBits = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements)
+{
+	LAVA_NULL_CALL(vkGetBufferMemoryRequirements);
+	GetMemoryRequirements(LAVA_NULL_BUFFER, uint64_t(uintptr_t(buffer)), pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+	LAVA_NULL_CALL(vkGetImageMemoryRequirements);
+	GetMemoryRequirements(LAVA_NULL_IMAGE, uint64_t(uintptr_t(image)), pMemoryRequirements);
+}
+
+//Resources.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkBuffer* pBuffer)
+{
+	LAVA_NULL_CALL(vkCreateBuffer);
+	*pBuffer = CreateObject<VkBuffer>(LAVA_NULL_BUFFER, pCreateInfo->size);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyBuffer);
+	DestroyObject(LAVA_NULL_BUFFER, buffer, "vkDestroyBuffer");
+}
+
+//Sized as 4 bytes per texel plus a third for the mip chain, close enough for budgets.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkImage* pImage)
+{
+	LAVA_NULL_CALL(vkCreateImage);
+	VkDeviceSize size = VkDeviceSize(pCreateInfo->extent.width) * pCreateInfo->extent.height * pCreateInfo->extent.depth * pCreateInfo->arrayLayers * 4;
+	if (pCreateInfo->mipLevels > 1)
+		size += size / 3;
+	*pImage = CreateObject<VkImage>(LAVA_NULL_IMAGE, size);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyImage);
+	DestroyObject(LAVA_NULL_IMAGE, image, "vkDestroyImage");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* pView)
+{
+	LAVA_NULL_CALL(vkCreateImageView);
+	*pView = CreateObject<VkImageView>(LAVA_NULL_IMAGE_VIEW);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView imageView, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyImageView);
+	DestroyObject(LAVA_NULL_IMAGE_VIEW, imageView, "vkDestroyImageView");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice, const VkSamplerCreateInfo*, const VkAllocationCallbacks*, VkSampler* pSampler)
+{
+	LAVA_NULL_CALL(vkCreateSampler);
+	*pSampler = CreateObject<VkSampler>(LAVA_NULL_SAMPLER);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice, VkSampler sampler, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroySampler);
+	DestroyObject(LAVA_NULL_SAMPLER, sampler, "vkDestroySampler");
+}
+
+//Queries never see GPU work, every result is 0 and available.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo*, const VkAllocationCallbacks*, VkQueryPool* pQueryPool)
+{
+	LAVA_NULL_CALL(vkCreateQueryPool);
+	*pQueryPool = CreateObject<VkQueryPool>(LAVA_NULL_QUERY_POOL);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice, VkQueryPool queryPool, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyQueryPool);
+	DestroyObject(LAVA_NULL_QUERY_POOL, queryPool, "vkDestroyQueryPool");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice, VkQueryPool, uint32_t, uint32_t, size_t dataSize, void* pData, VkDeviceSize, VkQueryResultFlags)
+{
+	LAVA_NULL_CALL(vkGetQueryPoolResults);
+	memset(pData, 0, dataSize);
+	return VK_SUCCESS;
+}
+
+//Pipeline state. Shader code is never looked at.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*, VkShaderModule* pShaderModule)
+{
+	LAVA_NULL_CALL(vkCreateShaderModule);
+	*pShaderModule = CreateObject<VkShaderModule>(LAVA_NULL_SHADER_MODULE);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice, VkShaderModule shaderModule, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyShaderModule);
+	DestroyObject(LAVA_NULL_SHADER_MODULE, shaderModule, "vkDestroyShaderModule");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo*,
+	const VkAllocationCallbacks*, VkPipeline* pPipelines)
+{
+	LAVA_NULL_CALL(vkCreateGraphicsPipelines);
+	for (uint32_t i = 0; i < createInfoCount; i++) {
+		pPipelines[i] = CreateObject<VkPipeline>(LAVA_NULL_PIPELINE);
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount, const VkComputePipelineCreateInfo*,
+	const VkAllocationCallbacks*, VkPipeline* pPipelines)
+{
+	LAVA_NULL_CALL(vkCreateComputePipelines);
+	for (uint32_t i = 0; i < createInfoCount; i++) {
+		pPipelines[i] = CreateObject<VkPipeline>(LAVA_NULL_PIPELINE);
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline pipeline, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyPipeline);
+	DestroyObject(LAVA_NULL_PIPELINE, pipeline, "vkDestroyPipeline");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*, VkPipelineLayout* pPipelineLayout)
+{
+	LAVA_NULL_CALL(vkCreatePipelineLayout);
+	*pPipelineLayout = CreateObject<VkPipelineLayout>(LAVA_NULL_PIPELINE_LAYOUT);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice, VkPipelineLayout pipelineLayout, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyPipelineLayout);
+	DestroyObject(LAVA_NULL_PIPELINE_LAYOUT, pipelineLayout, "vkDestroyPipelineLayout");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo*, const VkAllocationCallbacks*, VkRenderPass* pRenderPass)
+{
+	LAVA_NULL_CALL(vkCreateRenderPass);
+	*pRenderPass = CreateObject<VkRenderPass>(LAVA_NULL_RENDER_PASS);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass renderPass, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyRenderPass);
+	DestroyObject(LAVA_NULL_RENDER_PASS, renderPass, "vkDestroyRenderPass");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*, VkFramebuffer* pFramebuffer)
+{
+	LAVA_NULL_CALL(vkCreateFramebuffer);
+	*pFramebuffer = CreateObject<VkFramebuffer>(LAVA_NULL_FRAMEBUFFER);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer framebuffer, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyFramebuffer);
+	DestroyObject(LAVA_NULL_FRAMEBUFFER, framebuffer, "vkDestroyFramebuffer");
+}
+
+//Descriptors.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*,
+	VkDescriptorSetLayout* pSetLayout)
+{
+	LAVA_NULL_CALL(vkCreateDescriptorSetLayout);
+	*pSetLayout = CreateObject<VkDescriptorSetLayout>(LAVA_NULL_DESCRIPTOR_SET_LAYOUT);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout descriptorSetLayout, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyDescriptorSetLayout);
+	DestroyObject(LAVA_NULL_DESCRIPTOR_SET_LAYOUT, descriptorSetLayout, "vkDestroyDescriptorSetLayout");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo*, const VkAllocationCallbacks*, VkDescriptorPool* pDescriptorPool)
+{
+	LAVA_NULL_CALL(vkCreateDescriptorPool);
+	*pDescriptorPool = CreateObject<VkDescriptorPool>(LAVA_NULL_DESCRIPTOR_POOL);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool descriptorPool, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyDescriptorPool);
+	DestroyObject(LAVA_NULL_DESCRIPTOR_POOL, descriptorPool, "vkDestroyDescriptorPool");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* pAllocateInfo, VkDescriptorSet* pDescriptorSets)
+{
+	LAVA_NULL_CALL(vkAllocateDescriptorSets);
+	for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+		pDescriptorSets[i] = CreateObject<VkDescriptorSet>(LAVA_NULL_DESCRIPTOR_SET, 0, uint64_t(uintptr_t(pAllocateInfo->descriptorPool)));
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*)
+{
+	LAVA_NULL_CALL(vkUpdateDescriptorSets);
+}
+
+//Command buffers.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*, VkCommandPool* pCommandPool)
+{
+	LAVA_NULL_CALL(vkCreateCommandPool);
+	*pCommandPool = CreateObject<VkCommandPool>(LAVA_NULL_COMMAND_POOL);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool commandPool, const VkAllocationCallbacks*)
+{
+	LAVA_NULL_CALL(vkDestroyCommandPool);
+	DestroyObject(LAVA_NULL_COMMAND_POOL, commandPool, "vkDestroyCommandPool");
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice, VkCommandPool, VkCommandPoolResetFlags)
+{
+	LAVA_NULL_CALL(vkResetCommandPool);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers)
+{
+	LAVA_NULL_CALL(vkAllocateCommandBuffers);
+	for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+		pCommandBuffers[i] = CreateObject<VkCommandBuffer>(LAVA_NULL_COMMAND_BUFFER, 0, uint64_t(uintptr_t(pAllocateInfo->commandPool)));
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo*)
+{
+	LAVA_NULL_CALL(vkBeginCommandBuffer);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer)
+{
+	LAVA_NULL_CALL(vkEndCommandBuffer);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer, VkCommandBufferResetFlags)
+{
+	LAVA_NULL_CALL(vkResetCommandBuffer);
+	return VK_SUCCESS;
+}
+
+//Recording is only counted. Command buffer handles aren't looked up, benchmarks record into made up ones.
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline)
+{
+	LAVA_NULL_COMMAND(vkCmdBindPipeline);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer, uint32_t, uint32_t, const VkViewport*)
+{
+	LAVA_NULL_COMMAND(vkCmdSetViewport);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer, uint32_t, uint32_t, const VkRect2D*)
+{
+	LAVA_NULL_COMMAND(vkCmdSetScissor);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, uint32_t, const VkDescriptorSet*,
+	uint32_t, const uint32_t*)
+{
+	LAVA_NULL_COMMAND(vkCmdBindDescriptorSets);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkIndexType)
+{
+	LAVA_NULL_COMMAND(vkCmdBindIndexBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer, uint32_t, uint32_t, const VkBuffer*, const VkDeviceSize*)
+{
+	LAVA_NULL_COMMAND(vkCmdBindVertexBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, uint32_t, uint32_t, const void*)
+{
+	LAVA_NULL_COMMAND(vkCmdPushConstants);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer, uint32_t, uint32_t, uint32_t, int32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdDrawIndexed);
+	stats.draws++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdDrawIndirect);
+	stats.draws++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdDrawIndexedIndirect);
+	stats.draws++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirectCount(VkCommandBuffer, VkBuffer, VkDeviceSize, VkBuffer, VkDeviceSize, uint32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdDrawIndexedIndirectCount);
+	stats.draws++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(VkCommandBuffer, uint32_t, uint32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdDispatch);
+	stats.dispatches++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatchIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize)
+{
+	LAVA_NULL_COMMAND(vkCmdDispatchIndirect);
+	stats.dispatches++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImage(VkCommandBuffer, VkImage, VkImageLayout, VkImage, VkImageLayout, uint32_t, const VkImageCopy*)
+{
+	LAVA_NULL_COMMAND(vkCmdCopyImage);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, uint32_t, const VkBufferImageCopy*)
+{
+	LAVA_NULL_COMMAND(vkCmdCopyBufferToImage);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, uint32_t, const VkBufferImageCopy*)
+{
+	LAVA_NULL_COMMAND(vkCmdCopyImageToBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdFillBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkDeviceSize, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdFillBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags,
+	uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*, uint32_t, const VkImageMemoryBarrier*)
+{
+	LAVA_NULL_COMMAND(vkCmdPipelineBarrier);
+	stats.barriers++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery(VkCommandBuffer, VkQueryPool, uint32_t, VkQueryControlFlags)
+{
+	LAVA_NULL_COMMAND(vkCmdBeginQuery);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndQuery(VkCommandBuffer, VkQueryPool, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdEndQuery);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer, VkQueryPool, uint32_t, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdResetQueryPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer, VkPipelineStageFlagBits, VkQueryPool, uint32_t)
+{
+	LAVA_NULL_COMMAND(vkCmdWriteTimestamp);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents)
+{
+	LAVA_NULL_COMMAND(vkCmdBeginRenderPass);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer)
+{
+	LAVA_NULL_COMMAND(vkCmdEndRenderPass);
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "LavaCore.h"
+
+//Null Vulkan driver: the entry points the renderer, lava_bench and lava_replay call, linked in place of the loader.
+//Objects get unique handles that are never reused, host visible memory is real memory, submits complete at once
+//and every query reads back 0. Nothing is drawn, so a frame costs exactly the engine's own CPU work.
+//Safe to call from several threads like a real driver, as the renderer's startup does.
+struct LavaNullVulkanStats {
+	uint64_t calls; //Every entry point
+	uint64_t commands; //vkCmd*, into any command buffer
+	uint64_t draws; //Direct and indirect calls, not the draws an indirect call expands to
+	uint64_t dispatches;
+	uint64_t barriers; //vkCmdPipelineBarrier calls
+	uint64_t submits; //Command buffers submitted
+	uint64_t createdObjects;
+	uint64_t liveObjects;
+	uint64_t allocatedBytes; //Live device memory
+	uint64_t invalidHandles; //Destroys and waits on handles the device doesn't know, e.g. already destroyed
+};
+
+//Snapshot of the counters, valid until the next call.
+const LavaNullVulkanStats& LavaNullVulkanGetStats();
+//Calls per entry point since startup, most called first, divided by frameCount to report them per frame.
+void LavaNullVulkanPrintCalls(uint64_t frameCount = 1);
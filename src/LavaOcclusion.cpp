@@ -0,0 +1,419 @@
+#include "LavaOcclusion.h"
+#include "LavaJobs.h"
+#include "LavaSimd.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <unordered_map>
+
+static const uint32_t occlusionTileWidth = 32; //Multiple of the 8 pixel row kernel
+static const uint32_t occlusionTileHeight = 16;
+static const uint32_t occlusionBinChunkSize = 4096; //Triangles per binning job
+static const uint32_t occlusionMaxTestTexels = 4; //Box tests pick the pyramid level where the rect is at most this wide
+
+void BuildOccluderLod(const float* positions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	uint32_t gridResolution, std::vector<glm::vec3>& lodPositions, std::vector<uint32_t>& lodIndices)
+{
+	lodPositions.clear();
+	lodIndices.clear();
+	if (vertexCount == 0 || gridResolution == 0)
+		return;
+
+	auto position = [&](uint32_t vertex) {
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + size_t(vertex) * positionStride);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		boundsMin = glm::min(boundsMin, position(i));
+		boundsMax = glm::max(boundsMax, position(i));
+	}
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(FLT_EPSILON));
+
+	//Every vertex lands in a grid cell, the cell becomes one vertex at the average of its members.
+	std::unordered_map<uint32_t, uint32_t> cellClusters;
+	std::vector<uint32_t> vertexClusters(vertexCount);
+	std::vector<uint32_t> clusterSizes;
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		glm::vec3 cell = (position(i) - boundsMin) / extent * float(gridResolution);
+		uint32_t x = std::min(uint32_t(cell.x), gridResolution - 1);
+		uint32_t y = std::min(uint32_t(cell.y), gridResolution - 1);
+		uint32_t z = std::min(uint32_t(cell.z), gridResolution - 1);
+		uint32_t key = x + (y + z * gridResolution) * gridResolution;
+
+		auto inserted = cellClusters.insert(std::make_pair(key, uint32_t(lodPositions.size())));
+		if (inserted.second) {
+			lodPositions.push_back(glm::vec3(0.f));
+			clusterSizes.push_back(0);
+		}
+		uint32_t cluster = inserted.first->second;
+		lodPositions[cluster] += position(i);
+		clusterSizes[cluster]++;
+		vertexClusters[i] = cluster;
+	}
+
+	for (size_t i = 0; i < lodPositions.size(); i++) {
+		lodPositions[i] /= float(clusterSizes[i]);
+	}
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = vertexClusters[indices[i]];
+		uint32_t b = vertexClusters[indices[i + 1]];
+		uint32_t c = vertexClusters[indices[i + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+		lodIndices.push_back(a);
+		lodIndices.push_back(b);
+		lodIndices.push_back(c);
+	}
+}
+
+void LavaOcclusionCuller::Init(uint32_t requestedWidth, uint32_t requestedHeight)
+{
+	tilesX = (requestedWidth + occlusionTileWidth - 1) / occlusionTileWidth;
+	tilesY = (requestedHeight + occlusionTileHeight - 1) / occlusionTileHeight;
+	width = tilesX * occlusionTileWidth;
+	height = tilesY * occlusionTileHeight;
+	depth.assign(width * height, 1.f);
+
+	hiZ.clear();
+	uint32_t levelWidth = width, levelHeight = height;
+	while (levelWidth > 1 || levelHeight > 1) {
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+		hiZ.push_back(std::vector<float>(levelWidth * levelHeight, 1.f));
+	}
+}
+
+void LavaOcclusionCuller::BeginFrame(const glm::mat4& frameViewProjection)
+{
+	viewProjection = frameViewProjection;
+	occluders.clear();
+}
+
+void LavaOcclusionCuller::AddOccluder(const LavaOccluder& occluder)
+{
+	occluders.push_back(occluder);
+}
+
+void LavaOcclusionCuller::SetupTriangles(LavaJobSystem* jobSystem)
+{
+	occluderFirstTriangle.resize(occluders.size());
+	uint32_t triangleCount = 0;
+	for (size_t i = 0; i < occluders.size(); i++) {
+		occluderFirstTriangle[i] = triangleCount;
+		triangleCount += occluders[i].indexCount / 3;
+	}
+	triangles.resize(triangleCount);
+
+	float screenWidth = float(width);
+	float screenHeight = float(height);
+	LavaParallelFor(jobSystem, uint32_t(occluders.size()), 1, [&](uint32_t begin, uint32_t, uint32_t) {
+		const LavaOccluder& occluder = occluders[begin];
+		glm::mat4 clipTransform = viewProjection * occluder.world;
+		Triangle* occluderTriangles = triangles.data() + occluderFirstTriangle[begin];
+
+		for (uint32_t t = 0; t < occluder.indexCount / 3; t++) {
+			Triangle& triangle = occluderTriangles[t];
+			triangle.minX = 1;
+			triangle.maxX = 0;
+
+			glm::vec3 screen[3];
+			bool clipped = false;
+			for (int v = 0; v < 3; v++) {
+				const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(occluder.positions) +
+					size_t(occluder.indices[t * 3 + v]) * occluder.positionStride);
+				glm::vec4 clip = clipTransform * glm::vec4(p[0], p[1], p[2], 1.f);
+
+				//Triangles crossing the near plane are dropped, losing an occluder is always safe.
+				if (clip.w <= FLT_EPSILON || clip.z < 0.f) {
+					clipped = true;
+					break;
+				}
+				float inverseW = 1.f / clip.w;
+				screen[v] = glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * screenWidth, (clip.y * inverseW * 0.5f + 0.5f) * screenHeight, clip.z * inverseW);
+			}
+			if (clipped)
+				continue;
+
+			//Edge i is opposite vertex i.
+			for (int e = 0; e < 3; e++) {
+				const glm::vec3& from = screen[(e + 1) % 3];
+				const glm::vec3& to = screen[(e + 2) % 3];
+				triangle.edgeA[e] = from.y - to.y;
+				triangle.edgeB[e] = to.x - from.x;
+				triangle.edgeC[e] = from.x * to.y - from.y * to.x;
+			}
+
+			float area = triangle.edgeA[0] * screen[0].x + triangle.edgeB[0] * screen[0].y + triangle.edgeC[0];
+			if (area == 0.f)
+				continue;
+			if (area < 0.f) {
+				for (int e = 0; e < 3; e++) {
+					triangle.edgeA[e] = -triangle.edgeA[e];
+					triangle.edgeB[e] = -triangle.edgeB[e];
+					triangle.edgeC[e] = -triangle.edgeC[e];
+				}
+				area = -area;
+			}
+
+			//Depth is linear in screen space, barycentrics are the edge functions over the area.
+			float inverseArea = 1.f / area;
+			triangle.depthA = (triangle.edgeA[0] * screen[0].z + triangle.edgeA[1] * screen[1].z + triangle.edgeA[2] * screen[2].z) * inverseArea;
+			triangle.depthB = (triangle.edgeB[0] * screen[0].z + triangle.edgeB[1] * screen[1].z + triangle.edgeB[2] * screen[2].z) * inverseArea;
+			triangle.depthC = (triangle.edgeC[0] * screen[0].z + triangle.edgeC[1] * screen[1].z + triangle.edgeC[2] * screen[2].z) * inverseArea;
+
+			//Pixel centers are at +0.5
+			float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+			float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+			float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+			float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+			triangle.minX = std::max(int(ceilf(minX - 0.5f)), 0);
+			triangle.maxX = std::min(int(floorf(maxX - 0.5f)), int(width) - 1);
+			triangle.minY = std::max(int(ceilf(minY - 0.5f)), 0);
+			triangle.maxY = std::min(int(floorf(maxY - 0.5f)), int(height) - 1);
+			if (triangle.minY > triangle.maxY)
+				triangle.maxX = triangle.minX - 1;
+		}
+	});
+}
+
+//8 pixels of one row starting at x. Same expressions as the scalar path: A * x + (B * y + C).
+static void RasterizeRow(float* row, int x, const float* edgeA, const float* edgeRow, float depthA, float depthRow)
+{
+#if defined(LAVA_SIMD_AVX2)
+	__m256 pixelX = _mm256_add_ps(_mm256_set1_ps(float(x)), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+	__m256 zero = _mm256_setzero_ps();
+	__m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[0]), pixelX), _mm256_set1_ps(edgeRow[0])), zero, _CMP_GE_OQ);
+	inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[1]), pixelX), _mm256_set1_ps(edgeRow[1])), zero, _CMP_GE_OQ));
+	inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[2]), pixelX), _mm256_set1_ps(edgeRow[2])), zero, _CMP_GE_OQ));
+	if (_mm256_movemask_ps(inside) == 0)
+		return;
+
+	__m256 pixelDepth = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(depthA), pixelX), _mm256_set1_ps(depthRow));
+	__m256 current = _mm256_loadu_ps(row + x);
+	_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, pixelDepth), inside));
+#elif defined(LAVA_SIMD_SSE2)
+	for (int half = 0; half < 8; half += 4) {
+		__m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x + half)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+		__m128 zero = _mm_setzero_ps();
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[0]), pixelX), _mm_set1_ps(edgeRow[0])), zero);
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[1]), pixelX), _mm_set1_ps(edgeRow[1])), zero));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[2]), pixelX), _mm_set1_ps(edgeRow[2])), zero));
+		if (_mm_movemask_ps(inside) == 0)
+			continue;
+
+		__m128 pixelDepth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), pixelX), _mm_set1_ps(depthRow));
+		__m128 current = _mm_loadu_ps(row + x + half);
+		__m128 nearer = _mm_min_ps(current, pixelDepth);
+		_mm_storeu_ps(row + x + half, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+	}
+#else
+	for (int i = 0; i < 8; i++) {
+		float pixelX = float(x + i) + 0.5f;
+		if (edgeA[0] * pixelX + edgeRow[0] >= 0.f && edgeA[1] * pixelX + edgeRow[1] >= 0.f && edgeA[2] * pixelX + edgeRow[2] >= 0.f)
+			row[x + i] = std::min(row[x + i], depthA * pixelX + depthRow);
+	}
+#endif
+}
+
+void LavaOcclusionCuller::RasterizeTile(uint32_t tile)
+{
+	int tileMinX = int((tile % tilesX) * occlusionTileWidth);
+	int tileMinY = int((tile / tilesX) * occlusionTileHeight);
+	int tileMaxX = tileMinX + int(occlusionTileWidth) - 1;
+	int tileMaxY = tileMinY + int(occlusionTileHeight) - 1;
+
+	for (int y = tileMinY; y <= tileMaxY; y++) {
+		std::fill(depth.begin() + y * width + tileMinX, depth.begin() + y * width + tileMaxX + 1, 1.f);
+	}
+
+	uint32_t tileCount = tilesX * tilesY;
+	uint32_t chunkCount = uint32_t(tileBins.size()) / std::max(tileCount, 1u);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+		for (uint32_t triangleIndex : tileBins[chunk * tileCount + tile]) {
+			const Triangle& triangle = triangles[triangleIndex];
+
+			//Pixels outside the triangle bounds but inside the 8 wide run fail the edge tests anyway.
+			int minX = std::max(triangle.minX, tileMinX) & ~7;
+			int maxX = std::min(triangle.maxX, tileMaxX);
+			int minY = std::max(triangle.minY, tileMinY);
+			int maxY = std::min(triangle.maxY, tileMaxY);
+
+			for (int y = minY; y <= maxY; y++) {
+				float pixelY = float(y) + 0.5f;
+				float edgeRow[3];
+				for (int e = 0; e < 3; e++) {
+					edgeRow[e] = triangle.edgeB[e] * pixelY + triangle.edgeC[e];
+				}
+				float depthRow = triangle.depthB * pixelY + triangle.depthC;
+
+				float* row = depth.data() + y * width;
+				for (int x = minX; x <= maxX; x += 8) {
+					RasterizeRow(row, x, triangle.edgeA, edgeRow, triangle.depthA, depthRow);
+				}
+			}
+		}
+	}
+}
+
+void LavaOcclusionCuller::BuildHiZ(LavaJobSystem* jobSystem)
+{
+	const float* source = depth.data();
+	uint32_t sourceWidth = width, sourceHeight = height;
+	for (std::vector<float>& level : hiZ) {
+		uint32_t levelWidth = (sourceWidth + 1) / 2;
+		uint32_t levelHeight = (sourceHeight + 1) / 2;
+		float* destination = level.data();
+
+		LavaParallelFor(levelWidth * levelHeight > 4096 ? jobSystem : nullptr, levelHeight, 16, [&](uint32_t begin, uint32_t end, uint32_t) {
+			for (uint32_t y = begin; y < end; y++) {
+				uint32_t y0 = y * 2, y1 = std::min(y * 2 + 1, sourceHeight - 1);
+				for (uint32_t x = 0; x < levelWidth; x++) {
+					uint32_t x0 = x * 2, x1 = std::min(x * 2 + 1, sourceWidth - 1);
+					destination[y * levelWidth + x] = std::max(std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+						std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+				}
+			}
+		});
+
+		source = destination;
+		sourceWidth = levelWidth;
+		sourceHeight = levelHeight;
+	}
+}
+
+void LavaOcclusionCuller::Rasterize(LavaJobSystem* jobSystem)
+{
+	SetupTriangles(jobSystem);
+
+	//Bin triangles to the tiles they touch, one bin list per chunk so binning needs no locks.
+	uint32_t tileCount = tilesX * tilesY;
+	uint32_t triangleCount = uint32_t(triangles.size());
+	uint32_t chunkCount = (triangleCount + occlusionBinChunkSize - 1) / occlusionBinChunkSize;
+	tileBins.resize(size_t(chunkCount) * tileCount);
+
+	LavaParallelFor(jobSystem, triangleCount, occlusionBinChunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+		std::vector<uint32_t>* bins = tileBins.data() + size_t(chunk) * tileCount;
+		for (uint32_t tile = 0; tile < tileCount; tile++) {
+			bins[tile].clear();
+		}
+
+		for (uint32_t i = begin; i < end; i++) {
+			const Triangle& triangle = triangles[i];
+			if (triangle.minX > triangle.maxX)
+				continue;
+
+			uint32_t tileMinX = uint32_t(triangle.minX) / occlusionTileWidth, tileMaxX = uint32_t(triangle.maxX) / occlusionTileWidth;
+			uint32_t tileMinY = uint32_t(triangle.minY) / occlusionTileHeight, tileMaxY = uint32_t(triangle.maxY) / occlusionTileHeight;
+			for (uint32_t tileY = tileMinY; tileY <= tileMaxY; tileY++) {
+				for (uint32_t tileX = tileMinX; tileX <= tileMaxX; tileX++) {
+					bins[tileY * tilesX + tileX].push_back(i);
+				}
+			}
+		}
+	});
+
+	LavaParallelFor(jobSystem, tileCount, 1, [&](uint32_t begin, uint32_t, uint32_t) {
+		RasterizeTile(begin);
+	});
+
+	BuildHiZ(jobSystem);
+}
+
+void LavaOcclusionCuller::RasterizeReference()
+{
+	SetupTriangles(nullptr);
+	std::fill(depth.begin(), depth.end(), 1.f);
+
+	for (const Triangle& triangle : triangles) {
+		for (int y = triangle.minY; y <= triangle.maxY; y++) {
+			float pixelY = float(y) + 0.5f;
+			for (int x = triangle.minX; x <= triangle.maxX; x++) {
+				float pixelX = float(x) + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++) {
+					inside = inside && triangle.edgeA[e] * pixelX + (triangle.edgeB[e] * pixelY + triangle.edgeC[e]) >= 0.f;
+				}
+				if (!inside)
+					continue;
+
+				float& pixel = depth[y * width + x];
+				pixel = std::min(pixel, triangle.depthA * pixelX + (triangle.depthB * pixelY + triangle.depthC));
+			}
+		}
+	}
+
+	BuildHiZ(nullptr);
+}
+
+bool LavaOcclusionCuller::IsVisible(const LavaAabb& bounds) const
+{
+	glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	float nearestDepth = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 position((corner & 1) ? bounds.max.x : bounds.min.x, (corner & 2) ? bounds.max.y : bounds.min.y, (corner & 4) ? bounds.max.z : bounds.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(position, 1.f);
+
+		//Touching the near plane, can't say anything about it.
+		if (clip.w <= FLT_EPSILON || clip.z < 0.f)
+			return true;
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		screenMin = glm::min(screenMin, glm::vec2(ndc));
+		screenMax = glm::max(screenMax, glm::vec2(ndc));
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	float minX = (screenMin.x * 0.5f + 0.5f) * float(width);
+	float maxX = (screenMax.x * 0.5f + 0.5f) * float(width);
+	float minY = (screenMin.y * 0.5f + 0.5f) * float(height);
+	float maxY = (screenMax.y * 0.5f + 0.5f) * float(height);
+	if (maxX < 0.f || maxY < 0.f || minX >= float(width) || minY >= float(height))
+		return false;
+
+	int pixelMinX = std::max(int(minX), 0), pixelMaxX = std::min(int(maxX), int(width) - 1);
+	int pixelMinY = std::max(int(minY), 0), pixelMaxY = std::min(int(maxY), int(height) - 1);
+
+	//Coarsest level where the rect still spans only a few texels. Level -1 is the full resolution buffer.
+	int level = -1;
+	while (level + 1 < int(hiZ.size()) &&
+		std::max((pixelMaxX >> (level + 1)) - (pixelMinX >> (level + 1)), (pixelMaxY >> (level + 1)) - (pixelMinY >> (level + 1))) >= int(occlusionMaxTestTexels)) {
+		level++;
+	}
+
+	const float* texels = level < 0 ? depth.data() : hiZ[level].data();
+	int levelWidth = level < 0 ? int(width) : int(width + (1u << (level + 1)) - 1) >> (level + 1);
+	for (int y = pixelMinY >> (level + 1); y <= pixelMaxY >> (level + 1); y++) {
+		for (int x = pixelMinX >> (level + 1); x <= pixelMaxX >> (level + 1); x++) {
+			if (texels[y * levelWidth + x] >= nearestDepth)
+				return true;
+		}
+	}
+	return false;
+}
+
+void LavaOcclusionCuller::TestVisibility(const LavaAabb* bounds, uint32_t count, uint8_t* visible, LavaJobSystem* jobSystem) const
+{
+	LavaParallelFor(jobSystem, count, 256, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			visible[i] = IsVisible(bounds[i]) ? 1 : 0;
+		}
+	});
+}
+
+LavaOcclusionDiff LavaOcclusionCuller::CompareDepth(const LavaOcclusionCuller& first, const LavaOcclusionCuller& second, float tolerance)
+{
+	assert(first.width == second.width && first.height == second.height);
+
+	LavaOcclusionDiff diff = {};
+	for (size_t i = 0; i < first.depth.size(); i++) {
+		float difference = fabsf(first.depth[i] - second.depth[i]);
+		diff.maxDifference = std::max(diff.maxDifference, difference);
+		if (difference > tolerance)
+			diff.mismatchedPixels++;
+	}
+	return diff;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaBvh.h"
+
+#include <vector>
+
+class LavaJobSystem;
+
+//Triangle mesh drawn into the occlusion buffer. Positions are read with a stride so Mesh vertices can be used directly.
+struct LavaOccluder {
+	const float* positions;
+	uint32_t positionStride; //Bytes between positions
+	const uint32_t* indices;
+	uint32_t indexCount;
+	glm::mat4 world;
+};
+
+struct LavaOcclusionDiff {
+	uint32_t mismatchedPixels;
+	float maxDifference;
+};
+
+//Coarse occluder LOD by vertex clustering on a grid over the mesh bounds, degenerate triangles are dropped.
+//Cluster positions are averages, so the LOD stays inside the bounds of the source mesh.
+void BuildOccluderLod(const float* positions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	uint32_t gridResolution, std::vector<glm::vec3>& lodPositions, std::vector<uint32_t>& lodIndices);
+
+//CPU software occlusion culling. Occluders are rasterized into a low resolution depth buffer in screen tiles,
+//one tile per job with AVX2/SSE2 row kernels, then a max depth pyramid is built for conservative box tests.
+//Depth follows Vulkan clip space: 0 near, 1 far, cleared to 1.
+class LavaOcclusionCuller {
+public:
+	void Init(uint32_t width, uint32_t height); //Width and height get rounded up to whole tiles
+
+	void BeginFrame(const glm::mat4& viewProjection);
+	void AddOccluder(const LavaOccluder& occluder); //Data has to stay alive until Rasterize
+	void Rasterize(LavaJobSystem* jobSystem);
+	void RasterizeReference(); //Scalar whole screen rasterizer over the same occluders, for validation
+
+	//False only when the box is fully behind occluder depth.
+	bool IsVisible(const LavaAabb& bounds) const;
+	void TestVisibility(const LavaAabb* bounds, uint32_t count, uint8_t* visible, LavaJobSystem* jobSystem) const;
+
+	static LavaOcclusionDiff CompareDepth(const LavaOcclusionCuller& first, const LavaOcclusionCuller& second, float tolerance);
+
+	const float* GetDepth() const { return depth.data(); }
+	uint32_t GetWidth() const { return width; }
+	uint32_t GetHeight() const { return height; }
+	uint32_t GetTriangleCount() const { return uint32_t(triangles.size()); }
+
+private:
+	//Edge functions and depth plane in screen space, inside when all edges are >= 0.
+	struct Triangle {
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA, depthB, depthC;
+		int minX, minY, maxX, maxY; //Inclusive pixel bounds, empty when minX > maxX
+	};
+
+	void SetupTriangles(LavaJobSystem* jobSystem);
+	void RasterizeTile(uint32_t tile);
+	void BuildHiZ(LavaJobSystem* jobSystem);
+
+private:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tilesX = 0;
+	uint32_t tilesY = 0;
+	glm::mat4 viewProjection = glm::mat4(1.f);
+
+	std::vector<LavaOccluder> occluders;
+	std::vector<uint32_t> occluderFirstTriangle;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> tileBins; //Per binning chunk and tile, triangle indices
+
+	std::vector<float> depth;
+	std::vector<std::vector<float>> hiZ; //Level 0 is half resolution, each texel is the max of the 2x2 below
+};
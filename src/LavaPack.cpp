@@ -0,0 +1,288 @@
+#include "LavaPack.h"
+#include "LavaLz4.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t LavaPackHash(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t LavaPackHashName(const char* name)
+{
+	return LavaPackHash(name, strlen(name));
+}
+
+static uint64_t AlignPack(uint64_t offset)
+{
+	return (offset + LAVA_PACK_ALIGNMENT - 1) & ~uint64_t(LAVA_PACK_ALIGNMENT - 1);
+}
+
+LavaPack::~LavaPack()
+{
+	Close();
+}
+
+bool LavaPack::Map(const char* path)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		return false;
+	}
+	mappingHandle = mapping;
+	mappingSize = size_t(fileSize.QuadPart);
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+		close(file);
+		return false;
+	}
+	void* view = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+	mappingSize = size_t(fileStat.st_size);
+#endif
+	data = static_cast<const uint8_t*>(view);
+	return true;
+}
+
+//Every offset is checked once here, lookups trust the index afterwards.
+bool LavaPack::Open(const char* path)
+{
+	Close();
+	if (!Map(path))
+		return false;
+
+	const LavaPackHeader* packHeader = reinterpret_cast<const LavaPackHeader*>(data);
+	bool valid = mappingSize >= sizeof(LavaPackHeader) && packHeader->magic == LAVA_PACK_MAGIC && packHeader->version == LAVA_PACK_VERSION &&
+		packHeader->fileSize == mappingSize && packHeader->slotCount && (packHeader->slotCount & (packHeader->slotCount - 1)) == 0 &&
+		packHeader->entryCount < packHeader->slotCount && packHeader->indexOffset % LAVA_PACK_ALIGNMENT == 0 &&
+		packHeader->indexOffset <= mappingSize && (mappingSize - packHeader->indexOffset) / sizeof(LavaPackEntry) >= packHeader->slotCount;
+
+	uint32_t entryCount = 0;
+	const LavaPackEntry* packSlots = valid ? reinterpret_cast<const LavaPackEntry*>(data + packHeader->indexOffset) : nullptr;
+	for (uint32_t i = 0; valid && i < packHeader->slotCount; i++) {
+		const LavaPackEntry& entry = packSlots[i];
+		if (!entry.nameLength)
+			continue;
+		entryCount++;
+		uint64_t namesSize = mappingSize - packHeader->indexOffset;
+		valid = entry.offset % LAVA_PACK_ALIGNMENT == 0 && entry.offset <= packHeader->indexOffset && entry.storedSize <= packHeader->indexOffset - entry.offset &&
+			entry.nameOffset <= namesSize && entry.nameLength <= namesSize - entry.nameOffset &&
+			(entry.compression == LAVA_PACK_STORED ? entry.storedSize == entry.size : entry.compression == LAVA_PACK_LZ4);
+	}
+	if (!valid || entryCount != packHeader->entryCount) {
+		fprintf(stderr, "%s is not a valid pack\n", path);
+		Close();
+		return false;
+	}
+
+	header = packHeader;
+	slots = packSlots;
+	return true;
+}
+
+void LavaPack::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(expandMutex);
+		expanded.clear();
+	}
+	if (data) {
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(data), mappingSize);
+#endif
+	}
+	header = nullptr;
+	data = nullptr;
+	slots = nullptr;
+	mappingSize = 0;
+}
+
+const LavaPackEntry* LavaPack::FindEntry(const char* name) const
+{
+	if (!header)
+		return nullptr;
+	size_t nameLength = strlen(name);
+	uint64_t nameHash = LavaPackHash(name, nameLength);
+	const char* names = reinterpret_cast<const char*>(data + header->indexOffset);
+	uint32_t mask = header->slotCount - 1;
+	for (uint32_t slot = uint32_t(nameHash) & mask;; slot = (slot + 1) & mask) {
+		const LavaPackEntry& entry = slots[slot];
+		if (!entry.nameLength)
+			return nullptr;
+		if (entry.nameHash == nameHash && entry.nameLength == nameLength && memcmp(names + entry.nameOffset, name, nameLength) == 0)
+			return &entry;
+	}
+}
+
+const void* LavaPack::Find(const char* name, size_t* size) const
+{
+	const LavaPackEntry* entry = FindEntry(name);
+	if (!entry)
+		return nullptr;
+	if (size)
+		*size = size_t(entry->size);
+	if (entry->compression == LAVA_PACK_STORED)
+		return data + entry->offset;
+
+	std::lock_guard<std::mutex> lock(expandMutex);
+	for (const auto& blob : expanded) {
+		if (blob.first == entry)
+			return blob.second.get();
+	}
+	std::unique_ptr<uint8_t[]> bytes(new uint8_t[size_t(entry->size) + 1]);
+	if (!LavaLz4Decompress(data + entry->offset, size_t(entry->storedSize), bytes.get(), size_t(entry->size)) ||
+		LavaPackHash(bytes.get(), size_t(entry->size)) != entry->contentHash) {
+		fprintf(stderr, "Pack entry %s is corrupt\n", name);
+		return nullptr;
+	}
+	expanded.emplace_back(entry, std::move(bytes));
+	return expanded.back().second.get();
+}
+
+bool LavaPack::Read(const char* name, std::vector<uint8_t>& bytes) const
+{
+	const LavaPackEntry* entry = FindEntry(name);
+	if (!entry)
+		return false;
+	const uint8_t* stored = data + entry->offset;
+	if (entry->compression == LAVA_PACK_STORED) {
+		bytes.assign(stored, stored + entry->size);
+		return true;
+	}
+	bytes.resize(size_t(entry->size));
+	if (!LavaLz4Decompress(stored, size_t(entry->storedSize), bytes.data(), bytes.size()) || LavaPackHash(bytes.data(), bytes.size()) != entry->contentHash) {
+		fprintf(stderr, "Pack entry %s is corrupt\n", name);
+		bytes.clear();
+		return false;
+	}
+	return true;
+}
+
+std::vector<const LavaPackEntry*> LavaPack::GetEntries() const
+{
+	std::vector<const LavaPackEntry*> entries;
+	for (uint32_t i = 0; header && i < header->slotCount; i++) {
+		if (slots[i].nameLength)
+			entries.push_back(&slots[i]);
+	}
+	return entries;
+}
+
+std::string LavaPack::GetName(const LavaPackEntry& entry) const
+{
+	return std::string(reinterpret_cast<const char*>(data + header->indexOffset + entry.nameOffset), entry.nameLength);
+}
+
+void LavaPackWriter::Add(const std::string& name, const void* data, size_t size, bool compress)
+{
+	Blob blob;
+	blob.name = name;
+	blob.size = size;
+	blob.contentHash = LavaPackHash(data, size);
+	blob.compression = LAVA_PACK_STORED;
+	if (compress) {
+		blob.stored.resize(LavaLz4CompressBound(size));
+		size_t compressedSize = LavaLz4Compress(static_cast<const uint8_t*>(data), size, blob.stored.data(), blob.stored.size());
+		if (compressedSize && compressedSize <= size - size / 8) {
+			blob.stored.resize(compressedSize);
+			blob.compression = LAVA_PACK_LZ4;
+		}
+	}
+	if (blob.compression == LAVA_PACK_STORED)
+		blob.stored.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	blobs.push_back(std::move(blob));
+}
+
+bool LavaPackWriter::Write(const char* path) const
+{
+	uint32_t slotCount = 2;
+	while (slotCount < blobs.size() * 2)
+		slotCount *= 2;
+
+	std::vector<uint8_t> file(sizeof(LavaPackHeader));
+	std::vector<LavaPackEntry> entries(slotCount, LavaPackEntry{});
+	std::string names;
+	for (const Blob& blob : blobs) {
+		uint64_t nameHash = LavaPackHashName(blob.name.c_str());
+		uint32_t slot = uint32_t(nameHash) & (slotCount - 1);
+		for (; entries[slot].nameLength; slot = (slot + 1) & (slotCount - 1)) {
+			if (entries[slot].nameHash == nameHash && names.compare(entries[slot].nameOffset, entries[slot].nameLength, blob.name) == 0) {
+				fprintf(stderr, "%s added to the pack twice\n", blob.name.c_str());
+				return false;
+			}
+		}
+
+		LavaPackEntry& entry = entries[slot];
+		entry.nameHash = nameHash;
+		entry.contentHash = blob.contentHash;
+		entry.offset = AlignPack(file.size());
+		entry.size = blob.size;
+		entry.storedSize = blob.stored.size();
+		entry.nameOffset = uint32_t(slotCount * sizeof(LavaPackEntry) + names.size());
+		entry.nameLength = uint32_t(blob.name.size());
+		entry.compression = blob.compression;
+		names += blob.name;
+
+		file.resize(size_t(entry.offset));
+		file.insert(file.end(), blob.stored.begin(), blob.stored.end());
+	}
+
+	LavaPackHeader header = {};
+	header.magic = LAVA_PACK_MAGIC;
+	header.version = LAVA_PACK_VERSION;
+	header.entryCount = uint32_t(blobs.size());
+	header.slotCount = slotCount;
+	header.indexOffset = AlignPack(file.size());
+	header.fileSize = header.indexOffset + slotCount * sizeof(LavaPackEntry) + names.size();
+	file.resize(size_t(header.indexOffset));
+	file.insert(file.end(), reinterpret_cast<const uint8_t*>(entries.data()), reinterpret_cast<const uint8_t*>(entries.data() + slotCount));
+	file.insert(file.end(), names.begin(), names.end());
+	memcpy(file.data(), &header, sizeof(header));
+
+	FILE* output = fopen(path, "wb");
+	if (!output)
+		return false;
+	bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+	return fclose(output) == 0 && written;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Read only archive of named blobs that is mapped whole. The index is an open addressed hash table of the names,
+//so a lookup touches an entry or two and never the file system. Blobs are 16 byte aligned in the file, stored ones
+//are used straight from the mapping (SPIR-V needs no copy to become a shader module). LZ4 compressed ones are
+//expanded once, on first use.
+//Layout: LavaPackHeader, the blobs, then slotCount LavaPackEntry slots and the names they point at.
+const uint32_t LAVA_PACK_MAGIC = 0x4b50414c; //"LAPK"
+const uint32_t LAVA_PACK_VERSION = 1;
+const uint32_t LAVA_PACK_ALIGNMENT = 16;
+
+enum LavaPackCompression : uint32_t {
+	LAVA_PACK_STORED,
+	LAVA_PACK_LZ4,
+};
+
+struct LavaPackHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t slotCount; //Power of two, at most half full
+	uint64_t indexOffset;
+	uint64_t fileSize;
+};
+
+struct LavaPackEntry {
+	uint64_t nameHash; //LavaPackHashName
+	uint64_t contentHash; //FNV-1a of the uncompressed bytes
+	uint64_t offset;
+	uint64_t size; //Uncompressed
+	uint64_t storedSize; //Bytes in the file
+	uint32_t nameOffset; //From indexOffset
+	uint32_t nameLength; //0 for an empty slot
+	uint32_t compression; //LavaPackCompression
+	uint32_t padding;
+};
+
+uint64_t LavaPackHash(const void* data, size_t size);
+uint64_t LavaPackHashName(const char* name);
+
+class LavaPack {
+public:
+	~LavaPack();
+
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return header != nullptr; }
+
+	//Null when the name isn't in the pack or a compressed entry doesn't expand. Valid until Close, thread safe.
+	const void* Find(const char* name, size_t* size) const;
+	bool Contains(const char* name) const { return FindEntry(name) != nullptr; }
+	//Copies or expands the entry into data, compressed entries skip the expanded cache Find keeps.
+	bool Read(const char* name, std::vector<uint8_t>& data) const;
+
+	uint32_t GetEntryCount() const { return header ? header->entryCount : 0; }
+	//Entries in slot order, for listing, empty slots skipped.
+	std::vector<const LavaPackEntry*> GetEntries() const;
+	std::string GetName(const LavaPackEntry& entry) const;
+
+private:
+	const LavaPackEntry* FindEntry(const char* name) const;
+	bool Map(const char* path);
+
+private:
+	const LavaPackHeader* header = nullptr;
+	const uint8_t* data = nullptr;
+	size_t mappingSize = 0;
+	void* mappingHandle = nullptr; //Windows file mapping
+	const LavaPackEntry* slots = nullptr;
+
+	mutable std::mutex expandMutex;
+	mutable std::vector<std::pair<const LavaPackEntry*, std::unique_ptr<uint8_t[]>>> expanded;
+};
+
+//Collects blobs and writes a pack. Compression is kept per entry only where it saves at least an eighth.
+class LavaPackWriter {
+public:
+	void Add(const std::string& name, const void* data, size_t size, bool compress);
+	bool Write(const char* path) const;
+
+private:
+	struct Blob {
+		std::string name;
+		std::vector<uint8_t> stored;
+		uint64_t size;
+		uint64_t contentHash;
+		LavaPackCompression compression;
+	};
+	std::vector<Blob> blobs;
+};
@@ -0,0 +1,145 @@
+#include "LavaParticles.h"
+
+#include <math.h>
+#include <algorithm>
+
+uint32_t LavaParticleHash(uint32_t value)
+{
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+//24 bits, exactly representable, so CPU and GPU get the same float.
+static float HashToUnit(uint32_t hash)
+{
+	return float(hash >> 8) * (1.f / 16777216.f);
+}
+
+float LavaParticleLifetime(const LavaParticleConstants& constants, uint32_t seed)
+{
+	uint32_t hash = LavaParticleHash(LavaParticleHash(LavaParticleHash(LavaParticleHash(seed))));
+	return constants.minLifetime + (constants.maxLifetime - constants.minLifetime) * HashToUnit(hash);
+}
+
+//Straight up out of the emitter with a random sideways push, no trig so both sides round the same way.
+LavaParticle LavaEmitParticle(const LavaParticleConstants& constants, uint32_t seed)
+{
+	uint32_t hash0 = LavaParticleHash(seed);
+	uint32_t hash1 = LavaParticleHash(hash0);
+	uint32_t hash2 = LavaParticleHash(hash1);
+	float speed = constants.emitterSpeed * (0.75f + 0.5f * HashToUnit(hash2));
+
+	LavaParticle particle;
+	particle.position = glm::vec3(constants.emitterX, constants.emitterY, constants.emitterZ);
+	particle.age = 0.f;
+	particle.velocity = glm::vec3((2.f * HashToUnit(hash0) - 1.f) * constants.emitterSpread, 1.f,
+		(2.f * HashToUnit(hash1) - 1.f) * constants.emitterSpread) * speed;
+	particle.seed = seed;
+	return particle;
+}
+
+bool LavaSimulateParticle(const LavaParticleConstants& constants, float deltaTime, LavaParticle& particle)
+{
+	particle.velocity.y += constants.gravity * deltaTime;
+	particle.position += particle.velocity * deltaTime;
+	//Bounce off the floor, losing half the speed and some of the slide.
+	if (particle.position.y < constants.floorHeight) {
+		particle.position.y = constants.floorHeight;
+		particle.velocity.y = -0.5f * particle.velocity.y;
+		particle.velocity.x *= 0.8f;
+		particle.velocity.z *= 0.8f;
+	}
+	particle.age += deltaTime;
+	return particle.age < LavaParticleLifetime(constants, particle.seed);
+}
+
+void LavaParticleReference::Init(uint32_t particleCapacity)
+{
+	capacity = particleCapacity;
+	emittedCount = 0;
+	particles.clear();
+	particles.reserve(capacity);
+}
+
+void LavaParticleReference::Step(const LavaParticleConstants& constants, const LavaParticleStep& step)
+{
+	//Begin pass: the request clamped to the free slots. Emitted particles are simulated in the same frame.
+	uint32_t emitCount = std::min(step.emitRequest, capacity - uint32_t(particles.size()));
+	for (uint32_t i = 0; i < emitCount; i++) {
+		particles.push_back(LavaEmitParticle(constants, emittedCount + i));
+	}
+	emittedCount += emitCount;
+
+	size_t keptCount = 0;
+	for (LavaParticle& particle : particles) {
+		if (LavaSimulateParticle(constants, step.deltaTime, particle))
+			particles[keptCount++] = particle;
+	}
+	particles.resize(keptCount);
+}
+
+static void GatherBySeed(const LavaParticle* particles, const uint32_t* aliveIndices, uint32_t aliveCount, std::vector<LavaParticle>& sorted)
+{
+	sorted.resize(aliveCount);
+	for (uint32_t i = 0; i < aliveCount; i++) {
+		sorted[i] = particles[aliveIndices[i]];
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const LavaParticle& a, const LavaParticle& b) { return a.seed < b.seed; });
+}
+
+void LavaParticleReference::Sync(const LavaParticle* gpuParticles, const uint32_t* aliveIndices, uint32_t aliveCount)
+{
+	GatherBySeed(gpuParticles, aliveIndices, aliveCount, sorted);
+	size_t g = 0;
+	for (LavaParticle& particle : particles) {
+		while (g < sorted.size() && sorted[g].seed < particle.seed)
+			g++;
+		if (g < sorted.size() && sorted[g].seed == particle.seed)
+			particle = sorted[g];
+	}
+}
+
+LavaParticleValidation LavaValidateParticles(const LavaParticleReference& reference, const LavaParticleConstants& constants,
+	const LavaParticleStep& step, const LavaParticleCounters& counters, const LavaParticle* particles, const uint32_t* aliveIndices, float positionTolerance)
+{
+	LavaParticleValidation validation = {};
+	validation.gpuAlive = counters.draw.instanceCount;
+	validation.referenceAlive = uint32_t(reference.GetParticles().size());
+	validation.countersValid = validation.gpuAlive <= constants.capacity && counters.deadCount + validation.gpuAlive == constants.capacity &&
+		counters.emittedCount == reference.GetEmittedCount();
+	if (validation.gpuAlive > constants.capacity) {
+		validation.mismatches = validation.gpuAlive;
+		return validation;
+	}
+
+	std::vector<LavaParticle> gpuSorted;
+	GatherBySeed(particles, aliveIndices, validation.gpuAlive, gpuSorted);
+
+	//Lifetimes may round differently on the GPU, a particle ending within that may die a frame apart.
+	auto isBorderline = [&](const LavaParticle& particle) {
+		float lifetime = LavaParticleLifetime(constants, particle.seed);
+		return fabsf(particle.age - lifetime) <= 1e-5f * lifetime + 1e-3f * step.deltaTime;
+	};
+
+	const std::vector<LavaParticle>& expected = reference.GetParticles();
+	size_t g = 0, r = 0;
+	while (g < gpuSorted.size() || r < expected.size()) {
+		if (r == expected.size() || (g < gpuSorted.size() && gpuSorted[g].seed < expected[r].seed)) {
+			validation.mismatches += isBorderline(gpuSorted[g]) ? 0 : 1;
+			g++;
+		}
+		else if (g == gpuSorted.size() || expected[r].seed < gpuSorted[g].seed) {
+			validation.mismatches += isBorderline(expected[r]) ? 0 : 1;
+			r++;
+		}
+		else {
+			bool matches = glm::length(gpuSorted[g].position - expected[r].position) <= positionTolerance &&
+				fabsf(gpuSorted[g].age - expected[r].age) <= 1e-3f * step.deltaTime;
+			validation.mismatches += matches ? 0 : 1;
+			g++;
+			r++;
+		}
+	}
+	return validation;
+}
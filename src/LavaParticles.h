@@ -0,0 +1,109 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <vector>
+
+//GPU layouts below mirror the structs in the particle shaders, std430.
+//Everything a particle does follows from its seed, the emission serial, so the CPU reference can replay it
+//no matter which pool slot or alive list position the GPU atomics gave it.
+struct LavaParticle {
+	glm::vec3 position;
+	float age; //Seconds since emission
+	glm::vec3 velocity;
+	uint32_t seed;
+};
+
+//Same layout as VkDrawIndirectCommand
+struct LavaParticleDraw {
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+};
+
+//Same layout as VkDispatchIndirectCommand
+struct LavaParticleDispatch {
+	uint32_t x;
+	uint32_t y;
+	uint32_t z;
+};
+
+//Only ever touched by the particle passes. Simulate appending survivors counts them in the draw's instance count,
+//so the draw arguments are written directly and always sit at the same offset.
+struct LavaParticleCounters {
+	LavaParticleDraw draw;
+	LavaParticleDispatch emitDispatch;
+	LavaParticleDispatch simulateDispatch;
+	uint32_t aliveCount; //Of the list simulated this frame, last frame's survivors plus the emitted particles
+	uint32_t deadCount;
+	uint32_t emitCount; //Of this frame, the request clamped to the dead list
+	uint32_t emittedCount; //Over all frames, the seed of the next particle
+};
+
+//What changes every frame. Lives in a buffer rewritten per frame, so recorded command buffers stay valid.
+struct LavaParticleStep {
+	uint32_t emitRequest;
+	uint32_t current; //Alive list emitted into and simulated this frame, survivors go to the other one
+	float deltaTime;
+	uint32_t padding;
+};
+
+//Pushed to every particle pass and the draw, fixed once created.
+struct LavaParticleConstants {
+	uint32_t particleBuffer;
+	uint32_t deadBuffer;
+	uint32_t aliveBuffer; //Both alive lists, list i starts at i * capacity
+	uint32_t counterBuffer;
+	uint32_t stepBuffer;
+	uint32_t frameBuffer;
+	uint32_t capacity;
+	uint32_t padding;
+	float emitterX, emitterY, emitterZ;
+	float emitterSpeed;
+	float emitterSpread; //Sideways speed as a fraction of the upwards one
+	float gravity;
+	float floorHeight;
+	float minLifetime;
+	float maxLifetime;
+	float quadScaleX, quadScaleY; //Clip space half size of a particle at distance 1, the size times the projection scale
+};
+
+//PCG hash, bit for bit the same as in the shaders.
+uint32_t LavaParticleHash(uint32_t value);
+float LavaParticleLifetime(const LavaParticleConstants& constants, uint32_t seed);
+LavaParticle LavaEmitParticle(const LavaParticleConstants& constants, uint32_t seed);
+//One step of particle_simulate.comp, false once the particle is past its lifetime.
+bool LavaSimulateParticle(const LavaParticleConstants& constants, float deltaTime, LavaParticle& particle);
+
+//Scalar reference of the begin, emit and simulate passes, used to validate the GPU results. The alive
+//particles are kept in seed order.
+class LavaParticleReference {
+public:
+	void Init(uint32_t capacity);
+	void Step(const LavaParticleConstants& constants, const LavaParticleStep& step);
+	//Takes over the GPU's state of the particles both sides have, so float differences don't pile up over
+	//the frames. Which particles are alive stays the reference's own.
+	void Sync(const LavaParticle* particles, const uint32_t* aliveIndices, uint32_t aliveCount);
+
+	const std::vector<LavaParticle>& GetParticles() const { return particles; }
+	uint32_t GetEmittedCount() const { return emittedCount; }
+
+private:
+	std::vector<LavaParticle> particles;
+	std::vector<LavaParticle> sorted; //Sync scratch
+	uint32_t capacity = 0;
+	uint32_t emittedCount = 0;
+};
+
+struct LavaParticleValidation {
+	uint32_t gpuAlive;
+	uint32_t referenceAlive;
+	uint32_t mismatches; //Particles only one side has, or whose state is off
+	bool countersValid; //Dead and alive counts add up to the capacity, the serial matches
+};
+
+//GPU state after simulate against the reference stepped the same way. aliveIndices is the list simulate compacted
+//into, step.current ^ 1. Positions may differ by positionTolerance, particles right at the end of their lifetime
+//may be alive on one side only.
+LavaParticleValidation LavaValidateParticles(const LavaParticleReference& reference, const LavaParticleConstants& constants,
+	const LavaParticleStep& step, const LavaParticleCounters& counters, const LavaParticle* particles, const uint32_t* aliveIndices, float positionTolerance);
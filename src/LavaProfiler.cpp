@@ -0,0 +1,241 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "LavaProfiler.h"
+#include "LavaCore.h"
+
+#if LAVA_PROFILER
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+//Events per thread and capture: chunks are allocated on first use and kept for later captures.
+static const uint32_t profileChunkSize = 4096;
+static const uint32_t profileMaxChunks = 256;
+
+struct ProfileEvent {
+	const char* name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+//Only the owning thread writes. count publishes the written events with release, a reader that loads it with
+//acquire can read everything below it while the owner keeps appending.
+struct ProfileThread {
+	std::atomic<uint32_t> count{ 0 };
+	std::atomic<uint32_t> generation{ 0 }; //Capture the events belong to, the owner resets count when it changes
+	std::atomic<ProfileEvent*> chunks[profileMaxChunks];
+	std::atomic<uint32_t> dropped{ 0 };
+	uint32_t threadId = 0;
+	std::string name; //Under threadsMutex
+
+	ProfileThread()
+	{
+		for (std::atomic<ProfileEvent*>& chunk : chunks) {
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~ProfileThread()
+	{
+		for (std::atomic<ProfileEvent*>& chunk : chunks) {
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+};
+
+std::atomic<bool> lavaProfilerCapturing{ false };
+
+static std::atomic<uint32_t> captureGeneration{ 0 };
+static std::mutex threadsMutex;
+static std::vector<std::unique_ptr<ProfileThread>> threads; //Never shrinks, buffers of exited threads stay readable
+static thread_local ProfileThread* currentThread = nullptr;
+
+//GPU events arrive from the thread that reads the queries back, a plain locked list is enough.
+static std::mutex gpuMutex;
+static std::vector<ProfileEvent> gpuEvents;
+
+static uint64_t captureBeginTicks = 0;
+static std::chrono::steady_clock::time_point captureBeginTime;
+static double nanosecondsPerTick = 0.0;
+
+static ProfileThread* GetThread()
+{
+	if (currentThread)
+		return currentThread;
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	threads.emplace_back(new ProfileThread());
+	currentThread = threads.back().get();
+	currentThread->threadId = uint32_t(threads.size());
+	currentThread->name = "Thread " + std::to_string(currentThread->threadId);
+	return currentThread;
+}
+
+//Ticks against the steady clock over a short spin, refined by the length of every capture.
+static void CalibrateTicks()
+{
+	std::chrono::steady_clock::time_point beginTime = std::chrono::steady_clock::now();
+	uint64_t beginTicks = LavaProfilerTicks();
+	std::chrono::steady_clock::time_point endTime;
+	do {
+		endTime = std::chrono::steady_clock::now();
+	} while (endTime - beginTime < std::chrono::milliseconds(5));
+	uint64_t endTicks = LavaProfilerTicks();
+	nanosecondsPerTick = double(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - beginTime).count()) / double(endTicks - beginTicks);
+}
+
+void LavaProfilerBeginCapture()
+{
+	if (nanosecondsPerTick == 0.0)
+		CalibrateTicks();
+
+	{
+		std::lock_guard<std::mutex> lock(gpuMutex);
+		gpuEvents.clear();
+	}
+	captureGeneration.fetch_add(1, std::memory_order_release);
+	captureBeginTime = std::chrono::steady_clock::now();
+	captureBeginTicks = LavaProfilerTicks();
+	lavaProfilerCapturing.store(true, std::memory_order_release);
+}
+
+void LavaProfilerEndCapture()
+{
+	lavaProfilerCapturing.store(false, std::memory_order_release);
+
+	uint64_t endTicks = LavaProfilerTicks();
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - captureBeginTime).count();
+	if (elapsed > 100000000 && endTicks > captureBeginTicks)
+		nanosecondsPerTick = double(elapsed) / double(endTicks - captureBeginTicks);
+}
+
+double LavaProfilerNanosecondsPerTick()
+{
+	if (nanosecondsPerTick == 0.0)
+		CalibrateTicks();
+	return nanosecondsPerTick;
+}
+
+void LavaProfilerSetThreadName(const char* name)
+{
+	ProfileThread* thread = GetThread();
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	thread->name = name;
+}
+
+void LavaProfilerRecord(const char* name, uint64_t beginTicks, uint64_t endTicks)
+{
+	ProfileThread* thread = GetThread();
+	uint32_t generation = captureGeneration.load(std::memory_order_acquire);
+	if (thread->generation.load(std::memory_order_relaxed) != generation) {
+		thread->count.store(0, std::memory_order_relaxed);
+		thread->dropped.store(0, std::memory_order_relaxed);
+		thread->generation.store(generation, std::memory_order_release);
+	}
+
+	uint32_t index = thread->count.load(std::memory_order_relaxed);
+	uint32_t chunk = index / profileChunkSize;
+	if (chunk >= profileMaxChunks) {
+		thread->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ProfileEvent* events = thread->chunks[chunk].load(std::memory_order_relaxed);
+	if (!events) {
+		events = new ProfileEvent[profileChunkSize];
+		thread->chunks[chunk].store(events, std::memory_order_release);
+	}
+	events[index % profileChunkSize] = { name, beginTicks, endTicks };
+	thread->count.store(index + 1, std::memory_order_release);
+}
+
+void LavaProfilerRecordGpu(const char* name, uint64_t beginTicks, uint64_t endTicks)
+{
+	std::lock_guard<std::mutex> lock(gpuMutex);
+	gpuEvents.push_back({ name, beginTicks, endTicks });
+}
+
+static void WriteJsonString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* c = text; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if (uint8_t(*c) >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+static void WriteEvent(FILE* file, bool& first, uint32_t processId, uint32_t threadId, const ProfileEvent& event)
+{
+	//Microseconds relative to the capture start, events that began before it (GPU work in flight) come out negative.
+	double begin = (double(int64_t(event.begin - captureBeginTicks)) * nanosecondsPerTick) * 1e-3;
+	double duration = (double(int64_t(event.end - event.begin)) * nanosecondsPerTick) * 1e-3;
+	fprintf(file, "%s\n{\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", first ? "" : ",", processId, threadId, begin, duration);
+	WriteJsonString(file, event.name);
+	fputc('}', file);
+	first = false;
+}
+
+static void WriteMetadata(FILE* file, bool& first, const char* type, uint32_t processId, uint32_t threadId, const char* name)
+{
+	fprintf(file, "%s\n{\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"name\":\"%s\",\"args\":{\"name\":", first ? "" : ",", processId, threadId, type);
+	WriteJsonString(file, name);
+	fputs("}}", file);
+	first = false;
+}
+
+bool LavaProfilerWriteChromeTrace(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	const uint32_t cpuProcess = 1;
+	const uint32_t gpuProcess = 2;
+	uint32_t generation = captureGeneration.load(std::memory_order_acquire);
+	uint64_t eventCount = 0;
+	uint64_t droppedCount = 0;
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+	bool first = true;
+	WriteMetadata(file, first, "process_name", cpuProcess, 0, "CPU");
+	WriteMetadata(file, first, "process_name", gpuProcess, 0, "GPU");
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		for (const std::unique_ptr<ProfileThread>& thread : threads) {
+			if (thread->generation.load(std::memory_order_acquire) != generation)
+				continue;
+
+			WriteMetadata(file, first, "thread_name", cpuProcess, thread->threadId, thread->name.c_str());
+			uint32_t count = thread->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; i++) {
+				const ProfileEvent* events = thread->chunks[i / profileChunkSize].load(std::memory_order_acquire);
+				WriteEvent(file, first, cpuProcess, thread->threadId, events[i % profileChunkSize]);
+			}
+			eventCount += count;
+			droppedCount += thread->dropped.load(std::memory_order_relaxed);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(gpuMutex);
+		WriteMetadata(file, first, "thread_name", gpuProcess, 1, "Graphics queue");
+		for (const ProfileEvent& event : gpuEvents) {
+			WriteEvent(file, first, gpuProcess, 1, event);
+		}
+		eventCount += gpuEvents.size();
+	}
+	fputs("\n]}\n", file);
+	fclose(file);
+
+	LAVA_PRINT("Profiler: " << eventCount << " events written to " << path);
+	if (droppedCount)
+		LAVA_PRINT("Profiler: " << droppedCount << " events dropped, per thread buffers are full");
+	return true;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+
+//Build with LAVA_PROFILER=0 to compile every zone out, the macros below then expand to nothing.
+#ifndef LAVA_PROFILER
+#define LAVA_PROFILER 1
+#endif
+
+#if LAVA_PROFILER
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//Zones only record while a capture is running, outside of one a zone is a single relaxed load.
+//Every thread writes its own event buffer, the exporter reads the published part without locks.
+//Names have to outlive the capture, string literals in practice.
+void LavaProfilerBeginCapture();
+void LavaProfilerEndCapture();
+
+extern std::atomic<bool> lavaProfilerCapturing;
+
+inline bool LavaProfilerIsCapturing()
+{
+	return lavaProfilerCapturing.load(std::memory_order_relaxed);
+}
+
+//Chrome trace event JSON, loads in chrome://tracing and ui.perfetto.dev. Times are relative to the capture start.
+bool LavaProfilerWriteChromeTrace(const char* path);
+
+void LavaProfilerSetThreadName(const char* name);
+
+//Raw CPU timestamp: TSC on x86, steady clock nanoseconds elsewhere. Converted to time when the trace is written.
+inline uint64_t LavaProfilerTicks()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+//Measured against the steady clock over the capture, so it is only exact once a capture ran for a while.
+double LavaProfilerNanosecondsPerTick();
+
+void LavaProfilerRecord(const char* name, uint64_t beginTicks, uint64_t endTicks);
+//GPU work already mapped to CPU ticks, shows up on its own track.
+void LavaProfilerRecordGpu(const char* name, uint64_t beginTicks, uint64_t endTicks);
+
+struct LavaProfileZone {
+	const char* name;
+	uint64_t begin;
+
+	explicit LavaProfileZone(const char* zoneName) : name(zoneName), begin(LavaProfilerIsCapturing() ? LavaProfilerTicks() : 0) {}
+	~LavaProfileZone()
+	{
+		if (begin)
+			LavaProfilerRecord(name, begin, LavaProfilerTicks());
+	}
+};
+
+#define LAVA_PROFILE_CONCAT_(a, b) a##b
+#define LAVA_PROFILE_CONCAT(a, b) LAVA_PROFILE_CONCAT_(a, b)
+#define LAVA_PROFILE_ZONE(name) LavaProfileZone LAVA_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define LAVA_PROFILE_THREAD(name) LavaProfilerSetThreadName(name)
+
+#else
+
+#define LAVA_PROFILE_ZONE(name)
+#define LAVA_PROFILE_THREAD(name)
+
+#endif
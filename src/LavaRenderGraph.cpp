@@ -0,0 +1,588 @@
+#include "LavaRenderGraph.h"
+
+#include <algorithm>
+
+static const VkDeviceSize graphImageAlignment = 64 * 1024; //Placement estimate when no memory query is given
+static const VkDeviceSize graphBufferAlignment = 256;
+static const VkAccessFlags graphWriteAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT;
+
+struct LavaGraphAccessInfo {
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout; //Images only
+	bool write;
+};
+
+static const LavaGraphAccessInfo graphAccessInfos[LAVA_GRAPH_ACCESS_COUNT] = {
+	{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+	{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true },
+	{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false },
+	{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+	{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+	{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+	{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+	{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+	{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+	{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+	{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+	{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+	{ VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+	{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false },
+};
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t FormatSize(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_R8_UNORM:
+		return 1;
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_R16_SFLOAT:
+		return 2;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return 8;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+LavaGraphResource LavaRenderGraph::ImportImage(const char* name, VkImageAspectFlags aspect, VkImageLayout initialLayout,
+	VkPipelineStageFlags initialStages, LavaGraphAccess finalAccess)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.imageDesc.aspect = aspect;
+	resource.initialLayout = initialLayout;
+	resource.initialStages = initialStages;
+	resource.finalAccess = finalAccess;
+	resource.hasFinalAccess = true;
+	return AddResource(resource);
+}
+
+LavaGraphResource LavaRenderGraph::ImportBuffer(const char* name, LavaGraphAccess finalAccess, bool shared)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.imported = true;
+	resource.shared = shared;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.finalAccess = finalAccess;
+	resource.hasFinalAccess = true;
+	return AddResource(resource);
+}
+
+LavaGraphResource LavaRenderGraph::CreateImage(const char* name, const LavaGraphImageDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imageDesc = desc;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return AddResource(resource);
+}
+
+LavaGraphResource LavaRenderGraph::CreateBuffer(const char* name, const LavaGraphBufferDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.bufferDesc = desc;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return AddResource(resource);
+}
+
+LavaGraphResource LavaRenderGraph::AddResource(const Resource& resource)
+{
+	resources.push_back(resource);
+	return LavaGraphResource(resources.size() - 1);
+}
+
+uint32_t LavaRenderGraph::AddPass(const char* name, std::function<void(VkCommandBuffer)> execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	pass.sideEffects = false;
+	passes.push_back(std::move(pass));
+	return uint32_t(passes.size() - 1);
+}
+
+void LavaRenderGraph::Read(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access)
+{
+	AddAccess(pass, resource, access, false);
+}
+
+void LavaRenderGraph::Write(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access)
+{
+	AddAccess(pass, resource, access, true);
+}
+
+void LavaRenderGraph::SetSideEffects(uint32_t pass)
+{
+	passes[pass].sideEffects = true;
+}
+
+void LavaRenderGraph::AddAccess(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access, bool write)
+{
+	assert(pass < passes.size() && resource < resources.size() && access < LAVA_GRAPH_ACCESS_COUNT);
+	const LavaGraphAccessInfo& info = graphAccessInfos[access];
+	VkImageLayout layout = resources[resource].isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+	//Same resource twice in a pass, e.g. read as indirect args and written by compute: one combined access.
+	for (PassAccess& existing : passes[pass].accesses) {
+		if (existing.resource == resource) {
+			assert(existing.layout == layout); //A pass can't use an image in two layouts
+			existing.stages |= info.stages;
+			existing.access |= info.access;
+			existing.write = existing.write || write || info.write;
+			return;
+		}
+	}
+
+	PassAccess passAccess;
+	passAccess.resource = resource;
+	passAccess.stages = info.stages;
+	passAccess.access = info.access;
+	passAccess.layout = layout;
+	passAccess.write = write || info.write;
+	passes[pass].accesses.push_back(passAccess);
+}
+
+void LavaRenderGraph::CullPasses(std::vector<bool>& keepPass) const
+{
+	//Imported resources are consumed outside the graph, everything else is needed only if a kept pass reads it.
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].imported && resources[i].hasFinalAccess;
+	}
+
+	keepPass.assign(passes.size(), false);
+	for (size_t p = passes.size(); p-- > 0;) {
+		const Pass& pass = passes[p];
+		bool keep = pass.sideEffects;
+		for (const PassAccess& access : pass.accesses) {
+			keep = keep || (access.write && needed[access.resource]);
+		}
+		if (!keep)
+			continue;
+
+		keepPass[p] = true;
+		for (const PassAccess& access : pass.accesses) {
+			needed[access.resource] = true;
+		}
+	}
+}
+
+void LavaRenderGraph::Compile(const LavaGraphMemoryQuery& memoryQuery)
+{
+	std::vector<bool> keepPass;
+	CullPasses(keepPass);
+
+	schedule.clear();
+	for (uint32_t p = 0; p < passes.size(); p++) {
+		if (keepPass[p])
+			schedule.push_back(p);
+	}
+
+	std::vector<std::vector<LavaGraphResource>> aliasPredecessors;
+	PlaceTransients(memoryQuery, aliasPredecessors);
+	BuildBarriers(aliasPredecessors);
+}
+
+void LavaRenderGraph::PlaceTransients(const LavaGraphMemoryQuery& memoryQuery, std::vector<std::vector<LavaGraphResource>>& aliasPredecessors)
+{
+	//Lifetime in schedule positions, first to last use.
+	std::vector<uint32_t> firstUse(resources.size(), UINT32_MAX);
+	std::vector<uint32_t> lastUse(resources.size(), 0);
+	for (uint32_t s = 0; s < schedule.size(); s++) {
+		for (const PassAccess& access : passes[schedule[s]].accesses) {
+			firstUse[access.resource] = std::min(firstUse[access.resource], s);
+			lastUse[access.resource] = std::max(lastUse[access.resource], s);
+		}
+	}
+
+	struct Request {
+		LavaGraphResource resource;
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+	};
+	std::vector<Request> requests;
+	for (LavaGraphResource r = 0; r < resources.size(); r++) {
+		const Resource& resource = resources[r];
+		if (resource.imported || firstUse[r] == UINT32_MAX)
+			continue;
+
+		Request request;
+		request.resource = r;
+		if (memoryQuery) {
+			VkMemoryRequirements requirements = memoryQuery(r);
+			request.size = requirements.size;
+			request.alignment = requirements.alignment;
+		}
+		else if (resource.isImage) {
+			request.size = AlignUp(VkDeviceSize(resource.imageDesc.width) * resource.imageDesc.height * FormatSize(resource.imageDesc.format), graphImageAlignment);
+			request.alignment = graphImageAlignment;
+		}
+		else {
+			request.size = AlignUp(resource.bufferDesc.size, graphBufferAlignment);
+			request.alignment = graphBufferAlignment;
+		}
+		requests.push_back(request);
+	}
+
+	//Largest first, each at the lowest offset not overlapping a placed resource that is alive at the same time.
+	std::stable_sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.size > b.size; });
+
+	allocations.clear();
+	aliasPredecessors.assign(resources.size(), std::vector<LavaGraphResource>());
+	transientHeapSize = 0;
+	for (const Request& request : requests) {
+		LavaGraphResource r = request.resource;
+		auto livesWith = [&](LavaGraphResource other) { return firstUse[r] <= lastUse[other] && firstUse[other] <= lastUse[r]; };
+
+		VkDeviceSize offset = 0;
+		for (bool moved = true; moved;) {
+			moved = false;
+			for (const LavaGraphAllocation& placed : allocations) {
+				if (livesWith(placed.resource) && offset < placed.offset + placed.size && placed.offset < offset + request.size) {
+					offset = AlignUp(placed.offset + placed.size, request.alignment);
+					moved = true;
+				}
+			}
+		}
+
+		//Earlier resources in the same memory hand it over, their last use has to finish before the first use here.
+		for (const LavaGraphAllocation& placed : allocations) {
+			if (!livesWith(placed.resource) && offset < placed.offset + placed.size && placed.offset < offset + request.size) {
+				if (lastUse[placed.resource] < firstUse[r])
+					aliasPredecessors[r].push_back(placed.resource);
+				else
+					aliasPredecessors[placed.resource].push_back(r);
+			}
+		}
+
+		LavaGraphAllocation allocation;
+		allocation.resource = r;
+		allocation.offset = offset;
+		allocation.size = request.size;
+		allocations.push_back(allocation);
+		transientHeapSize = std::max(transientHeapSize, offset + request.size);
+	}
+}
+
+void LavaRenderGraph::BuildBarriers(const std::vector<std::vector<LavaGraphResource>>& aliasPredecessors)
+{
+	//Tracked per resource: the last writes, the reads since then and which read stages already see those writes.
+	struct State {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages;
+		VkAccessFlags writeAccess;
+		VkPipelineStageFlags readStages;
+		VkPipelineStageFlags visibleStages;
+		VkAccessFlags visibleAccess;
+	};
+	std::vector<State> states(resources.size());
+	for (size_t r = 0; r < resources.size(); r++) {
+		State& state = states[r];
+		state = {};
+		state.layout = resources[r].initialLayout;
+		state.writeStages = resources[r].initialStages; //E.g. the swapchain acquire wait
+	}
+
+	//Transients are rewritten every frame, the first use waits for the previous frame's uses of the same memory
+	//and makes its writes available, same as an alias handover. Shared imports may still be in use by the
+	//previous frame too.
+	for (uint32_t p : schedule) {
+		for (const PassAccess& access : passes[p].accesses) {
+			if (resources[access.resource].imported && !resources[access.resource].shared)
+				continue;
+			states[access.resource].writeStages |= access.stages;
+			if (access.write)
+				states[access.resource].writeAccess |= access.access & graphWriteAccessMask;
+		}
+	}
+
+	barriers.clear();
+	batches.clear();
+
+	std::vector<bool> touched(resources.size(), false);
+	auto addAccess = [&](LavaGraphResource r, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write, LavaGraphBatch& batch) {
+		State& state = states[r];
+		bool isImage = resources[r].isImage;
+
+		//First use of aliased memory waits for everything the previous owners did.
+		if (!touched[r]) {
+			touched[r] = true;
+			for (LavaGraphResource predecessor : aliasPredecessors[r]) {
+				state.writeStages |= states[predecessor].writeStages | states[predecessor].readStages;
+				state.writeAccess |= states[predecessor].writeAccess;
+			}
+		}
+
+		bool layoutChange = isImage && layout != state.layout;
+		bool needsBarrier;
+		VkPipelineStageFlags srcStages;
+		VkAccessFlags srcAccess;
+		if (write || layoutChange) {
+			//WAW and WAR: wait for the writes and every read since
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+			needsBarrier = srcStages != 0 || layoutChange;
+		}
+		else {
+			//RAW: only when these stages don't see the last writes yet
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+			needsBarrier = state.writeStages != 0 && ((stages & ~state.visibleStages) != 0 || (access & ~state.visibleAccess) != 0);
+		}
+
+		if (needsBarrier) {
+			LavaGraphBarrier barrier;
+			barrier.resource = r;
+			barrier.srcStages = srcStages ? srcStages : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			barrier.dstStages = stages;
+			barrier.srcAccess = srcAccess;
+			barrier.dstAccess = access;
+			barrier.oldLayout = isImage ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = isImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers.push_back(barrier);
+			batch.srcStages |= barrier.srcStages;
+			batch.dstStages |= barrier.dstStages;
+			batch.barrierCount++;
+		}
+
+		if (write) {
+			state.writeStages = stages;
+			state.writeAccess = access & graphWriteAccessMask;
+			state.readStages = 0;
+			state.visibleStages = stages;
+			state.visibleAccess = access;
+		}
+		else {
+			//A layout transition is a write too, later reads have to wait for it.
+			if (layoutChange) {
+				state.writeStages = stages;
+				state.writeAccess = 0;
+				state.visibleStages = 0;
+				state.visibleAccess = 0;
+				state.readStages = 0;
+			}
+			state.readStages |= stages;
+			if (needsBarrier) {
+				state.visibleStages |= stages;
+				state.visibleAccess |= access;
+			}
+		}
+		state.layout = isImage ? layout : state.layout;
+	};
+
+	auto pushBatch = [&](LavaGraphBatch& batch) {
+		if (batch.barrierCount > 0)
+			batches.push_back(batch);
+	};
+
+	for (uint32_t p : schedule) {
+		LavaGraphBatch batch = {};
+		batch.pass = p;
+		batch.firstBarrier = uint32_t(barriers.size());
+		for (const PassAccess& access : passes[p].accesses) {
+			addAccess(access.resource, access.stages, access.access, access.layout, access.write, batch);
+		}
+		pushBatch(batch);
+	}
+
+	LavaGraphBatch finalBatch = {};
+	finalBatch.pass = LAVA_GRAPH_INVALID_RESOURCE;
+	finalBatch.firstBarrier = uint32_t(barriers.size());
+	for (LavaGraphResource r = 0; r < resources.size(); r++) {
+		if (!resources[r].hasFinalAccess)
+			continue;
+		const LavaGraphAccessInfo& info = graphAccessInfos[resources[r].finalAccess];
+		addAccess(r, info.stages, info.access, resources[r].isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED, false, finalBatch);
+	}
+	pushBatch(finalBatch);
+}
+
+void LavaRenderGraph::BindImage(LavaGraphResource resource, VkImage image)
+{
+	assert(resources[resource].imported && resources[resource].isImage);
+	resources[resource].image = image;
+}
+
+void LavaRenderGraph::BindBuffer(LavaGraphResource resource, VkBuffer buffer)
+{
+	assert(resources[resource].imported && !resources[resource].isImage);
+	resources[resource].buffer = buffer;
+}
+
+void LavaRenderGraph::CreateTransients(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties)
+{
+	assert(transientMemory == VK_NULL_HANDLE);
+
+	//First compile only finds which transients survive culling, the real placement needs their memory requirements.
+	Compile();
+
+	std::vector<VkMemoryRequirements> requirements(resources.size());
+	uint32_t memoryTypeBits = ~0u;
+	for (const LavaGraphAllocation& allocation : allocations) {
+		Resource& resource = resources[allocation.resource];
+		if (resource.isImage) {
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = resource.imageDesc.format;
+			imageCreateInfo.extent.width = resource.imageDesc.width;
+			imageCreateInfo.extent.height = resource.imageDesc.height;
+			imageCreateInfo.extent.depth = 1;
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = resource.imageDesc.usage;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			LAVA_ASSERT(vkCreateImage(device, &imageCreateInfo, nullptr, &resource.image));
+			vkGetImageMemoryRequirements(device, resource.image, &requirements[allocation.resource]);
+		}
+		else {
+			VkBufferCreateInfo bufferCreateInfo = {};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = resource.bufferDesc.size;
+			bufferCreateInfo.usage = resource.bufferDesc.usage;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			LAVA_ASSERT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &resource.buffer));
+			vkGetBufferMemoryRequirements(device, resource.buffer, &requirements[allocation.resource]);
+		}
+		memoryTypeBits &= requirements[allocation.resource].memoryTypeBits;
+	}
+
+	Compile([&](LavaGraphResource resource) { return requirements[resource]; });
+	if (allocations.empty())
+		return;
+
+	//One heap for every transient, so aliasing needs a memory type all of them accept.
+	uint32_t memoryTypeIndex = UINT32_MAX;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((memoryTypeBits & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+			memoryTypeIndex = i;
+			break;
+		}
+	}
+	assert(memoryTypeIndex != UINT32_MAX);
+
+	VkMemoryAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = transientHeapSize;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+	LAVA_ASSERT(vkAllocateMemory(device, &allocateInfo, nullptr, &transientMemory));
+
+	for (const LavaGraphAllocation& allocation : allocations) {
+		Resource& resource = resources[allocation.resource];
+		if (!resource.isImage) {
+			LAVA_ASSERT(vkBindBufferMemory(device, resource.buffer, transientMemory, allocation.offset));
+			continue;
+		}
+
+		LAVA_ASSERT(vkBindImageMemory(device, resource.image, transientMemory, allocation.offset));
+
+		VkImageViewCreateInfo imageViewCreateInfo = {};
+		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCreateInfo.image = resource.image;
+		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCreateInfo.format = resource.imageDesc.format;
+		imageViewCreateInfo.subresourceRange.aspectMask = resource.imageDesc.aspect;
+		imageViewCreateInfo.subresourceRange.levelCount = 1;
+		imageViewCreateInfo.subresourceRange.layerCount = 1;
+		LAVA_ASSERT(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &resource.imageView));
+	}
+}
+
+void LavaRenderGraph::DestroyTransients(VkDevice device)
+{
+	for (Resource& resource : resources) {
+		if (resource.imported)
+			continue;
+		if (resource.imageView)
+			vkDestroyImageView(device, resource.imageView, nullptr);
+		if (resource.image)
+			vkDestroyImage(device, resource.image, nullptr);
+		if (resource.buffer)
+			vkDestroyBuffer(device, resource.buffer, nullptr);
+		resource.imageView = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+		resource.buffer = VK_NULL_HANDLE;
+	}
+
+	if (transientMemory)
+		vkFreeMemory(device, transientMemory, nullptr);
+	transientMemory = VK_NULL_HANDLE;
+}
+
+void LavaRenderGraph::Execute(VkCommandBuffer commandBuffer, VkQueryPool timestampPool, uint32_t firstTimestamp) const
+{
+	if (timestampPool) {
+		vkCmdResetQueryPool(commandBuffer, timestampPool, firstTimestamp, GetTimestampCount());
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, firstTimestamp);
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	auto recordBatch = [&](const LavaGraphBatch& batch) {
+		//Buffers need no handle for a global memory barrier, their masks are merged into one.
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		imageBarriers.clear();
+
+		for (uint32_t i = batch.firstBarrier; i < batch.firstBarrier + batch.barrierCount; i++) {
+			const LavaGraphBarrier& barrier = barriers[i];
+			const Resource& resource = resources[barrier.resource];
+			if (!resource.isImage) {
+				memoryBarrier.srcAccessMask |= barrier.srcAccess;
+				memoryBarrier.dstAccessMask |= barrier.dstAccess;
+				continue;
+			}
+
+			VkImageMemoryBarrier imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange.aspectMask = resource.imageDesc.aspect;
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			imageBarriers.push_back(imageBarrier);
+		}
+
+		bool hasMemoryBarrier = memoryBarrier.srcAccessMask != 0 || memoryBarrier.dstAccessMask != 0;
+		vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, hasMemoryBarrier ? 1 : 0, &memoryBarrier, 0, 0,
+			uint32_t(imageBarriers.size()), imageBarriers.data());
+	};
+
+	size_t batchIndex = 0;
+	for (uint32_t s = 0; s < schedule.size(); s++) {
+		uint32_t p = schedule[s];
+		if (batchIndex < batches.size() && batches[batchIndex].pass == p)
+			recordBatch(batches[batchIndex++]);
+		passes[p].execute(commandBuffer);
+		if (timestampPool)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstTimestamp + s + 1);
+	}
+	if (batchIndex < batches.size())
+		recordBatch(batches[batchIndex]);
+}
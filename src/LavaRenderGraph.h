@@ -0,0 +1,164 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef uint32_t LavaGraphResource;
+const LavaGraphResource LAVA_GRAPH_INVALID_RESOURCE = ~0u;
+
+//How a pass touches a resource. Each maps to fixed stage, access and layout masks, see the table in LavaRenderGraph.cpp.
+enum LavaGraphAccess {
+	LAVA_GRAPH_COLOR_ATTACHMENT_WRITE,
+	LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE,
+	LAVA_GRAPH_DEPTH_ATTACHMENT_READ, //Depth test without writes
+	LAVA_GRAPH_SAMPLED_READ_FRAGMENT,
+	LAVA_GRAPH_SAMPLED_READ_COMPUTE,
+	LAVA_GRAPH_STORAGE_READ_VERTEX,
+	LAVA_GRAPH_STORAGE_READ_COMPUTE,
+	LAVA_GRAPH_STORAGE_WRITE_COMPUTE, //Read-write
+	LAVA_GRAPH_INDIRECT_READ,
+	LAVA_GRAPH_VERTEX_READ,
+	LAVA_GRAPH_TRANSFER_READ,
+	LAVA_GRAPH_TRANSFER_WRITE,
+	LAVA_GRAPH_HOST_READ,
+	LAVA_GRAPH_PRESENT,
+	LAVA_GRAPH_ACCESS_COUNT
+};
+
+struct LavaGraphImageDesc {
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	VkImageUsageFlags usage;
+	VkImageAspectFlags aspect;
+};
+
+struct LavaGraphBufferDesc {
+	VkDeviceSize size;
+	VkBufferUsageFlags usage;
+};
+
+//One resource transition. Buffers have no layouts, both stay VK_IMAGE_LAYOUT_UNDEFINED.
+struct LavaGraphBarrier {
+	LavaGraphResource resource;
+	VkPipelineStageFlags srcStages;
+	VkPipelineStageFlags dstStages;
+	VkAccessFlags srcAccess;
+	VkAccessFlags dstAccess;
+	VkImageLayout oldLayout;
+	VkImageLayout newLayout;
+};
+
+//Barriers recorded with a single vkCmdPipelineBarrier before a pass, or after the last one for final states.
+struct LavaGraphBatch {
+	uint32_t pass; //LAVA_GRAPH_INVALID_RESOURCE for the final batch
+	uint32_t firstBarrier;
+	uint32_t barrierCount;
+	VkPipelineStageFlags srcStages;
+	VkPipelineStageFlags dstStages;
+};
+
+//Placement of a transient resource in the shared heap. Transients whose lifetimes don't overlap share memory.
+struct LavaGraphAllocation {
+	LavaGraphResource resource;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+typedef std::function<VkMemoryRequirements(LavaGraphResource)> LavaGraphMemoryQuery;
+
+//Frame graph: passes declare what they read and write, Compile() culls passes nobody consumes, derives the barriers
+//between passes from the declared accesses and places transient resources in one aliased heap.
+//Compile() doesn't need a device, the barrier and allocation lists can be checked directly.
+class LavaRenderGraph {
+public:
+	//External resources keep their state across frames: initial layout/stages on entry, final access on exit.
+	LavaGraphResource ImportImage(const char* name, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStages,
+		LavaGraphAccess finalAccess);
+	//A buffer every frame in flight uses is shared: its first use waits for the previous frame's uses, like a transient.
+	LavaGraphResource ImportBuffer(const char* name, LavaGraphAccess finalAccess, bool shared = false);
+	LavaGraphResource CreateImage(const char* name, const LavaGraphImageDesc& desc);
+	LavaGraphResource CreateBuffer(const char* name, const LavaGraphBufferDesc& desc);
+
+	uint32_t AddPass(const char* name, std::function<void(VkCommandBuffer)> execute);
+	void Read(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access);
+	void Write(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access);
+	void SetSideEffects(uint32_t pass); //Never culled, e.g. readbacks
+
+	//Without a query transients are sized from their desc, good enough for tests.
+	void Compile(const LavaGraphMemoryQuery& memoryQuery = LavaGraphMemoryQuery());
+
+	const std::vector<uint32_t>& GetSchedule() const { return schedule; }
+	const std::vector<LavaGraphBatch>& GetBatches() const { return batches; }
+	const std::vector<LavaGraphBarrier>& GetBarriers() const { return barriers; }
+	const std::vector<LavaGraphAllocation>& GetAllocations() const { return allocations; }
+	VkDeviceSize GetTransientHeapSize() const { return transientHeapSize; }
+	const char* GetPassName(uint32_t pass) const { return passes[pass].name.c_str(); }
+	const char* GetResourceName(LavaGraphResource resource) const { return resources[resource].name.c_str(); }
+
+	//Device side: handles for imported resources, transients are created by the graph.
+	void BindImage(LavaGraphResource resource, VkImage image);
+	void BindBuffer(LavaGraphResource resource, VkBuffer buffer);
+	void CreateTransients(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties);
+	void DestroyTransients(VkDevice device);
+	VkImage GetImage(LavaGraphResource resource) const { return resources[resource].image; }
+	VkImageView GetImageView(LavaGraphResource resource) const { return resources[resource].imageView; }
+	VkBuffer GetBuffer(LavaGraphResource resource) const { return resources[resource].buffer; }
+
+	//With a query pool, timestamp 0 is written before the first pass and timestamp i + 1 after scheduled pass i,
+	//counted from firstTimestamp.
+	void Execute(VkCommandBuffer commandBuffer, VkQueryPool timestampPool = VK_NULL_HANDLE, uint32_t firstTimestamp = 0) const;
+	uint32_t GetTimestampCount() const { return uint32_t(schedule.size() + 1); }
+
+private:
+	struct Resource {
+		std::string name;
+		bool isImage;
+		bool imported;
+		bool shared; //Imported buffer the frames in flight all use
+		LavaGraphImageDesc imageDesc;
+		LavaGraphBufferDesc bufferDesc;
+		VkImageLayout initialLayout;
+		VkPipelineStageFlags initialStages;
+		LavaGraphAccess finalAccess;
+		bool hasFinalAccess;
+
+		VkImage image;
+		VkImageView imageView;
+		VkBuffer buffer;
+	};
+
+	struct PassAccess {
+		LavaGraphResource resource;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		bool write;
+	};
+
+	struct Pass {
+		std::string name;
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<PassAccess> accesses;
+		bool sideEffects;
+	};
+
+	LavaGraphResource AddResource(const Resource& resource);
+	void AddAccess(uint32_t pass, LavaGraphResource resource, LavaGraphAccess access, bool write);
+	void CullPasses(std::vector<bool>& keepPass) const;
+	void PlaceTransients(const LavaGraphMemoryQuery& memoryQuery, std::vector<std::vector<LavaGraphResource>>& aliasPredecessors);
+	void BuildBarriers(const std::vector<std::vector<LavaGraphResource>>& aliasPredecessors);
+
+private:
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+
+	std::vector<uint32_t> schedule;
+	std::vector<LavaGraphBatch> batches;
+	std::vector<LavaGraphBarrier> barriers;
+	std::vector<LavaGraphAllocation> allocations;
+	VkDeviceSize transientHeapSize = 0;
+	VkDeviceMemory transientMemory = VK_NULL_HANDLE;
+};
@@ -1,112 +1,565 @@
 #include "LavaRenderer.h"
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#include <unordered_map>
-#define LAVA_ASSERT(call) \
-			{ \
-				VkResult result = call; \
-				assert(result == VK_SUCCESS); \
+#include <chrono>
+#include <float.h>
+#include <stdexcept>
+#include <gtc/matrix_transform.hpp>
+#if LAVA_NULL_VULKAN
+#include "LavaNullVulkan.h"
+#endif
+
+//Pass field of the draw keys, the depth prepass sorts before the main pass.
+static const uint32_t drawPassDepth = 0;
+static const uint32_t drawPassMain = 1;
+
+static LavaAabb SphereBounds(const glm::vec4& sphere)
+{
+	LavaAabb aabb;
+	aabb.min = glm::vec3(sphere) - sphere.w;
+	aabb.max = glm::vec3(sphere) + sphere.w;
+	return aabb;
+}
+
+//Lays instances out on a cube grid as scene nodes, node i is instance i. Returns the radius of the bounding sphere of the grid.
+static float BuildInstanceGrid(LavaScene& scene, std::vector<LavaInstance>& instances, uint32_t count)
+{
+	const float spacing = 3.f;
+	uint32_t side = 1;
+	while (side * side * side < count)
+		side++;
+
+	float halfExtent = (side - 1) * spacing * 0.5f;
+	instances.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		float x = (i % side) * spacing - halfExtent;
+		float y = ((i / side) % side) * spacing - halfExtent;
+		float z = (i / (side * side)) * spacing - halfExtent;
+
+		LavaNodeHandle node = scene.CreateNode();
+		assert(node == i);
+		scene.SetPosition(node, glm::vec3(x, y, z));
+
+		LavaInstance& instance = instances[i];
+		instance.materialIndex = 0;
+		instance.color[0] = 0.5f + 0.5f * float(i % side + 1) / side;
+		instance.color[1] = 0.5f + 0.5f * float((i / side) % side + 1) / side;
+		instance.color[2] = 0.5f + 0.5f * float(i / (side * side) + 1) / side;
+	}
+
+	return halfExtent * 1.7320508f + spacing;
+}
+
+LavaRenderer::LavaRenderer(const LavaRendererSettings& rendererSettings)
+{
+	settings = rendererSettings;
+
+	//Capture starts before the window so init shows up in the trace too.
+	LAVA_PROFILE_THREAD("Main");
+	if (settings.profilePath) {
+#if LAVA_PROFILER
+		LavaProfilerBeginCapture();
+#else
+		LAVA_PRINT("Built with LAVA_PROFILER=0, --profile ignored");
+		settings.profilePath = nullptr;
+#endif
+	}
+
+#if !LAVA_GLFW
+	if (!settings.headless)
+		LAVA_PRINT("Built without GLFW, rendering headless");
+	settings.headless = true;
+#endif
+	frameBufferWidth = std::max(1u, settings.width);
+	frameBufferHeight = std::max(1u, settings.height);
+#if LAVA_GLFW
+	if (!settings.headless) {
+		int windowInit = glfwInit();
+		assert(windowInit);
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		window = glfwCreateWindow(int(frameBufferWidth), int(frameBufferHeight), "Lava", 0, 0);
+		assert(window);
+
+		int s_width = 0, s_height = 0;
+		glfwGetWindowSize(window, &s_width, &s_height);
+		frameBufferWidth = s_width;
+		frameBufferHeight = s_height;
+	}
+#endif
+
+	//Packs are mounted over the working directory, whatever they don't have loads from the loose files,
+	//e.g. "lava_pack --compress --extension .obj assets assets/assets.lpk".
+	vfs.Init(&jobSystem);
+	vfs.MountDirectory(".");
+	vfs.MountDirectory(settings.shaderPath, "shaders");
+	vfs.MountPack((std::string(settings.shaderPath) + "/shaders.lpk").c_str(), "shaders");
+	vfs.MountPack("assets/assets.lpk", "assets");
+
+	//Startup runs as a dependency graph on the job system: the mesh and the SPIR-V are read while the device is
+	//created, pipelines are built while the swapchain is set up.
+	LavaTaskGraph startup;
+	Mesh mesh;
+	uint32_t loadMesh = startup.Add("Load mesh", [&]() {
+		size_t meshSize = 0;
+		const void* meshData = vfs.Map(settings.meshPath, &meshSize);
+		std::vector<uint8_t> meshFile;
+		if (!meshData) {
+			if (!vfs.Read(settings.meshPath, meshFile)) {
+				LAVA_PRINT("Could not read " << settings.meshPath);
+				throw std::runtime_error(std::string("Could not read ") + settings.meshPath);
 			}
+			meshData = meshFile.data();
+			meshSize = meshFile.size();
+		}
+		mesh = LoadMeshFromMemory(meshData, meshSize);
+	});
+
+	startup.Add("Build instances", [&]() {
+		sceneRadius = BuildInstanceGrid(scene, instances, std::max(1u, settings.instanceCount));
+		scene.Update(&jobSystem);
+		const LavaAffineTransform* worldTransforms = scene.GetWorldTransforms();
+		for (size_t i = 0; i < instances.size(); i++) {
+			memcpy(instances[i].transform, worldTransforms[i].rows, sizeof(instances[i].transform));
+		}
+	});
+
+	uint32_t device = InitVulkan(startup);
+#if LAVA_PROFILER
+	startup.Add("GPU profiler", [&]() {
+		gpuProfiler.Init(activeDevice, activePhysicalDevice, queue, queueFamilyIndex, LAVA_FRAMES_IN_FLIGHT);
+	}, { device });
+#endif
+
+	//GPU driven draws switch to a clustered LOD in the distance, stored behind the mesh in both buffers.
+	//The skin pass only covers the full mesh, animated meshes keep the one LOD.
+	Mesh lodMesh;
+	startup.Add("Mesh buffers", [&]() {
+		//The skin pass reads the bind pose vertices as a storage buffer.
+		CreateBuffer(vb, 128 * 1024 * 1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (settings.animate ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0));
+		CreateBuffer(ib, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		memcpy(vb.data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		memcpy(ib.data, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		if (settings.gpuDriven && !settings.animate) {
+			lodMesh = BuildClusteredLod(mesh, 16);
+			memcpy(static_cast<Vertex*>(vb.data) + mesh.vertices.size(), lodMesh.vertices.data(), lodMesh.vertices.size() * sizeof(Vertex));
+			memcpy(static_cast<uint32_t*>(ib.data) + mesh.indices.size(), lodMesh.indices.data(), lodMesh.indices.size() * sizeof(uint32_t));
+		}
+	}, { device, loadMesh });
+
+	startup.Run(settings.serialStartup ? nullptr : &jobSystem);
+	startup.PrintTimeline();
+	shaderCode.clear();
+	LavaVfsStats vfsStats = vfs.GetStats();
+	LAVA_PRINT("VFS (" << LavaVfs::GetBackendName(vfs.GetBackend()) << "): " << vfsStats.maps << " mapped, " << vfsStats.packReads << " pack and " << vfsStats.looseReads << " loose reads, "
+		<< vfsStats.bytes / 1024 << " KB");
+	uint32_t instanceCount = uint32_t(instances.size());
+	meshIndexCount = uint32_t(mesh.indices.size());
+
+	//Prepass only needs positions, a tight stream fetches a third of the vertex data. Animated, the skin pass writes it.
+	if (settings.depthPrepass && !settings.animate) {
+		CreateBuffer(positionBuffer, std::max<size_t>(1, mesh.vertices.size() + lodMesh.vertices.size()) * sizeof(Vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		Vec3* positions = static_cast<Vec3*>(positionBuffer.data);
+		for (size_t i = 0; i < mesh.vertices.size(); i++) {
+			positions[i] = mesh.vertices[i].Position;
+		}
+		for (size_t i = 0; i < lodMesh.vertices.size(); i++) {
+			positions[mesh.vertices.size() + i] = lodMesh.vertices[i].Position;
+		}
+	}
 
-#define LAVA_PRINT(s) std::cout<<s<<std::endl
-Mesh LoadMesh() {
-	using tinyobj::shape_t;
-	using tinyobj::material_t;
-	using tinyobj::index_t;
-	tinyobj::attrib_t attrib;
-	std::vector<shape_t> shapes;
-	std::vector<material_t> materials;
-	std::string warn, err;
+	CreateFrameData();
+
+	meshSphere = ComputeBoundingSphere(mesh);
+	if (settings.animate)
+		meshSphere = CreateSkinningData(mesh, vb);
+	//Animated draws read the streams the skin pass writes.
+	mainVertexBuffer = settings.animate ? skinning.vertices.buffer : vb.buffer;
+	depthVertexBuffer = settings.animate ? skinning.positions.buffer : positionBuffer.buffer;
+
+	material.baseColor[0] = 1.f;
+	material.baseColor[1] = 1.f;
+	material.baseColor[2] = 1.f;
+	material.baseColor[3] = 1.f;
+	material.albedoTexture = LAVA_BINDLESS_INVALID_INDEX;
+	material.albedoSampler = LAVA_BINDLESS_INVALID_INDEX;
+
+	//Only the mip tail is loaded here, finer levels stream in per frame. One repeat across the mesh diameter,
+	//so the texel density on screen follows the projected size of the instance.
+	if (settings.texturePath) {
+		textureDevice.Init(activeDevice, activePhysicalDevice, queue, queueFamilyIndex, &bindlessHeap, LAVA_FRAMES_IN_FLIGHT);
+		textureStreamer.Init(&textureDevice);
+		textureStreamer.memoryBudget = settings.textureMemoryBudget;
+		textureStreamer.uploadBudget = settings.textureUploadBudget;
+		albedoTexture = textureStreamer.RegisterFile(settings.texturePath);
+	}
+	if (albedoTexture != LAVA_INVALID_TEXTURE) {
+		VkSamplerCreateInfo samplerCreateInfo = {};
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		LAVA_ASSERT(vkCreateSampler(activeDevice, &samplerCreateInfo, nullptr, &albedoSampler));
+
+		material.albedoTexture = textureDevice.GetBindlessIndex(albedoTexture);
+		material.albedoSampler = bindlessHeap.RegisterSampler(albedoSampler);
+		material.uvScale = 0.5f / meshSphere.w;
+	}
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, "assets/armadillo.obj")) {
-		throw std::runtime_error(warn + err);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		CreateBuffer(frames[i].materialData, sizeof(LavaMaterial), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		memcpy(frames[i].materialData.data, &material, sizeof(LavaMaterial));
+		frames[i].materialIndex = bindlessHeap.RegisterBuffer(frames[i].materialData.buffer);
 	}
 
-	Mesh outputMesh;
-	for (const shape_t& shape : shapes) {
-		uint32_t i = 0;
-		for (const index_t& index : shape.mesh.indices) {
-			Vertex vertex = {};
-			vertex.Position = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+	drawConstants.materialBuffer = frames[0].materialIndex;
 
-			vertex.Normal = {
-				attrib.normals[3 * index.normal_index + 0],
-				attrib.normals[3 * index.normal_index + 1],
-				attrib.normals[3 * index.normal_index + 2]
-			};
+	if (settings.gpuDriven && !supportsIndirectFirstInstance) {
+		LAVA_PRINT("drawIndirectFirstInstance not supported, GPU driven path disabled");
+		settings.gpuDriven = false;
+	}
 
-			outputMesh.vertices.push_back(vertex);
-			outputMesh.indices.push_back(i);
-			i++;
+	//Async compute needs something to move to the compute queue and a queue to move it to.
+	if (settings.asyncCompute && !settings.gpuDriven)
+		LAVA_PRINT("Async compute only moves the GPU driven cull, ignored without --gpu-driven");
+	else if (settings.asyncCompute && !computeQueue)
+		LAVA_PRINT("No separate compute queue, culling stays on the graphics queue");
+	settings.asyncCompute = settings.asyncCompute && settings.gpuDriven && computeQueue;
+
+#if LAVA_NULL_VULKAN
+	//The null device runs no shaders, the readbacks would never match the CPU references.
+	if (settings.validateGpuCulling || settings.validateParticles)
+		LAVA_PRINT("The null device runs no shaders, --validate-culling and --validate-particles are ignored");
+	settings.validateGpuCulling = false;
+	settings.validateParticles = false;
+#endif
+
+	if (settings.gpuDriven)
+		CreateGpuDrivenData(mesh, lodMesh);
+	settings.validateParticles = settings.validateParticles && settings.particleCount > 0;
+	if (settings.particleCount > 0)
+		CreateParticleData(TransformBoundingSphere(scene.GetWorldTransform(0), meshSphere));
+
+	//Everything the frames reference is described once up front, see lava_replay.
+	if (settings.capturePath) {
+		LavaCaptureFileHeader captureHeader = {};
+		captureHeader.passCount = drawPassMain + 1;
+		captureHeader.instanceCount = instanceCount;
+		captureHeader.instanceStride = sizeof(LavaInstance);
+		captureHeader.flags = (settings.reuseCommandBuffers ? LAVA_CAPTURE_FLAG_CACHED_COMMAND_BUFFERS : 0) | (settings.gpuDriven ? LAVA_CAPTURE_FLAG_GPU_DRIVEN : 0);
+		if (captureWriter.Open(settings.capturePath, captureHeader)) {
+			captureWriter.AddBuffer(vb.buffer, vb.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "vertices");
+			captureWriter.AddBuffer(ib.buffer, ib.size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "indices");
+			captureWriter.AddBuffer(frames[0].instanceBuffer.buffer, frames[0].instanceBuffer.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "instances",
+				LAVA_CAPTURE_BUFFER_INSTANCES);
+			for (uint32_t i = 1; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+				captureWriter.AliasBuffer(frames[i].instanceBuffer.buffer, frames[0].instanceBuffer.buffer);
+			}
+			captureWriter.AddBuffer(frames[0].materialData.buffer, frames[0].materialData.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "material");
+			for (uint32_t i = 1; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+				captureWriter.AliasBuffer(frames[i].materialData.buffer, frames[0].materialData.buffer);
+			}
+			captureWriter.AddPipeline(trianglePipeline, drawPassMain, "triangle");
+			captureWriter.Upload(vb.buffer, 0, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+			captureWriter.Upload(ib.buffer, 0, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+			if (!lodMesh.indices.empty()) {
+				captureWriter.Upload(vb.buffer, mesh.vertices.size() * sizeof(Vertex), lodMesh.vertices.data(), lodMesh.vertices.size() * sizeof(Vertex));
+				captureWriter.Upload(ib.buffer, mesh.indices.size() * sizeof(uint32_t), lodMesh.indices.data(), lodMesh.indices.size() * sizeof(uint32_t));
+			}
+			captureWriter.Upload(frames[0].instanceBuffer.buffer, 0, instances.data(), instanceCount * sizeof(LavaInstance));
+			captureWriter.Upload(frames[0].materialData.buffer, 0, &material, sizeof(LavaMaterial));
+			if (settings.depthPrepass) {
+				captureWriter.AddPipeline(depthPipeline, drawPassDepth, "depth");
+				if (!settings.animate) {
+					captureWriter.AddBuffer(positionBuffer.buffer, positionBuffer.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "positions");
+					captureWriter.Upload(positionBuffer.buffer, 0, positionBuffer.data, (mesh.vertices.size() + lodMesh.vertices.size()) * sizeof(Vec3));
+				}
+			}
+			//The skin dispatch isn't captured, replays draw the bind pose the skinned streams start out with.
+			if (settings.animate) {
+				captureWriter.AddBuffer(skinning.vertices.buffer, skinning.vertices.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "skinned vertices");
+				captureWriter.Upload(skinning.vertices.buffer, 0, skinning.vertices.data, skinning.vertices.size);
+				if (settings.depthPrepass) {
+					captureWriter.AddBuffer(skinning.positions.buffer, skinning.positions.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "skinned positions");
+					captureWriter.Upload(skinning.positions.buffer, 0, skinning.positions.data, skinning.positions.size);
+				}
+			}
+		}
+		else {
+			LAVA_PRINT("Could not create capture " << settings.capturePath);
 		}
 	}
-	return outputMesh;
-}
 
-LavaRenderer::LavaRenderer()
-{
-	int windowInit = glfwInit();
-	assert(windowInit);
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-	window = glfwCreateWindow(1024, 768, "Lava", 0, 0);
-	assert(window);
+	//GPU path culls on its own, CPU culling only feeds the instance stream paths.
+	settings.cpuCulling = (settings.cpuCulling || settings.bvhCulling || settings.occlusionCulling) && !settings.gpuDriven;
+	settings.occlusionCulling = settings.occlusionCulling && settings.cpuCulling;
+	settings.bvhCulling = settings.bvhCulling && settings.cpuCulling;
+	if (settings.cpuCulling) {
+		cullingBounds.Resize(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++) {
+			glm::vec3 translation(instances[i].transform[0].w, instances[i].transform[1].w, instances[i].transform[2].w);
+			cullingBounds.SetSphere(i, glm::vec4(glm::vec3(meshSphere) + translation, meshSphere.w));
+		}
+	}
 
-	int s_width = 0, s_height = 0;
-	glfwGetWindowSize(window, &s_width, &s_height);
-	frameBufferWidth = s_width;
-	frameBufferHeight = s_height;
+	if (settings.bvhCulling) {
+		LAVA_PROFILE_ZONE("Build BVH");
+		std::vector<LavaAabb> instanceBounds(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++) {
+			instanceBounds[i] = SphereBounds(TransformBoundingSphere(scene.GetWorldTransform(i), meshSphere));
+		}
+		bvh.Build(instanceBounds.data(), instanceCount, &jobSystem);
+	}
 
-	InitVulkan();
+	//Occluders are drawn with a clustered LOD of the mesh.
+	if (settings.occlusionCulling) {
+		LAVA_PROFILE_ZONE("Build occluder LOD");
+		occlusion.culler.Init(256, 128);
+		BuildOccluderLod(&mesh.vertices[0].Position.x, sizeof(Vertex), uint32_t(mesh.vertices.size()), mesh.indices.data(), uint32_t(mesh.indices.size()),
+			16, occlusion.occluderPositions, occlusion.occluderIndices);
+		occlusion.meshSphere = meshSphere;
+		LAVA_PRINT("Occluder LOD: " << occlusion.occluderIndices.size() / 3 << " triangles");
+	}
 
-	VkCommandBufferAllocateInfo allocateInfo = {};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocateInfo.commandPool = commandPool;
-	allocateInfo.commandBufferCount = 1;
-	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	LAVA_PRINT(instanceCount << " instances of " << mesh.indices.size() / 3 << " triangles, "
+		<< (settings.gpuDriven ? (supportsDrawIndirectCount ? "GPU culled indirect count draws" : "GPU culled indirect draws") :
+			settings.drawPerObject ? "one draw per object" : "single instanced draw"));
+	if (settings.cpuCulling)
+		LAVA_PRINT((settings.bvhCulling ? "BVH" : "SIMD") << " CPU frustum culling on " << jobSystem.GetThreadCount() << " threads");
+
+	drawInstanceCount = instanceCount;
+	BuildRenderGraph();
+	CreateTimestampPool(renderGraph.GetTimestampCount());
+	if (settings.asyncCompute) {
+		CreateAsyncCompute();
+		LAVA_PRINT("Culling on the async compute queue" << (computeQueueFamilyIndex == queueFamilyIndex ? " (second graphics family queue)" : "")
+			<< ", a frame ahead of graphics");
+	}
+	if (settings.statsName) {
+		if (statsRing.Create(settings.statsFrames, settings.statsName))
+			CreateStatisticsPool();
+		else
+			LAVA_PRINT("Could not create stats segment " << settings.statsName);
+	}
+	report.gpuPassTimeSums.assign(renderGraph.GetSchedule().size(), 0.0);
+	if (settings.reuseCommandBuffers)
+		CreateCachedCommandBuffers();
+}
 
-	VkCommandBuffer commandBuffer;
-	LAVA_ASSERT(vkAllocateCommandBuffers(activeDevice, &allocateInfo, &commandBuffer));
+//Teardown waits for the queues, a cull prepared for a frame that never ran may still be on the compute queue.
+LavaRenderer::~LavaRenderer()
+{
+	LAVA_ASSERT(vkDeviceWaitIdle(activeDevice));
+	DestroyFrameBuffers();
+	renderGraph.DestroyTransients(activeDevice);
+	if (settings.asyncCompute)
+		DestroyAsyncCompute();
+	if (settings.gpuDriven)
+		DestroyGpuDrivenData();
+	if (settings.animate)
+		DestroySkinningData();
+	if (settings.particleCount > 0)
+		DestroyParticleData();
+
+	if (settings.texturePath) {
+		textureStreamer.Shutdown();
+		textureDevice.Destroy();
+	}
+	if (albedoSampler) {
+		bindlessHeap.Release(LAVA_BINDLESS_SAMPLER, material.albedoSampler);
+		vkDestroySampler(activeDevice, albedoSampler, 0);
+	}
 
-	Mesh mesh = LoadMesh();
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, frames[i].materialIndex);
+		DestroyBuffer(frames[i].materialData);
+	}
+	DestroyFrameData();
+	if (settings.depthPrepass && !settings.animate)
+		DestroyBuffer(positionBuffer);
+	DestroyBuffer(vb);
+	DestroyBuffer(ib);
 
-	LavaGpuBuffer vb = {};
-	CreateBuffer(vb,128*1024*1024,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-	LavaGpuBuffer ib = {};
-	CreateBuffer(ib, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+#if LAVA_PROFILER
+	if (settings.profilePath) {
+		LavaProfilerEndCapture();
+		LavaProfilerWriteChromeTrace(settings.profilePath);
+	}
+	gpuProfiler.Destroy();
+#endif
 
-	memcpy(vb.data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
-	memcpy(ib.data, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+#if LAVA_GLFW
+	if (window)
+		glfwDestroyWindow(window);
+#endif
+	DestroyVulkan();
+}
 
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-		uint32_t imageIndex = 0;
-		LAVA_ASSERT(vkAcquireNextImageKHR(activeDevice, swapChain, UINT64_MAX, acquireSemaphore, nullptr, &imageIndex));
+//Frames run until the window is closed or the headless frames are done, then the ones still in flight are finished.
+void LavaRenderer::Run()
+{
+	//Headless runs write one line per frame, the camera follows the frame index so runs are reproducible.
+	if (settings.headless) {
+		LAVA_PRINT("Headless: " << settings.headlessFrames << " frames at " << frameBufferWidth << "x" << frameBufferHeight);
+		if (settings.outputPath) {
+			std::string timingsPath = std::string(settings.outputPath) + "/timings.csv";
+			timingsFile = fopen(timingsPath.c_str(), "w");
+#if LAVA_NULL_VULKAN
+			if (timingsFile)
+				fprintf(timingsFile, "frame,cpu_ms,gpu_ms,draws,api_calls,commands,barriers\n");
+#else
+			if (timingsFile)
+				fprintf(timingsFile, "frame,cpu_ms,gpu_ms,draws\n");
+#endif
+			else
+				LAVA_PRINT("Could not write " << timingsPath);
+		}
+	}
 
-		LAVA_ASSERT(vkResetCommandPool(activeDevice, commandPool, 0));
+#if LAVA_NULL_VULKAN
+	const LavaNullVulkanStats& nullStats = LavaNullVulkanGetStats();
+	nullCountsMark[0] = nullStats.calls;
+	nullCountsMark[1] = nullStats.commands;
+	nullCountsMark[2] = nullStats.barriers;
+#endif
+	while (true) {
+		if (settings.headless) {
+			if (frameIndex == settings.headlessFrames)
+				break;
+		}
+#if LAVA_GLFW
+		else if (glfwWindowShouldClose(window)) {
+			break;
+		}
+#endif
+		RunFrame();
+	}
+	FinishFrames();
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		LAVA_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+	if (timingsFile) {
+		fclose(timingsFile);
+		timingsFile = nullptr;
+	}
+	PrintHeadlessSummary();
+}
 
-		ImageLayout beginSrcLayout;
-		beginSrcLayout.AccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		beginSrcLayout.Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+//Frame graph, passes only record commands, the graph places every barrier between them and around the swapchain.
+void LavaRenderer::BuildRenderGraph()
+{
+	//Headless the offscreen image stands in for the swapchain and ends the frame copied out instead of presented.
+	swapchainImage = renderGraph.ImportImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+		settings.headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		settings.headless ? LAVA_GRAPH_TRANSFER_READ : LAVA_GRAPH_PRESENT);
+	//Async compute culls outside the graph, the submit waits on it instead of a barrier. In the graph every frame
+	//culls into its own slot, bound when the frame is recorded.
+	if (settings.gpuDriven && !settings.asyncCompute) {
+		//Validation reads the draws back on the host after the frame.
+		LavaGraphAccess drawFinalAccess = settings.validateGpuCulling ? LAVA_GRAPH_HOST_READ : LAVA_GRAPH_INDIRECT_READ;
+		drawCommandsResource = renderGraph.ImportBuffer("draw commands", drawFinalAccess);
+		drawCountResource = renderGraph.ImportBuffer("draw count", drawFinalAccess);
+
+		uint32_t clearPass = renderGraph.AddPass("clear draw count", [this](VkCommandBuffer cb) {
+			vkCmdFillBuffer(cb, gpuDriven.slots[frameSlot].drawCount.buffer, 0, sizeof(uint32_t), 0);
+		});
+		renderGraph.Write(clearPass, drawCountResource, LAVA_GRAPH_TRANSFER_WRITE);
+
+		uint32_t cullPass = renderGraph.AddPass("cull", [this](VkCommandBuffer cb) { RecordCullPass(cb, frameSlot); });
+		renderGraph.Write(cullPass, drawCommandsResource, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		renderGraph.Write(cullPass, drawCountResource, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	}
 
-		ImageLayout beginDstLayout;
-		beginDstLayout.AccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		beginDstLayout.Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	//Skinned streams are rewritten every frame before any pass draws from them. There is one copy of them and of the
+	//particle buffers, shared by the frames in flight.
+	LavaGraphResource skinnedVertices = LAVA_GRAPH_INVALID_RESOURCE;
+	LavaGraphResource skinnedPositions = LAVA_GRAPH_INVALID_RESOURCE;
+	if (settings.animate) {
+		skinnedVertices = renderGraph.ImportBuffer("skinned vertices", LAVA_GRAPH_VERTEX_READ, true);
+		renderGraph.BindBuffer(skinnedVertices, skinning.vertices.buffer);
+
+		uint32_t skinPass = renderGraph.AddPass("skinning", [this](VkCommandBuffer cb) { RecordSkinPass(cb); });
+		renderGraph.Write(skinPass, skinnedVertices, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		if (settings.depthPrepass) {
+			skinnedPositions = renderGraph.ImportBuffer("skinned positions", LAVA_GRAPH_VERTEX_READ, true);
+			renderGraph.BindBuffer(skinnedPositions, skinning.positions.buffer);
+			renderGraph.Write(skinPass, skinnedPositions, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		}
+	}
 
+	//Particles emit, move and compact on the GPU before the main pass draws them. The counters carry the indirect
+	//arguments from pass to pass, the host only reads them for the stats and validation, after the frame.
+	LavaGraphResource particlePool = LAVA_GRAPH_INVALID_RESOURCE;
+	LavaGraphResource particleAliveLists = LAVA_GRAPH_INVALID_RESOURCE;
+	LavaGraphResource particleCounters = LAVA_GRAPH_INVALID_RESOURCE;
+	if (settings.particleCount > 0) {
+		LavaGraphAccess drawnFinalAccess = settings.validateParticles ? LAVA_GRAPH_HOST_READ : LAVA_GRAPH_STORAGE_READ_VERTEX;
+		particlePool = renderGraph.ImportBuffer("particles", drawnFinalAccess, true);
+		particleAliveLists = renderGraph.ImportBuffer("particle alive lists", drawnFinalAccess, true);
+		particleCounters = renderGraph.ImportBuffer("particle counters", LAVA_GRAPH_HOST_READ, true);
+		LavaGraphResource particleDeadList = renderGraph.ImportBuffer("particle dead list", LAVA_GRAPH_STORAGE_WRITE_COMPUTE, true);
+		renderGraph.BindBuffer(particlePool, particles.pool.buffer);
+		renderGraph.BindBuffer(particleAliveLists, particles.aliveLists.buffer);
+		renderGraph.BindBuffer(particleCounters, particles.counters.buffer);
+		renderGraph.BindBuffer(particleDeadList, particles.deadList.buffer);
+
+		uint32_t beginPass = renderGraph.AddPass("particle begin", [this](VkCommandBuffer cb) { RecordParticlePass(cb, LAVA_PARTICLE_PASS_BEGIN); });
+		renderGraph.Write(beginPass, particleCounters, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+
+		uint32_t emitPass = renderGraph.AddPass("particle emit", [this](VkCommandBuffer cb) { RecordParticlePass(cb, LAVA_PARTICLE_PASS_EMIT); });
+		renderGraph.Read(emitPass, particleCounters, LAVA_GRAPH_INDIRECT_READ);
+		renderGraph.Read(emitPass, particleCounters, LAVA_GRAPH_STORAGE_READ_COMPUTE);
+		renderGraph.Read(emitPass, particleDeadList, LAVA_GRAPH_STORAGE_READ_COMPUTE);
+		renderGraph.Write(emitPass, particlePool, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		renderGraph.Write(emitPass, particleAliveLists, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+
+		uint32_t simulatePass = renderGraph.AddPass("particle simulate", [this](VkCommandBuffer cb) { RecordParticlePass(cb, LAVA_PARTICLE_PASS_SIMULATE); });
+		renderGraph.Read(simulatePass, particleCounters, LAVA_GRAPH_INDIRECT_READ);
+		renderGraph.Write(simulatePass, particleCounters, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		renderGraph.Write(simulatePass, particleDeadList, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		renderGraph.Write(simulatePass, particlePool, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+		renderGraph.Write(simulatePass, particleAliveLists, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	}
 
-		VkImageMemoryBarrier renderBeginBarrier = PipelineBarrierImage(swapChainData.swapChainImages[imageIndex], beginSrcLayout, beginDstLayout);
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &renderBeginBarrier);
+	LavaGraphImageDesc depthDesc = {};
+	depthDesc.format = depthFormat;
+	depthDesc.width = frameBufferWidth;
+	depthDesc.height = frameBufferHeight;
+	depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	LavaGraphResource depthImage = renderGraph.CreateImage("depth", depthDesc);
+
+	if (settings.depthPrepass) {
+		uint32_t prepass = renderGraph.AddPass("depth prepass", [this](VkCommandBuffer cb) {
+			VkClearValue depthClear = {};
+			depthClear.depthStencil.depth = 1.f;
+
+			VkRenderPassBeginInfo beginPassInfo = {};
+			beginPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			beginPassInfo.renderPass = depthPrepassRenderPass;
+			beginPassInfo.framebuffer = depthFrameBuffer;
+			beginPassInfo.renderArea.extent.width = frameBufferWidth;
+			beginPassInfo.renderArea.extent.height = frameBufferHeight;
+			beginPassInfo.pClearValues = &depthClear;
+			beginPassInfo.clearValueCount = 1;
+
+			vkCmdBeginRenderPass(cb, &beginPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			RecordDraws(cb, depthPipeline, depthVertexBuffer, drawPassDepth);
+			vkCmdEndRenderPass(cb);
+		});
+		renderGraph.Write(prepass, depthImage, LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE);
+		if (skinnedPositions != LAVA_GRAPH_INVALID_RESOURCE)
+			renderGraph.Read(prepass, skinnedPositions, LAVA_GRAPH_VERTEX_READ);
+		if (drawCommandsResource != LAVA_GRAPH_INVALID_RESOURCE) {
+			renderGraph.Read(prepass, drawCommandsResource, LAVA_GRAPH_INDIRECT_READ);
+			renderGraph.Read(prepass, drawCountResource, LAVA_GRAPH_INDIRECT_READ);
+		}
+	}
 
-		VkClearValue color = { .5,0,0,1 };
+	uint32_t mainPass = renderGraph.AddPass("main", [this](VkCommandBuffer cb) {
+		VkClearValue clearValues[2] = {};
+		clearValues[0].color = { .5f, 0.f, 0.f, 1.f };
+		clearValues[1].depthStencil.depth = 1.f;
 
 		//Dont clear the screen with a command, clear it via renderpass. No need for additional operation.
 		VkRenderPassBeginInfo beginPassInfo = {};
@@ -115,113 +568,722 @@ LavaRenderer::LavaRenderer()
 		beginPassInfo.framebuffer = swapChainData.frameBuffers[imageIndex];
 		beginPassInfo.renderArea.extent.width = frameBufferWidth; //Useful for tiled rendering, specifying helps to performance for them
 		beginPassInfo.renderArea.extent.height = frameBufferHeight;
-		beginPassInfo.pClearValues = &color;
-		beginPassInfo.clearValueCount = 1;
-
-		vkCmdBeginRenderPass(commandBuffer, &beginPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewPort = {};
-		viewPort.width = float(frameBufferWidth);
-		viewPort.height = float(frameBufferHeight);
-		viewPort.x = 0.f;
-		viewPort.y = 0.f;
-		viewPort.minDepth = 0.f;
-		viewPort.maxDepth = 1.f;
-
-		VkRect2D scissors = {};
-		scissors.extent.width = frameBufferWidth;
-		scissors.extent.height = frameBufferHeight;
-		scissors.offset.x = 0;
-		scissors.offset.y = 0;
-
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewPort);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipeline);
-
-		VkDeviceSize offsets = 0;
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offsets);
-		vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffer, mesh.indices.size(), 1, 0, 0, 0);
-		//vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-		vkCmdEndRenderPass(commandBuffer);
-
-		ImageLayout endSrcLayout;
-		endSrcLayout.AccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		endSrcLayout.Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		ImageLayout endDstLayout;
-		endDstLayout.AccessMask = 0;
-		endDstLayout.Layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkImageMemoryBarrier renderEndBarrier = PipelineBarrierImage(swapChainData.swapChainImages[imageIndex], endSrcLayout, endDstLayout);
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-			VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &renderEndBarrier);
-
-		vkEndCommandBuffer(commandBuffer);
-
-		VkPipelineStageFlags submitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &acquireSemaphore;
-		submitInfo.pWaitDstStageMask = &submitStageMask;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &releaseSemaphore;
-
-		LAVA_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		VkPresentInfoKHR presentInfo = {};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = &swapChain;
-		presentInfo.pImageIndices = &imageIndex;
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &releaseSemaphore;
+		beginPassInfo.pClearValues = clearValues;
+		beginPassInfo.clearValueCount = 2;
+
+		vkCmdBeginRenderPass(cb, &beginPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		RecordDraws(cb, trianglePipeline, mainVertexBuffer, drawPassMain);
+		if (settings.particleCount > 0)
+			RecordParticleDraw(cb);
+		vkCmdEndRenderPass(cb);
+	});
+	renderGraph.Write(mainPass, swapchainImage, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	if (skinnedVertices != LAVA_GRAPH_INVALID_RESOURCE)
+		renderGraph.Read(mainPass, skinnedVertices, LAVA_GRAPH_VERTEX_READ);
+	if (particleCounters != LAVA_GRAPH_INVALID_RESOURCE) {
+		renderGraph.Read(mainPass, particlePool, LAVA_GRAPH_STORAGE_READ_VERTEX);
+		renderGraph.Read(mainPass, particleAliveLists, LAVA_GRAPH_STORAGE_READ_VERTEX);
+		renderGraph.Read(mainPass, particleCounters, LAVA_GRAPH_INDIRECT_READ);
+	}
+	if (settings.depthPrepass)
+		renderGraph.Read(mainPass, depthImage, LAVA_GRAPH_DEPTH_ATTACHMENT_READ);
+	else
+		renderGraph.Write(mainPass, depthImage, LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE);
+	if (drawCommandsResource != LAVA_GRAPH_INVALID_RESOURCE) {
+		renderGraph.Read(mainPass, drawCommandsResource, LAVA_GRAPH_INDIRECT_READ);
+		renderGraph.Read(mainPass, drawCountResource, LAVA_GRAPH_INDIRECT_READ);
+	}
+	if (settings.headless) {
+		readbackResource = renderGraph.ImportBuffer("readback", LAVA_GRAPH_HOST_READ);
+
+		uint32_t readbackPass = renderGraph.AddPass("readback", [this](VkCommandBuffer cb) {
+			VkBufferImageCopy region = {};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent.width = frameBufferWidth;
+			region.imageExtent.height = frameBufferHeight;
+			region.imageExtent.depth = 1;
+			vkCmdCopyImageToBuffer(cb, swapChainData.swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frames[frameSlot].readbackBuffer.buffer,
+				1, &region);
+		});
+		renderGraph.Read(readbackPass, swapchainImage, LAVA_GRAPH_TRANSFER_READ);
+		renderGraph.Write(readbackPass, readbackResource, LAVA_GRAPH_TRANSFER_WRITE);
+		renderGraph.SetSideEffects(readbackPass);
+	}
+	renderGraph.CreateTransients(activeDevice, memoryProperties);
+	CreateFrameBuffers(renderGraph.GetImageView(depthImage));
+}
+
+//Both passes draw the same geometry, the prepass with the position only stream.
+void LavaRenderer::RecordDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkBuffer vertexStream, uint32_t drawPass)
+{
+	VkViewport viewPort = {};
+	viewPort.width = float(frameBufferWidth);
+	viewPort.height = float(frameBufferHeight);
+	viewPort.x = 0.f;
+	viewPort.y = 0.f;
+	viewPort.minDepth = 0.f;
+	viewPort.maxDepth = 1.f;
+
+	VkRect2D scissors = {};
+	scissors.extent.width = frameBufferWidth;
+	scissors.extent.height = frameBufferHeight;
+	scissors.offset.x = 0;
+	scissors.offset.y = 0;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewPort);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissors);
+
+	//Single bind for the whole frame, draws only push their indices.
+	VkDescriptorSet bindlessSet = bindlessHeap.GetSet();
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1, &bindlessSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, trianglePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+		0, sizeof(LavaDrawConstants), &drawConstants);
+
+	if (!settings.gpuDriven) {
+		drawList.Submit(commandBuffer, drawPass, report.drawStats);
+		return;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	VkBuffer vertexBuffers[] = { vertexStream, frames[frameSlot].instanceBuffer.buffer };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, VK_INDEX_TYPE_UINT32);
+	RecordIndirectDraws(commandBuffer, frameSlot);
+}
+
+//CPU paths go through the draw list, one packet per pass and draw. Depth is the distance over the camera range.
+void LavaRenderer::BuildDrawList(const LavaCamera& camera)
+{
+	auto sortBegin = std::chrono::high_resolution_clock::now();
+	drawList.Reset();
+
+	const LavaInstance* instanceData = static_cast<const LavaInstance*>(frames[frameSlot].instanceBuffer.data);
+	float depthScale = 1.f / (3.f * sceneRadius);
+	for (uint32_t drawPass = settings.depthPrepass ? drawPassDepth : drawPassMain; drawPass <= drawPassMain; drawPass++) {
+		LavaDrawPacket packet = {};
+		packet.pipeline = drawPass == drawPassDepth ? depthPipeline : trianglePipeline;
+		packet.vertexBuffers[0] = drawPass == drawPassDepth ? depthVertexBuffer : mainVertexBuffer;
+		packet.vertexBuffers[1] = frames[frameSlot].instanceBuffer.buffer;
+		packet.indexBuffer = ib.buffer;
+		packet.indexCount = meshIndexCount;
+		packet.instanceCount = 1;
+
+		if (!settings.drawPerObject) {
+			packet.instanceCount = drawInstanceCount;
+			if (drawInstanceCount > 0)
+				drawList.Push(LavaMakeDrawKey(drawPass, drawPass, 0, 0, 0), packet);
+			continue;
+		}
+
+		//firstInstance selects the object's slot in the instance stream
+		for (uint32_t i = 0; i < drawInstanceCount; i++) {
+			glm::vec3 position(instanceData[i].transform[0].w, instanceData[i].transform[1].w, instanceData[i].transform[2].w);
+			packet.firstInstance = i;
+			drawList.Push(LavaMakeDrawKey(drawPass, drawPass, instanceData[i].materialIndex, 0,
+				LavaDepthBucket(glm::length(position - camera.position) * depthScale)), packet);
+		}
+	}
+
+	drawList.Sort(&jobSystem);
+	report.drawSortTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortBegin).count();
+}
+
+//Headless time follows the frame index, so runs are reproducible.
+float LavaRenderer::GetFrameTime(uint64_t index)
+{
+#if LAVA_GLFW
+	return settings.headless ? float(index) / 60.f : float(glfwGetTime());
+#else
+	return float(index) / 60.f;
+#endif
+}
+
+//Scene sync, camera and cull of a frame into its slot. Async compute prepares the next frame while the current one
+//draws, so its cull runs on the compute queue next to the graphics work. The slot's last frame has finished either way.
+LavaCamera LavaRenderer::PrepareFrame(uint64_t index, uint32_t slot)
+{
+	//Only nodes that moved since last frame come back. The object table has a single copy the frames in flight cull
+	//against, it is only rewritten once they are done. Each frame's instance stream is rewritten before it draws.
+	scene.Update(&jobSystem);
+	{
+		LAVA_PROFILE_ZONE("Scene sync");
+		const std::vector<LavaNodeHandle>& changedNodes = scene.GetChangedNodes();
+		if (settings.gpuDriven && !changedNodes.empty())
+			FinishFrames();
+		for (LavaNodeHandle node : changedNodes) {
+			const LavaAffineTransform& world = scene.GetWorldTransform(node);
+			memcpy(instances[node].transform, world.rows, sizeof(instances[node].transform));
+			captureWriter.Transform(node, world);
+
+			glm::vec4 sphere = TransformBoundingSphere(world, meshSphere);
+			if (settings.cpuCulling)
+				cullingBounds.SetSphere(node, sphere);
+			if (settings.bvhCulling)
+				bvh.UpdateObject(node, SphereBounds(sphere));
+			if (settings.gpuDriven)
+				static_cast<LavaObjectData*>(gpuDriven.objects.data)[node].boundingSphere = sphere;
+		}
+		if (settings.bvhCulling)
+			bvh.Refit();
+		for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT && !changedNodes.empty(); i++) {
+			frames[i].instancesStale = true;
+		}
+	}
+
+	LavaCamera camera = GetCamera(GetFrameTime(index));
+	if (settings.gpuDriven)
+		UpdateCullView(camera, slot);
+	if (settings.asyncCompute)
+		SubmitAsyncCull(slot);
+	return camera;
+}
+
+//One frame: prepare, record, submit and present it into the next slot. Only the frame that last used the slot is
+//waited for, what a frame measured is read back once it finishes, see FinishFrame.
+void LavaRenderer::RunFrame()
+{
+#if LAVA_PROFILER
+	if (settings.profilePath && profiledFrameCount++ == settings.profileFrames) {
+		LavaProfilerEndCapture();
+		LavaProfilerWriteChromeTrace(settings.profilePath);
+		settings.profilePath = nullptr;
+	}
+#endif
+	LAVA_PROFILE_ZONE("Frame");
+#if LAVA_GLFW
+	if (window)
+		glfwPollEvents();
+#endif
+	frameSlot = uint32_t(frameIndex % LAVA_FRAMES_IN_FLIGHT);
+	LavaFrameResources& frame = frames[frameSlot];
+	FinishFrame(frameSlot);
+
+	auto cpuFrameBegin = std::chrono::high_resolution_clock::now();
+	frame.stats = {};
+	frame.stats.frameIndex = frameIndex;
+	uint32_t allocationsBegin = memoryAllocationCount + textureDevice.GetAllocationCount();
+
+	LavaCamera camera = framePrepared ? preparedCamera : PrepareFrame(frameIndex, frameSlot);
+	framePrepared = false;
+	//CPU culling rewrites the stream below anyway.
+	if (!settings.cpuCulling && frame.instancesStale)
+		memcpy(frame.instanceBuffer.data, instances.data(), instances.size() * sizeof(LavaInstance));
+	frame.instancesStale = false;
+	static_cast<LavaFrameData*>(frame.frameData.data)->viewProjection = camera.viewProjection;
+	drawConstants.frameBuffer = frame.frameDataIndex;
+	drawConstants.materialBuffer = frame.materialIndex;
+	captureWriter.BeginFrame(frameIndex, camera.viewProjection);
+
+	if (settings.animate) {
+		LAVA_PROFILE_ZONE("Animation");
+		auto animationBegin = std::chrono::high_resolution_clock::now();
+		UpdateSkinning(GetFrameTime(frameIndex));
+		report.animationTimeSum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - animationBegin).count();
+	}
+	//Clamped, so a stall doesn't throw every particle through the floor at once.
+	if (settings.particleCount > 0) {
+		float particleTime = GetFrameTime(frameIndex);
+		UpdateParticles(frameIndex > 0 ? std::min(particleTime - lastParticleTime, 0.1f) : 1.f / 60.f);
+		lastParticleTime = particleTime;
+	}
+
+	drawInstanceCount = uint32_t(instances.size());
+	if (settings.cpuCulling)
+		CullInstances(camera, frame.stats);
+
+	if (!settings.gpuDriven) {
+		LAVA_PROFILE_ZONE("Draw list");
+		BuildDrawList(camera);
+		captureWriter.DrawList(drawList);
+	}
+
+	if (albedoTexture != LAVA_INVALID_TEXTURE)
+		StreamTextures(camera, frame.stats);
+
+	bindlessHeap.BeginFrame(frameIndex);
+	if (settings.headless) {
+		imageIndex = uint32_t(frameIndex % swapChainData.swapChainImages.size());
+	}
+	else {
+		LAVA_PROFILE_ZONE("Acquire");
+		LAVA_ASSERT(vkAcquireNextImageKHR(activeDevice, swapChain, UINT64_MAX, frame.acquireSemaphore, nullptr, &imageIndex));
+	}
+	renderGraph.BindImage(swapchainImage, swapChainData.swapChainImages[imageIndex]);
+	if (drawCommandsResource != LAVA_GRAPH_INVALID_RESOURCE) {
+		renderGraph.BindBuffer(drawCommandsResource, gpuDriven.slots[frameSlot].drawCommands.buffer);
+		renderGraph.BindBuffer(drawCountResource, gpuDriven.slots[frameSlot].drawCount.buffer);
+	}
+	if (readbackResource != LAVA_GRAPH_INVALID_RESOURCE)
+		renderGraph.BindBuffer(readbackResource, frame.readbackBuffer.buffer);
+
+	VkCommandBuffer frameCommandBuffer = RecordFrame(frame.drawStats);
+
+	//With async compute only the indirect draws wait for the cull, the frame's work up to them can already run.
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStageMasks[2];
+	uint32_t waitSemaphoreCount = 0;
+	if (!settings.headless) {
+		waitSemaphores[waitSemaphoreCount] = frame.acquireSemaphore;
+		waitStageMasks[waitSemaphoreCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+	if (settings.asyncCompute) {
+		waitSemaphores[waitSemaphoreCount] = asyncCompute.cullDone[frameSlot];
+		waitStageMasks[waitSemaphoreCount++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStageMasks;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frameCommandBuffer;
+	submitInfo.signalSemaphoreCount = settings.headless ? 0 : 1;
+	submitInfo.pSignalSemaphores = &frame.releaseSemaphore;
+
+	{
+		LAVA_PROFILE_ZONE("Submit");
+		LAVA_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+	}
+	frame.pending = true;
+
+	//CPU cost of the frame: acquire, recording and submit. Present and the wait for the slot are GPU bound.
+	std::chrono::duration<double, std::milli> cpuFrameTime = std::chrono::high_resolution_clock::now() - cpuFrameBegin;
+	cpuFrameTime += std::chrono::duration<double, std::milli>(preparedCpuMs);
+	preparedCpuMs = 0.0;
+	report.cpuFrameTimeSum += cpuFrameTime.count();
+	if (captureWriter.IsOpen()) {
+		captureWriter.EndFrame(cpuFrameTime.count());
+		if (captureWriter.GetFrameCount() == settings.captureFrames) {
+			captureWriter.Close();
+			LAVA_PRINT("Captured " << settings.captureFrames << " frames to " << settings.capturePath);
+		}
+	}
+
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &swapChain;
+	presentInfo.pImageIndices = &imageIndex;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &frame.releaseSemaphore;
 
+	if (!settings.headless) {
+		LAVA_PROFILE_ZONE("Present");
 		LAVA_ASSERT(vkQueuePresentKHR(queue, &presentInfo));
+	}
 
-		LAVA_ASSERT(vkDeviceWaitIdle(activeDevice));
+	frame.stats.cpuFrameMs = cpuFrameTime.count();
+	frame.stats.draws = frame.drawStats.draws;
+	frame.stats.pipelineBinds = frame.drawStats.pipelineBinds;
+	frame.stats.barriers = uint32_t(renderGraph.GetBarriers().size());
+	frame.stats.allocations = memoryAllocationCount + textureDevice.GetAllocationCount() - allocationsBegin;
+	if (!settings.gpuDriven)
+		frame.stats.triangles = uint64_t(drawInstanceCount) * (meshIndexCount / 3) * (settings.depthPrepass ? 2 : 1);
+#if LAVA_NULL_VULKAN
+	//Everything the frame asked of the device since the last one, the prepare of the next frame counts towards that.
+	const LavaNullVulkanStats& nullStats = LavaNullVulkanGetStats();
+	frame.apiCalls = nullStats.calls - nullCountsMark[0];
+	frame.commands = nullStats.commands - nullCountsMark[1];
+	frame.barriers = nullStats.barriers - nullCountsMark[2];
+	nullCountsMark[0] = nullStats.calls;
+	nullCountsMark[1] = nullStats.commands;
+	nullCountsMark[2] = nullStats.barriers;
+#endif
+
+	//The readbacks compare against the CPU state of this frame, before the next one is prepared.
+	if (settings.validateGpuCulling || settings.validateParticles)
+		FinishFrame(frameSlot);
+
+	uint32_t nextSlot = uint32_t((frameIndex + 1) % LAVA_FRAMES_IN_FLIGHT);
+	if (settings.asyncCompute && !(settings.headless && frameIndex + 1 == settings.headlessFrames)) {
+		LAVA_PROFILE_ZONE("Prepare next frame");
+		FinishFrame(nextSlot);
+		auto prepareBegin = std::chrono::high_resolution_clock::now();
+		preparedCamera = PrepareFrame(frameIndex + 1, nextSlot);
+		framePrepared = true;
+		preparedCpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - prepareBegin).count();
 	}
 
-	DestroyBuffer(vb);
-	DestroyBuffer(ib);
+	if (++report.frameCount == 100)
+		PrintFrameReport();
+	frameIndex++;
+}
 
-	glfwDestroyWindow(window);
-	DestroyVulkan();
+//Waits for the fence of the slot's frame, then its queries, readbacks and stats are complete.
+void LavaRenderer::FinishFrame(uint32_t slot)
+{
+	LavaFrameResources& frame = frames[slot];
+	if (!frame.pending)
+		return;
+	{
+		LAVA_PROFILE_ZONE("Wait for frame");
+		LAVA_ASSERT(vkWaitForFences(activeDevice, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		LAVA_ASSERT(vkResetFences(activeDevice, 1, &frame.fence));
+	}
+	frame.pending = false;
+
+	LavaFrameStats& frameStats = frame.stats;
+#if LAVA_PROFILER
+	gpuProfiler.Collect(frameStats.frameIndex);
+#endif
+	if (timestampPool)
+		ReadGpuTimings(frameStats, slot);
+
+	if (statsRing.IsValid()) {
+		if (statisticsPool) {
+			uint64_t statistics[5] = {};
+			LAVA_ASSERT(vkGetQueryPoolResults(activeDevice, statisticsPool, slot, 1, sizeof(statistics), statistics, sizeof(statistics),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			frameStats.hasPipelineStatistics = 1;
+			frameStats.inputPrimitives = statistics[0];
+			frameStats.vertexInvocations = statistics[1];
+			frameStats.clippingPrimitives = statistics[2];
+			frameStats.fragmentInvocations = statistics[3];
+			frameStats.computeInvocations = statistics[4];
+		}
+		statsRing.Push(frameStats);
+	}
+
+	if (settings.gpuDriven && settings.validateGpuCulling)
+		ValidateGpuCulling(slot);
+	if (settings.validateParticles)
+		ValidateParticles();
+
+	if (settings.headless) {
+		headlessCpuMs.push_back(frameStats.cpuFrameMs);
+		headlessGpuMs.push_back(frameStats.gpuFrameMs);
+#if LAVA_NULL_VULKAN
+		if (timingsFile)
+			fprintf(timingsFile, "%llu,%.4f,%.4f,%u,%llu,%llu,%llu\n", (unsigned long long)frameStats.frameIndex, frameStats.cpuFrameMs,
+				frameStats.gpuFrameMs, frame.drawStats.draws, (unsigned long long)frame.apiCalls, (unsigned long long)frame.commands,
+				(unsigned long long)frame.barriers);
+#else
+		if (timingsFile)
+			fprintf(timingsFile, "%llu,%.4f,%.4f,%u\n", (unsigned long long)frameStats.frameIndex, frameStats.cpuFrameMs, frameStats.gpuFrameMs,
+				frame.drawStats.draws);
+#endif
+
+		bool lastFrame = frameStats.frameIndex + 1 == settings.headlessFrames;
+		if (settings.outputPath && (lastFrame || (settings.dumpInterval && frameStats.frameIndex % settings.dumpInterval == 0))) {
+			char imagePath[1024];
+			snprintf(imagePath, sizeof(imagePath), "%s/frame_%05llu.ppm", settings.outputPath, (unsigned long long)frameStats.frameIndex);
+			WriteFrameImage(imagePath, frame.readbackBuffer);
+		}
+	}
 }
 
-void LavaRenderer::InitVulkan()
+void LavaRenderer::FinishFrames()
 {
-	CreateInstance();
-	RegisterDebugCallback();
-	CreateSurface();
-	CreateDevice();
-	GetSwapchainSupportData();
-	CreateSwapchain();
-	CreateSemaphore();
-	CreateQueue();
-	CreateRenderPass();
-	CreateGraphicsPipeline();
-	CreateCommandPool();
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		FinishFrame(uint32_t((frameIndex + i) % LAVA_FRAMES_IN_FLIGHT));
+	}
 }
 
-void LavaRenderer::DestroyVulkan()
+//The slot's last frame is done, so its instance stream can be rewritten with just the visible instances.
+void LavaRenderer::CullInstances(const LavaCamera& camera, LavaFrameStats& frameStats)
 {
-	LAVA_ASSERT(vkDeviceWaitIdle(activeDevice));
+	LAVA_PROFILE_ZONE("Culling");
+	LavaFrustum frustum = ExtractFrustum(camera.viewProjection);
+	if (settings.bvhCulling)
+		bvh.CullFrustum(frustum, visibleInstances);
+	else
+		CullBounds(frustum, cullingBounds, LAVA_CULL_SPHERES, &jobSystem, visibleInstances);
+
+	if (settings.occlusionCulling)
+		CullOccluded(camera);
+	drawInstanceCount = uint32_t(visibleInstances.size());
+	captureWriter.InstanceStream(visibleInstances.data(), drawInstanceCount);
+	frameStats.uploadedBytes += uint64_t(drawInstanceCount) * sizeof(LavaInstance);
+
+	LavaInstance* instanceData = static_cast<LavaInstance*>(frames[frameSlot].instanceBuffer.data);
+	jobSystem.ParallelFor(drawInstanceCount, 4096, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			instanceData[i] = instances[visibleInstances[i]];
+		}
+	});
+}
+
+//Usage feedback from the nearest instance, every instance shares the material. A commit moves the texture to a new
+//bindless slot, which only this frame's material copy points at, and the frames in flight keep the old image until
+//they retire. The material buffer index is the same for every frame in a slot, so cached command buffers stay valid.
+void LavaRenderer::StreamTextures(const LavaCamera& camera, LavaFrameStats& frameStats)
+{
+	LAVA_PROFILE_ZONE("Texture streaming");
+	textureDevice.BeginFrame(frameIndex);
+	float nearestDistance = FLT_MAX;
+	for (const LavaInstance& instance : instances) {
+		glm::vec3 center = glm::vec3(meshSphere) + glm::vec3(instance.transform[0].w, instance.transform[1].w, instance.transform[2].w);
+		nearestDistance = std::min(nearestDistance, glm::length(center - camera.position) - meshSphere.w);
+	}
+	float projectedDiameter = 2.f * meshSphere.w * float(frameBufferHeight) / (2.f * tanf(glm::radians(30.f)) * std::max(nearestDistance, 0.1f));
+
+	textureStreamer.BeginFrame(frameIndex);
+	textureStreamer.RequestLevel(albedoTexture, LavaTextureLevelForScreenSize(textureStreamer.GetInfo(albedoTexture).width, projectedDiameter));
+	textureStreamer.Update();
+	material.albedoTexture = textureDevice.GetBindlessIndex(albedoTexture);
+	static_cast<LavaMaterial*>(frames[frameSlot].materialData.data)->albedoTexture = material.albedoTexture;
+	report.textureUploadSum += textureStreamer.GetStats().uploadedBytes;
+	frameStats.uploadedBytes += textureStreamer.GetStats().uploadedBytes;
+}
+
+//Cached mode replays the buffer of the image and frame slot as long as everything it recorded is the same, the camera
+//and culling data only live in buffers. Otherwise the slot's pool is reset and one buffer recorded per frame.
+VkCommandBuffer LavaRenderer::RecordFrame(LavaDrawListStats& frameDrawStats)
+{
+	LavaFrameResources& frame = frames[frameSlot];
+	VkCommandBuffer frameCommandBuffer = frame.commandBuffer;
+	bool recordFrame = true;
+	uint32_t cachedIndex = imageIndex * LAVA_FRAMES_IN_FLIGHT + frameSlot;
+	if (settings.reuseCommandBuffers) {
+		uint64_t stateHash = LavaHashCombine(0, uint64_t(swapChainData.frameBuffers[imageIndex]));
+		stateHash = LavaHashCombine(stateHash, (uint64_t(frameBufferWidth) << 32) | frameBufferHeight);
+		if (!settings.gpuDriven)
+			stateHash = LavaHashCombine(stateHash, drawList.ComputeHash());
+
+		LavaCachedCommandBuffer& cached = cachedCommandBuffers[cachedIndex];
+		frameCommandBuffer = cached.commandBuffer;
+		recordFrame = !cached.recorded || cached.stateHash != stateHash;
+		cached.stateHash = stateHash;
+		cached.recorded = true;
+	}
+	else {
+		LAVA_ASSERT(vkResetCommandPool(activeDevice, frame.commandPool, 0));
+	}
+
+	frameDrawStats = settings.reuseCommandBuffers ? cachedCommandBuffers[cachedIndex].drawStats : LavaDrawListStats{};
+	if (!recordFrame)
+		return frameCommandBuffer;
+
+	LAVA_PROFILE_ZONE("Record");
+	//Begin resets a cached buffer, its pool allows per buffer resets.
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	LAVA_ASSERT(vkBeginCommandBuffer(frameCommandBuffer, &beginInfo));
+
+#if LAVA_PROFILER
+	gpuProfiler.BeginFrame(frameCommandBuffer, frameIndex);
+#endif
+	//Statistics cover every pass, the query is begun outside the render passes.
+	if (statisticsPool) {
+		vkCmdResetQueryPool(frameCommandBuffer, statisticsPool, frameSlot, 1);
+		vkCmdBeginQuery(frameCommandBuffer, statisticsPool, frameSlot, 0);
+	}
+	LavaDrawListStats recordBegin = report.drawStats;
+	{
+		LAVA_PROFILE_GPU_ZONE(gpuProfiler, frameCommandBuffer, "Frame");
+		renderGraph.Execute(frameCommandBuffer, timestampPool, frameSlot * renderGraph.GetTimestampCount());
+	}
+	if (statisticsPool)
+		vkCmdEndQuery(frameCommandBuffer, statisticsPool, frameSlot);
+
+	frameDrawStats.draws = report.drawStats.draws - recordBegin.draws;
+	frameDrawStats.pipelineBinds = report.drawStats.pipelineBinds - recordBegin.pipelineBinds;
+	frameDrawStats.vertexBufferBinds = report.drawStats.vertexBufferBinds - recordBegin.vertexBufferBinds;
+	frameDrawStats.indexBufferBinds = report.drawStats.indexBufferBinds - recordBegin.indexBufferBinds;
+	if (settings.reuseCommandBuffers)
+		cachedCommandBuffers[cachedIndex].drawStats = frameDrawStats;
+
+	vkEndCommandBuffer(frameCommandBuffer);
+	report.recordedFrameCount++;
+	return frameCommandBuffer;
+}
+
+//Timestamps bracket every graph pass, so prepass savings show up directly in the main pass time.
+void LavaRenderer::ReadGpuTimings(LavaFrameStats& frameStats, uint32_t slot)
+{
+	std::vector<uint64_t> timestamps(renderGraph.GetTimestampCount());
+	LAVA_ASSERT(vkGetQueryPoolResults(activeDevice, timestampPool, slot * uint32_t(timestamps.size()), uint32_t(timestamps.size()), timestamps.size() * sizeof(uint64_t),
+		timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+	for (size_t i = 0; i < report.gpuPassTimeSums.size(); i++) {
+		report.gpuPassTimeSums[i] += double(timestamps[i + 1] - timestamps[i]) * timestampPeriod * 1e-6;
+	}
+	frameStats.gpuFrameMs = double(timestamps.back() - timestamps.front()) * timestampPeriod * 1e-6;
+	report.gpuFrameCount++;
+
+	//This frame's cull against the previous frame's graphics, timestamps of both queues come from the same device clock.
+	uint64_t cullTimestamps[2] = {};
+	if (asyncCompute.timestampPool) {
+		LAVA_ASSERT(vkGetQueryPoolResults(activeDevice, asyncCompute.timestampPool, slot * 2, 2, sizeof(cullTimestamps), cullTimestamps,
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		uint64_t overlapBegin = std::max(cullTimestamps[0], previousGpuFrame[0]);
+		uint64_t overlapEnd = std::min(cullTimestamps[1], previousGpuFrame[1]);
+		report.asyncCullTimeSum += double(cullTimestamps[1] - cullTimestamps[0]) * timestampPeriod * 1e-6;
+		report.asyncOverlapTimeSum += overlapEnd > overlapBegin ? double(overlapEnd - overlapBegin) * timestampPeriod * 1e-6 : 0.0;
+	}
+#if LAVA_PROFILER
+	if (LavaProfilerIsCapturing()) {
+		std::vector<const char*> passNames(report.gpuPassTimeSums.size());
+		for (size_t i = 0; i < passNames.size(); i++) {
+			passNames[i] = renderGraph.GetPassName(renderGraph.GetSchedule()[i]);
+		}
+		gpuProfiler.RecordSequence(passNames.data(), timestamps.data(), uint32_t(passNames.size()));
+		const char* asyncCullName = "cull (async compute)";
+		if (asyncCompute.timestampPool)
+			gpuProfiler.RecordSequence(&asyncCullName, cullTimestamps, 1);
+	}
+#endif
+	previousGpuFrame[0] = timestamps.front();
+	previousGpuFrame[1] = timestamps.back();
+}
+
+void LavaRenderer::PrintFrameReport()
+{
+	uint32_t frameCount = report.frameCount;
+	LAVA_PRINT("CPU frame: " << report.cpuFrameTimeSum / frameCount << " ms");
+	if (settings.reuseCommandBuffers)
+		LAVA_PRINT("  Command buffers: " << report.recordedFrameCount << "/" << frameCount << " frames re-recorded");
+	if (!settings.gpuDriven) {
+		const LavaDrawListStats& drawStats = report.drawStats;
+		LAVA_PRINT("  Draw list: " << drawList.GetPacketCount() << " packets, build + sort " << report.drawSortTimeSum / frameCount << " ms, "
+			<< drawStats.draws / frameCount << " draws, " << drawStats.pipelineBinds / frameCount << " pipeline / "
+			<< drawStats.vertexBufferBinds / frameCount << " vertex / " << drawStats.indexBufferBinds / frameCount << " index binds per frame");
+	}
+	if (settings.animate) {
+		LAVA_PRINT("  Animation: " << report.animationTimeSum / frameCount << " ms sampling, blending and skinning matrices for "
+			<< skinning.skeleton.GetJointCount() << " joints");
+	}
+	if (settings.particleCount > 0) {
+		const LavaParticleCounters& counters = *static_cast<const LavaParticleCounters*>(particles.counters.data);
+		LAVA_PRINT("  Particles: " << counters.draw.instanceCount << "/" << settings.particleCount << " alive, "
+			<< counters.emittedCount << " emitted in total");
+	}
+	if (albedoTexture != LAVA_INVALID_TEXTURE) {
+		textureStreamer.PrintResidency();
+		LAVA_PRINT("  Texture uploads: " << report.textureUploadSum / frameCount / 1024 << " KB per frame");
+	}
+	uint32_t gpuFrameCount = std::max(report.gpuFrameCount, 1u);
+	for (size_t i = 0; i < report.gpuPassTimeSums.size(); i++) {
+		if (timestampPool)
+			LAVA_PRINT("  GPU " << renderGraph.GetPassName(renderGraph.GetSchedule()[i]) << ": " << report.gpuPassTimeSums[i] / gpuFrameCount << " ms");
+	}
+	if (asyncCompute.timestampPool) {
+		LAVA_PRINT("  GPU cull (async compute): " << report.asyncCullTimeSum / gpuFrameCount << " ms, " << report.asyncOverlapTimeSum / gpuFrameCount
+			<< " ms of it overlapped the previous frame's graphics");
+	}
+
+	std::vector<double> gpuPassTimeSums(report.gpuPassTimeSums.size(), 0.0);
+	report = {};
+	report.gpuPassTimeSums = std::move(gpuPassTimeSums);
+}
+
+void LavaRenderer::PrintHeadlessSummary()
+{
+	if (headlessCpuMs.empty())
+		return;
+
+	std::vector<double> sortedCpuMs = headlessCpuMs;
+	std::vector<double> sortedGpuMs = headlessGpuMs;
+	std::sort(sortedCpuMs.begin(), sortedCpuMs.end());
+	std::sort(sortedGpuMs.begin(), sortedGpuMs.end());
+	double cpuSum = 0.0;
+	for (double ms : headlessCpuMs) {
+		cpuSum += ms;
+	}
+	LAVA_PRINT("Headless: " << headlessCpuMs.size() << " frames, CPU mean " << cpuSum / headlessCpuMs.size() << " ms, median "
+		<< sortedCpuMs[sortedCpuMs.size() / 2] << " ms, max " << sortedCpuMs.back() << " ms, GPU median " << sortedGpuMs[sortedGpuMs.size() / 2] << " ms");
+#if LAVA_NULL_VULKAN
+	LAVA_PRINT("Null device calls per frame, including startup:");
+	LavaNullVulkanPrintCalls(headlessCpuMs.size());
+#endif
+}
+
+uint32_t LavaRenderer::InitVulkan(LavaTaskGraph& startup)
+{
+	uint32_t readShaders = startup.Add("Read shaders", [this]() {
+		ReadShaders();
+	});
+	uint32_t instanceStage = startup.Add("Instance", [this]() {
+		CreateInstance();
+		RegisterDebugCallback();
+		if (!settings.headless)
+			CreateSurface();
+	});
+	uint32_t device = startup.Add("Device", [this]() {
+		CreateDevice();
+		CreateQueue();
+	}, { instanceStage });
+	uint32_t formats = startup.Add("Formats", [this]() {
+		if (settings.headless) {
+			swapChainData = {};
+			swapChainData.format = VK_FORMAT_B8G8R8A8_UNORM; //Same layout the PPM dump swizzles from
+		}
+		else {
+			GetSwapchainSupportData();
+		}
+		depthFormat = SelectDepthFormat();
+	}, { device });
+	startup.Add("Swapchain", [this]() {
+		if (settings.headless)
+			CreateOffscreenTargets();
+		else
+			CreateSwapchain();
+		CreateSemaphore();
+		CreateCommandPool();
+	}, { formats });
+	uint32_t bindless = startup.Add("Bindless heap", [this]() {
+		bindlessHeap.Create(activeDevice, activePhysicalDevice, LAVA_FRAMES_IN_FLIGHT);
+	}, { device });
+	uint32_t renderPasses = startup.Add("Render passes", [this]() {
+		CreateRenderPass();
+	}, { formats });
+	uint32_t graphicsPipeline = startup.Add("Graphics pipeline", [this]() {
+		CreateGraphicsPipeline();
+	}, { renderPasses, bindless, readShaders });
+	//Shares the triangle pipeline layout.
+	if (settings.depthPrepass) {
+		startup.Add("Depth pipeline", [this]() {
+			CreateDepthPipeline();
+		}, { graphicsPipeline });
+	}
+	if (settings.gpuDriven) {
+		startup.Add("Cull pipeline", [this]() {
+			CreateCullPipeline();
+		}, { bindless, readShaders });
+	}
+	if (settings.animate) {
+		startup.Add("Skin pipeline", [this]() {
+			CreateSkinPipeline();
+		}, { bindless, readShaders });
+	}
+	if (settings.particleCount > 0) {
+		startup.Add("Particle pipelines", [this]() {
+			CreateParticlePipelines();
+		}, { renderPasses, bindless, readShaders });
+	}
+	return device;
+}
 
-	vkDestroyCommandPool(activeDevice, commandPool, 0);
+//The device is idle, see ~LavaRenderer.
+void LavaRenderer::DestroyVulkan()
+{
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyCommandPool(activeDevice, frames[i].commandPool, 0);
+	}
+	if (cachedCommandPool)
+		vkDestroyCommandPool(activeDevice, cachedCommandPool, 0);
+	if (timestampPool)
+		vkDestroyQueryPool(activeDevice, timestampPool, 0);
+	if (statisticsPool)
+		vkDestroyQueryPool(activeDevice, statisticsPool, 0);
+	statsRing.Destroy();
 
 	DestroySwapchain();
-	vkDestroySurfaceKHR(instance, surface, 0);
+	if (settings.headless)
+		DestroyOffscreenTargets();
+	bindlessHeap.Destroy();
+	if (surface)
+		vkDestroySurfaceKHR(instance, surface, 0);
 	vkDestroyDevice(activeDevice, 0);
 	
-	PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT =
-		(PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
+	if (callback) {
+		PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT =
+			(PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
 
-	vkDestroyDebugReportCallbackEXT(instance, callback, 0);
+		vkDestroyDebugReportCallbackEXT(instance, callback, 0);
+	}
 	vkDestroyInstance(instance, 0);
 }
 
@@ -250,6 +1312,7 @@ VkPhysicalDevice LavaRenderer::PickPhysicalDevice(VkPhysicalDevice* devices, uin
 
 void LavaRenderer::CreateInstance()
 {
+	LAVA_PROFILE_ZONE("CreateInstance");
 	VkApplicationInfo appInfo = {};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	appInfo.apiVersion = VK_API_VERSION_1_2;
@@ -262,16 +1325,43 @@ void LavaRenderer::CreateInstance()
 	//	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	//};
 
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-	extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+	std::vector<const char*> extensions;
+#if LAVA_GLFW
+	if (!settings.headless) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
+#endif
+
+	//Build boxes with just a software driver usually have neither the layer nor debug report, run without them there.
+	uint32_t layerCount = 0;
+	LAVA_ASSERT(vkEnumerateInstanceLayerProperties(&layerCount, 0));
+	std::vector<VkLayerProperties> layers(layerCount);
+	LAVA_ASSERT(vkEnumerateInstanceLayerProperties(&layerCount, layers.data()));
+	bool hasValidation = false;
+	for (const VkLayerProperties& layer : layers) {
+		hasValidation |= strcmp(layer.layerName, validationLayers[0]) == 0;
+	}
+
+	uint32_t extensionCount = 0;
+	LAVA_ASSERT(vkEnumerateInstanceExtensionProperties(0, &extensionCount, 0));
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	LAVA_ASSERT(vkEnumerateInstanceExtensionProperties(0, &extensionCount, availableExtensions.data()));
+	hasDebugReport = false;
+	for (const VkExtensionProperties& extension : availableExtensions) {
+		hasDebugReport |= strcmp(extension.extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) == 0;
+	}
+	if (hasDebugReport)
+		extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+	if (!hasValidation)
+		LAVA_PRINT("Validation layer not available, running without it");
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 	createInfo.ppEnabledLayerNames = validationLayers;
-	createInfo.enabledLayerCount = 1;
+	createInfo.enabledLayerCount = hasValidation ? 1 : 0;
 	createInfo.ppEnabledExtensionNames = extensions.data();
 	createInfo.enabledExtensionCount = extensions.size();
 
@@ -283,13 +1373,13 @@ void LavaRenderer::CreateInstance()
 //Cannot be an instance function somehow.
 VKAPI_ATTR VkBool32 VKAPI_CALL MyDebugReportCallback(
 	VkDebugReportFlagsEXT       flags,
-	VkDebugReportObjectTypeEXT  objectType,
-	uint64_t                    object,
-	size_t                      location,
-	int32_t                     messageCode,
-	const char* pLayerPrefix,
+	VkDebugReportObjectTypeEXT  /*objectType*/,
+	uint64_t                    /*object*/,
+	size_t                      /*location*/,
+	int32_t                     /*messageCode*/,
+	const char* /*pLayerPrefix*/,
 	const char* pMessage,
-	void* pUserData)
+	void* /*pUserData*/)
 {
 	const char* type = (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) ? "ERROR:" :
 		(flags & (VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT)) ? "WARNING:" :
@@ -304,6 +1394,9 @@ VKAPI_ATTR VkBool32 VKAPI_CALL MyDebugReportCallback(
 
 void LavaRenderer::RegisterDebugCallback()
 {
+	if (!hasDebugReport)
+		return;
+
 	VkDebugReportCallbackCreateInfoEXT  debugReportCreateInfo = {};
 	debugReportCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CREATE_INFO_EXT;
 	debugReportCreateInfo.flags =
@@ -320,6 +1413,7 @@ void LavaRenderer::RegisterDebugCallback()
 
 void LavaRenderer::CreateDevice()
 {
+	LAVA_PROFILE_ZONE("CreateDevice");
 	VkPhysicalDevice gpus[16];
 
 	uint32_t deviceCount = sizeof(gpus) / sizeof(gpus[0]);
@@ -328,28 +1422,82 @@ void LavaRenderer::CreateDevice()
 	assert(activePhysicalDevice);
 
 	SetGraphicsQueueFamily();
+	if (settings.asyncCompute && settings.gpuDriven)
+		SetComputeQueueFamily();
 
 	//VkBool32 presentationSupported = 0; //TODO: This is a HACK, fix later. We should actually check while device pick.
 	//LAVA_ASSERT(vkGetPhysicalDeviceSurfaceSupportKHR(activePhysicalDevice, queueFamilyIndex, surface, &presentationSupported) == VK_SUCCESS);
 	//LAVA_ASSERT(presentationSupported);
 
-	float queuePriorities = 1.;
-	VkDeviceQueueCreateInfo queueInfo = {};
-	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueInfo.queueCount = 1;
-	queueInfo.pQueuePriorities = &queuePriorities;
-	queueInfo.queueFamilyIndex = queueFamilyIndex;
+	//A second queue of the graphics family or one from a compute family.
+	float queuePriorities[2] = { 1.f, 1.f };
+	VkDeviceQueueCreateInfo queueInfos[2] = {};
+	uint32_t queueInfoCount = 1;
+	queueInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfos[0].queueCount = 1;
+	queueInfos[0].pQueuePriorities = queuePriorities;
+	queueInfos[0].queueFamilyIndex = queueFamilyIndex;
+	if (computeQueueFamilyIndex == queueFamilyIndex) {
+		queueInfos[0].queueCount = 2;
+	}
+	else if (computeQueueFamilyIndex != ~0u) {
+		queueInfos[1] = queueInfos[0];
+		queueInfos[1].queueFamilyIndex = computeQueueFamilyIndex;
+		queueInfoCount = 2;
+	}
 
 	const char* deviceExtensions[] = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
+	uint32_t deviceExtensionCount = settings.headless ? 0 : sizeof(deviceExtensions) / sizeof(deviceExtensions[0]);
+
+	//Descriptor indexing is core in 1.2, query and enable just what the bindless heap needs.
+	VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 supportedFeatures = {};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedFeatures12;
+	vkGetPhysicalDeviceFeatures2(activePhysicalDevice, &supportedFeatures);
+
+	if (!LavaBindlessHeap::IsSupported(supportedFeatures.features, supportedFeatures12)) {
+		LAVA_PRINT("GPU does not support the descriptor indexing the bindless heap needs");
+		throw std::runtime_error("GPU does not support descriptor indexing");
+	}
+
+	//GPU driven path: firstInstance picks the object transform, draw count comes from the cull shader when possible.
+	supportsIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+	supportsMultiDrawIndirect = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+	supportsDrawIndirectCount = supportedFeatures12.drawIndirectCount == VK_TRUE;
+	supportsPipelineStatistics = supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.descriptorIndexing = VK_TRUE;
+	features12.runtimeDescriptorArray = VK_TRUE;
+	features12.descriptorBindingPartiallyBound = VK_TRUE;
+	features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	features12.drawIndirectCount = supportsDrawIndirectCount;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+	features.features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+	features.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	features.features.drawIndirectFirstInstance = supportsIndirectFirstInstance;
+	features.features.multiDrawIndirect = supportsMultiDrawIndirect;
+	features.features.pipelineStatisticsQuery = supportsPipelineStatistics;
 
 	VkDeviceCreateInfo deviceCreateInfo = {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCreateInfo.queueCreateInfoCount = 1;
-	deviceCreateInfo.pQueueCreateInfos = &queueInfo;
+	deviceCreateInfo.pNext = &features;
+	deviceCreateInfo.queueCreateInfoCount = queueInfoCount;
+	deviceCreateInfo.pQueueCreateInfos = queueInfos;
 	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
-	deviceCreateInfo.enabledExtensionCount = sizeof(deviceExtensions) / sizeof(deviceExtensions[0]);
+	deviceCreateInfo.enabledExtensionCount = deviceExtensionCount;
 
 	LAVA_ASSERT(vkCreateDevice(activePhysicalDevice, &deviceCreateInfo, nullptr, &activeDevice));
 
@@ -358,12 +1506,15 @@ void LavaRenderer::CreateDevice()
 
 void LavaRenderer::CreateSurface()
 {
+#if LAVA_GLFW
 	LAVA_ASSERT(glfwCreateWindowSurface(instance, window, nullptr, &surface));
+#endif
 }
 
 
 void LavaRenderer::CreateSwapchain()
 {
+	LAVA_PROFILE_ZONE("CreateSwapchain");
 	//Query surface support for swapchain specs
 	VkSurfaceCapabilitiesKHR surfaceCapabilities = {};
 	LAVA_ASSERT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(activePhysicalDevice, surface, &surfaceCapabilities));
@@ -397,91 +1548,289 @@ void LavaRenderer::DestroySwapchain()
 	//	vkDestroyImage(activeDevice, swapChainData.swapChainImages[i], 0);
 	//}
 
-	for (uint32_t i = 0; i < swapChainData.frameBuffers.size(); i++) {
-		vkDestroyFramebuffer(activeDevice, swapChainData.frameBuffers[i], 0);
-	}
-
 	for (uint32_t i = 0; i < swapChainData.swapChainImageViews.size(); i++) {
 		vkDestroyImageView(activeDevice, swapChainData.swapChainImageViews[i], 0);
 	}
 
 	vkDestroyPipeline(activeDevice, trianglePipeline, 0);
 	vkDestroyPipelineLayout(activeDevice, trianglePipelineLayout, 0);
+	if (depthPipeline) {
+		vkDestroyPipeline(activeDevice, depthPipeline, 0);
+		vkDestroyShaderModule(activeDevice, depthShader, 0);
+		vkDestroyRenderPass(activeDevice, depthPrepassRenderPass, 0);
+	}
+	if (cullPipeline) {
+		vkDestroyPipeline(activeDevice, cullPipeline, 0);
+		vkDestroyPipelineLayout(activeDevice, cullPipelineLayout, 0);
+		vkDestroyShaderModule(activeDevice, cullShader, 0);
+	}
+	if (skinPipeline) {
+		vkDestroyPipeline(activeDevice, skinPipeline, 0);
+		vkDestroyPipelineLayout(activeDevice, skinPipelineLayout, 0);
+		vkDestroyShaderModule(activeDevice, skinShader, 0);
+	}
+	if (particleDrawPipeline) {
+		for (uint32_t i = 0; i < LAVA_PARTICLE_PASS_COUNT; i++) {
+			vkDestroyPipeline(activeDevice, particlePipelines[i], 0);
+			vkDestroyPipelineLayout(activeDevice, particlePipelineLayouts[i], 0);
+			vkDestroyShaderModule(activeDevice, particleShaders[i], 0);
+		}
+		vkDestroyPipeline(activeDevice, particleDrawPipeline, 0);
+		vkDestroyPipelineLayout(activeDevice, particleDrawPipelineLayout, 0);
+		vkDestroyShaderModule(activeDevice, particleVertShader, 0);
+		vkDestroyShaderModule(activeDevice, particleFragShader, 0);
+	}
 	vkDestroyShaderModule(activeDevice, vertShader, 0);
 	vkDestroyShaderModule(activeDevice, fragShader, 0);
 	vkDestroyRenderPass(activeDevice, renderPass, 0);
-	vkDestroySemaphore(activeDevice, acquireSemaphore, 0);
-	vkDestroySemaphore(activeDevice, releaseSemaphore, 0);
-	vkDestroySwapchainKHR(activeDevice, swapChain, 0);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		vkDestroySemaphore(activeDevice, frames[i].acquireSemaphore, 0);
+		vkDestroySemaphore(activeDevice, frames[i].releaseSemaphore, 0);
+		vkDestroyFence(activeDevice, frames[i].fence, 0);
+	}
+	if (swapChain)
+		vkDestroySwapchainKHR(activeDevice, swapChain, 0);
+}
+
+//Headless stand ins for the swapchain images, rendered into like them and copied to the readback buffer.
+void LavaRenderer::CreateOffscreenTargets()
+{
+	LAVA_PROFILE_ZONE("CreateOffscreenTargets");
+	swapChainData.width = frameBufferWidth;
+	swapChainData.height = frameBufferHeight;
+
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = swapChainData.format;
+		imageCreateInfo.extent.width = frameBufferWidth;
+		imageCreateInfo.extent.height = frameBufferHeight;
+		imageCreateInfo.extent.depth = 1;
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image = VK_NULL_HANDLE;
+		LAVA_ASSERT(vkCreateImage(activeDevice, &imageCreateInfo, 0, &image));
+
+		VkMemoryRequirements memoryRequirements = {};
+		vkGetImageMemoryRequirements(activeDevice, image, &memoryRequirements);
+
+		VkMemoryAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocateInfo.allocationSize = memoryRequirements.size;
+		allocateInfo.memoryTypeIndex = SelectBufferMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		assert(allocateInfo.memoryTypeIndex != ~0u);
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		LAVA_ASSERT(vkAllocateMemory(activeDevice, &allocateInfo, 0, &memory));
+		memoryAllocationCount++;
+		LAVA_ASSERT(vkBindImageMemory(activeDevice, image, memory, 0));
+
+		swapChainData.swapChainImages.push_back(image);
+		offscreenMemory.push_back(memory);
+	}
+
+	//Tightly packed BGRA rows, every frame is copied into its slot's buffer and read once the frame has finished.
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		CreateBuffer(frames[i].readbackBuffer, size_t(frameBufferWidth) * frameBufferHeight * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	}
+}
+
+//Image views go with the swapchain ones in DestroySwapchain.
+void LavaRenderer::DestroyOffscreenTargets()
+{
+	for (size_t i = 0; i < swapChainData.swapChainImages.size(); i++) {
+		vkDestroyImage(activeDevice, swapChainData.swapChainImages[i], 0);
+		vkFreeMemory(activeDevice, offscreenMemory[i], 0);
+	}
+	swapChainData.swapChainImages.clear();
+	offscreenMemory.clear();
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		DestroyBuffer(frames[i].readbackBuffer);
+		frames[i].readbackBuffer = {};
+	}
 }
 
+//Binary PPM of a finished frame's readback buffer.
+void LavaRenderer::WriteFrameImage(const char* path, const LavaGpuBuffer& readbackBuffer)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		LAVA_PRINT("Could not write " << path);
+		return;
+	}
+	fprintf(file, "P6\n%u %u\n255\n", frameBufferWidth, frameBufferHeight);
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(readbackBuffer.data);
+	std::vector<uint8_t> row(size_t(frameBufferWidth) * 3);
+	for (uint32_t y = 0; y < frameBufferHeight; y++) {
+		const uint8_t* source = pixels + size_t(y) * frameBufferWidth * 4;
+		for (uint32_t x = 0; x < frameBufferWidth; x++) {
+			row[x * 3 + 0] = source[x * 4 + 2];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 0];
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+}
+
+//Fences start out unsignaled, a slot only waits once a frame was submitted to it.
 void LavaRenderer::CreateSemaphore()
 {
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	LAVA_ASSERT(vkCreateSemaphore(activeDevice, &semaphoreCreateInfo, nullptr, &acquireSemaphore));
-
-	LAVA_ASSERT(vkCreateSemaphore(activeDevice, &semaphoreCreateInfo, nullptr, &releaseSemaphore));
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LAVA_ASSERT(vkCreateSemaphore(activeDevice, &semaphoreCreateInfo, nullptr, &frames[i].acquireSemaphore));
+		LAVA_ASSERT(vkCreateSemaphore(activeDevice, &semaphoreCreateInfo, nullptr, &frames[i].releaseSemaphore));
+		LAVA_ASSERT(vkCreateFence(activeDevice, &fenceCreateInfo, nullptr, &frames[i].fence));
+		frames[i].pending = false;
+	}
 }
 
 void LavaRenderer::CreateQueue()
 {
 	vkGetDeviceQueue(activeDevice, queueFamilyIndex, 0, &queue);
+	if (computeQueueFamilyIndex != ~0u)
+		vkGetDeviceQueue(activeDevice, computeQueueFamilyIndex, computeQueueIndex, &computeQueue);
 }
 
 void LavaRenderer::CreateCommandPool()
 {
-	uint32_t swapChainImageCount = 0;
-	LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, 0));
-	swapChainData.swapChainImages = std::vector<VkImage>(swapChainImageCount);
+	LAVA_PROFILE_ZONE("CreateCommandPool");
+	//Headless images were created with the offscreen targets.
+	uint32_t swapChainImageCount = uint32_t(swapChainData.swapChainImages.size());
+	if (!settings.headless) {
+		LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, 0));
+		swapChainData.swapChainImages = std::vector<VkImage>(swapChainImageCount);
+
+		LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, swapChainData.swapChainImages.data()));
+		//LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, 0) == VK_SUCCESS);
+	}
 	swapChainData.swapChainImageViews = std::vector<VkImageView>(swapChainImageCount);
-	swapChainData.frameBuffers = std::vector<VkFramebuffer>(swapChainImageCount);
-
-	LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, swapChainData.swapChainImages.data()));
-	//LAVA_ASSERT(vkGetSwapchainImagesKHR(activeDevice, swapChain, &swapChainImageCount, 0) == VK_SUCCESS);
 
 	for (uint32_t i = 0; i < swapChainImageCount; i++) {
 		swapChainData.swapChainImageViews[i] = CreateImageView(swapChainData.swapChainImages[i]);
 	}
 
-	for (uint32_t i = 0; i < swapChainImageCount; i++) {
-		swapChainData.frameBuffers[i] = CreateFrameBuffer(swapChainData.swapChainImageViews[i]);
-	}
-
+	//A pool per frame in flight, a frame resets its own while the other one may still execute.
 	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
 	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
 
-	LAVA_ASSERT(vkCreateCommandPool(activeDevice, &commandPoolCreateInfo, nullptr, &commandPool));
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LAVA_ASSERT(vkCreateCommandPool(activeDevice, &commandPoolCreateInfo, nullptr, &frames[i].commandPool));
+
+		VkCommandBufferAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = frames[i].commandPool;
+		allocateInfo.commandBufferCount = 1;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		LAVA_ASSERT(vkAllocateCommandBuffers(activeDevice, &allocateInfo, &frames[i].commandBuffer));
+	}
 }
 
-void LavaRenderer::CreateRenderPass()
+//Host written copies of what changes per frame. Every copy of the instance stream starts out with all instances.
+void LavaRenderer::CreateFrameData()
 {
-	//Create attachment
-	VkAttachmentDescription attachments[1] = {};
-
-	attachments[0].format = swapChainData.format;
-	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LavaFrameResources& frame = frames[i];
+		CreateBuffer(frame.instanceBuffer, instances.size() * sizeof(LavaInstance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		memcpy(frame.instanceBuffer.data, instances.data(), instances.size() * sizeof(LavaInstance));
+		frame.instancesStale = false;
+		CreateBuffer(frame.frameData, sizeof(LavaFrameData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		frame.frameDataIndex = bindlessHeap.RegisterBuffer(frame.frameData.buffer);
+	}
+	drawConstants.frameBuffer = frames[0].frameDataIndex;
+}
 
-	//These allow us to clear the screen and render in a single pass.
-	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+void LavaRenderer::DestroyFrameData()
+{
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, frames[i].frameDataIndex);
+		DestroyBuffer(frames[i].frameData);
+		DestroyBuffer(frames[i].instanceBuffer);
+	}
+}
 
-	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+//One command buffer per swapchain image and frame slot, from a pool that allows resetting them one by one.
+void LavaRenderer::CreateCachedCommandBuffers()
+{
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+	LAVA_ASSERT(vkCreateCommandPool(activeDevice, &commandPoolCreateInfo, nullptr, &cachedCommandPool));
+
+	std::vector<VkCommandBuffer> commandBuffers(swapChainData.swapChainImages.size() * LAVA_FRAMES_IN_FLIGHT);
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = cachedCommandPool;
+	allocateInfo.commandBufferCount = uint32_t(commandBuffers.size());
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	LAVA_ASSERT(vkAllocateCommandBuffers(activeDevice, &allocateInfo, commandBuffers.data()));
+
+	cachedCommandBuffers.resize(commandBuffers.size());
+	for (size_t i = 0; i < commandBuffers.size(); i++) {
+		cachedCommandBuffers[i].commandBuffer = commandBuffers[i];
+		cachedCommandBuffers[i].stateHash = 0;
+		cachedCommandBuffers[i].recorded = false;
+		cachedCommandBuffers[i].drawStats = {};
+	}
+}
+
+void LavaRenderer::CreateRenderPass()
+{
+	LAVA_PROFILE_ZONE("CreateRenderPass");
+	//Create attachment
+	VkAttachmentDescription attachments[2] = {};
+
+	attachments[0].format = swapChainData.format;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+
+	//These allow us to clear the screen and render in a single pass.
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	//Layout transitions are done by the render graph, the pass keeps the attachment in its layout.
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	//After a prepass depth is only tested, otherwise cleared and written here. Nobody reads it after the frame.
+	VkImageLayout depthLayout = settings.depthPrepass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachments[1].format = depthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = settings.depthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = depthLayout;
+	attachments[1].finalLayout = depthLayout;
+
 	VkAttachmentReference colorAttachments;
 	colorAttachments.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	colorAttachments.attachment = 0; //attachment index at the top(which is 0)
 
+	VkAttachmentReference depthAttachment;
+	depthAttachment.layout = depthLayout;
+	depthAttachment.attachment = 1;
+
 	VkSubpassDescription subpass = {};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.pColorAttachments = &colorAttachments;
 	subpass.colorAttachmentCount = 1;
+	subpass.pDepthStencilAttachment = &depthAttachment;
 
 
 	VkRenderPassCreateInfo renderPassCreateInfo = {};
@@ -492,12 +1841,34 @@ void LavaRenderer::CreateRenderPass()
 	renderPassCreateInfo.pSubpasses = &subpass;
 
 	LAVA_ASSERT(vkCreateRenderPass(activeDevice, &renderPassCreateInfo, nullptr, &renderPass));
+
+	if (!settings.depthPrepass)
+		return;
+
+	//Depth only pass, its result is kept for the main pass.
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.attachment = 0;
+
+	VkSubpassDescription depthSubpass = {};
+	depthSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	depthSubpass.pDepthStencilAttachment = &depthAttachment;
+
+	renderPassCreateInfo.attachmentCount = 1;
+	renderPassCreateInfo.pAttachments = &attachments[1];
+	renderPassCreateInfo.pSubpasses = &depthSubpass;
+
+	LAVA_ASSERT(vkCreateRenderPass(activeDevice, &renderPassCreateInfo, nullptr, &depthPrepassRenderPass));
 }
 
 void LavaRenderer::CreateGraphicsPipeline()
 {
-	vertShader = LoadShader("shaders/triangle.vert.spv");
-	fragShader = LoadShader("shaders/triangle.frag.spv");
+	LAVA_PROFILE_ZONE("CreateGraphicsPipeline");
+	vertShader = LoadShader("triangle.vert.spv");
+	fragShader = LoadShader("triangle.frag.spv");
 	VkPipelineCache pipelineCache = 0;//critical for performance, fill later, don't leave zero inited
 
 	VkPipelineShaderStageCreateInfo stages[2] = {};
@@ -514,12 +1885,16 @@ void LavaRenderer::CreateGraphicsPipeline()
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {}; //Probably fill this when switch to VBOs
 	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-	VkVertexInputBindingDescription stream = {};
-	stream.binding = 0;
-	stream.stride = sizeof(Vertex);
-	stream.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	VkVertexInputBindingDescription streams[2] = {};
+	streams[0].binding = 0;
+	streams[0].stride = sizeof(Vertex);
+	streams[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	streams[1].binding = 1;
+	streams[1].stride = sizeof(LavaInstance);
+	streams[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-	VkVertexInputAttributeDescription attribs[3] = {};
+	VkVertexInputAttributeDescription attribs[8] = {};
 	attribs[0].location = 0;
 	attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT; // 3 floats
 	attribs[0].offset = 0;
@@ -532,34 +1907,37 @@ void LavaRenderer::CreateGraphicsPipeline()
 	attribs[2].format = VK_FORMAT_R32G32_SFLOAT; // 2 floats
 	attribs[2].offset = 24;
 
-	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1; //buffer count
-	vertexInputStateCreateInfo.pVertexBindingDescriptions = &stream;
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount=3;
+	//Instance stream: 3 transform rows, material index, color
+	for (uint32_t i = 0; i < 3; i++) {
+		attribs[3 + i].location = 3 + i;
+		attribs[3 + i].binding = 1;
+		attribs[3 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribs[3 + i].offset = offsetof(LavaInstance, transform) + i * sizeof(glm::vec4);
+	}
+
+	attribs[6].location = 6;
+	attribs[6].binding = 1;
+	attribs[6].format = VK_FORMAT_R32_UINT;
+	attribs[6].offset = offsetof(LavaInstance, materialIndex);
+
+	attribs[7].location = 7;
+	attribs[7].binding = 1;
+	attribs[7].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attribs[7].offset = offsetof(LavaInstance, color);
+
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 2; //buffer count
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = streams;
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = sizeof(attribs) / sizeof(attribs[0]);
 	vertexInputStateCreateInfo.pVertexAttributeDescriptions = attribs;
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
 	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-	VkViewport viewPort = {};
-	viewPort.width = frameBufferWidth;
-	viewPort.height = frameBufferHeight;
-	viewPort.x = 0.f;
-	viewPort.y = 0.f;
-	viewPort.minDepth = 0.f;
-	viewPort.maxDepth = 1.f;
-
-	VkRect2D scissors = {};
-	scissors.extent.width = frameBufferWidth;
-	scissors.extent.height = frameBufferHeight;
-	scissors.offset.x = 0;
-	scissors.offset.y = 0;
-
+	//Viewport and scissor are dynamic state, set when recording.
 	VkPipelineViewportStateCreateInfo viewPortCreateInfo = {};
 	viewPortCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	//viewPortCreateInfo.pViewports = &viewPort;
 	viewPortCreateInfo.viewportCount = 1;
-	//viewPortCreateInfo.pScissors = &scissors;
 	viewPortCreateInfo.scissorCount = 1;
 
 	VkPipelineRasterizationStateCreateInfo rasterCreateInfo = {};
@@ -570,8 +1948,12 @@ void LavaRenderer::CreateGraphicsPipeline()
 	multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+	//With a prepass every visible pixel already has its final depth, EQUAL shades it exactly once.
 	VkPipelineDepthStencilStateCreateInfo stencilCreateInfo = {};
 	stencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	stencilCreateInfo.depthTestEnable = VK_TRUE;
+	stencilCreateInfo.depthWriteEnable = settings.depthPrepass ? VK_FALSE : VK_TRUE;
+	stencilCreateInfo.depthCompareOp = settings.depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
 
 	VkPipelineColorBlendAttachmentState colorAttachments = {};
 	colorAttachments.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
@@ -602,8 +1984,20 @@ void LavaRenderer::CreateGraphicsPipeline()
 	dynamicStateCreateInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
 
 	//Define input resources, like textures etc. Thats where you specify it.
+	//Everything goes through the bindless set, per draw data is just push constant indices.
+	VkDescriptorSetLayout bindlessLayout = bindlessHeap.GetLayout();
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(LavaDrawConstants);
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	LAVA_ASSERT(vkCreatePipelineLayout(activeDevice, &pipelineLayoutCreateInfo, nullptr, &trianglePipelineLayout));
 
@@ -625,14 +2019,165 @@ void LavaRenderer::CreateGraphicsPipeline()
 	LAVA_ASSERT(vkCreateGraphicsPipelines(activeDevice, pipelineCache, 1, &createInfo, nullptr, &trianglePipeline));
 }
 
-VkFramebuffer LavaRenderer::CreateFrameBuffer(VkImageView imageView)
+void LavaRenderer::CreateDepthPipeline()
+{
+	LAVA_PROFILE_ZONE("CreateDepthPipeline");
+	depthShader = LoadShader("depth.vert.spv");
+
+	VkPipelineShaderStageCreateInfo stage = {};
+	stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stage.module = depthShader;
+	stage.pName = "main";
+
+	//Tight position stream plus the transform rows of the instance stream.
+	VkVertexInputBindingDescription streams[2] = {};
+	streams[0].binding = 0;
+	streams[0].stride = sizeof(Vec3);
+	streams[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	streams[1].binding = 1;
+	streams[1].stride = sizeof(LavaInstance);
+	streams[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription attribs[4] = {};
+	attribs[0].location = 0;
+	attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attribs[0].offset = 0;
+
+	for (uint32_t i = 0; i < 3; i++) {
+		attribs[1 + i].location = 3 + i;
+		attribs[1 + i].binding = 1;
+		attribs[1 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribs[1 + i].offset = offsetof(LavaInstance, transform) + i * sizeof(glm::vec4);
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
+	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 2;
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = streams;
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = sizeof(attribs) / sizeof(attribs[0]);
+	vertexInputStateCreateInfo.pVertexAttributeDescriptions = attribs;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewPortCreateInfo = {};
+	viewPortCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewPortCreateInfo.viewportCount = 1;
+	viewPortCreateInfo.scissorCount = 1;
+
+	//Same raster state as the main pipeline, otherwise the EQUAL test drops pixels.
+	VkPipelineRasterizationStateCreateInfo rasterCreateInfo = {};
+	rasterCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterCreateInfo.lineWidth = 1.f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
+	multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo stencilCreateInfo = {};
+	stencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	stencilCreateInfo.depthTestEnable = VK_TRUE;
+	stencilCreateInfo.depthWriteEnable = VK_TRUE;
+	stencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
+	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+	dynamicStateCreateInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+
+	//Shares the main layout, the draw constants are pushed once for both passes.
+	VkGraphicsPipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	createInfo.stageCount = 1;
+	createInfo.pStages = &stage;
+	createInfo.pVertexInputState = &vertexInputStateCreateInfo;
+	createInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	createInfo.pRasterizationState = &rasterCreateInfo;
+	createInfo.pViewportState = &viewPortCreateInfo;
+	createInfo.pMultisampleState = &multisampleStateCreateInfo;
+	createInfo.pDepthStencilState = &stencilCreateInfo;
+	createInfo.pColorBlendState = &colorBlendCreateInfo;
+	createInfo.pDynamicState = &dynamicStateCreateInfo;
+	createInfo.renderPass = depthPrepassRenderPass;
+	createInfo.layout = trianglePipelineLayout;
+
+	LAVA_ASSERT(vkCreateGraphicsPipelines(activeDevice, 0, 1, &createInfo, nullptr, &depthPipeline));
+}
+
+VkFormat LavaRenderer::SelectDepthFormat()
+{
+	//Most precise format first, stencil formats only as fallbacks since nothing uses stencil.
+	const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D32_SFLOAT_S8_UINT,
+		VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM };
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(activePhysicalDevice, format, &properties);
+		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			return format;
+	}
+
+	assert(!"No depth format supported");
+	return VK_FORMAT_D16_UNORM;
+}
+
+//queryCount per frame, each frame in flight writes its own range.
+void LavaRenderer::CreateTimestampPool(uint32_t queryCount)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(activePhysicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queueFamilyCount, 0);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	if (queueFamilies[queueFamilyIndex].timestampValidBits == 0) {
+		LAVA_PRINT("Timestamps not supported on the graphics queue, no GPU pass timings");
+		return;
+	}
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = queryCount * LAVA_FRAMES_IN_FLIGHT;
+	LAVA_ASSERT(vkCreateQueryPool(activeDevice, &queryPoolCreateInfo, nullptr, &timestampPool));
+}
+
+void LavaRenderer::CreateStatisticsPool()
+{
+	if (!supportsPipelineStatistics) {
+		LAVA_PRINT("Pipeline statistics queries not supported, frame stats without them");
+		return;
+	}
+
+	//Results come back in bit order, LavaFrameStats reads them in the same order.
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	queryPoolCreateInfo.queryCount = LAVA_FRAMES_IN_FLIGHT;
+	queryPoolCreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	LAVA_ASSERT(vkCreateQueryPool(activeDevice, &queryPoolCreateInfo, nullptr, &statisticsPool));
+}
+
+VkFramebuffer LavaRenderer::CreateFrameBuffer(VkRenderPass pass, const VkImageView* attachments, uint32_t attachmentCount)
 {
 	VkFramebuffer frameBuffer = 0;
 	VkFramebufferCreateInfo frameBufferCreateInfo = {};
 	frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	frameBufferCreateInfo.renderPass = renderPass;
-	frameBufferCreateInfo.attachmentCount = 1;
-	frameBufferCreateInfo.pAttachments = &imageView;
+	frameBufferCreateInfo.renderPass = pass;
+	frameBufferCreateInfo.attachmentCount = attachmentCount;
+	frameBufferCreateInfo.pAttachments = attachments;
 	frameBufferCreateInfo.width = frameBufferWidth;
 	frameBufferCreateInfo.height = frameBufferHeight;
 	frameBufferCreateInfo.layers = 1;
@@ -641,6 +2186,31 @@ VkFramebuffer LavaRenderer::CreateFrameBuffer(VkImageView imageView)
 	return frameBuffer;
 }
 
+//Depth is a render graph transient, so framebuffers can only be made once the graph created it.
+void LavaRenderer::CreateFrameBuffers(VkImageView depthView)
+{
+	swapChainData.frameBuffers = std::vector<VkFramebuffer>(swapChainData.swapChainImageViews.size());
+	for (size_t i = 0; i < swapChainData.frameBuffers.size(); i++) {
+		VkImageView attachments[] = { swapChainData.swapChainImageViews[i], depthView };
+		swapChainData.frameBuffers[i] = CreateFrameBuffer(renderPass, attachments, 2);
+	}
+
+	if (settings.depthPrepass)
+		depthFrameBuffer = CreateFrameBuffer(depthPrepassRenderPass, &depthView, 1);
+}
+
+void LavaRenderer::DestroyFrameBuffers()
+{
+	for (uint32_t i = 0; i < swapChainData.frameBuffers.size(); i++) {
+		vkDestroyFramebuffer(activeDevice, swapChainData.frameBuffers[i], 0);
+	}
+	swapChainData.frameBuffers.clear();
+
+	if (depthFrameBuffer)
+		vkDestroyFramebuffer(activeDevice, depthFrameBuffer, 0);
+	depthFrameBuffer = VK_NULL_HANDLE;
+}
+
 VkImageView LavaRenderer::CreateImageView(VkImage image)
 {
 	VkImageViewCreateInfo imageViewCreateInfo = {};
@@ -658,25 +2228,6 @@ VkImageView LavaRenderer::CreateImageView(VkImage image)
 	return imageView;
 }
 
-VkImageMemoryBarrier LavaRenderer::PipelineBarrierImage(VkImage image, ImageLayout sourceLayout, ImageLayout targetLayout)
-{
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.srcAccessMask = sourceLayout.AccessMask;
-	barrier.dstAccessMask = targetLayout.AccessMask;
-	barrier.oldLayout = sourceLayout.Layout;
-	barrier.newLayout = targetLayout.Layout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	//BUG: Some android drivers don't support these constants
-	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;  
-	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-	return barrier;
-}
-
 uint32_t LavaRenderer::SelectBufferMemoryTypeIndex(uint32_t requiredMemoryTypeBits, VkMemoryPropertyFlags requiredFlags)
 {
 	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
@@ -687,12 +2238,782 @@ uint32_t LavaRenderer::SelectBufferMemoryTypeIndex(uint32_t requiredMemoryTypeBi
 	return ~0u;
 }
 
-void LavaRenderer::CreateBuffer(LavaGpuBuffer& gpuBuffer, size_t size, VkBufferUsageFlags usageFlags)
+LavaCamera LavaRenderer::GetCamera(float time)
+{
+	//Orbit on the scene bounding sphere looking at the center, so big scenes are partly out of view.
+	float distance = sceneRadius;
+	LavaCamera camera;
+	camera.position = glm::vec3(sinf(time * 0.2f) * distance, 0.f, cosf(time * 0.2f) * distance);
+
+	glm::mat4 view = glm::lookAt(camera.position, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), float(frameBufferWidth) / float(frameBufferHeight),
+		0.1f, distance + sceneRadius * 2.f);
+	projection[1][1] *= -1.f; //Vulkan y points down
+
+	camera.viewProjection = projection * view;
+	return camera;
+}
+
+void LavaRenderer::CreateCullPipeline()
+{
+	LAVA_PROFILE_ZONE("CreateCullPipeline");
+	CreateComputePipeline("cull.comp.spv", sizeof(LavaCullConstants), cullShader, cullPipelineLayout, cullPipeline);
+}
+
+//Compute shaders reach everything through the bindless set, the layout only differs in the push constant size.
+void LavaRenderer::CreateComputePipeline(const char* shaderName, uint32_t constantsSize, VkShaderModule& shader, VkPipelineLayout& pipelineLayout,
+	VkPipeline& pipeline)
+{
+	shader = LoadShader(shaderName);
+
+	VkDescriptorSetLayout bindlessLayout = bindlessHeap.GetLayout();
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = constantsSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	LAVA_ASSERT(vkCreatePipelineLayout(activeDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	createInfo.stage.module = shader;
+	createInfo.stage.pName = "main";
+	createInfo.layout = pipelineLayout;
+
+	LAVA_ASSERT(vkCreateComputePipelines(activeDevice, 0, 1, &createInfo, nullptr, &pipeline));
+}
+
+void LavaRenderer::CreateGpuDrivenData(const Mesh& mesh, const Mesh& lodMesh)
+{
+	LAVA_PROFILE_ZONE("CreateGpuDrivenData");
+	uint32_t objectCount = uint32_t(instances.size());
+
+	//Single mesh, the full LOD up close and the clustered one, if any, past 16 radii. There the mesh is about a
+	//tenth of the screen height high.
+	LavaGpuMesh gpuMesh = {};
+	gpuMesh.lodCount = 1;
+	gpuMesh.lods[0].indexCount = uint32_t(mesh.indices.size());
+	gpuMesh.lods[0].firstIndex = 0;
+	gpuMesh.lods[0].vertexOffset = 0;
+	gpuMesh.lods[0].maxDistance = FLT_MAX;
+	if (!lodMesh.indices.empty()) {
+		gpuMesh.lodCount = 2;
+		gpuMesh.lods[0].maxDistance = 16.f * meshSphere.w;
+		gpuMesh.lods[1].indexCount = uint32_t(lodMesh.indices.size());
+		gpuMesh.lods[1].firstIndex = uint32_t(mesh.indices.size());
+		gpuMesh.lods[1].vertexOffset = int32_t(mesh.vertices.size());
+		gpuMesh.lods[1].maxDistance = FLT_MAX;
+		LAVA_PRINT("GPU driven LODs: " << mesh.indices.size() / 3 << " and " << lodMesh.indices.size() / 3 << " triangles, switching at "
+			<< gpuMesh.lods[0].maxDistance);
+	}
+
+	CreateBuffer(gpuDriven.meshes, sizeof(LavaGpuMesh), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(gpuDriven.meshes.data, &gpuMesh, sizeof(LavaGpuMesh));
+
+	CreateBuffer(gpuDriven.objects, objectCount * sizeof(LavaObjectData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	LavaObjectData* objects = static_cast<LavaObjectData*>(gpuDriven.objects.data);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		const LavaInstance& instance = instances[i];
+		glm::vec3 translation(instance.transform[0].w, instance.transform[1].w, instance.transform[2].w);
+
+		objects[i] = {};
+		objects[i].boundingSphere = glm::vec4(glm::vec3(meshSphere) + translation, meshSphere.w);
+		objects[i].meshIndex = 0;
+	}
+
+	//Async compute writes the draws on the compute queue, graphics reads them.
+	uint32_t objectBuffer = bindlessHeap.RegisterBuffer(gpuDriven.objects.buffer);
+	uint32_t meshBuffer = bindlessHeap.RegisterBuffer(gpuDriven.meshes.buffer);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LavaCullSlot& slot = gpuDriven.slots[i];
+		CreateBuffer(slot.cullView, sizeof(LavaCullView), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		CreateBuffer(slot.drawCommands, objectCount * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, true);
+		CreateBuffer(slot.drawCount, sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, true);
+
+		slot.constants.viewBuffer = bindlessHeap.RegisterBuffer(slot.cullView.buffer);
+		slot.constants.objectBuffer = objectBuffer;
+		slot.constants.meshBuffer = meshBuffer;
+		slot.constants.commandBuffer = bindlessHeap.RegisterBuffer(slot.drawCommands.buffer);
+		slot.constants.countBuffer = bindlessHeap.RegisterBuffer(slot.drawCount.buffer);
+		slot.constants.objectCount = objectCount;
+		slot.constants.compact = supportsDrawIndirectCount ? 1 : 0;
+	}
+}
+
+void LavaRenderer::DestroyGpuDrivenData()
+{
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, gpuDriven.slots[0].constants.objectBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, gpuDriven.slots[0].constants.meshBuffer);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LavaCullSlot& slot = gpuDriven.slots[i];
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, slot.constants.viewBuffer);
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, slot.constants.commandBuffer);
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, slot.constants.countBuffer);
+		DestroyBuffer(slot.cullView);
+		DestroyBuffer(slot.drawCommands);
+		DestroyBuffer(slot.drawCount);
+	}
+
+	DestroyBuffer(gpuDriven.objects);
+	DestroyBuffer(gpuDriven.meshes);
+}
+
+void LavaRenderer::UpdateCullView(const LavaCamera& camera, uint32_t slot)
+{
+	LavaCullView* view = static_cast<LavaCullView*>(gpuDriven.slots[slot].cullView.data);
+	view->frustum = ExtractFrustum(camera.viewProjection);
+	view->cameraPosition = glm::vec4(camera.position, 1.f);
+}
+
+//Draw count clear and the barriers around the dispatch come from the render graph, or SubmitAsyncCull.
+void LavaRenderer::RecordCullPass(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	const LavaCullConstants& constants = gpuDriven.slots[slot].constants;
+	VkDescriptorSet bindlessSet = bindlessHeap.GetSet();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &bindlessSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LavaCullConstants), &constants);
+	vkCmdDispatch(commandBuffer, (constants.objectCount + 63) / 64, 1, 1);
+}
+
+void LavaRenderer::RecordIndirectDraws(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	const LavaCullSlot& cullSlot = gpuDriven.slots[slot];
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	uint32_t maxDrawCount = cullSlot.constants.objectCount;
+
+	if (supportsDrawIndirectCount) {
+		vkCmdDrawIndexedIndirectCount(commandBuffer, cullSlot.drawCommands.buffer, 0, cullSlot.drawCount.buffer, 0, maxDrawCount, stride);
+	}
+	else if (supportsMultiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, cullSlot.drawCommands.buffer, 0, maxDrawCount, stride);
+	}
+	else {
+		for (uint32_t i = 0; i < maxDrawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, cullSlot.drawCommands.buffer, i * stride, 1, stride);
+		}
+	}
+}
+
+void LavaRenderer::CreateAsyncCompute()
+{
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = computeQueueFamilyIndex;
+	LAVA_ASSERT(vkCreateCommandPool(activeDevice, &commandPoolCreateInfo, nullptr, &asyncCompute.commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = asyncCompute.commandPool;
+	allocateInfo.commandBufferCount = LAVA_FRAMES_IN_FLIGHT;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	LAVA_ASSERT(vkAllocateCommandBuffers(activeDevice, &allocateInfo, asyncCompute.commandBuffers));
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		LAVA_ASSERT(vkCreateSemaphore(activeDevice, &semaphoreCreateInfo, nullptr, &asyncCompute.cullDone[i]));
+		LAVA_ASSERT(vkCreateFence(activeDevice, &fenceCreateInfo, nullptr, &asyncCompute.fences[i]));
+		asyncCompute.pending[i] = false;
+	}
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queueFamilyCount, 0);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queueFamilyCount, queueFamilies.data());
+	if (timestampPool && queueFamilies[computeQueueFamilyIndex].timestampValidBits) {
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = 2 * LAVA_FRAMES_IN_FLIGHT;
+		LAVA_ASSERT(vkCreateQueryPool(activeDevice, &queryPoolCreateInfo, nullptr, &asyncCompute.timestampPool));
+	}
+}
+
+void LavaRenderer::DestroyAsyncCompute()
+{
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		vkDestroySemaphore(activeDevice, asyncCompute.cullDone[i], 0);
+		vkDestroyFence(activeDevice, asyncCompute.fences[i], 0);
+	}
+	if (asyncCompute.timestampPool)
+		vkDestroyQueryPool(activeDevice, asyncCompute.timestampPool, 0);
+	vkDestroyCommandPool(activeDevice, asyncCompute.commandPool, 0);
+	asyncCompute = {};
+}
+
+//Clears the slot's draw count and culls into it on the compute queue, signaling the slot's semaphore for the
+//graphics submit that draws it. Timestamps bracket the work so the overlap with graphics can be measured.
+void LavaRenderer::SubmitAsyncCull(uint32_t slot)
+{
+	LAVA_PROFILE_ZONE("Async cull submit");
+	WaitAsyncCull(slot);
+	const LavaCullSlot& cullSlot = gpuDriven.slots[slot];
+	VkCommandBuffer commandBuffer = asyncCompute.commandBuffers[slot];
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	LAVA_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+	if (asyncCompute.timestampPool) {
+		vkCmdResetQueryPool(commandBuffer, asyncCompute.timestampPool, slot * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, asyncCompute.timestampPool, slot * 2);
+	}
+
+	vkCmdFillBuffer(commandBuffer, cullSlot.drawCount.buffer, 0, sizeof(uint32_t), 0);
+	VkMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, 0, 0, 0);
+
+	RecordCullPass(commandBuffer, slot);
+
+	//The semaphore makes the draws visible to the indirect stage, validation also reads them on the host.
+	if (settings.validateGpuCulling) {
+		VkMemoryBarrier hostBarrier = {};
+		hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+	}
+	if (asyncCompute.timestampPool)
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, asyncCompute.timestampPool, slot * 2 + 1);
+	LAVA_ASSERT(vkEndCommandBuffer(commandBuffer));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &asyncCompute.cullDone[slot];
+	LAVA_ASSERT(vkQueueSubmit(computeQueue, 1, &submitInfo, asyncCompute.fences[slot]));
+	asyncCompute.pending[slot] = true;
+}
+
+//The compute queue only runs the cull, waiting for it doesn't wait for any graphics work.
+void LavaRenderer::WaitAsyncCull(uint32_t slot)
+{
+	if (!asyncCompute.pending[slot])
+		return;
+	LAVA_ASSERT(vkWaitForFences(activeDevice, 1, &asyncCompute.fences[slot], VK_TRUE, UINT64_MAX));
+	LAVA_ASSERT(vkResetFences(activeDevice, 1, &asyncCompute.fences[slot]));
+	asyncCompute.pending[slot] = false;
+}
+
+void LavaRenderer::CullOccluded(const LavaCamera& camera)
+{
+	const uint32_t maxOccluders = 64;
+	uint32_t visibleCount = uint32_t(visibleInstances.size());
+
+	occlusion.visibleBounds.resize(visibleCount);
+	occlusion.occluderCandidates.resize(visibleCount);
+	jobSystem.ParallelFor(visibleCount, 1024, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			glm::vec4 sphere = TransformBoundingSphere(scene.GetWorldTransform(visibleInstances[i]), occlusion.meshSphere);
+			occlusion.visibleBounds[i] = SphereBounds(sphere);
+			occlusion.occluderCandidates[i] = std::make_pair(glm::length(glm::vec3(sphere) - camera.position), visibleInstances[i]);
+		}
+	});
+
+	//Nearest visible instances occlude the most screen.
+	uint32_t occluderCount = std::min(maxOccluders, visibleCount);
+	std::partial_sort(occlusion.occluderCandidates.begin(), occlusion.occluderCandidates.begin() + occluderCount, occlusion.occluderCandidates.end());
+
+	occlusion.culler.BeginFrame(camera.viewProjection);
+	for (uint32_t i = 0; i < occluderCount; i++) {
+		const LavaAffineTransform& world = scene.GetWorldTransform(occlusion.occluderCandidates[i].second);
+
+		LavaOccluder occluder;
+		occluder.positions = &occlusion.occluderPositions[0].x;
+		occluder.positionStride = sizeof(glm::vec3);
+		occluder.indices = occlusion.occluderIndices.data();
+		occluder.indexCount = uint32_t(occlusion.occluderIndices.size());
+		occluder.world = glm::transpose(glm::mat4(world.rows[0], world.rows[1], world.rows[2], glm::vec4(0.f, 0.f, 0.f, 1.f)));
+		occlusion.culler.AddOccluder(occluder);
+	}
+	occlusion.culler.Rasterize(&jobSystem);
+
+	occlusion.visibleFlags.resize(visibleCount);
+	occlusion.culler.TestVisibility(occlusion.visibleBounds.data(), visibleCount, occlusion.visibleFlags.data(), &jobSystem);
+
+	uint32_t keptCount = 0;
+	for (uint32_t i = 0; i < visibleCount; i++) {
+		if (occlusion.visibleFlags[i])
+			visibleInstances[keptCount++] = visibleInstances[i];
+	}
+	visibleInstances.resize(keptCount);
+}
+
+void LavaRenderer::ValidateGpuCulling(uint32_t slot)
+{
+	//Buffers are host coherent and the slot's frame has finished, read the indirect draws straight back.
+	const LavaCullSlot& cullSlot = gpuDriven.slots[slot];
+	const LavaCullView* view = static_cast<const LavaCullView*>(cullSlot.cullView.data);
+	const LavaObjectData* objects = static_cast<const LavaObjectData*>(gpuDriven.objects.data);
+	const LavaGpuMesh* meshes = static_cast<const LavaGpuMesh*>(gpuDriven.meshes.data);
+	const VkDrawIndexedIndirectCommand* commands = static_cast<const VkDrawIndexedIndirectCommand*>(cullSlot.drawCommands.data);
+	uint32_t objectCount = cullSlot.constants.objectCount;
+	uint32_t commandCount = cullSlot.constants.compact ? *static_cast<const uint32_t*>(cullSlot.drawCount.data) : objectCount;
+
+	std::vector<LavaVisibleObject> gpuVisible;
+	for (uint32_t i = 0; i < commandCount; i++) {
+		if (commands[i].instanceCount == 0)
+			continue;
+
+		const LavaGpuMesh& mesh = meshes[objects[commands[i].firstInstance].meshIndex];
+		LavaVisibleObject visible = { commands[i].firstInstance, 0 };
+		while (visible.lod < mesh.lodCount && mesh.lods[visible.lod].firstIndex != commands[i].firstIndex)
+			visible.lod++;
+		gpuVisible.push_back(visible);
+	}
+
+	std::vector<LavaVisibleObject> cpuVisible;
+	CullObjectsReference(*view, objects, objectCount, meshes, cpuVisible);
+
+	auto byObject = [](const LavaVisibleObject& a, const LavaVisibleObject& b) { return a.objectIndex < b.objectIndex; };
+	std::sort(gpuVisible.begin(), gpuVisible.end(), byObject);
+
+	//Objects touching a plane can go either way with GPU float precision, only flag clear disagreements.
+	auto isBorderline = [&](uint32_t objectIndex) {
+		glm::vec4 sphere = objects[objectIndex].boundingSphere;
+		glm::vec4 shrunk = glm::vec4(glm::vec3(sphere), sphere.w * 0.999f - 1e-3f);
+		glm::vec4 grown = glm::vec4(glm::vec3(sphere), sphere.w * 1.001f + 1e-3f);
+		return IsSphereVisible(view->frustum, shrunk) != IsSphereVisible(view->frustum, grown);
+	};
+
+	uint32_t mismatches = 0;
+	size_t g = 0, c = 0;
+	while (g < gpuVisible.size() || c < cpuVisible.size()) {
+		if (c == cpuVisible.size() || (g < gpuVisible.size() && gpuVisible[g].objectIndex < cpuVisible[c].objectIndex)) {
+			mismatches += isBorderline(gpuVisible[g].objectIndex) ? 0 : 1;
+			g++;
+		}
+		else if (g == gpuVisible.size() || cpuVisible[c].objectIndex < gpuVisible[g].objectIndex) {
+			mismatches += isBorderline(cpuVisible[c].objectIndex) ? 0 : 1;
+			c++;
+		}
+		else {
+			mismatches += gpuVisible[g].lod != cpuVisible[c].lod ? 1 : 0;
+			g++;
+			c++;
+		}
+	}
+
+	if (mismatches > 0 || frameIndex % 100 == 0) {
+		LAVA_PRINT("GPU culling: " << gpuVisible.size() << " visible, CPU reference: " << cpuVisible.size()
+			<< ", mismatches: " << mismatches);
+	}
+	assert(mismatches == 0 && "GPU culling disagrees with the CPU reference");
+}
+
+void LavaRenderer::CreateSkinPipeline()
+{
+	LAVA_PROFILE_ZONE("CreateSkinPipeline");
+	CreateComputePipeline("skin.comp.spv", sizeof(LavaSkinConstants), skinShader, skinPipelineLayout, skinPipeline);
+}
+
+glm::vec4 LavaRenderer::CreateSkinningData(const Mesh& mesh, const LavaGpuBuffer& vertexBuffer)
+{
+	LAVA_PROFILE_ZONE("CreateSkinningData");
+	const uint32_t jointCount = 8;
+	uint32_t vertexCount = uint32_t(mesh.vertices.size());
+
+	//OBJ meshes carry no skin: a joint chain runs along the longest side of the bounds, every vertex is weighted
+	//between the two joints it lies between.
+	glm::vec3 minPosition(FLT_MAX), maxPosition(-FLT_MAX);
+	for (const Vertex& vertex : mesh.vertices) {
+		glm::vec3 position(vertex.Position.x, vertex.Position.y, vertex.Position.z);
+		minPosition = glm::min(minPosition, position);
+		maxPosition = glm::max(maxPosition, position);
+	}
+	glm::vec3 extent = maxPosition - minPosition;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	glm::vec3 start = (minPosition + maxPosition) * 0.5f;
+	glm::vec3 end = start;
+	start[axis] = minPosition[axis];
+	end[axis] = maxPosition[axis];
+	LavaBuildChainSkeleton(start, end, jointCount, skinning.skeleton);
+
+	std::vector<LavaSkinWeights> weights(vertexCount);
+	LavaComputeChainWeights(skinning.skeleton, start, end, mesh.vertices.data(), vertexCount, weights.data());
+
+	//Two sways at different rates, the blend between them drifts back and forth, see UpdateSkinning.
+	LavaAnimationSamples samples[2];
+	LavaBuildSwayClip(skinning.skeleton, 0.12f, 0.5f, 1, samples[0]);
+	LavaBuildSwayClip(skinning.skeleton, 0.08f, 1.3f, 2, samples[1]);
+	size_t sampleSize = 0;
+	size_t clipSize = 0;
+	float maxRotationError = 0.f;
+	for (int i = 0; i < 2; i++) {
+		LavaCompressClip(samples[i], LavaClipCompressionSettings(), skinning.clips[i]);
+		sampleSize += LavaGetSamplesSize(samples[i]);
+		clipSize += skinning.clips[i].GetSize();
+		maxRotationError = std::max(maxRotationError, skinning.clips[i].maxRotationError);
+	}
+	skinning.system.Init(&skinning.skeleton, &jobSystem);
+	skinning.state = {};
+	skinning.state.clips[0] = &skinning.clips[0];
+	skinning.state.clips[1] = &skinning.clips[1];
+
+	//The skinned streams start out in the bind pose, what a replay of a capture draws.
+	CreateBuffer(skinning.weights, std::max(1u, vertexCount) * sizeof(LavaSkinWeights), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(skinning.weights.data, weights.data(), vertexCount * sizeof(LavaSkinWeights));
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		CreateBuffer(skinning.matrices[i], jointCount * sizeof(LavaAffineTransform), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	}
+	CreateBuffer(skinning.vertices, std::max(1u, vertexCount) * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(skinning.vertices.data, mesh.vertices.data(), vertexCount * sizeof(Vertex));
+	if (settings.depthPrepass) {
+		CreateBuffer(skinning.positions, std::max(1u, vertexCount) * sizeof(Vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		Vec3* positions = static_cast<Vec3*>(skinning.positions.data);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			positions[i] = mesh.vertices[i].Position;
+		}
+	}
+
+	skinning.constants.vertexBuffer = bindlessHeap.RegisterBuffer(vertexBuffer.buffer);
+	skinning.constants.weightBuffer = bindlessHeap.RegisterBuffer(skinning.weights.buffer);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		skinning.matrixBuffers[i] = bindlessHeap.RegisterBuffer(skinning.matrices[i].buffer);
+	}
+	skinning.constants.matrixBuffer = skinning.matrixBuffers[0];
+	skinning.constants.outputBuffer = bindlessHeap.RegisterBuffer(skinning.vertices.buffer);
+	skinning.constants.positionBuffer = settings.depthPrepass ? bindlessHeap.RegisterBuffer(skinning.positions.buffer) : LAVA_BINDLESS_INVALID_INDEX;
+	skinning.constants.vertexCount = vertexCount;
+
+	//Culling needs a sphere around every pose, not just the bind pose. Poses over the longer clip at a few blend
+	//weights are skinned on the CPU, with some slack for whatever lies between them.
+	glm::vec4 sphere = ComputeBoundingSphere(mesh);
+	float duration = std::max(skinning.clips[0].GetDuration(), skinning.clips[1].GetDuration());
+	std::vector<LavaAffineTransform> matrices(jointCount);
+	std::vector<Vertex> skinnedVertices(vertexCount);
+	float radius = sphere.w;
+	for (uint32_t i = 0; i < 16; i++) {
+		LavaAnimationState state = skinning.state;
+		state.times[0] = duration * float(i) / 16.f;
+		state.times[1] = state.times[0];
+		state.blendWeight = float(i % 3) * 0.5f;
+		skinning.system.Update(&state, 1, matrices.data());
+		LavaSkinVertices(mesh.vertices.data(), weights.data(), vertexCount, matrices.data(), skinnedVertices.data());
+		for (const Vertex& vertex : skinnedVertices) {
+			radius = std::max(radius, glm::length(glm::vec3(vertex.Position.x, vertex.Position.y, vertex.Position.z) - glm::vec3(sphere)));
+		}
+	}
+
+	LAVA_PRINT("Animated: " << jointCount << " joint chain, clips " << clipSize / 1024.f << " KB compressed from " << sampleSize / 1024.f
+		<< " KB, max rotation error " << maxRotationError << " rad, bounds radius " << sphere.w << " -> " << radius * 1.1f);
+	return glm::vec4(glm::vec3(sphere), radius * 1.1f);
+}
+
+void LavaRenderer::DestroySkinningData()
+{
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, skinning.constants.vertexBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, skinning.constants.weightBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, skinning.constants.outputBuffer);
+	DestroyBuffer(skinning.weights);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, skinning.matrixBuffers[i]);
+		DestroyBuffer(skinning.matrices[i]);
+	}
+	DestroyBuffer(skinning.vertices);
+	if (settings.depthPrepass) {
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, skinning.constants.positionBuffer);
+		DestroyBuffer(skinning.positions);
+	}
+}
+
+//Both clips play off the frame time, the blend towards the faster one comes and goes every few seconds.
+//The matrices go straight into the slot's mapped buffer, the skin pass of the slot's last frame is done with them.
+void LavaRenderer::UpdateSkinning(float time)
+{
+	skinning.constants.matrixBuffer = skinning.matrixBuffers[frameSlot];
+	skinning.state.times[0] = time;
+	skinning.state.times[1] = time;
+	skinning.state.blendWeight = 0.5f + 0.5f * sinf(0.7f * time);
+	skinning.system.Update(&skinning.state, 1, static_cast<LavaAffineTransform*>(skinning.matrices[frameSlot].data));
+}
+
+//Barriers between the dispatch and the draws reading its output come from the render graph.
+void LavaRenderer::RecordSkinPass(VkCommandBuffer commandBuffer)
+{
+	VkDescriptorSet bindlessSet = bindlessHeap.GetSet();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinPipelineLayout, 0, 1, &bindlessSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, skinPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LavaSkinConstants), &skinning.constants);
+	vkCmdDispatch(commandBuffer, (skinning.constants.vertexCount + 63) / 64, 1, 1);
+}
+
+void LavaRenderer::CreateParticlePipelines()
+{
+	LAVA_PROFILE_ZONE("CreateParticlePipelines");
+	const char* computeShaders[LAVA_PARTICLE_PASS_COUNT] = { "particle_begin.comp.spv", "particle_emit.comp.spv", "particle_simulate.comp.spv" };
+	for (uint32_t i = 0; i < LAVA_PARTICLE_PASS_COUNT; i++) {
+		CreateComputePipeline(computeShaders[i], sizeof(LavaParticleConstants), particleShaders[i], particlePipelineLayouts[i], particlePipelines[i]);
+	}
+
+	particleVertShader = LoadShader("particle.vert.spv");
+	particleFragShader = LoadShader("particle.frag.spv");
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = particleVertShader;
+	stages[0].pName = "main";
+
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = particleFragShader;
+	stages[1].pName = "main";
+
+	//No vertex streams, the quad corners come from the vertex index and the particle from the alive list.
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
+	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewPortCreateInfo = {};
+	viewPortCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewPortCreateInfo.viewportCount = 1;
+	viewPortCreateInfo.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterCreateInfo = {};
+	rasterCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterCreateInfo.lineWidth = 1.f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
+	multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	//Hidden behind the mesh, but additive particles don't occlude each other, so no depth writes and no sorting.
+	VkPipelineDepthStencilStateCreateInfo stencilCreateInfo = {};
+	stencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	stencilCreateInfo.depthTestEnable = VK_TRUE;
+	stencilCreateInfo.depthWriteEnable = VK_FALSE;
+	stencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	VkPipelineColorBlendAttachmentState colorAttachments = {};
+	colorAttachments.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorAttachments.blendEnable = VK_TRUE;
+	colorAttachments.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorAttachments.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorAttachments.colorBlendOp = VK_BLEND_OP_ADD;
+	colorAttachments.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorAttachments.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorAttachments.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
+	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendCreateInfo.pAttachments = &colorAttachments;
+	colorBlendCreateInfo.attachmentCount = 1;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCreateInfo.pDynamicStates = dynamicStates;
+	dynamicStateCreateInfo.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+
+	VkDescriptorSetLayout bindlessLayout = bindlessHeap.GetLayout();
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(LavaParticleConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	LAVA_ASSERT(vkCreatePipelineLayout(activeDevice, &pipelineLayoutCreateInfo, nullptr, &particleDrawPipelineLayout));
+
+	VkGraphicsPipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	createInfo.stageCount = 2;
+	createInfo.pStages = stages;
+	createInfo.pVertexInputState = &vertexInputStateCreateInfo;
+	createInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	createInfo.pRasterizationState = &rasterCreateInfo;
+	createInfo.pViewportState = &viewPortCreateInfo;
+	createInfo.pMultisampleState = &multisampleStateCreateInfo;
+	createInfo.pDepthStencilState = &stencilCreateInfo;
+	createInfo.pColorBlendState = &colorBlendCreateInfo;
+	createInfo.pDynamicState = &dynamicStateCreateInfo;
+	createInfo.renderPass = renderPass;
+	createInfo.layout = particleDrawPipelineLayout;
+
+	LAVA_ASSERT(vkCreateGraphicsPipelines(activeDevice, 0, 1, &createInfo, nullptr, &particleDrawPipeline));
+}
+
+//A fountain out of the top of emitterSphere, falling back down and bouncing on the floor at its bottom.
+void LavaRenderer::CreateParticleData(const glm::vec4& emitterSphere)
+{
+	LAVA_PROFILE_ZONE("CreateParticleData");
+	uint32_t capacity = settings.particleCount;
+
+	CreateBuffer(particles.pool, capacity * sizeof(LavaParticle), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	CreateBuffer(particles.deadList, capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	CreateBuffer(particles.aliveLists, 2 * capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	CreateBuffer(particles.counters, sizeof(LavaParticleCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		CreateBuffer(particles.steps[i], sizeof(LavaParticleStep), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	}
+
+	//Every slot starts out free.
+	uint32_t* deadList = static_cast<uint32_t*>(particles.deadList.data);
+	for (uint32_t i = 0; i < capacity; i++) {
+		deadList[i] = i;
+	}
+	LavaParticleCounters counters = {};
+	counters.draw.vertexCount = 6;
+	counters.deadCount = capacity;
+	memcpy(particles.counters.data, &counters, sizeof(LavaParticleCounters));
+
+	float radius = emitterSphere.w;
+	float projectionScale = 1.f / tanf(glm::radians(30.f));
+	LavaParticleConstants& constants = particles.constants;
+	constants = {};
+	constants.particleBuffer = bindlessHeap.RegisterBuffer(particles.pool.buffer);
+	constants.deadBuffer = bindlessHeap.RegisterBuffer(particles.deadList.buffer);
+	constants.aliveBuffer = bindlessHeap.RegisterBuffer(particles.aliveLists.buffer);
+	constants.counterBuffer = bindlessHeap.RegisterBuffer(particles.counters.buffer);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		particles.stepBuffers[i] = bindlessHeap.RegisterBuffer(particles.steps[i].buffer);
+	}
+	constants.stepBuffer = particles.stepBuffers[0];
+	constants.frameBuffer = frames[0].frameDataIndex;
+	constants.capacity = capacity;
+	constants.emitterX = emitterSphere.x;
+	constants.emitterY = emitterSphere.y + radius;
+	constants.emitterZ = emitterSphere.z;
+	constants.emitterSpeed = 4.f * radius;
+	constants.emitterSpread = 0.3f;
+	constants.gravity = -4.f * radius;
+	constants.floorHeight = emitterSphere.y - radius;
+	constants.minLifetime = 2.f;
+	constants.maxLifetime = 4.f;
+	constants.quadScaleY = 0.02f * radius * projectionScale;
+	constants.quadScaleX = constants.quadScaleY * float(frameBufferHeight) / float(frameBufferWidth);
+
+	particles.step = {};
+	particles.emitRate = float(capacity) / (0.5f * (constants.minLifetime + constants.maxLifetime));
+	particles.emitCarry = 0.f;
+	if (settings.validateParticles)
+		particles.reference.Init(capacity);
+
+	LAVA_PRINT("Particles: " << capacity << " capacity, " << particles.emitRate << " emitted per second, "
+		<< (capacity * (sizeof(LavaParticle) + 3 * sizeof(uint32_t))) / 1024 << " KB");
+}
+
+void LavaRenderer::DestroyParticleData()
+{
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, particles.constants.particleBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, particles.constants.deadBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, particles.constants.aliveBuffer);
+	bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, particles.constants.counterBuffer);
+	DestroyBuffer(particles.pool);
+	DestroyBuffer(particles.deadList);
+	DestroyBuffer(particles.aliveLists);
+	DestroyBuffer(particles.counters);
+	for (uint32_t i = 0; i < LAVA_FRAMES_IN_FLIGHT; i++) {
+		bindlessHeap.Release(LAVA_BINDLESS_STORAGE_BUFFER, particles.stepBuffers[i]);
+		DestroyBuffer(particles.steps[i]);
+	}
+}
+
+//Each frame in flight has its own step, the slot's last frame has finished reading it. Fractions of a particle
+//carry over, so the emission rate holds at any frame rate.
+void LavaRenderer::UpdateParticles(float deltaTime)
+{
+	particles.constants.stepBuffer = particles.stepBuffers[frameSlot];
+	particles.constants.frameBuffer = frames[frameSlot].frameDataIndex;
+	float emitCount = particles.emitRate * deltaTime + particles.emitCarry;
+	particles.step.emitRequest = uint32_t(emitCount);
+	particles.step.current = uint32_t(frameIndex & 1);
+	particles.step.deltaTime = deltaTime;
+	particles.emitCarry = emitCount - float(particles.step.emitRequest);
+	memcpy(particles.steps[frameSlot].data, &particles.step, sizeof(LavaParticleStep));
+}
+
+//Begin sizes the other two, they dispatch indirectly off what it wrote.
+void LavaRenderer::RecordParticlePass(VkCommandBuffer commandBuffer, LavaParticlePass pass)
+{
+	VkDescriptorSet bindlessSet = bindlessHeap.GetSet();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particlePipelines[pass]);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particlePipelineLayouts[pass], 0, 1, &bindlessSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, particlePipelineLayouts[pass], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LavaParticleConstants), &particles.constants);
+	if (pass == LAVA_PARTICLE_PASS_BEGIN)
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+	else if (pass == LAVA_PARTICLE_PASS_EMIT)
+		vkCmdDispatchIndirect(commandBuffer, particles.counters.buffer, offsetof(LavaParticleCounters, emitDispatch));
+	else
+		vkCmdDispatchIndirect(commandBuffer, particles.counters.buffer, offsetof(LavaParticleCounters, simulateDispatch));
+}
+
+//Inside the main render pass, after the mesh. One instance per particle simulate kept alive.
+void LavaRenderer::RecordParticleDraw(VkCommandBuffer commandBuffer)
+{
+	LAVA_PROFILE_GPU_ZONE(gpuProfiler, commandBuffer, "Particles");
+	VkDescriptorSet bindlessSet = bindlessHeap.GetSet();
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particleDrawPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particleDrawPipelineLayout, 0, 1, &bindlessSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, particleDrawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(LavaParticleConstants), &particles.constants);
+	vkCmdDrawIndirect(commandBuffer, particles.counters.buffer, offsetof(LavaParticleCounters, draw), 1, sizeof(LavaParticleDraw));
+}
+
+//The frame has finished and the next one isn't submitted yet. The reference replays the frame's emission and simulation, then takes over the GPU's states
+//for the next frame.
+void LavaRenderer::ValidateParticles()
+{
+	const LavaParticleCounters& counters = *static_cast<const LavaParticleCounters*>(particles.counters.data);
+	const LavaParticle* pool = static_cast<const LavaParticle*>(particles.pool.data);
+	const uint32_t* aliveList = static_cast<const uint32_t*>(particles.aliveLists.data) + (particles.step.current ^ 1) * particles.constants.capacity;
+
+	particles.reference.Step(particles.constants, particles.step);
+	//Positions are integrated over many frames, the GPU may fuse or reorder the multiply adds.
+	float positionTolerance = 1e-4f * particles.constants.emitterSpeed * particles.constants.maxLifetime;
+	LavaParticleValidation validation = LavaValidateParticles(particles.reference, particles.constants, particles.step, counters, pool, aliveList,
+		positionTolerance);
+	if (validation.mismatches > 0 || !validation.countersValid || frameIndex % 100 == 0) {
+		LAVA_PRINT("GPU particles: " << validation.gpuAlive << " alive, CPU reference: " << validation.referenceAlive
+			<< ", mismatches: " << validation.mismatches << (validation.countersValid ? "" : ", counters off"));
+	}
+	assert(validation.mismatches == 0 && validation.countersValid && "GPU particles disagree with the CPU reference");
+	particles.reference.Sync(pool, aliveList, std::min(validation.gpuAlive, particles.constants.capacity));
+}
+
+void LavaRenderer::CreateBuffer(LavaGpuBuffer& gpuBuffer, size_t size, VkBufferUsageFlags usageFlags, bool sharedWithCompute)
 {
 	VkBufferCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	createInfo.size = size;
 	createInfo.usage = usageFlags;
+	uint32_t queueFamilies[] = { queueFamilyIndex, computeQueueFamilyIndex };
+	if (sharedWithCompute && computeQueueFamilyIndex != ~0u && computeQueueFamilyIndex != queueFamilyIndex) {
+		createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = 2;
+		createInfo.pQueueFamilyIndices = queueFamilies;
+	}
 
 	VkBuffer buffer = {};
 	LAVA_ASSERT(vkCreateBuffer(activeDevice, &createInfo, nullptr, &buffer));
@@ -712,6 +3033,7 @@ void LavaRenderer::CreateBuffer(LavaGpuBuffer& gpuBuffer, size_t size, VkBufferU
 
 	VkDeviceMemory memory = {};
 	LAVA_ASSERT(vkAllocateMemory(activeDevice, &allocateInfo, nullptr, &memory));
+	memoryAllocationCount++;
 
 	vkBindBufferMemory(activeDevice, buffer, memory, 0); // no need for offset
 
@@ -765,8 +3087,9 @@ void LavaRenderer::SetGraphicsQueueFamily()
 	for (uint32_t i = 0; i < queuePropertyCount; i++) {
 		if (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
-			VkBool32 presentationSupport = 0;
-			vkGetPhysicalDeviceSurfaceSupportKHR(activePhysicalDevice, i, surface, &presentationSupport);
+			VkBool32 presentationSupport = settings.headless;
+			if (surface)
+				vkGetPhysicalDeviceSurfaceSupportKHR(activePhysicalDevice, i, surface, &presentationSupport);
 			if (presentationSupport) {
 				queueFamilyIndex = i;
 				return;
@@ -778,22 +3101,89 @@ void LavaRenderer::SetGraphicsQueueFamily()
 	queueFamilyIndex = ~0u;
 }
 
-VkShaderModule LavaRenderer::LoadShader(const char* path)
+//Dedicated compute families run beside graphics on separate hardware queues where there are any, a second queue of
+//the graphics family can still overlap work. No separate queue leaves computeQueueFamilyIndex at ~0u.
+void LavaRenderer::SetComputeQueueFamily()
 {
-	FILE* file = fopen(path, "rb");
-	fseek(file, 0, SEEK_END);
-	long length = ftell(file);
-	fseek(file, 0, SEEK_SET);
+	uint32_t queuePropertyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queuePropertyCount, 0);
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties(queuePropertyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDevice, &queuePropertyCount, queueFamilyProperties.data());
 
-	char* buffer = new char[length];
-	size_t file_length = fread(buffer, 1, length, file);
-	assert(file_length == size_t(length));
-	fclose(file);
+	computeQueueFamilyIndex = ~0u;
+	computeQueueIndex = 0;
+	for (uint32_t i = 0; i < queuePropertyCount; i++) {
+		VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && queueFamilyProperties[i].queueCount > 0) {
+			computeQueueFamilyIndex = i;
+			return;
+		}
+	}
+	if (queueFamilyProperties[queueFamilyIndex].queueCount > 1) {
+		computeQueueFamilyIndex = queueFamilyIndex;
+		computeQueueIndex = 1;
+	}
+}
+
+//Maps whatever the mounted packs have, the remaining stages are read as one batch.
+void LavaRenderer::ReadShaders()
+{
+	std::vector<const char*> names = { "triangle.vert.spv", "triangle.frag.spv" };
+	if (settings.gpuDriven)
+		names.push_back("cull.comp.spv");
+	if (settings.depthPrepass)
+		names.push_back("depth.vert.spv");
+	if (settings.animate)
+		names.push_back("skin.comp.spv");
+	if (settings.particleCount > 0) {
+		names.insert(names.end(), { "particle_begin.comp.spv", "particle_emit.comp.spv", "particle_simulate.comp.spv",
+			"particle.vert.spv", "particle.frag.spv" });
+	}
+
+	std::vector<std::string> paths;
+	for (const char* name : names) {
+		std::string path = std::string("shaders/") + name;
+		if (!vfs.IsPacked(path.c_str()))
+			paths.push_back(path);
+	}
+	std::vector<LavaVfsRequest> requests(paths.size());
+	for (size_t i = 0; i < paths.size(); i++) {
+		requests[i] = { paths[i].c_str(), 0, {}, false };
+	}
+	vfs.Read(requests.data(), uint32_t(requests.size()));
+	//A stage that failed to read is left out, LoadShader retries it and reports it.
+	for (size_t i = 0; i < requests.size(); i++) {
+		if (requests[i].loaded)
+			shaderCode[paths[i].substr(strlen("shaders/"))] = std::move(requests[i].data);
+	}
+}
+
+//Straight from a mapped pack, or from the code read at startup.
+VkShaderModule LavaRenderer::LoadShader(const char* name)
+{
+	LAVA_PROFILE_ZONE("LoadShader");
+	std::string path = std::string("shaders/") + name;
+	size_t codeSize = 0;
+	const void* code = vfs.Map(path.c_str(), &codeSize);
+	std::vector<uint8_t> fileCode;
+	if (!code) {
+		auto readCode = shaderCode.find(name);
+		if (readCode == shaderCode.end())
+			vfs.Read(path.c_str(), fileCode);
+		const std::vector<uint8_t>& bytes = readCode != shaderCode.end() ? readCode->second : fileCode;
+		code = bytes.data();
+		codeSize = bytes.size();
+	}
+	//Shaders are compiled by the build, a missing or truncated stage means the build didn't run glslangValidator.
+	if (codeSize == 0 || codeSize % sizeof(uint32_t) != 0 || *static_cast<const uint32_t*>(code) != 0x07230203u) {
+		LAVA_PRINT("Could not read SPIR-V from " << path);
+		throw std::runtime_error("Could not read SPIR-V from " + path);
+	}
 
 	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
 	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = length;
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(buffer);
+	shaderModuleCreateInfo.codeSize = codeSize;
+	shaderModuleCreateInfo.pCode = static_cast<const uint32_t*>(code);
 
 	VkShaderModule shaderModule = 0;
 	LAVA_ASSERT(vkCreateShaderModule(activeDevice, &shaderModuleCreateInfo, nullptr, &shaderModule));
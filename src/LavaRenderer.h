@@ -4,12 +4,47 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 
+//Builds without GLFW only render headless, e.g. on build boxes with just a software Vulkan driver.
+#ifndef LAVA_GLFW
+#define LAVA_GLFW 1
+#endif
+#if LAVA_GLFW
 #include <GLFW/glfw3.h>
-//#include <vulkan/vulkan.h>
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+//Where the compiled SPIR-V is, CMake builds point this at the build tree.
+#ifndef LAVA_SHADER_DIR
+#define LAVA_SHADER_DIR "shaders"
+#endif
+
+#include "LavaCore.h"
+#include "LavaBindless.h"
+#include "LavaCulling.h"
+#include "LavaJobs.h"
+#include "LavaScene.h"
+#include "LavaBvh.h"
+#include "LavaOcclusion.h"
+#include "LavaRenderGraph.h"
+#include "LavaDrawList.h"
+#include "LavaTextureStreaming.h"
+#include "LavaMesh.h"
+#include "LavaGpuProfiler.h"
+#include "LavaStats.h"
+#include "LavaCapture.h"
+#include "LavaTaskGraph.h"
+#include "LavaVfs.h"
+#include "LavaParticles.h"
+#include "LavaAnimation.h"
 
 struct SwapChainData {
 public:
@@ -21,11 +56,6 @@ public:
 	uint32_t width, height;
 };
 
-struct ImageLayout {
-	VkAccessFlags AccessMask;
-	VkImageLayout Layout;
-};
-
 struct LavaGpuBuffer {
 	VkBuffer buffer;
 	VkDeviceMemory memory;
@@ -33,30 +63,216 @@ struct LavaGpuBuffer {
 	size_t size;
 };
 
+//Frames the CPU runs ahead of the GPU. Whatever the host writes per frame comes in this many copies, frame N
+//uses copy N % LAVA_FRAMES_IN_FLIGHT.
+const uint32_t LAVA_FRAMES_IN_FLIGHT = 2;
+
+
+//Mirrors the Material struct in the shaders, std430 layout.
+struct LavaMaterial {
+	float baseColor[4];
+	uint32_t albedoTexture;
+	uint32_t albedoSampler;
+	float uvScale; //Planar world space mapping, texture repeats every 1 / uvScale units
+	uint32_t padding;
+};
+
+//Per instance vertex stream (binding 1). Transform is stored as the 3 rows of an affine matrix.
+struct LavaInstance {
+	glm::vec4 transform[3];
+	uint32_t materialIndex;
+	float color[3];
+};
+
+//Per draw bindless indices, pushed instead of binding descriptor sets.
+struct LavaDrawConstants {
+	uint32_t frameBuffer;
+	uint32_t materialBuffer;
+	uint32_t padding[2];
+};
+
+//Mirrors FrameBuffer in the vertex shaders. Rewritten every frame, recorded commands only hold the index of the frame's copy.
+struct LavaFrameData {
+	glm::mat4 viewProjection;
+};
+
+struct LavaCamera {
+	glm::vec3 position;
+	glm::mat4 viewProjection;
+};
+
+//What one cull dispatch reads and writes besides the shared object and mesh tables.
+struct LavaCullSlot {
+	LavaGpuBuffer cullView;
+	LavaGpuBuffer drawCommands;
+	LavaGpuBuffer drawCount;
+	LavaCullConstants constants;
+};
+
+//Buffers of the GPU driven path, all reachable by the cull shader through the bindless heap. Frame N culls into
+//slot N % LAVA_FRAMES_IN_FLIGHT, async compute does so while the frame before it is still drawn.
+struct LavaGpuDrivenData {
+	LavaGpuBuffer objects;
+	LavaGpuBuffer meshes;
+	LavaCullSlot slots[LAVA_FRAMES_IN_FLIGHT];
+};
+
+//Cull submits on the compute queue, per slot. The graphics submit of a frame waits on its slot's semaphore at the
+//indirect stage, nothing else of the frame depends on the cull.
+struct LavaAsyncComputeData {
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffers[LAVA_FRAMES_IN_FLIGHT];
+	VkSemaphore cullDone[LAVA_FRAMES_IN_FLIGHT];
+	VkFence fences[LAVA_FRAMES_IN_FLIGHT];
+	bool pending[LAVA_FRAMES_IN_FLIGHT]; //Submitted and not waited for on the host yet
+	VkQueryPool timestampPool; //Begin and end of each slot's cull
+};
+
+struct LavaOcclusionData {
+	LavaOcclusionCuller culler;
+	std::vector<glm::vec3> occluderPositions; //Clustered LOD of the mesh
+	std::vector<uint32_t> occluderIndices;
+	glm::vec4 meshSphere;
+	std::vector<LavaAabb> visibleBounds;
+	std::vector<uint8_t> visibleFlags;
+	std::vector<std::pair<float, uint32_t>> occluderCandidates; //Distance, instance
+};
+
+//Skinned mesh of --animate. The CPU samples and blends the clips into the matrix buffer, the skin pass writes the
+//vertex streams every draw reads from it. All instances share the one skinned mesh.
+struct LavaSkinningData {
+	LavaSkeleton skeleton;
+	LavaAnimationClip clips[2];
+	LavaAnimationSystem system;
+	LavaAnimationState state;
+	LavaGpuBuffer weights;
+	LavaGpuBuffer matrices[LAVA_FRAMES_IN_FLIGHT];
+	uint32_t matrixBuffers[LAVA_FRAMES_IN_FLIGHT]; //Bindless, constants point at the current frame's
+	LavaGpuBuffer vertices; //Skinned, same layout as the mesh vertices
+	LavaGpuBuffer positions; //Skinned positions, depth prepass only
+	LavaSkinConstants constants;
+};
+
+enum LavaParticlePass {
+	LAVA_PARTICLE_PASS_BEGIN,
+	LAVA_PARTICLE_PASS_EMIT,
+	LAVA_PARTICLE_PASS_SIMULATE,
+	LAVA_PARTICLE_PASS_COUNT
+};
 
-struct Vec3 {
-	float x, y, z;
+//GPU particle system of --particles. The pool is a fixed array, free slots are on the dead list and the alive ones on
+//two index lists, simulated from one and compacted into the other every frame. Nothing is read back to draw them.
+struct LavaParticleData {
+	LavaGpuBuffer pool;
+	LavaGpuBuffer deadList;
+	LavaGpuBuffer aliveLists;
+	LavaGpuBuffer counters; //Also the indirect dispatch and draw arguments
+	LavaGpuBuffer steps[LAVA_FRAMES_IN_FLIGHT];
+	uint32_t stepBuffers[LAVA_FRAMES_IN_FLIGHT]; //Bindless, constants point at the current frame's
+	LavaParticleConstants constants;
+	LavaParticleStep step; //What the current frame's step buffer holds
+	float emitRate; //Particles per second, keeps the pool about full
+	float emitCarry; //Fraction of a particle left over from the last frame
+	LavaParticleReference reference; //--validate-particles only
 };
 
-struct Vertex {
-	Vec3 Position;
-	Vec3 Normal;
+//What one frame in flight owns. The CPU fills a frame's copies while the GPU still runs the frames before it, the
+//fence tells when they can be rewritten and what the frame measured read back.
+struct LavaFrameResources {
+	VkFence fence;
+	bool pending; //Submitted and not finished on the host yet
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer; //Recorded every frame without reused command buffers
+	VkSemaphore acquireSemaphore;
+	VkSemaphore releaseSemaphore;
+	LavaGpuBuffer instanceBuffer;
+	bool instancesStale; //A node moved since the copy was written, only the paths drawing every instance keep it
+	LavaGpuBuffer frameData;
+	uint32_t frameDataIndex; //Bindless
+	LavaGpuBuffer materialData; //Streaming moves the albedo texture to a new bindless slot between frames
+	uint32_t materialIndex; //Bindless
+	LavaGpuBuffer readbackBuffer; //Headless only
+
+	//Filled in by the frame, completed and reported once it has finished.
+	LavaFrameStats stats;
+	LavaDrawListStats drawStats;
+	uint64_t apiCalls; //Null device only
+	uint64_t commands;
+	uint64_t barriers;
 };
 
-struct Mesh {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+//Per swapchain image and frame slot command buffer, replayed while the state it was recorded from is unchanged.
+struct LavaCachedCommandBuffer {
+	VkCommandBuffer commandBuffer;
+	uint64_t stateHash;
+	bool recorded;
+	LavaDrawListStats drawStats; //What a replay submits
 };
 
+//Sums over the frames since the last report, printed and reset every 100 frames.
+struct LavaFrameReport {
+	uint32_t frameCount;
+	double cpuFrameTimeSum;
+	uint32_t recordedFrameCount; //Reused command buffers only
+	LavaDrawListStats drawStats;
+	double drawSortTimeSum;
+	double animationTimeSum;
+	uint64_t textureUploadSum;
+	double asyncCullTimeSum;
+	double asyncOverlapTimeSum; //Of the async cull with the previous frame's graphics
+	uint32_t gpuFrameCount; //Frames whose timings are in, they finish a frame or two after they are counted
+	std::vector<double> gpuPassTimeSums; //Per scheduled graph pass
+};
+
+struct LavaRendererSettings {
+	const char* meshPath = "assets/armadillo.obj";
+	const char* shaderPath = LAVA_SHADER_DIR; //Directory of the .spv files and shaders.lpk, mounted as shaders/
+	uint32_t instanceCount = 1;
+	bool drawPerObject = false; //Stress comparison: one vkCmdDrawIndexed per instance instead of one instanced draw
+	bool gpuDriven = false; //Compute frustum culling + LOD selection writing indirect draws
+	bool validateGpuCulling = false; //Read back the indirect draws and compare to the CPU reference culler
+	bool cpuCulling = false; //SIMD frustum culling on the job system, only visible instances are uploaded and drawn
+	bool bvhCulling = false; //CPU culling through the scene BVH instead of the flat SIMD pass
+	bool occlusionCulling = false; //CPU culling followed by software occlusion culling against the nearest instances
+	bool reuseCommandBuffers = false; //Record once per swapchain image and frame slot, replay until the draw list or swapchain changes
+	bool depthPrepass = false; //Depth only pass first, the main pass then shades each visible pixel once with an EQUAL test
+	const char* texturePath = nullptr; //KTX2 albedo, mips streamed in from how large the nearest instance is on screen
+	uint64_t textureMemoryBudget = 256ull * 1024 * 1024;
+	uint64_t textureUploadBudget = 8ull * 1024 * 1024; //Per frame
+	const char* profilePath = nullptr; //Chrome trace of startup and the first profileFrames frames, CPU and GPU zones
+	uint32_t profileFrames = 300;
+	const char* statsName = nullptr; //Shared memory segment the per frame counters are published to, read with lava_stats
+	uint32_t statsFrames = 1024;
+	const char* capturePath = nullptr; //Frame work of the first captureFrames frames, replayed by lava_replay
+	uint32_t captureFrames = 600;
+	bool headless = false; //No window or swapchain, renders into offscreen images and reads every frame back
+	uint32_t headlessFrames = 300; //Frames to run before exiting
+	uint32_t width = 1024;
+	uint32_t height = 768;
+	const char* outputPath = nullptr; //Directory for frame dumps and timings.csv, headless only
+	uint32_t dumpInterval = 0; //Write every Nth frame as a PPM, 0 only writes the last one
+	bool serialStartup = false; //Run the startup stages one after another on the main thread, for comparing timelines
+	bool asyncCompute = false; //GPU driven only: cull on a separate compute queue, a frame ahead so it overlaps the previous frame's graphics
+	bool animate = false; //Skeletal animation of the mesh, compressed clips blended on the CPU, skinned in a compute pass
+	uint32_t particleCount = 0; //Capacity of the GPU particle system, 0 disables it
+	bool validateParticles = false; //Read the particles back every frame and compare to the CPU reference
+};
+
+//The constructor sets everything up, Run renders until the window is closed or the headless frames are done.
 class LavaRenderer {
 public:
-	LavaRenderer();
-	void InitVulkan();
+	LavaRenderer(const LavaRendererSettings& settings = LavaRendererSettings());
+	~LavaRenderer();
+	void Run();
+	uint32_t InitVulkan(LavaTaskGraph& startup); //Adds the Vulkan stages, returns the one creating the device
 	void DestroyVulkan();
 
 private:
 	void CreateSwapchain();
 	void DestroySwapchain();
+	void CreateOffscreenTargets();
+	void DestroyOffscreenTargets();
+	void WriteFrameImage(const char* path, const LavaGpuBuffer& readbackBuffer);
 private:
 	VkPhysicalDevice PickPhysicalDevice(VkPhysicalDevice* devices, uint32_t deviceCount);
 	void CreateInstance();
@@ -66,44 +282,196 @@ private:
 	void CreateSemaphore();
 	void CreateQueue();
 	void CreateCommandPool();
+	void CreateFrameData(); //The per frame instance stream and frame data copies
+	void DestroyFrameData();
+	void CreateCachedCommandBuffers();
 	void CreateRenderPass();
 	void CreateGraphicsPipeline();
-	VkFramebuffer CreateFrameBuffer(VkImageView imageView);
+	void CreateDepthPipeline();
+	VkFormat SelectDepthFormat();
+	void CreateTimestampPool(uint32_t queryCount);
+	void CreateStatisticsPool();
+	VkFramebuffer CreateFrameBuffer(VkRenderPass pass, const VkImageView* attachments, uint32_t attachmentCount);
+	void CreateFrameBuffers(VkImageView depthView);
+	void DestroyFrameBuffers();
 	VkImageView CreateImageView(VkImage image);
-	VkImageMemoryBarrier PipelineBarrierImage(VkImage image,ImageLayout sourceLayout,ImageLayout targetLayout);
 	uint32_t SelectBufferMemoryTypeIndex(uint32_t requiredMemoryTypeBits, VkMemoryPropertyFlags requiredFlags);
+	LavaCamera GetCamera(float time);
+
+private:
+	void BuildRenderGraph(); //Passes of every frame, creates the graph's transients and the frame buffers
+	void RunFrame();
+	void FinishFrame(uint32_t slot); //Waits for the slot's frame and reads back what it measured, if it is in flight
+	void FinishFrames(); //Every frame in flight, oldest first
+	float GetFrameTime(uint64_t index);
+	LavaCamera PrepareFrame(uint64_t index, uint32_t slot);
+	void CullInstances(const LavaCamera& camera, LavaFrameStats& frameStats);
+	void BuildDrawList(const LavaCamera& camera);
+	void StreamTextures(const LavaCamera& camera, LavaFrameStats& frameStats);
+	VkCommandBuffer RecordFrame(LavaDrawListStats& frameDrawStats); //Returns the command buffer to submit, recorded or reused
+	void RecordDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkBuffer vertexStream, uint32_t drawPass);
+	void ReadGpuTimings(LavaFrameStats& frameStats, uint32_t slot);
+	void PrintFrameReport();
+	void PrintHeadlessSummary();
 
 private:
-	void CreateBuffer(LavaGpuBuffer& buffer, size_t size,VkBufferUsageFlags usageFlags);
+	void CreateCullPipeline();
+	void CreateComputePipeline(const char* shaderName, uint32_t constantsSize, VkShaderModule& shader, VkPipelineLayout& pipelineLayout, VkPipeline& pipeline);
+	void CreateGpuDrivenData(const Mesh& mesh, const Mesh& lodMesh);
+	void DestroyGpuDrivenData();
+	void UpdateCullView(const LavaCamera& camera, uint32_t slot);
+	void RecordCullPass(VkCommandBuffer commandBuffer, uint32_t slot);
+	void RecordIndirectDraws(VkCommandBuffer commandBuffer, uint32_t slot);
+	void ValidateGpuCulling(uint32_t slot);
+	void CreateAsyncCompute();
+	void DestroyAsyncCompute();
+	void SubmitAsyncCull(uint32_t slot);
+	void WaitAsyncCull(uint32_t slot);
+	void CullOccluded(const LavaCamera& camera); //Removes occluded instances from visibleInstances
+
+private:
+	void CreateSkinPipeline();
+	glm::vec4 CreateSkinningData(const Mesh& mesh, const LavaGpuBuffer& vertexBuffer); //Returns the bounding sphere of the animated mesh
+	void DestroySkinningData();
+	void UpdateSkinning(float time);
+	void RecordSkinPass(VkCommandBuffer commandBuffer);
+
+private:
+	void CreateParticlePipelines();
+	void CreateParticleData(const glm::vec4& emitterSphere);
+	void DestroyParticleData();
+	void UpdateParticles(float deltaTime);
+	void RecordParticlePass(VkCommandBuffer commandBuffer, LavaParticlePass pass);
+	void RecordParticleDraw(VkCommandBuffer commandBuffer);
+	void ValidateParticles();
+
+private:
+	//Shared buffers are concurrent between the graphics and compute queue families, no ownership transfers.
+	void CreateBuffer(LavaGpuBuffer& buffer, size_t size,VkBufferUsageFlags usageFlags, bool sharedWithCompute = false);
 	void DestroyBuffer(const LavaGpuBuffer& buffer);
 private:
-	GLFWwindow* window;
+#if LAVA_GLFW
+	GLFWwindow* window = nullptr;
+#endif
 	VkInstance instance;
 	VkPhysicalDevice activePhysicalDevice;
 	VkDevice activeDevice;
-	VkSurfaceKHR surface;
-	VkSwapchainKHR swapChain;
-	VkSemaphore acquireSemaphore;
-	VkSemaphore releaseSemaphore;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> offscreenMemory; //Headless stand ins for the swapchain images
 	VkQueue queue;
-	VkCommandPool commandPool;
+	VkQueue computeQueue = VK_NULL_HANDLE; //Only with a second queue, see SetComputeQueueFamily
+	LavaFrameResources frames[LAVA_FRAMES_IN_FLIGHT] = {};
+	VkCommandPool cachedCommandPool = VK_NULL_HANDLE;
+	std::vector<LavaCachedCommandBuffer> cachedCommandBuffers;
 	VkRenderPass renderPass;
 	VkShaderModule vertShader;
 	VkShaderModule fragShader;
 	VkPipeline trianglePipeline;
 	VkPipelineLayout trianglePipelineLayout;
+	VkRenderPass depthPrepassRenderPass = VK_NULL_HANDLE;
+	VkFramebuffer depthFrameBuffer = VK_NULL_HANDLE;
+	VkShaderModule depthShader = VK_NULL_HANDLE;
+	VkPipeline depthPipeline = VK_NULL_HANDLE;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	VkQueryPool timestampPool = VK_NULL_HANDLE; //A range of graph timestamps per frame in flight
+	float timestampPeriod = 1.f; //Nanoseconds per tick
+	VkQueryPool statisticsPool = VK_NULL_HANDLE; //A query per frame in flight
+	LavaStatsRing statsRing;
+	LavaCaptureWriter captureWriter;
+	std::atomic<uint32_t> memoryAllocationCount{ 0 }; //Startup stages allocate from several threads
+	VkShaderModule cullShader = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkShaderModule skinShader = VK_NULL_HANDLE;
+	VkPipeline skinPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout skinPipelineLayout = VK_NULL_HANDLE;
+	VkShaderModule particleShaders[LAVA_PARTICLE_PASS_COUNT] = {};
+	VkPipeline particlePipelines[LAVA_PARTICLE_PASS_COUNT] = {};
+	VkPipelineLayout particlePipelineLayouts[LAVA_PARTICLE_PASS_COUNT] = {};
+	VkShaderModule particleVertShader = VK_NULL_HANDLE;
+	VkShaderModule particleFragShader = VK_NULL_HANDLE;
+	VkPipeline particleDrawPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout particleDrawPipelineLayout = VK_NULL_HANDLE;
 	VkDebugReportCallbackEXT callback = 0;
+	bool hasDebugReport = false;
 	VkPhysicalDeviceMemoryProperties memoryProperties;
+	LavaBindlessHeap bindlessHeap;
+	LavaGpuDrivenData gpuDriven = {};
+	LavaAsyncComputeData asyncCompute = {};
+	LavaJobSystem jobSystem;
+	LavaScene scene;
+	LavaOcclusionData occlusion;
+	LavaSkinningData skinning;
+	LavaParticleData particles = {};
+	LavaRenderGraph renderGraph;
+	LavaDrawList drawList;
+#if LAVA_PROFILER
+	LavaGpuProfiler gpuProfiler;
+	uint32_t profiledFrameCount = 0;
+#endif
+
+private:
+	//The instanced scene every frame draws. The constructor sets it up, RunFrame updates it.
+	std::vector<LavaInstance> instances; //Every instance in node order, the instance buffer holds the drawn ones
+	float sceneRadius = 0.f;
+	glm::vec4 meshSphere = glm::vec4(0.f);
+	uint32_t meshIndexCount = 0; //Full LOD, what the CPU paths draw
+	LavaGpuBuffer vb = {};
+	LavaGpuBuffer ib = {};
+	LavaGpuBuffer positionBuffer = {}; //Depth prepass of a static mesh
+	VkBuffer mainVertexBuffer = VK_NULL_HANDLE; //The skinned streams when animated
+	VkBuffer depthVertexBuffer = VK_NULL_HANDLE;
+	LavaMaterial material = {};
+	LavaDrawConstants drawConstants = {};
+	LavaVulkanTextureDevice textureDevice;
+	LavaTextureStreamer textureStreamer;
+	uint32_t albedoTexture = LAVA_INVALID_TEXTURE;
+	VkSampler albedoSampler = VK_NULL_HANDLE;
+	LavaCullingBounds cullingBounds;
+	LavaBvh bvh;
+	std::vector<uint32_t> visibleInstances;
+
+	//Frame loop state.
+	LavaGraphResource swapchainImage = LAVA_GRAPH_INVALID_RESOURCE;
+	LavaGraphResource drawCommandsResource = LAVA_GRAPH_INVALID_RESOURCE; //GPU culling in the graph, bound to the frame's slot
+	LavaGraphResource drawCountResource = LAVA_GRAPH_INVALID_RESOURCE;
+	LavaGraphResource readbackResource = LAVA_GRAPH_INVALID_RESOURCE;
+	uint32_t imageIndex = 0;
+	uint32_t frameSlot = 0; //frameIndex % LAVA_FRAMES_IN_FLIGHT, the copies and cull slot the frame uses
+	uint32_t drawInstanceCount = 0; //Instances in the instance stream this frame
+	LavaCamera preparedCamera = {}; //Async compute prepares the next frame while the current one draws
+	bool framePrepared = false;
+	double preparedCpuMs = 0.0; //Counted in the frame that was prepared
+	uint64_t previousGpuFrame[2] = {}; //First and last graph timestamp of the last finished frame, the async cull overlaps it
+	uint64_t nullCountsMark[3] = {}; //Null device calls, commands and barriers as of the last frame, the next frame's prepare counts towards the frame
+	float lastParticleTime = 0.f;
+	LavaFrameReport report = {};
+	FILE* timingsFile = nullptr; //Headless with --output
+	std::vector<double> headlessCpuMs;
+	std::vector<double> headlessGpuMs;
 
 private:
 	void GetSwapchainSupportData();
 	void SetGraphicsQueueFamily();
-	VkShaderModule LoadShader(const char* path);
+	void SetComputeQueueFamily();
+	VkShaderModule LoadShader(const char* name); //Under shaders/, e.g. "triangle.vert.spv"
+	void ReadShaders(); //SPIR-V of every pipeline, mapped or read while the device is still being created
 
 
 private:
 	uint32_t queueFamilyIndex = 0; //TODO:Calculate with enumaration and checks
+	uint32_t computeQueueFamilyIndex = ~0u; //~0u without a second queue, compute work then stays on the graphics queue
+	uint32_t computeQueueIndex = 0;
 	uint32_t frameBufferWidth;
 	uint32_t frameBufferHeight;
 	SwapChainData swapChainData;
+	LavaVfs vfs; //The working directory with packs mounted over it
+	std::unordered_map<std::string, std::vector<uint8_t>> shaderCode; //Stages no pack has, by name, only during startup
+	LavaRendererSettings settings;
+	uint64_t frameIndex = 0;
+	bool supportsDrawIndirectCount = false;
+	bool supportsPipelineStatistics = false;
+	bool supportsMultiDrawIndirect = false;
+	bool supportsIndirectFirstInstance = false;
 };
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "LavaScene.h"
+#include "LavaJobs.h"
+#include "LavaProfiler.h"
+#include <algorithm>
+
+//Nodes per job when updating a level.
+static const uint32_t sceneChunkSize = 4096;
+
+LavaAffineTransform ComposeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+
+	LavaAffineTransform transform;
+	for (int i = 0; i < 3; i++) {
+		transform.rows[i] = glm::vec4(rotationMatrix[0][i] * scale.x, rotationMatrix[1][i] * scale.y, rotationMatrix[2][i] * scale.z, position[i]);
+	}
+	return transform;
+}
+
+glm::vec4 TransformBoundingSphere(const LavaAffineTransform& transform, const glm::vec4& sphere)
+{
+	glm::vec4 center(glm::vec3(sphere), 1.f);
+	float maxScale = 0.f;
+	for (int i = 0; i < 3; i++) {
+		maxScale = std::max(maxScale, glm::length(glm::vec3(transform.rows[0][i], transform.rows[1][i], transform.rows[2][i])));
+	}
+	return glm::vec4(glm::dot(transform.rows[0], center), glm::dot(transform.rows[1], center), glm::dot(transform.rows[2], center), sphere.w * maxScale);
+}
+
+LavaNodeHandle LavaScene::CreateNode(LavaNodeHandle parent)
+{
+	assert(parent == LAVA_INVALID_NODE || records[parent].alive);
+
+	LavaNodeHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else {
+		handle = uint32_t(records.size());
+		records.push_back({});
+		worldTransforms.push_back({});
+	}
+
+	uint32_t level = parent == LAVA_INVALID_NODE ? 0 : records[parent].level + 1;
+	if (levels.size() <= level)
+		levels.resize(level + 1);
+
+	LavaAffineTransform identity = ComposeTransform(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+
+	Level& nodeLevel = levels[level];
+	uint32_t slot = uint32_t(nodeLevel.handles.size());
+	nodeLevel.handles.push_back(handle);
+	nodeLevel.parents.push_back(parent == LAVA_INVALID_NODE ? ~0u : records[parent].slot);
+	nodeLevel.positions.push_back(glm::vec3(0.f));
+	nodeLevel.rotations.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+	nodeLevel.scales.push_back(glm::vec3(1.f));
+	nodeLevel.worlds.push_back(identity);
+
+	//A reused handle can still sit in the dirty list from before it was destroyed, keep its flag so it isn't queued twice.
+	NodeRecord& record = records[handle];
+	bool queued = record.dirty;
+	record = {};
+	record.level = level;
+	record.slot = slot;
+	record.parent = parent;
+	record.firstChild = LAVA_INVALID_NODE;
+	record.previousSibling = LAVA_INVALID_NODE;
+	record.nextSibling = LAVA_INVALID_NODE;
+	record.alive = true;
+	record.dirty = queued;
+
+	if (parent != LAVA_INVALID_NODE) {
+		record.nextSibling = records[parent].firstChild;
+		if (record.nextSibling != LAVA_INVALID_NODE)
+			records[record.nextSibling].previousSibling = handle;
+		records[parent].firstChild = handle;
+	}
+
+	worldTransforms[handle] = identity;
+	nodeCount++;
+	MarkDirty(handle);
+	return handle;
+}
+
+void LavaScene::DestroyNode(LavaNodeHandle node)
+{
+	assert(records[node].alive);
+
+	//Preorder walk, then remove in reverse so children always go before their parent.
+	std::vector<LavaNodeHandle> subtree;
+	subtree.push_back(node);
+	for (size_t i = 0; i < subtree.size(); i++) {
+		for (LavaNodeHandle child = records[subtree[i]].firstChild; child != LAVA_INVALID_NODE; child = records[child].nextSibling) {
+			subtree.push_back(child);
+		}
+	}
+
+	for (size_t i = subtree.size(); i-- > 0;) {
+		LavaNodeHandle handle = subtree[i];
+		NodeRecord& record = records[handle];
+
+		if (record.previousSibling != LAVA_INVALID_NODE)
+			records[record.previousSibling].nextSibling = record.nextSibling;
+		else if (record.parent != LAVA_INVALID_NODE)
+			records[record.parent].firstChild = record.nextSibling;
+		if (record.nextSibling != LAVA_INVALID_NODE)
+			records[record.nextSibling].previousSibling = record.previousSibling;
+
+		RemoveFromLevel(handle);
+		record.alive = false;
+		freeHandles.push_back(handle);
+		nodeCount--;
+	}
+}
+
+void LavaScene::RemoveFromLevel(LavaNodeHandle node)
+{
+	const NodeRecord& record = records[node];
+	Level& level = levels[record.level];
+	uint32_t slot = record.slot;
+	uint32_t lastSlot = uint32_t(level.handles.size()) - 1;
+
+	//Swap remove: the last node of the level takes the free slot and its children are pointed at it.
+	if (slot != lastSlot) {
+		LavaNodeHandle moved = level.handles[lastSlot];
+		level.handles[slot] = moved;
+		level.parents[slot] = level.parents[lastSlot];
+		level.positions[slot] = level.positions[lastSlot];
+		level.rotations[slot] = level.rotations[lastSlot];
+		level.scales[slot] = level.scales[lastSlot];
+		level.worlds[slot] = level.worlds[lastSlot];
+		records[moved].slot = slot;
+
+		for (LavaNodeHandle child = records[moved].firstChild; child != LAVA_INVALID_NODE; child = records[child].nextSibling) {
+			levels[record.level + 1].parents[records[child].slot] = slot;
+		}
+	}
+
+	level.handles.pop_back();
+	level.parents.pop_back();
+	level.positions.pop_back();
+	level.rotations.pop_back();
+	level.scales.pop_back();
+	level.worlds.pop_back();
+}
+
+void LavaScene::SetLocalTransform(LavaNodeHandle node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	const NodeRecord& record = records[node];
+	assert(record.alive);
+	Level& level = levels[record.level];
+	level.positions[record.slot] = position;
+	level.rotations[record.slot] = rotation;
+	level.scales[record.slot] = scale;
+	MarkDirty(node);
+}
+
+void LavaScene::SetPosition(LavaNodeHandle node, const glm::vec3& position)
+{
+	const NodeRecord& record = records[node];
+	assert(record.alive);
+	levels[record.level].positions[record.slot] = position;
+	MarkDirty(node);
+}
+
+void LavaScene::SetRotation(LavaNodeHandle node, const glm::quat& rotation)
+{
+	const NodeRecord& record = records[node];
+	assert(record.alive);
+	levels[record.level].rotations[record.slot] = rotation;
+	MarkDirty(node);
+}
+
+void LavaScene::MarkDirty(LavaNodeHandle node)
+{
+	if (records[node].dirty)
+		return;
+
+	records[node].dirty = true;
+	dirtyNodes.push_back(node);
+}
+
+bool LavaScene::HasDirtyAncestor(LavaNodeHandle node) const
+{
+	for (LavaNodeHandle parent = records[node].parent; parent != LAVA_INVALID_NODE; parent = records[parent].parent) {
+		if (records[parent].dirty)
+			return true;
+	}
+	return false;
+}
+
+void LavaScene::Update(LavaJobSystem* jobSystem)
+{
+	LAVA_PROFILE_ZONE("Scene update");
+	changedNodes.clear();
+	if (dirtyNodes.empty())
+		return;
+
+	//Dirty nodes under another dirty node are covered by that subtree, only the topmost ones start an update.
+	dirtyRoots.resize(levels.size());
+	for (std::vector<uint32_t>& roots : dirtyRoots) {
+		roots.clear();
+	}
+	for (LavaNodeHandle node : dirtyNodes) {
+		const NodeRecord& record = records[node];
+		if (record.alive && record.dirty && !HasDirtyAncestor(node))
+			dirtyRoots[record.level].push_back(record.slot);
+	}
+	for (LavaNodeHandle node : dirtyNodes) {
+		records[node].dirty = false;
+	}
+	dirtyNodes.clear();
+
+	//Level by level: slots to update are the dirty roots on this level plus the children of what changed above.
+	levelSlots.clear();
+	for (uint32_t levelIndex = 0; levelIndex < uint32_t(levels.size()); levelIndex++) {
+		levelSlots.insert(levelSlots.end(), dirtyRoots[levelIndex].begin(), dirtyRoots[levelIndex].end());
+		if (levelSlots.empty())
+			continue;
+
+		Level& level = levels[levelIndex];
+		const Level* parentLevel = levelIndex > 0 ? &levels[levelIndex - 1] : nullptr;
+		bool hasChildLevel = levelIndex + 1 < uint32_t(levels.size());
+
+		uint32_t slotCount = uint32_t(levelSlots.size());
+		uint32_t chunkCount = (slotCount + sceneChunkSize - 1) / sceneChunkSize;
+		if (chunkChildren.size() < chunkCount)
+			chunkChildren.resize(chunkCount);
+
+		LavaParallelFor(jobSystem, slotCount, sceneChunkSize, [&](uint32_t begin, uint32_t end, uint32_t chunk) {
+			std::vector<uint32_t>& children = chunkChildren[chunk];
+			children.clear();
+
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t slot = levelSlots[i];
+				LavaAffineTransform local = ComposeTransform(level.positions[slot], level.rotations[slot], level.scales[slot]);
+				LavaAffineTransform world = parentLevel ? MultiplyTransforms(parentLevel->worlds[level.parents[slot]], local) : local;
+				level.worlds[slot] = world;
+
+				LavaNodeHandle handle = level.handles[slot];
+				worldTransforms[handle] = world;
+
+				if (!hasChildLevel)
+					continue;
+				for (LavaNodeHandle child = records[handle].firstChild; child != LAVA_INVALID_NODE; child = records[child].nextSibling) {
+					children.push_back(records[child].slot);
+				}
+			}
+		});
+
+		for (uint32_t slot : levelSlots) {
+			changedNodes.push_back(level.handles[slot]);
+		}
+
+		levelSlots.clear();
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			levelSlots.insert(levelSlots.end(), chunkChildren[chunk].begin(), chunkChildren[chunk].end());
+		}
+	}
+}
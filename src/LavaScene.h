@@ -0,0 +1,98 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <gtc/quaternion.hpp>
+#include <vector>
+
+class LavaJobSystem;
+
+typedef uint32_t LavaNodeHandle;
+const LavaNodeHandle LAVA_INVALID_NODE = ~0u;
+
+//Affine transform as the top 3 rows of a 4x4 matrix, same layout as LavaInstance::transform.
+struct LavaAffineTransform {
+	glm::vec4 rows[3];
+};
+
+LavaAffineTransform ComposeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+//Inline, skinning and the scene update run it for every joint and node.
+inline LavaAffineTransform MultiplyTransforms(const LavaAffineTransform& parent, const LavaAffineTransform& child)
+{
+	//Implicit (0,0,0,1) bottom rows, so only the parent translation is added on top.
+	LavaAffineTransform result;
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4& row = parent.rows[i];
+		result.rows[i] = row.x * child.rows[0] + row.y * child.rows[1] + row.z * child.rows[2] + glm::vec4(0.f, 0.f, 0.f, row.w);
+	}
+	return result;
+}
+
+//Bounding sphere (center, radius) through a transform, the radius grows with the largest axis scale.
+glm::vec4 TransformBoundingSphere(const LavaAffineTransform& transform, const glm::vec4& sphere);
+
+//Transform hierarchy stored per depth level in structure of arrays, so a level only reads the level above it.
+//Update() recomputes just the dirty subtrees, one level at a time with the level spread over the job system.
+//Handles are stable, the slot of a node inside its level moves when nodes are destroyed.
+class LavaScene {
+public:
+	LavaNodeHandle CreateNode(LavaNodeHandle parent = LAVA_INVALID_NODE);
+	void DestroyNode(LavaNodeHandle node); //Destroys the whole subtree
+
+	void SetLocalTransform(LavaNodeHandle node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void SetPosition(LavaNodeHandle node, const glm::vec3& position);
+	void SetRotation(LavaNodeHandle node, const glm::quat& rotation);
+
+	void Update(LavaJobSystem* jobSystem);
+
+	//Published world transforms indexed by handle, ready to copy into an instance or storage buffer.
+	const LavaAffineTransform* GetWorldTransforms() const { return worldTransforms.data(); }
+	const LavaAffineTransform& GetWorldTransform(LavaNodeHandle node) const { return worldTransforms[node]; }
+	uint32_t GetHandleCapacity() const { return uint32_t(worldTransforms.size()); }
+
+	//Nodes whose world transform changed in the last Update(), for partial uploads.
+	const std::vector<LavaNodeHandle>& GetChangedNodes() const { return changedNodes; }
+
+	uint32_t GetNodeCount() const { return nodeCount; }
+	uint32_t GetLevelCount() const { return uint32_t(levels.size()); }
+
+private:
+	struct Level {
+		std::vector<LavaNodeHandle> handles;
+		std::vector<uint32_t> parents; //Slot in the level above
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<LavaAffineTransform> worlds;
+	};
+
+	//Cold per handle data, only touched when the hierarchy changes.
+	struct NodeRecord {
+		uint32_t level;
+		uint32_t slot;
+		LavaNodeHandle parent;
+		LavaNodeHandle firstChild;
+		LavaNodeHandle nextSibling;
+		LavaNodeHandle previousSibling;
+		bool alive;
+		bool dirty;
+	};
+
+	void MarkDirty(LavaNodeHandle node);
+	void RemoveFromLevel(LavaNodeHandle node);
+	bool HasDirtyAncestor(LavaNodeHandle node) const;
+
+private:
+	std::vector<Level> levels;
+	std::vector<NodeRecord> records;
+	std::vector<LavaNodeHandle> freeHandles;
+	std::vector<LavaAffineTransform> worldTransforms;
+	uint32_t nodeCount = 0;
+
+	std::vector<LavaNodeHandle> dirtyNodes;
+	std::vector<LavaNodeHandle> changedNodes;
+
+	//Update scratch, kept between frames so a quiet frame doesn't allocate.
+	std::vector<std::vector<uint32_t>> dirtyRoots; //Per level slots of dirty subtree roots
+	std::vector<uint32_t> levelSlots;
+	std::vector<std::vector<uint32_t>> chunkChildren;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+//Compile time SIMD level. SSE2 is baseline on x64, AVX2 needs /arch:AVX2 or -mavx2.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAVA_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define LAVA_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+//Runtime dispatch on x86: functions marked LAVA_TARGET_AVX2 are compiled for AVX2 whatever the build flags say,
+//callers only run them when LavaCpuHasAvx2().
+#if defined(LAVA_SIMD_SSE2)
+#define LAVA_SIMD_AVX2_DISPATCH 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define LAVA_TARGET_AVX2
+inline bool LavaCpuHasAvx2()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6; //OSXSAVE, then XMM and YMM state enabled
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5)) != 0;
+}
+#else
+#define LAVA_TARGET_AVX2 __attribute__((target("avx2")))
+inline bool LavaCpuHasAvx2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+inline unsigned int LavaCountTrailingZeros(unsigned int mask)
+{
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+}
+#else
+inline unsigned int LavaCountTrailingZeros(unsigned int mask)
+{
+	return __builtin_ctz(mask);
+}
+#endif
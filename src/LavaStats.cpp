@@ -0,0 +1,179 @@
+#include "LavaStats.h"
+
+#include <string.h>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Stats ring needs lock free 64 bit atomics to live in shared memory");
+
+LavaStatsRing::~LavaStatsRing()
+{
+	Destroy();
+}
+
+bool LavaStatsRing::Map(const char* sharedName, size_t size, bool create)
+{
+#if defined(_WIN32)
+	name = sharedName;
+	HANDLE mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), sharedName)
+		: OpenFileMappingA(FILE_MAP_READ, FALSE, sharedName);
+	if (!mapping)
+		return false;
+
+	void* data = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	if (!data) {
+		CloseHandle(mapping);
+		return false;
+	}
+	mappingHandle = mapping;
+#else
+	//POSIX names are a single path component with a leading slash.
+	name = sharedName[0] == '/' ? sharedName : std::string("/") + sharedName;
+	int file = create ? shm_open(name.c_str(), O_CREAT | O_RDWR, 0644) : shm_open(name.c_str(), O_RDONLY, 0);
+	if (file < 0)
+		return false;
+
+	if (create && ftruncate(file, off_t(size)) != 0) {
+		close(file);
+		shm_unlink(name.c_str());
+		return false;
+	}
+	if (!create) {
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || size_t(fileStat.st_size) < size) {
+			close(file);
+			return false;
+		}
+	}
+
+	void* data = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (data == MAP_FAILED) {
+		if (create)
+			shm_unlink(name.c_str());
+		return false;
+	}
+#endif
+	header = static_cast<LavaStatsHeader*>(data);
+	mappingSize = size;
+	shared = true;
+	owner = create;
+	return true;
+}
+
+bool LavaStatsRing::Create(uint32_t capacity, const char* sharedName)
+{
+	Destroy();
+	capacity = (capacity ? capacity : 1) + 1;
+	size_t size = sizeof(LavaStatsHeader) + size_t(capacity) * sizeof(LavaStatsSlot);
+	if (sharedName) {
+		if (!Map(sharedName, size, true))
+			return false;
+		memset(static_cast<void*>(header), 0, size);
+	}
+	else {
+		header = static_cast<LavaStatsHeader*>(::operator new(size));
+		memset(static_cast<void*>(header), 0, size);
+		mappingSize = size;
+		owner = true;
+	}
+
+	slots = reinterpret_cast<LavaStatsSlot*>(header + 1);
+	new (&header->frameCount) std::atomic<uint64_t>(0);
+	for (uint32_t i = 0; i < capacity; i++) {
+		new (&slots[i].sequence) std::atomic<uint32_t>(0);
+	}
+	header->capacity = capacity;
+	header->slotSize = sizeof(LavaStatsSlot);
+	header->version = LAVA_STATS_VERSION;
+	//Magic last, a reader that opens the segment halfway through creation sees an invalid header.
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = LAVA_STATS_MAGIC;
+	return true;
+}
+
+bool LavaStatsRing::Open(const char* sharedName)
+{
+	Destroy();
+	if (!Map(sharedName, sizeof(LavaStatsHeader), false))
+		return false;
+
+	LavaStatsHeader headerCopy;
+	memcpy(static_cast<void*>(&headerCopy), header, sizeof(LavaStatsHeader));
+	bool valid = headerCopy.magic == LAVA_STATS_MAGIC && headerCopy.version == LAVA_STATS_VERSION && headerCopy.slotSize == sizeof(LavaStatsSlot)
+		&& headerCopy.capacity > 0;
+	Destroy();
+	if (!valid)
+		return false;
+
+	//Remap with the full ring now that the capacity is known.
+	if (!Map(sharedName, sizeof(LavaStatsHeader) + size_t(headerCopy.capacity) * sizeof(LavaStatsSlot), false))
+		return false;
+	slots = reinterpret_cast<LavaStatsSlot*>(header + 1);
+	return true;
+}
+
+void LavaStatsRing::Destroy()
+{
+	if (!header)
+		return;
+
+	if (shared) {
+#if defined(_WIN32)
+		UnmapViewOfFile(header);
+		CloseHandle(HANDLE(mappingHandle));
+#else
+		munmap(header, mappingSize);
+		if (owner)
+			shm_unlink(name.c_str());
+#endif
+	}
+	else {
+		::operator delete(header);
+	}
+	header = nullptr;
+	slots = nullptr;
+	mappingHandle = nullptr;
+	mappingSize = 0;
+	shared = false;
+	owner = false;
+}
+
+void LavaStatsRing::Push(const LavaFrameStats& stats)
+{
+	uint64_t frame = header->frameCount.load(std::memory_order_relaxed);
+	LavaStatsSlot& slot = slots[frame % header->capacity];
+
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.stats = stats;
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	header->frameCount.store(frame + 1, std::memory_order_release);
+}
+
+bool LavaStatsRing::Read(uint64_t frame, LavaFrameStats& stats) const
+{
+	//The writer starts overwriting frame's slot once frameCount reaches frame + capacity.
+	uint64_t frameCount = GetFrameCount();
+	if (frame >= frameCount || frameCount - frame >= header->capacity)
+		return false;
+
+	const LavaStatsSlot& slot = slots[frame % header->capacity];
+	uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+	if (sequence & 1)
+		return false;
+	memcpy(&stats, &slot.stats, sizeof(LavaFrameStats));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == sequence && GetFrameCount() - frame < header->capacity;
+}
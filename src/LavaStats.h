@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+//Counters of one frame. The layout is shared with readers in other processes, only append fields and bump
+//LAVA_STATS_VERSION when it changes.
+struct LavaFrameStats {
+	uint64_t frameIndex;
+	double cpuFrameMs; //Acquire, recording and submit, same as the printed CPU frame time
+	double gpuFrameMs; //First to last graph timestamp, 0 without timestamp support
+	uint64_t triangles; //Submitted by the CPU paths, the GPU driven path only reports them through pipeline statistics
+	uint64_t uploadedBytes; //Instance stream and texture uploads
+	uint32_t draws; //Recorded by the CPU, a replayed command buffer reports what it was recorded with
+	uint32_t pipelineBinds;
+	uint32_t barriers;
+	uint32_t allocations; //Device memory allocations made during the frame
+
+	//Pipeline statistics query over the whole frame, only valid when the device supports them.
+	uint32_t hasPipelineStatistics;
+	uint32_t padding;
+	uint64_t inputPrimitives;
+	uint64_t vertexInvocations;
+	uint64_t clippingPrimitives;
+	uint64_t fragmentInvocations;
+	uint64_t computeInvocations;
+};
+
+const uint32_t LAVA_STATS_MAGIC = 0x4154534c; //"LSTA"
+const uint32_t LAVA_STATS_VERSION = 1;
+
+struct LavaStatsHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity; //Slots, one more than the frames kept: the oldest one is the next to be overwritten
+	uint32_t slotSize;
+	std::atomic<uint64_t> frameCount; //Frames pushed so far, frame n lives in slot n % capacity
+};
+
+//Odd sequence while the writer is inside the slot, readers retry or skip the frame when it changed under them.
+struct LavaStatsSlot {
+	std::atomic<uint32_t> sequence;
+	uint32_t padding;
+	LavaFrameStats stats;
+};
+
+//Ring of the last capacity frames. With a name it lives in a named shared memory segment (POSIX shm, a named
+//file mapping on Windows), so a dashboard process can map it read only and never touches the render thread.
+//One writer, any number of readers, nobody takes a lock.
+class LavaStatsRing {
+public:
+	~LavaStatsRing();
+
+	//Writer side, sharedName may be null for a process local ring. False if the segment can't be created.
+	bool Create(uint32_t capacity, const char* sharedName);
+	//Reader side, maps an existing segment read only. False if it doesn't exist or has a different layout.
+	bool Open(const char* sharedName);
+	void Destroy();
+
+	void Push(const LavaFrameStats& stats);
+	//False once the frame was overwritten or while it is being written.
+	bool Read(uint64_t frame, LavaFrameStats& stats) const;
+
+	bool IsValid() const { return header != nullptr; }
+	uint64_t GetFrameCount() const { return header->frameCount.load(std::memory_order_acquire); }
+	uint32_t GetCapacity() const { return header->capacity - 1; }
+
+private:
+	bool Map(const char* sharedName, size_t size, bool create);
+
+private:
+	LavaStatsHeader* header = nullptr;
+	LavaStatsSlot* slots = nullptr;
+	size_t mappingSize = 0;
+	void* mappingHandle = nullptr; //Windows file mapping
+	bool shared = false;
+	bool owner = false;
+	std::string name;
+};
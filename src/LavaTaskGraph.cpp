@@ -0,0 +1,130 @@
+#include "LavaTaskGraph.h"
+#include "LavaCore.h"
+#include "LavaProfiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+uint32_t LavaTaskGraph::Add(const char* name, std::function<void()> function, std::initializer_list<uint32_t> dependencies)
+{
+	uint32_t task = uint32_t(tasks.size());
+	tasks.push_back({ name, std::move(function), dependencies, {} });
+	for (uint32_t dependency : dependencies) {
+		assert(dependency < task && "Tasks have to be added after their dependencies");
+		tasks[dependency].dependents.push_back(task);
+	}
+	return task;
+}
+
+void LavaTaskGraph::Run(LavaJobSystem* jobSystem)
+{
+	runBegin = std::chrono::steady_clock::now();
+	timings.assign(tasks.size(), LavaTaskTiming{});
+	threads.clear();
+
+	if (!jobSystem) {
+		for (uint32_t task = 0; task < uint32_t(tasks.size()); task++) {
+			Execute(task);
+		}
+	}
+	else {
+		remainingDependencies.reset(new std::atomic<uint32_t>[tasks.size()]);
+		for (size_t task = 0; task < tasks.size(); task++) {
+			remainingDependencies[task].store(uint32_t(tasks[task].dependencies.size()));
+		}
+
+		LavaJobCounter counter;
+		for (uint32_t task = 0; task < uint32_t(tasks.size()); task++) {
+			if (tasks[task].dependencies.empty())
+				Submit(jobSystem, &counter, task);
+		}
+		jobSystem->Wait(counter);
+	}
+
+	totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runBegin).count();
+}
+
+//The last dependency to finish submits the task, from the thread that ran it.
+void LavaTaskGraph::Submit(LavaJobSystem* jobSystem, LavaJobCounter* counter, uint32_t task)
+{
+	jobSystem->Submit([this, jobSystem, counter, task]() {
+		Execute(task);
+		for (uint32_t dependent : tasks[task].dependents) {
+			if (remainingDependencies[dependent].fetch_sub(1) == 1)
+				Submit(jobSystem, counter, dependent);
+		}
+	}, counter);
+}
+
+void LavaTaskGraph::Execute(uint32_t task)
+{
+	LavaTaskTiming& timing = timings[task];
+	timing.name = tasks[task].name;
+	{
+		std::lock_guard<std::mutex> lock(threadMutex);
+		std::thread::id id = std::this_thread::get_id();
+		timing.thread = uint32_t(std::find(threads.begin(), threads.end(), id) - threads.begin());
+		if (timing.thread == threads.size())
+			threads.push_back(id);
+	}
+
+	timing.beginMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runBegin).count();
+	{
+		LAVA_PROFILE_ZONE(tasks[task].name);
+		tasks[task].function();
+	}
+	timing.endMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runBegin).count();
+}
+
+void LavaTaskGraph::PrintTimeline() const
+{
+	const uint32_t barWidth = 40;
+	double workMs = 0.0;
+	uint32_t threadCount = 0;
+	for (const LavaTaskTiming& timing : timings) {
+		workMs += timing.endMs - timing.beginMs;
+		threadCount = std::max(threadCount, timing.thread + 1);
+	}
+
+	char line[256];
+	snprintf(line, sizeof(line), "Startup: %.1f ms, %.1f ms of work on %u threads", totalMs, workMs, threadCount);
+	LAVA_PRINT(line);
+	double scale = totalMs > 0.0 ? barWidth / totalMs : 0.0;
+	for (const LavaTaskTiming& timing : timings) {
+		char bar[barWidth + 1];
+		uint32_t barBegin = std::min(barWidth - 1, uint32_t(timing.beginMs * scale));
+		uint32_t barEnd = std::max(barBegin + 1, std::min(barWidth, uint32_t(timing.endMs * scale + 0.5)));
+		for (uint32_t i = 0; i < barWidth; i++) {
+			bar[i] = i >= barBegin && i < barEnd ? '#' : '.';
+		}
+		bar[barWidth] = 0;
+		snprintf(line, sizeof(line), "  %-20s %8.1f %8.1f ms  T%u %s", timing.name, timing.beginMs, timing.endMs - timing.beginMs, timing.thread, bar);
+		LAVA_PRINT(line);
+	}
+
+	//Walks back from the task that finished last through whichever dependency finished last, that chain bounded startup.
+	if (timings.empty())
+		return;
+	uint32_t task = 0;
+	for (uint32_t i = 1; i < uint32_t(timings.size()); i++) {
+		if (timings[i].endMs > timings[task].endMs)
+			task = i;
+	}
+	std::vector<uint32_t> criticalPath(1, task);
+	while (!tasks[task].dependencies.empty()) {
+		uint32_t latest = tasks[task].dependencies[0];
+		for (uint32_t dependency : tasks[task].dependencies) {
+			if (timings[dependency].endMs > timings[latest].endMs)
+				latest = dependency;
+		}
+		task = latest;
+		criticalPath.push_back(task);
+	}
+	std::string path;
+	for (size_t i = criticalPath.size(); i-- > 0;) {
+		path += timings[criticalPath[i]].name;
+		if (i)
+			path += " > ";
+	}
+	LAVA_PRINT("  Critical path: " << path);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "LavaJobs.h"
+
+#include <chrono>
+#include <initializer_list>
+#include <memory>
+
+struct LavaTaskTiming {
+	const char* name;
+	double beginMs; //Since Run() started
+	double endMs;
+	uint32_t thread; //In order of first use, 0 is whichever thread ran the first task
+};
+
+//Named tasks with dependencies, run on the job system as soon as everything they depend on finished. Every task
+//is timed, PrintTimeline() shows where startup time went and which chain of tasks bounded it.
+class LavaTaskGraph {
+public:
+	//Dependencies have to be added first, so the add order is always a valid serial order.
+	//Names have to outlive the graph, string literals in practice.
+	uint32_t Add(const char* name, std::function<void()> function, std::initializer_list<uint32_t> dependencies = {});
+
+	//Blocks until every task ran, the calling thread runs tasks while it waits. Serial in add order without a job system.
+	void Run(LavaJobSystem* jobSystem);
+
+	const std::vector<LavaTaskTiming>& GetTimings() const { return timings; }
+	double GetTotalMs() const { return totalMs; }
+	void PrintTimeline() const;
+
+private:
+	void Submit(LavaJobSystem* jobSystem, LavaJobCounter* counter, uint32_t task);
+	void Execute(uint32_t task);
+
+private:
+	struct Task {
+		const char* name;
+		std::function<void()> function;
+		std::vector<uint32_t> dependencies;
+		std::vector<uint32_t> dependents;
+	};
+
+	std::vector<Task> tasks;
+	std::unique_ptr<std::atomic<uint32_t>[]> remainingDependencies;
+	std::vector<LavaTaskTiming> timings;
+	std::vector<std::thread::id> threads;
+	std::mutex threadMutex;
+	std::chrono::steady_clock::time_point runBegin;
+	double totalMs = 0.0;
+};
@@ -0,0 +1,1090 @@
+#include "LavaTextureCompression.h"
+#include "LavaJobs.h"
+#include "LavaProfiler.h"
+#include "LavaSimd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <float.h>
+
+static const uint32_t compressionBlocksPerJob = 1024;
+
+//16 texels split per channel, the layout the index search vectorizes over. Values are 0-255.
+struct LavaColorBlock {
+	alignas(32) float channels[4][16];
+};
+
+static void LoadBlock(const LavaImage& image, uint32_t blockX, uint32_t blockY, LavaColorBlock& block)
+{
+	for (uint32_t y = 0; y < 4; y++) {
+		uint32_t sourceY = std::min(blockY * 4 + y, image.height - 1);
+		for (uint32_t x = 0; x < 4; x++) {
+			uint32_t sourceX = std::min(blockX * 4 + x, image.width - 1);
+			const uint8_t* texel = &image.rgba[(size_t(sourceY) * image.width + sourceX) * 4];
+			for (uint32_t channel = 0; channel < 4; channel++) {
+				block.channels[channel][y * 4 + x] = float(texel[channel]);
+			}
+		}
+	}
+}
+
+//Picks the closest palette entry for every texel over channels [firstChannel, firstChannel + channelCount) and
+//returns the summed squared error. Ties go to the lower index in every variant, so they encode identically.
+static float FitIndicesScalar(const LavaColorBlock& block, const float (*palette)[4], uint32_t paletteSize, uint32_t firstChannel, uint32_t channelCount,
+	uint8_t* indices)
+{
+	float total = 0.f;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		float best = FLT_MAX;
+		uint32_t bestIndex = 0;
+		for (uint32_t entry = 0; entry < paletteSize; entry++) {
+			float distance = 0.f;
+			for (uint32_t channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+				float difference = block.channels[channel][texel] - palette[entry][channel];
+				distance += difference * difference;
+			}
+			if (distance < best) {
+				best = distance;
+				bestIndex = entry;
+			}
+		}
+		indices[texel] = uint8_t(bestIndex);
+		total += best;
+	}
+	return total;
+}
+
+#if defined(LAVA_SIMD_AVX2_DISPATCH)
+LAVA_TARGET_AVX2 static float FitIndicesAvx2(const LavaColorBlock& block, const float (*palette)[4], uint32_t paletteSize, uint32_t firstChannel, uint32_t channelCount,
+	uint8_t* indices)
+{
+	float total = 0.f;
+	for (uint32_t group = 0; group < 16; group += 8) {
+		__m256 best = _mm256_set1_ps(FLT_MAX);
+		__m256 bestIndex = _mm256_setzero_ps();
+		for (uint32_t entry = 0; entry < paletteSize; entry++) {
+			__m256 distance = _mm256_setzero_ps();
+			for (uint32_t channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+				__m256 difference = _mm256_sub_ps(_mm256_load_ps(&block.channels[channel][group]), _mm256_set1_ps(palette[entry][channel]));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(difference, difference));
+			}
+			__m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+			best = _mm256_min_ps(distance, best);
+			bestIndex = _mm256_blendv_ps(bestIndex, _mm256_set1_ps(float(entry)), closer);
+		}
+
+		alignas(32) float errors[8];
+		alignas(32) int32_t groupIndices[8];
+		_mm256_store_ps(errors, best);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(groupIndices), _mm256_cvtps_epi32(bestIndex));
+		for (uint32_t i = 0; i < 8; i++) {
+			indices[group + i] = uint8_t(groupIndices[i]);
+			total += errors[i];
+		}
+	}
+	return total;
+}
+#endif
+
+#if defined(LAVA_SIMD_SSE2)
+static float FitIndicesSse2(const LavaColorBlock& block, const float (*palette)[4], uint32_t paletteSize, uint32_t firstChannel, uint32_t channelCount,
+	uint8_t* indices)
+{
+	float total = 0.f;
+	for (uint32_t group = 0; group < 16; group += 4) {
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (uint32_t entry = 0; entry < paletteSize; entry++) {
+			__m128 distance = _mm_setzero_ps();
+			for (uint32_t channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+				__m128 difference = _mm_sub_ps(_mm_load_ps(&block.channels[channel][group]), _mm_set1_ps(palette[entry][channel]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(int(entry))), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		alignas(16) float errors[4];
+		alignas(16) int32_t groupIndices[4];
+		_mm_store_ps(errors, best);
+		_mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+		for (uint32_t i = 0; i < 4; i++) {
+			indices[group + i] = uint8_t(groupIndices[i]);
+			total += errors[i];
+		}
+	}
+	return total;
+}
+#endif
+
+typedef float (*LavaFitIndicesFunction)(const LavaColorBlock& block, const float (*palette)[4], uint32_t paletteSize, uint32_t firstChannel,
+	uint32_t channelCount, uint8_t* indices);
+
+static LavaFitIndicesFunction GetFitIndicesFunction(LavaCompressionKernel kernel)
+{
+	switch (kernel) {
+#if defined(LAVA_SIMD_AVX2_DISPATCH)
+	case LAVA_COMPRESSION_KERNEL_AVX2:
+		return FitIndicesAvx2;
+#endif
+#if defined(LAVA_SIMD_SSE2)
+	case LAVA_COMPRESSION_KERNEL_SSE2:
+		return FitIndicesSse2;
+#endif
+	default:
+		return FitIndicesScalar;
+	}
+}
+
+static LavaCompressionKernel compressionKernel = LavaGetBestCompressionKernel();
+static LavaFitIndicesFunction fitIndices = GetFitIndicesFunction(compressionKernel);
+
+static float FitIndices(const LavaColorBlock& block, const float (*palette)[4], uint32_t paletteSize, uint32_t firstChannel, uint32_t channelCount,
+	uint8_t* indices)
+{
+	return fitIndices(block, palette, paletteSize, firstChannel, channelCount, indices);
+}
+
+bool LavaIsCompressionKernelSupported(LavaCompressionKernel kernel)
+{
+	switch (kernel) {
+	case LAVA_COMPRESSION_KERNEL_SCALAR:
+		return true;
+	case LAVA_COMPRESSION_KERNEL_SSE2:
+#if defined(LAVA_SIMD_SSE2)
+		return true;
+#else
+		return false;
+#endif
+	case LAVA_COMPRESSION_KERNEL_AVX2:
+#if defined(LAVA_SIMD_AVX2_DISPATCH)
+		return LavaCpuHasAvx2();
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+LavaCompressionKernel LavaGetBestCompressionKernel()
+{
+	if (LavaIsCompressionKernelSupported(LAVA_COMPRESSION_KERNEL_AVX2))
+		return LAVA_COMPRESSION_KERNEL_AVX2;
+	if (LavaIsCompressionKernelSupported(LAVA_COMPRESSION_KERNEL_SSE2))
+		return LAVA_COMPRESSION_KERNEL_SSE2;
+	return LAVA_COMPRESSION_KERNEL_SCALAR;
+}
+
+void LavaSetCompressionKernel(LavaCompressionKernel kernel)
+{
+	assert(LavaIsCompressionKernelSupported(kernel));
+	compressionKernel = kernel;
+	fitIndices = GetFitIndicesFunction(kernel);
+}
+
+LavaCompressionKernel LavaGetCompressionKernel()
+{
+	return compressionKernel;
+}
+
+const char* LavaCompressionKernelName(LavaCompressionKernel kernel)
+{
+	switch (kernel) {
+	case LAVA_COMPRESSION_KERNEL_SCALAR:
+		return "scalar";
+	case LAVA_COMPRESSION_KERNEL_SSE2:
+		return "sse2";
+	case LAVA_COMPRESSION_KERNEL_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+//Line through the texels the palette gets interpolated on. Fast takes the bounding box diagonal, the others the
+//principal axis of the covariance, which also follows anti-correlated channels.
+static void ComputeEndpoints(const LavaColorBlock& block, uint32_t firstChannel, uint32_t channelCount, LavaCompressionQuality quality,
+	float endpoint0[4], float endpoint1[4])
+{
+	uint32_t lastChannel = firstChannel + channelCount;
+	float minimum[4] = {};
+	float maximum[4] = {};
+	float mean[4] = {};
+	for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+		minimum[channel] = FLT_MAX;
+		maximum[channel] = -FLT_MAX;
+		for (uint32_t texel = 0; texel < 16; texel++) {
+			float value = block.channels[channel][texel];
+			minimum[channel] = std::min(minimum[channel], value);
+			maximum[channel] = std::max(maximum[channel], value);
+			mean[channel] += value;
+		}
+		mean[channel] /= 16.f;
+	}
+
+	if (quality == LAVA_COMPRESSION_FAST) {
+		//Inset by 1/16 of the range, extremes tend to be outliers and the interpolated entries land closer to the bulk.
+		for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+			float inset = (maximum[channel] - minimum[channel]) / 16.f;
+			endpoint0[channel] = maximum[channel] - inset;
+			endpoint1[channel] = minimum[channel] + inset;
+		}
+		return;
+	}
+
+	float covariance[4][4] = {};
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		for (uint32_t i = firstChannel; i < lastChannel; i++) {
+			float di = block.channels[i][texel] - mean[i];
+			for (uint32_t j = firstChannel; j < lastChannel; j++) {
+				covariance[i][j] += di * (block.channels[j][texel] - mean[j]);
+			}
+		}
+	}
+
+	//Power iteration from the row with the largest variance, a few steps are plenty for 16 points.
+	uint32_t largest = firstChannel;
+	for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+		if (covariance[channel][channel] > covariance[largest][largest])
+			largest = channel;
+	}
+	float axis[4] = {};
+	for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+		axis[channel] = covariance[largest][channel];
+	}
+	for (uint32_t iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		float length = 0.f;
+		for (uint32_t i = firstChannel; i < lastChannel; i++) {
+			for (uint32_t j = firstChannel; j < lastChannel; j++) {
+				next[i] += covariance[i][j] * axis[j];
+			}
+			length += next[i] * next[i];
+		}
+		if (length < 1e-12f)
+			break;
+		length = 1.f / std::sqrt(length);
+		for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+			axis[channel] = next[channel] * length;
+		}
+	}
+
+	float axisLength = 0.f;
+	for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+		axisLength += axis[channel] * axis[channel];
+	}
+	if (axisLength < 1e-12f) {
+		//Flat block
+		for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+			endpoint0[channel] = endpoint1[channel] = mean[channel];
+		}
+		return;
+	}
+	axisLength = 1.f / std::sqrt(axisLength);
+
+	float minimumT = FLT_MAX;
+	float maximumT = -FLT_MAX;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		float t = 0.f;
+		for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+			t += (block.channels[channel][texel] - mean[channel]) * axis[channel] * axisLength;
+		}
+		minimumT = std::min(minimumT, t);
+		maximumT = std::max(maximumT, t);
+	}
+	for (uint32_t channel = firstChannel; channel < lastChannel; channel++) {
+		endpoint0[channel] = std::min(std::max(mean[channel] + axis[channel] * axisLength * maximumT, 0.f), 255.f);
+		endpoint1[channel] = std::min(std::max(mean[channel] + axis[channel] * axisLength * minimumT, 0.f), 255.f);
+	}
+}
+
+//Least squares endpoints for fixed indices, weights[index] is how much of endpoint1 that index mixes in.
+static bool RefitEndpoints(const LavaColorBlock& block, uint32_t firstChannel, uint32_t channelCount, const uint8_t* indices, const float* weights,
+	float endpoint0[4], float endpoint1[4])
+{
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float ax[4] = {};
+	float bx[4] = {};
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		float b = weights[indices[texel]];
+		float a = 1.f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+			ax[channel] += a * block.channels[channel][texel];
+			bx[channel] += b * block.channels[channel][texel];
+		}
+	}
+
+	//Singular when every texel uses the same index
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	float inverse = 1.f / determinant;
+	for (uint32_t channel = firstChannel; channel < firstChannel + channelCount; channel++) {
+		endpoint0[channel] = std::min(std::max((bb * ax[channel] - ab * bx[channel]) * inverse, 0.f), 255.f);
+		endpoint1[channel] = std::min(std::max((aa * bx[channel] - ab * ax[channel]) * inverse, 0.f), 255.f);
+	}
+	return true;
+}
+
+struct LavaBitWriter {
+	uint8_t* output; //Zeroed
+	uint32_t offset;
+
+	void Write(uint32_t value, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++, offset++) {
+			if ((value >> i) & 1)
+				output[offset >> 3] |= uint8_t(1u << (offset & 7));
+		}
+	}
+};
+
+struct LavaBitReader {
+	const uint8_t* input;
+	uint32_t offset;
+
+	uint32_t Read(uint32_t count)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < count; i++, offset++) {
+			value |= uint32_t((input[offset >> 3] >> (offset & 7)) & 1) << i;
+		}
+		return value;
+	}
+};
+
+//BC1: two RGB565 endpoints, 2 bit indices. color0 > color1 selects the 4 color mode, the only one we encode.
+static const uint32_t rgb565Shifts[3] = { 11, 5, 0 };
+static const uint32_t rgb565Maximum[3] = { 31, 63, 31 };
+static const float bc1Weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+static uint16_t PackRgb565(const float color[4])
+{
+	uint32_t packed = 0;
+	for (uint32_t channel = 0; channel < 3; channel++) {
+		uint32_t value = uint32_t(color[channel] * float(rgb565Maximum[channel]) / 255.f + 0.5f);
+		packed |= std::min(value, rgb565Maximum[channel]) << rgb565Shifts[channel];
+	}
+	return uint16_t(packed);
+}
+
+static void UnpackRgb565(uint16_t packed, uint32_t color[3])
+{
+	uint32_t r = (packed >> 11) & 31;
+	uint32_t g = (packed >> 5) & 63;
+	uint32_t b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+static void BuildBc1Palette(uint16_t color0, uint16_t color1, bool fourColor, uint32_t palette[4][3])
+{
+	UnpackRgb565(color0, palette[0]);
+	UnpackRgb565(color1, palette[1]);
+	for (uint32_t channel = 0; channel < 3; channel++) {
+		uint32_t a = palette[0][channel];
+		uint32_t b = palette[1][channel];
+		palette[2][channel] = fourColor ? (2 * a + b + 1) / 3 : (a + b) / 2;
+		palette[3][channel] = fourColor ? (a + 2 * b + 1) / 3 : 0;
+	}
+}
+
+static float EncodeBc1Endpoints(const LavaColorBlock& block, uint16_t color0, uint16_t color1, uint8_t* output, uint8_t* indices)
+{
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint32_t colors[4][3];
+	BuildBc1Palette(color0, color1, true, colors);
+	float palette[4][4] = {};
+	for (uint32_t entry = 0; entry < 4; entry++) {
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			palette[entry][channel] = float(colors[entry][channel]);
+		}
+	}
+
+	//Equal endpoints decode in 3 color mode in BC1 but 4 color mode in BC3, index 0 is the same color in both.
+	float error = FitIndices(block, palette, color0 == color1 ? 1 : 4, 0, 3, indices);
+
+	uint32_t bits = 0;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		bits |= uint32_t(indices[texel]) << (texel * 2);
+	}
+	memcpy(output, &color0, 2);
+	memcpy(output + 2, &color1, 2);
+	memcpy(output + 4, &bits, 4);
+	return error;
+}
+
+static void EncodeBc1Block(const LavaColorBlock& block, LavaCompressionQuality quality, uint8_t* output)
+{
+	float endpoint0[4] = {};
+	float endpoint1[4] = {};
+	ComputeEndpoints(block, 0, 3, quality, endpoint0, endpoint1);
+
+	uint8_t indices[16];
+	float bestError = EncodeBc1Endpoints(block, PackRgb565(endpoint0), PackRgb565(endpoint1), output, indices);
+
+	uint8_t candidate[8];
+	uint8_t candidateIndices[16];
+	uint32_t refits = quality == LAVA_COMPRESSION_FAST ? 0 : quality == LAVA_COMPRESSION_NORMAL ? 1 : 4;
+	for (uint32_t i = 0; i < refits && bestError > 0.f; i++) {
+		//Indices refer to the stored (ordered) endpoints, so the refit does too.
+		if (!RefitEndpoints(block, 0, 3, indices, bc1Weights, endpoint0, endpoint1))
+			break;
+		float error = EncodeBc1Endpoints(block, PackRgb565(endpoint0), PackRgb565(endpoint1), candidate, candidateIndices);
+		if (error >= bestError)
+			break;
+		bestError = error;
+		memcpy(output, candidate, 8);
+		memcpy(indices, candidateIndices, 16);
+	}
+
+	if (quality != LAVA_COMPRESSION_HIGH)
+		return;
+
+	//Greedy walk over single steps of every 565 component, refits land close but rounding often misses the optimum.
+	for (uint32_t pass = 0; pass < 2 && bestError > 0.f; pass++) {
+		bool improved = false;
+		for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+			for (uint32_t channel = 0; channel < 3; channel++) {
+				for (int delta = -1; delta <= 1; delta += 2) {
+					uint16_t colors[2];
+					memcpy(colors, output, 4);
+					int value = int((colors[endpoint] >> rgb565Shifts[channel]) & rgb565Maximum[channel]) + delta;
+					if (value < 0 || value > int(rgb565Maximum[channel]))
+						continue;
+					colors[endpoint] = uint16_t((colors[endpoint] & ~(rgb565Maximum[channel] << rgb565Shifts[channel])) | (uint32_t(value) << rgb565Shifts[channel]));
+
+					float error = EncodeBc1Endpoints(block, colors[0], colors[1], candidate, candidateIndices);
+					if (error < bestError) {
+						bestError = error;
+						memcpy(output, candidate, 8);
+						improved = true;
+					}
+				}
+			}
+		}
+		if (!improved)
+			break;
+	}
+}
+
+//BC4: two 8 bit endpoints, 3 bit indices. endpoint0 > endpoint1 interpolates 8 values, otherwise 6 plus exact 0 and 255.
+static const float bc4Weights[8] = { 0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f };
+
+static void BuildBc4Palette(uint32_t endpoint0, uint32_t endpoint1, float palette[8])
+{
+	palette[0] = float(endpoint0);
+	palette[1] = float(endpoint1);
+	if (endpoint0 > endpoint1) {
+		for (uint32_t i = 2; i < 8; i++) {
+			palette[i] = float((8 - i) * endpoint0 + (i - 1) * endpoint1) / 7.f;
+		}
+	}
+	else {
+		for (uint32_t i = 2; i < 6; i++) {
+			palette[i] = float((6 - i) * endpoint0 + (i - 1) * endpoint1) / 5.f;
+		}
+		palette[6] = 0.f;
+		palette[7] = 255.f;
+	}
+}
+
+static float EncodeBc4Endpoints(const LavaColorBlock& block, uint32_t channel, uint32_t endpoint0, uint32_t endpoint1, uint8_t* output, uint8_t* indices)
+{
+	float values[8];
+	BuildBc4Palette(endpoint0, endpoint1, values);
+	float palette[8][4] = {};
+	for (uint32_t entry = 0; entry < 8; entry++) {
+		palette[entry][channel] = values[entry];
+	}
+	float error = FitIndices(block, palette, 8, channel, 1, indices);
+
+	uint64_t bits = 0;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		bits |= uint64_t(indices[texel]) << (texel * 3);
+	}
+	output[0] = uint8_t(endpoint0);
+	output[1] = uint8_t(endpoint1);
+	for (uint32_t i = 0; i < 6; i++) {
+		output[2 + i] = uint8_t(bits >> (i * 8));
+	}
+	return error;
+}
+
+static void EncodeBc4Block(const LavaColorBlock& block, uint32_t channel, LavaCompressionQuality quality, uint8_t* output)
+{
+	float minimum = 255.f;
+	float maximum = 0.f;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		minimum = std::min(minimum, block.channels[channel][texel]);
+		maximum = std::max(maximum, block.channels[channel][texel]);
+	}
+
+	uint8_t indices[16];
+	float bestError = EncodeBc4Endpoints(block, channel, uint32_t(maximum), uint32_t(minimum), output, indices);
+
+	uint8_t candidate[8];
+	uint8_t candidateIndices[16];
+	auto tryEndpoints = [&](int endpoint0, int endpoint1) {
+		if (endpoint0 < 0 || endpoint0 > 255 || endpoint1 < 0 || endpoint1 > 255)
+			return false;
+		float error = EncodeBc4Endpoints(block, channel, uint32_t(endpoint0), uint32_t(endpoint1), candidate, candidateIndices);
+		if (error >= bestError)
+			return false;
+		bestError = error;
+		memcpy(output, candidate, 8);
+		memcpy(indices, candidateIndices, 16);
+		return true;
+	};
+
+	uint32_t refits = quality == LAVA_COMPRESSION_FAST ? 0 : quality == LAVA_COMPRESSION_NORMAL ? 1 : 4;
+	for (uint32_t i = 0; i < refits && bestError > 0.f && output[0] > output[1]; i++) {
+		float endpoint0[4] = {};
+		float endpoint1[4] = {};
+		if (!RefitEndpoints(block, channel, 1, indices, bc4Weights, endpoint0, endpoint1))
+			break;
+		//Stay in 8 value mode, the refit assumes its weights.
+		int rounded0 = int(endpoint0[channel] + 0.5f);
+		int rounded1 = int(endpoint1[channel] + 0.5f);
+		if (rounded0 <= rounded1)
+			break;
+		if (!tryEndpoints(rounded0, rounded1))
+			break;
+	}
+
+	if (quality != LAVA_COMPRESSION_HIGH)
+		return;
+
+	//6 value mode spends its range on the texels between the exact 0 and 255 entries.
+	float innerMinimum = 255.f;
+	float innerMaximum = 0.f;
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		float value = block.channels[channel][texel];
+		if (value > 0.f && value < 255.f) {
+			innerMinimum = std::min(innerMinimum, value);
+			innerMaximum = std::max(innerMaximum, value);
+		}
+	}
+	if (innerMinimum <= innerMaximum)
+		tryEndpoints(int(innerMinimum), int(innerMaximum));
+
+	for (uint32_t pass = 0; pass < 2 && bestError > 0.f; pass++) {
+		bool improved = false;
+		for (int delta : { -2, -1, 1, 2 }) {
+			improved |= tryEndpoints(output[0] + delta, output[1]);
+			improved |= tryEndpoints(output[0], output[1] + delta);
+		}
+		if (!improved)
+			break;
+	}
+}
+
+//BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit (p-bit) each, 4 bit indices.
+static const uint32_t bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const float bc7RefitWeights[16] = { 0.f / 64, 4.f / 64, 9.f / 64, 13.f / 64, 17.f / 64, 21.f / 64, 26.f / 64, 30.f / 64,
+	34.f / 64, 38.f / 64, 43.f / 64, 47.f / 64, 51.f / 64, 55.f / 64, 60.f / 64, 64.f / 64 };
+
+struct LavaBc7Endpoints {
+	uint32_t quantized[2][4]; //7 bit
+	uint32_t pbits[2];
+};
+
+static uint32_t Bc7Interpolate(uint32_t endpoint0, uint32_t endpoint1, uint32_t weight)
+{
+	return ((64 - weight) * endpoint0 + weight * endpoint1 + 32) >> 6;
+}
+
+static float QuantizeBc7Endpoint(const float endpoint[4], uint32_t pbit, uint32_t quantized[4])
+{
+	float error = 0.f;
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		int value = int((endpoint[channel] - float(pbit)) * 0.5f + 0.5f);
+		quantized[channel] = uint32_t(std::min(std::max(value, 0), 127));
+		float difference = float((quantized[channel] << 1) | pbit) - endpoint[channel];
+		error += difference * difference;
+	}
+	return error;
+}
+
+//Indices come back relative to the given endpoint order, the stored block may have them swapped for the anchor bit.
+static float EncodeBc7Mode6(const LavaColorBlock& block, const LavaBc7Endpoints& endpoints, uint8_t* output, uint8_t* indices)
+{
+	uint32_t expanded[2][4];
+	for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+		for (uint32_t channel = 0; channel < 4; channel++) {
+			expanded[endpoint][channel] = (endpoints.quantized[endpoint][channel] << 1) | endpoints.pbits[endpoint];
+		}
+	}
+
+	float palette[16][4];
+	for (uint32_t entry = 0; entry < 16; entry++) {
+		for (uint32_t channel = 0; channel < 4; channel++) {
+			palette[entry][channel] = float(Bc7Interpolate(expanded[0][channel], expanded[1][channel], bc7Weights4[entry]));
+		}
+	}
+	float error = FitIndices(block, palette, 16, 0, 4, indices);
+
+	//Texel 0 is the anchor, its index is stored without the top bit. The weight table is symmetric, so swapping
+	//the endpoints and flipping the indices decodes to the same colors.
+	bool swap = indices[0] >= 8;
+	uint32_t first = swap ? 1 : 0;
+
+	memset(output, 0, 16);
+	LavaBitWriter writer = { output, 0 };
+	writer.Write(1u << 6, 7);
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		writer.Write(endpoints.quantized[first][channel], 7);
+		writer.Write(endpoints.quantized[first ^ 1][channel], 7);
+	}
+	writer.Write(endpoints.pbits[first], 1);
+	writer.Write(endpoints.pbits[first ^ 1], 1);
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		uint32_t index = swap ? 15 - indices[texel] : indices[texel];
+		writer.Write(index, texel == 0 ? 3 : 4);
+	}
+	return error;
+}
+
+static void EncodeBc7Block(const LavaColorBlock& block, LavaCompressionQuality quality, uint8_t* output)
+{
+	uint8_t candidate[16];
+	uint8_t candidateIndices[16];
+	uint8_t indices[16];
+	float bestError = FLT_MAX;
+	LavaBc7Endpoints best = {};
+
+	//P-bits per endpoint by least quantization error, high tries all four combinations against the real fit.
+	auto tryFloatEndpoints = [&](const float endpoint0[4], const float endpoint1[4]) {
+		bool improved = false;
+		for (uint32_t combination = 0; combination < 4; combination++) {
+			LavaBc7Endpoints endpoints;
+			if (quality == LAVA_COMPRESSION_HIGH) {
+				endpoints.pbits[0] = combination & 1;
+				endpoints.pbits[1] = combination >> 1;
+				QuantizeBc7Endpoint(endpoint0, endpoints.pbits[0], endpoints.quantized[0]);
+				QuantizeBc7Endpoint(endpoint1, endpoints.pbits[1], endpoints.quantized[1]);
+			}
+			else {
+				uint32_t quantized[2][4];
+				for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+					const float* source = endpoint == 0 ? endpoint0 : endpoint1;
+					float error0 = QuantizeBc7Endpoint(source, 0, quantized[0]);
+					float error1 = QuantizeBc7Endpoint(source, 1, quantized[1]);
+					endpoints.pbits[endpoint] = error1 < error0 ? 1 : 0;
+					memcpy(endpoints.quantized[endpoint], quantized[endpoints.pbits[endpoint]], sizeof(quantized[0]));
+				}
+			}
+
+			float error = EncodeBc7Mode6(block, endpoints, candidate, candidateIndices);
+			if (error < bestError) {
+				bestError = error;
+				best = endpoints;
+				memcpy(output, candidate, 16);
+				memcpy(indices, candidateIndices, 16);
+				improved = true;
+			}
+			if (quality != LAVA_COMPRESSION_HIGH)
+				break;
+		}
+		return improved;
+	};
+
+	float endpoint0[4] = {};
+	float endpoint1[4] = {};
+	ComputeEndpoints(block, 0, 4, quality, endpoint0, endpoint1);
+	tryFloatEndpoints(endpoint0, endpoint1);
+
+	uint32_t refits = quality == LAVA_COMPRESSION_FAST ? 0 : quality == LAVA_COMPRESSION_NORMAL ? 1 : 3;
+	for (uint32_t i = 0; i < refits && bestError > 0.f; i++) {
+		if (!RefitEndpoints(block, 0, 4, indices, bc7RefitWeights, endpoint0, endpoint1))
+			break;
+		if (!tryFloatEndpoints(endpoint0, endpoint1))
+			break;
+	}
+
+	if (quality != LAVA_COMPRESSION_HIGH)
+		return;
+
+	for (uint32_t pass = 0; pass < 2 && bestError > 0.f; pass++) {
+		bool improved = false;
+		for (uint32_t endpoint = 0; endpoint < 2; endpoint++) {
+			for (uint32_t channel = 0; channel < 4; channel++) {
+				for (int delta = -1; delta <= 1; delta += 2) {
+					int value = int(best.quantized[endpoint][channel]) + delta;
+					if (value < 0 || value > 127)
+						continue;
+					LavaBc7Endpoints endpoints = best;
+					endpoints.quantized[endpoint][channel] = uint32_t(value);
+					float error = EncodeBc7Mode6(block, endpoints, candidate, candidateIndices);
+					if (error < bestError) {
+						bestError = error;
+						best = endpoints;
+						memcpy(output, candidate, 16);
+						improved = true;
+					}
+				}
+			}
+		}
+		if (!improved)
+			break;
+	}
+}
+
+static void DecodeBc1Block(const uint8_t* input, bool alwaysFourColor, uint8_t texels[16][4])
+{
+	uint16_t color0, color1;
+	uint32_t bits;
+	memcpy(&color0, input, 2);
+	memcpy(&color1, input + 2, 2);
+	memcpy(&bits, input + 4, 4);
+
+	uint32_t palette[4][3];
+	BuildBc1Palette(color0, color1, alwaysFourColor || color0 > color1, palette);
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		uint32_t index = (bits >> (texel * 2)) & 3;
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			texels[texel][channel] = uint8_t(palette[index][channel]);
+		}
+	}
+}
+
+static void DecodeBc4Block(const uint8_t* input, uint32_t channel, uint8_t texels[16][4])
+{
+	float palette[8];
+	BuildBc4Palette(input[0], input[1], palette);
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 6; i++) {
+		bits |= uint64_t(input[2 + i]) << (i * 8);
+	}
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		texels[texel][channel] = uint8_t(palette[(bits >> (texel * 3)) & 7] + 0.5f);
+	}
+}
+
+static void DecodeBc7Block(const uint8_t* input, uint8_t texels[16][4])
+{
+	//Only mode 6 is ever written, anything else decodes to zero.
+	if ((input[0] & 0x7f) != 0x40) {
+		memset(texels, 0, 64);
+		return;
+	}
+
+	LavaBitReader reader = { input, 7 };
+	uint32_t expanded[2][4];
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		expanded[0][channel] = reader.Read(7) << 1;
+		expanded[1][channel] = reader.Read(7) << 1;
+	}
+	uint32_t pbit0 = reader.Read(1);
+	uint32_t pbit1 = reader.Read(1);
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		expanded[0][channel] |= pbit0;
+		expanded[1][channel] |= pbit1;
+	}
+	for (uint32_t texel = 0; texel < 16; texel++) {
+		uint32_t index = reader.Read(texel == 0 ? 3 : 4);
+		for (uint32_t channel = 0; channel < 4; channel++) {
+			texels[texel][channel] = uint8_t(Bc7Interpolate(expanded[0][channel], expanded[1][channel], bc7Weights4[index]));
+		}
+	}
+}
+
+uint32_t LavaBlockBytes(LavaBlockFormat format)
+{
+	return format == LAVA_BLOCK_BC1 ? 8 : 16;
+}
+
+VkFormat LavaBlockVkFormat(LavaBlockFormat format, bool srgb)
+{
+	switch (format) {
+	case LAVA_BLOCK_BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case LAVA_BLOCK_BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	case LAVA_BLOCK_BC5: return VK_FORMAT_BC5_UNORM_BLOCK; //Data, never sRGB
+	case LAVA_BLOCK_BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t LavaBlockChannelCount(LavaBlockFormat format)
+{
+	switch (format) {
+	case LAVA_BLOCK_BC1: return 3;
+	case LAVA_BLOCK_BC5: return 2;
+	default: return 4;
+	}
+}
+
+const char* LavaBlockFormatName(LavaBlockFormat format)
+{
+	static const char* names[] = { "BC1", "BC3", "BC5", "BC7" };
+	return names[format];
+}
+
+void LavaCompressImage(const LavaImage& image, LavaBlockFormat format, LavaCompressionQuality quality, LavaJobSystem* jobSystem,
+	std::vector<uint8_t>& blocks)
+{
+	LAVA_PROFILE_ZONE("Compress image");
+	uint32_t blocksX = (image.width + 3) / 4;
+	uint32_t blocksY = (image.height + 3) / 4;
+	uint32_t blockBytes = LavaBlockBytes(format);
+	blocks.assign(size_t(blocksX) * blocksY * blockBytes, 0);
+
+	uint32_t rowsPerJob = std::max(1u, compressionBlocksPerJob / blocksX);
+	LavaParallelFor(jobSystem, blocksY, rowsPerJob, [&](uint32_t begin, uint32_t end, uint32_t) {
+		LavaColorBlock block;
+		for (uint32_t blockY = begin; blockY < end; blockY++) {
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+				uint8_t* output = &blocks[(size_t(blockY) * blocksX + blockX) * blockBytes];
+				LoadBlock(image, blockX, blockY, block);
+				switch (format) {
+				case LAVA_BLOCK_BC1:
+					EncodeBc1Block(block, quality, output);
+					break;
+				case LAVA_BLOCK_BC3:
+					EncodeBc4Block(block, 3, quality, output);
+					EncodeBc1Block(block, quality, output + 8);
+					break;
+				case LAVA_BLOCK_BC5:
+					EncodeBc4Block(block, 0, quality, output);
+					EncodeBc4Block(block, 1, quality, output + 8);
+					break;
+				case LAVA_BLOCK_BC7:
+					EncodeBc7Block(block, quality, output);
+					break;
+				}
+			}
+		}
+	});
+}
+
+void LavaDecompressImage(const uint8_t* blocks, LavaBlockFormat format, uint32_t width, uint32_t height, LavaImage& image)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint32_t blockBytes = LavaBlockBytes(format);
+	image.width = width;
+	image.height = height;
+	image.rgba.resize(size_t(width) * height * 4);
+
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+			const uint8_t* input = &blocks[(size_t(blockY) * blocksX + blockX) * blockBytes];
+			uint8_t texels[16][4];
+			for (uint32_t texel = 0; texel < 16; texel++) {
+				texels[texel][0] = texels[texel][1] = texels[texel][2] = 0;
+				texels[texel][3] = 255;
+			}
+
+			switch (format) {
+			case LAVA_BLOCK_BC1:
+				DecodeBc1Block(input, false, texels);
+				break;
+			case LAVA_BLOCK_BC3:
+				DecodeBc4Block(input, 3, texels);
+				DecodeBc1Block(input + 8, true, texels);
+				break;
+			case LAVA_BLOCK_BC5:
+				DecodeBc4Block(input, 0, texels);
+				DecodeBc4Block(input + 8, 1, texels);
+				break;
+			case LAVA_BLOCK_BC7:
+				DecodeBc7Block(input, texels);
+				break;
+			}
+
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+					memcpy(&image.rgba[((size_t(blockY) * 4 + y) * width + blockX * 4 + x) * 4], texels[y * 4 + x], 4);
+				}
+			}
+		}
+	}
+}
+
+double LavaComputePsnr(const LavaImage& reference, const LavaImage& image, uint32_t channelCount)
+{
+	assert(reference.width == image.width && reference.height == image.height);
+	double squaredError = 0.0;
+	size_t texelCount = size_t(reference.width) * reference.height;
+	for (size_t texel = 0; texel < texelCount; texel++) {
+		for (uint32_t channel = 0; channel < channelCount; channel++) {
+			double difference = double(reference.rgba[texel * 4 + channel]) - double(image.rgba[texel * 4 + channel]);
+			squaredError += difference * difference;
+		}
+	}
+
+	double meanSquaredError = squaredError / double(texelCount * channelCount);
+	if (meanSquaredError == 0.0)
+		return INFINITY;
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+//Khronos data format descriptor: one basic block describing the block compressed layout. Loaders that only look at
+//vkFormat (ours included) skip it, but the spec requires it.
+static void BuildKtx2Descriptor(LavaBlockFormat format, bool srgb, std::vector<uint32_t>& words)
+{
+	struct Sample {
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t channel;
+	};
+
+	const uint32_t linearQualifier = 0x10;
+	uint32_t colorModel = 0;
+	Sample samples[2] = {};
+	uint32_t sampleCount = 1;
+	switch (format) {
+	case LAVA_BLOCK_BC1:
+		colorModel = 128; //BC1A, color channel
+		samples[0] = { 0, 64, 0 };
+		break;
+	case LAVA_BLOCK_BC3:
+		colorModel = 130; //Alpha block first, alpha is never sRGB encoded
+		samples[0] = { 0, 64, 15 | (srgb ? linearQualifier : 0) };
+		samples[1] = { 64, 64, 0 };
+		sampleCount = 2;
+		break;
+	case LAVA_BLOCK_BC5:
+		colorModel = 132;
+		samples[0] = { 0, 64, 0 };
+		samples[1] = { 64, 64, 1 };
+		sampleCount = 2;
+		break;
+	case LAVA_BLOCK_BC7:
+		colorModel = 134;
+		samples[0] = { 0, 128, 0 };
+		break;
+	}
+
+	uint32_t blockSize = 24 + 16 * sampleCount;
+	words.clear();
+	words.push_back(4 + blockSize); //Total size including this word
+	words.push_back(0); //Vendor Khronos, descriptor type basic
+	words.push_back(2 | (blockSize << 16)); //Version 1.3
+	words.push_back(colorModel | (1 << 8) | ((srgb && format != LAVA_BLOCK_BC5 ? 2 : 1) << 16)); //BT709 primaries, sRGB or linear transfer
+	words.push_back(3 | (3 << 8)); //4x4x1x1 texel block, stored minus one
+	words.push_back(LavaBlockBytes(format)); //Bytes in plane 0
+	words.push_back(0);
+	for (uint32_t i = 0; i < sampleCount; i++) {
+		words.push_back(samples[i].bitOffset | ((samples[i].bitLength - 1) << 16) | (samples[i].channel << 24));
+		words.push_back(0); //Sample position
+		words.push_back(0); //Lower
+		words.push_back(0xffffffffu); //Upper
+	}
+}
+
+bool LavaWriteKtx2(const char* path, const LavaCompressedTexture& texture)
+{
+	static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	uint32_t levelCount = uint32_t(texture.levels.size());
+	uint32_t blockBytes = LavaBlockBytes(texture.format);
+
+	std::vector<uint32_t> descriptor;
+	BuildKtx2Descriptor(texture.format, texture.srgb, descriptor);
+
+	//Header, level index, descriptor, then level data smallest first, each level aligned to the block size.
+	const uint64_t headerSize = 80;
+	uint64_t descriptorOffset = headerSize + uint64_t(levelCount) * 24;
+	uint64_t descriptorSize = descriptor.size() * sizeof(uint32_t);
+	std::vector<uint64_t> levelOffsets(levelCount);
+	uint64_t offset = descriptorOffset + descriptorSize;
+	for (uint32_t level = levelCount; level-- > 0;) {
+		offset = (offset + blockBytes - 1) / blockBytes * blockBytes;
+		levelOffsets[level] = offset;
+		offset += texture.levels[level].size();
+	}
+
+	std::vector<uint8_t> file(size_t(offset), 0);
+	auto writeU32 = [&](uint64_t position, uint32_t value) { memcpy(&file[size_t(position)], &value, 4); };
+	auto writeU64 = [&](uint64_t position, uint64_t value) { memcpy(&file[size_t(position)], &value, 8); };
+
+	memcpy(file.data(), identifier, sizeof(identifier));
+	writeU32(12, uint32_t(LavaBlockVkFormat(texture.format, texture.srgb)));
+	writeU32(16, 1); //typeSize, 1 for block compressed
+	writeU32(20, texture.width);
+	writeU32(24, texture.height);
+	writeU32(28, 0); //pixelDepth
+	writeU32(32, 0); //layerCount, not an array
+	writeU32(36, 1); //faceCount
+	writeU32(40, levelCount);
+	writeU32(44, 0); //No supercompression
+	writeU32(48, uint32_t(descriptorOffset));
+	writeU32(52, uint32_t(descriptorSize));
+	//Key/value data and supercompression global data stay empty.
+
+	for (uint32_t level = 0; level < levelCount; level++) {
+		uint64_t entry = headerSize + uint64_t(level) * 24;
+		writeU64(entry, levelOffsets[level]);
+		writeU64(entry + 8, texture.levels[level].size());
+		writeU64(entry + 16, texture.levels[level].size());
+		memcpy(&file[size_t(levelOffsets[level])], texture.levels[level].data(), texture.levels[level].size());
+	}
+	memcpy(&file[size_t(descriptorOffset)], descriptor.data(), size_t(descriptorSize));
+
+	FILE* output = fopen(path, "wb");
+	if (!output) {
+		LAVA_PRINT("Can't write " << path);
+		return false;
+	}
+	bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+	fclose(output);
+	return written;
+}
+
+bool LavaCompressTextureFile(const char* sourcePath, const char* targetPath, const LavaTextureCompressionSettings& settings, LavaJobSystem* jobSystem)
+{
+	LavaImage image;
+	if (!LavaLoadImage(sourcePath, image))
+		return false;
+
+	std::vector<LavaImage> levels;
+	if (settings.mips)
+		LavaGenerateMipChain(image, settings.srgb, levels);
+	else
+		levels.push_back(image);
+
+	static const char* qualityNames[] = { "fast", "normal", "high" };
+	LAVA_PRINT("Compressing " << sourcePath << " (" << image.width << "x" << image.height << ") to " << LavaBlockFormatName(settings.format)
+		<< ", " << qualityNames[settings.quality] << " quality, " << levels.size() << " levels, " << LavaCompressionKernelName(compressionKernel) << " kernel");
+
+	LavaCompressedTexture texture;
+	texture.format = settings.format;
+	texture.srgb = settings.srgb && settings.format != LAVA_BLOCK_BC5;
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.levels.resize(levels.size());
+
+	uint64_t totalBlocks = 0;
+	double totalMilliseconds = 0.0;
+	uint32_t channelCount = LavaBlockChannelCount(settings.format);
+	for (size_t level = 0; level < levels.size(); level++) {
+		auto begin = std::chrono::high_resolution_clock::now();
+		LavaCompressImage(levels[level], settings.format, settings.quality, jobSystem, texture.levels[level]);
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - begin;
+
+		LavaImage decoded;
+		LavaDecompressImage(texture.levels[level].data(), settings.format, levels[level].width, levels[level].height, decoded);
+		double psnr = LavaComputePsnr(levels[level], decoded, channelCount);
+
+		uint64_t blockCount = texture.levels[level].size() / LavaBlockBytes(settings.format);
+		totalBlocks += blockCount;
+		totalMilliseconds += time.count();
+		LAVA_PRINT("  Level " << level << ": " << levels[level].width << "x" << levels[level].height << ", " << blockCount << " blocks in "
+			<< time.count() << " ms, PSNR " << psnr << " dB");
+	}
+
+	uint64_t sourceBytes = uint64_t(image.width) * image.height * 4;
+	LAVA_PRINT("  " << totalBlocks << " blocks in " << totalMilliseconds << " ms (" << totalBlocks / std::max(totalMilliseconds, 1e-3) / 1000.0
+		<< " Mblocks/s), level 0 is " << sourceBytes / texture.levels[0].size() << "x smaller than RGBA8");
+
+	return LavaWriteKtx2(targetPath, texture);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "LavaCore.h"
+#include "LavaImage.h"
+
+#include <vector>
+
+class LavaJobSystem;
+
+enum LavaBlockFormat {
+	LAVA_BLOCK_BC1, //RGB, 8 bytes per 4x4 block, alpha ignored
+	LAVA_BLOCK_BC3, //RGBA, BC1 color + BC4 alpha
+	LAVA_BLOCK_BC5, //RG, two BC4 channels, for normal maps
+	LAVA_BLOCK_BC7 //RGBA, mode 6 only
+};
+
+//Trades encode time for quality. Fast: bounding box endpoints. Normal: principal axis endpoints plus a least squares
+//refit. High: more refits and a search over neighbouring quantized endpoints.
+enum LavaCompressionQuality {
+	LAVA_COMPRESSION_FAST,
+	LAVA_COMPRESSION_NORMAL,
+	LAVA_COMPRESSION_HIGH
+};
+
+//Palette index search, the hot loop of every encoder. All variants produce identical blocks, the best one the CPU
+//runs is picked at startup. Switching is for tests and benchmarks, not while a compression is running.
+enum LavaCompressionKernel {
+	LAVA_COMPRESSION_KERNEL_SCALAR,
+	LAVA_COMPRESSION_KERNEL_SSE2,
+	LAVA_COMPRESSION_KERNEL_AVX2
+};
+
+bool LavaIsCompressionKernelSupported(LavaCompressionKernel kernel);
+LavaCompressionKernel LavaGetBestCompressionKernel();
+void LavaSetCompressionKernel(LavaCompressionKernel kernel);
+LavaCompressionKernel LavaGetCompressionKernel();
+const char* LavaCompressionKernelName(LavaCompressionKernel kernel);
+
+uint32_t LavaBlockBytes(LavaBlockFormat format);
+VkFormat LavaBlockVkFormat(LavaBlockFormat format, bool srgb);
+uint32_t LavaBlockChannelCount(LavaBlockFormat format); //Leading RGBA channels the format stores
+const char* LavaBlockFormatName(LavaBlockFormat format);
+
+//Blocks in row major order, edge blocks repeat the last row/column. Rows of blocks are spread over the job system.
+void LavaCompressImage(const LavaImage& image, LavaBlockFormat format, LavaCompressionQuality quality, LavaJobSystem* jobSystem,
+	std::vector<uint8_t>& blocks);
+void LavaDecompressImage(const uint8_t* blocks, LavaBlockFormat format, uint32_t width, uint32_t height, LavaImage& image);
+
+//Over the first channelCount channels, infinite for identical images.
+double LavaComputePsnr(const LavaImage& reference, const LavaImage& image, uint32_t channelCount);
+
+struct LavaCompressedTexture {
+	LavaBlockFormat format;
+	bool srgb;
+	uint32_t width;
+	uint32_t height;
+	std::vector<std::vector<uint8_t>> levels; //Level 0 is the largest
+};
+
+//Writes a KTX2 file LavaTextureStreamer can load: no supercompression, levels stored smallest first.
+bool LavaWriteKtx2(const char* path, const LavaCompressedTexture& texture);
+
+struct LavaTextureCompressionSettings {
+	LavaBlockFormat format = LAVA_BLOCK_BC7;
+	LavaCompressionQuality quality = LAVA_COMPRESSION_NORMAL;
+	bool srgb = false; //Color data: sRGB format and mips filtered in linear space
+	bool mips = true;
+};
+
+//Offline asset step: image -> mip chain -> blocks -> KTX2. Prints blocks/s and PSNR of every level.
+bool LavaCompressTextureFile(const char* sourcePath, const char* targetPath, const LavaTextureCompressionSettings& settings, LavaJobSystem* jobSystem);
@@ -0,0 +1,683 @@
+#include "LavaTextureStreaming.h"
+#include "LavaBindless.h"
+#include "LavaProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+
+static const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t ktx2HeaderSize = 80; //Identifier, 9 u32 fields, dfd/kvd u32 offset+length, sgd u64 offset+length
+static const size_t ktx2LevelSize = 24; //byteOffset, byteLength, uncompressedByteLength
+
+static uint32_t ReadU32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint64_t ReadU64(const uint8_t* data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint32_t LevelExtent(uint32_t size, uint32_t level)
+{
+	return std::max(1u, size >> level);
+}
+
+bool LavaParseKtx2(const uint8_t* data, size_t size, LavaKtx2Info& info)
+{
+	if (size < ktx2HeaderSize || memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+		return false;
+
+	info = {};
+	info.format = VkFormat(ReadU32(data + 12));
+	info.width = ReadU32(data + 20);
+	info.height = ReadU32(data + 24);
+	uint32_t depth = ReadU32(data + 28);
+	uint32_t layerCount = ReadU32(data + 32);
+	uint32_t faceCount = ReadU32(data + 36);
+	uint32_t levelCount = std::max(1u, ReadU32(data + 40)); //0 asks the loader to generate mips, we stream what's there
+	uint32_t supercompression = ReadU32(data + 44);
+
+	//Basis/zstd payloads would need transcoding before upload, arrays and cubes aren't streamed.
+	if (info.format == VK_FORMAT_UNDEFINED || supercompression != 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+		return false;
+	if (info.width == 0 || info.height == 0 || levelCount > LAVA_MAX_TEXTURE_LEVELS)
+		return false;
+	if (size < ktx2HeaderSize + levelCount * ktx2LevelSize)
+		return false;
+
+	info.levelCount = levelCount;
+	for (uint32_t level = 0; level < levelCount; level++) {
+		const uint8_t* entry = data + ktx2HeaderSize + level * ktx2LevelSize;
+		info.levels[level].offset = ReadU64(entry);
+		info.levels[level].size = ReadU64(entry + 8);
+		if (info.levels[level].size == 0)
+			return false;
+	}
+	return true;
+}
+
+float LavaTextureLevelForScreenSize(uint32_t textureSize, float screenPixels)
+{
+	if (screenPixels <= 0.f)
+		return float(LAVA_MAX_TEXTURE_LEVELS);
+	return std::max(0.f, std::log2(float(textureSize) / screenPixels));
+}
+
+void LavaSimulatedTextureDevice::CommitResidency(uint32_t texture, const LavaKtx2Info& info, uint32_t minLevel, const LavaTextureLevelData* uploads, uint32_t uploadCount)
+{
+	if (texture >= minLevels.size()) {
+		minLevels.resize(texture + 1, LAVA_MAX_TEXTURE_LEVELS);
+		textureBytes.resize(texture + 1, 0);
+	}
+
+	//Uploads have to be exactly the levels that become resident, the kept ones are copied over.
+	uint32_t oldMinLevel = std::min(minLevels[texture], info.levelCount);
+	bool valid = minLevel < info.levelCount && uploadCount == (minLevel < oldMinLevel ? oldMinLevel - minLevel : 0);
+	for (uint32_t i = 0; i < uploadCount; i++) {
+		valid = valid && uploads[i].level == minLevel + i && uploads[i].size == info.levels[uploads[i].level].size;
+		uploadedBytes += uploads[i].size;
+	}
+	if (!valid) {
+		invalidCommitCount++;
+		return;
+	}
+
+	uint64_t bytes = 0;
+	for (uint32_t level = minLevel; level < info.levelCount; level++) {
+		bytes += info.levels[level].size;
+	}
+	residentBytes = residentBytes - textureBytes[texture] + bytes;
+	textureBytes[texture] = bytes;
+	minLevels[texture] = minLevel;
+	commitCount++;
+}
+
+void LavaSimulatedTextureDevice::DestroyTexture(uint32_t texture)
+{
+	residentBytes -= textureBytes[texture];
+	textureBytes[texture] = 0;
+	minLevels[texture] = LAVA_MAX_TEXTURE_LEVELS;
+}
+
+void LavaVulkanTextureDevice::Init(VkDevice activeDevice, VkPhysicalDevice activePhysicalDevice, VkQueue activeQueue, uint32_t queueFamilyIndex, LavaBindlessHeap* heap,
+	uint32_t frameCount)
+{
+	device = activeDevice;
+	physicalDevice = activePhysicalDevice;
+	queue = activeQueue;
+	bindlessHeap = heap;
+	framesInFlight = std::max(1u, frameCount);
+	currentFrame = 0;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+	LAVA_ASSERT(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+	LAVA_ASSERT(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	LAVA_ASSERT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+}
+
+void LavaVulkanTextureDevice::Destroy()
+{
+	for (uint32_t texture = 0; texture < textures.size(); texture++) {
+		DestroyTexture(texture);
+	}
+	textures.clear();
+	BeginFrame(currentFrame + framesInFlight);
+
+	if (stagingBuffer) {
+		vkUnmapMemory(device, stagingMemory);
+		vkDestroyBuffer(device, stagingBuffer, 0);
+		vkFreeMemory(device, stagingMemory, 0);
+	}
+	stagingBuffer = VK_NULL_HANDLE;
+	stagingMemory = VK_NULL_HANDLE;
+	stagingData = nullptr;
+	stagingSize = 0;
+
+	vkDestroyFence(device, fence, 0);
+	vkDestroyCommandPool(device, commandPool, 0);
+	fence = VK_NULL_HANDLE;
+	commandPool = VK_NULL_HANDLE;
+	commandBuffer = VK_NULL_HANDLE;
+}
+
+void LavaVulkanTextureDevice::BeginFrame(uint64_t frame)
+{
+	currentFrame = frame;
+
+	//Retired in frame order, so stop at the first image a frame in flight may still sample.
+	while (!retired.empty() && retired.front().frame + framesInFlight <= frame) {
+		const RetiredImage& image = retired.front();
+		vkDestroyImageView(device, image.view, 0);
+		vkDestroyImage(device, image.image, 0);
+		vkFreeMemory(device, image.memory, 0);
+		retired.pop_front();
+	}
+}
+
+void LavaVulkanTextureDevice::Retire(const Texture& texture)
+{
+	retired.push_back({ currentFrame, texture.image, texture.memory, texture.view });
+}
+
+bool LavaVulkanTextureDevice::SupportsFormat(VkFormat format) const
+{
+	VkFormatProperties properties = {};
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+uint32_t LavaVulkanTextureDevice::SelectMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+		if ((memoryTypeBits & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+			return i;
+	}
+	assert(!"No compatible memory type");
+	return ~0u;
+}
+
+void LavaVulkanTextureDevice::ReserveStaging(VkDeviceSize size)
+{
+	if (size <= stagingSize)
+		return;
+
+	if (stagingBuffer) {
+		vkUnmapMemory(device, stagingMemory);
+		vkDestroyBuffer(device, stagingBuffer, 0);
+		vkFreeMemory(device, stagingMemory, 0);
+	}
+
+	//Grow geometrically, budgets keep it bounded by the largest frame of uploads.
+	stagingSize = std::max(size, stagingSize * 2);
+
+	VkBufferCreateInfo bufferCreateInfo = {};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = stagingSize;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	LAVA_ASSERT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, stagingBuffer, &requirements);
+
+	VkMemoryAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = requirements.size;
+	allocateInfo.memoryTypeIndex = SelectMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	LAVA_ASSERT(vkAllocateMemory(device, &allocateInfo, nullptr, &stagingMemory));
+	allocationCount++;
+	LAVA_ASSERT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
+	LAVA_ASSERT(vkMapMemory(device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &stagingData));
+}
+
+void LavaVulkanTextureDevice::CommitResidency(uint32_t texture, const LavaKtx2Info& info, uint32_t minLevel, const LavaTextureLevelData* uploads, uint32_t uploadCount)
+{
+	LAVA_PROFILE_ZONE("Texture upload");
+	if (texture >= textures.size())
+		textures.resize(texture + 1, Texture{ VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, LAVA_MAX_TEXTURE_LEVELS, LAVA_BINDLESS_INVALID_INDEX });
+
+	Texture& old = textures[texture];
+	Texture fresh = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, minLevel, LAVA_BINDLESS_INVALID_INDEX };
+	uint32_t levelCount = info.levelCount - minLevel;
+
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = info.format;
+	imageCreateInfo.extent = { LevelExtent(info.width, minLevel), LevelExtent(info.height, minLevel), 1 };
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	LAVA_ASSERT(vkCreateImage(device, &imageCreateInfo, nullptr, &fresh.image));
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, fresh.image, &requirements);
+
+	VkMemoryAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = requirements.size;
+	allocateInfo.memoryTypeIndex = SelectMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	LAVA_ASSERT(vkAllocateMemory(device, &allocateInfo, nullptr, &fresh.memory));
+	allocationCount++;
+	LAVA_ASSERT(vkBindImageMemory(device, fresh.image, fresh.memory, 0));
+
+	VkDeviceSize uploadSize = 0;
+	for (uint32_t i = 0; i < uploadCount; i++) {
+		uploadSize += (uploads[i].size + 15) & ~VkDeviceSize(15); //Offsets must be a multiple of the texel block size
+	}
+	if (uploadSize > 0)
+		ReserveStaging(uploadSize);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	LAVA_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	VkImageMemoryBarrier barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	}
+
+	barriers[0].image = fresh.image;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	uint32_t barrierCount = 1;
+	if (old.image) {
+		barriers[1].image = old.image;
+		barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT; //Frames submitted before the commit may still be sampling it
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrierCount = 2;
+	}
+	VkPipelineStageFlags srcStageMask = old.image ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, barrierCount, barriers);
+
+	//Levels both images hold move on the GPU, everything finer than the old image comes from staging.
+	if (old.image) {
+		std::vector<VkImageCopy> copies;
+		for (uint32_t level = std::max(minLevel, old.minLevel); level < info.levelCount; level++) {
+			VkImageCopy copy = {};
+			copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - old.minLevel, 0, 1 };
+			copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - minLevel, 0, 1 };
+			copy.extent = { LevelExtent(info.width, level), LevelExtent(info.height, level), 1 };
+			copies.push_back(copy);
+		}
+		vkCmdCopyImage(commandBuffer, old.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, fresh.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			uint32_t(copies.size()), copies.data());
+	}
+
+	if (uploadCount > 0) {
+		std::vector<VkBufferImageCopy> copies(uploadCount);
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < uploadCount; i++) {
+			const LavaTextureLevelData& upload = uploads[i];
+			assert(upload.level >= minLevel && upload.level < old.minLevel);
+			memcpy((uint8_t*)stagingData + offset, upload.data, size_t(upload.size));
+
+			copies[i] = {};
+			copies[i].bufferOffset = offset;
+			copies[i].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, upload.level - minLevel, 0, 1 };
+			copies[i].imageExtent = { LevelExtent(info.width, upload.level), LevelExtent(info.height, upload.level), 1 };
+			offset += (upload.size + 15) & ~VkDeviceSize(15);
+		}
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, fresh.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uploadCount, copies.data());
+	}
+
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, barriers);
+
+	LAVA_ASSERT(vkEndCommandBuffer(commandBuffer));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	LAVA_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+	LAVA_ASSERT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+	LAVA_ASSERT(vkResetFences(device, 1, &fence));
+	LAVA_ASSERT(vkResetCommandBuffer(commandBuffer, 0));
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = fresh.image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = info.format;
+	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	LAVA_ASSERT(vkCreateImageView(device, &viewCreateInfo, nullptr, &fresh.view));
+
+	//Frames in flight still use the old slot, rewriting it under them would race with their sampling.
+	fresh.bindlessIndex = bindlessHeap->RegisterImage(fresh.view);
+	if (old.image) {
+		bindlessHeap->Release(LAVA_BINDLESS_SAMPLED_IMAGE, old.bindlessIndex);
+		Retire(old);
+	}
+	old = fresh;
+}
+
+void LavaVulkanTextureDevice::DestroyTexture(uint32_t texture)
+{
+	Texture& entry = textures[texture];
+	if (!entry.image)
+		return;
+
+	Retire(entry);
+	bindlessHeap->Release(LAVA_BINDLESS_SAMPLED_IMAGE, entry.bindlessIndex);
+	entry = Texture{ VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, LAVA_MAX_TEXTURE_LEVELS, LAVA_BINDLESS_INVALID_INDEX };
+}
+
+void LavaTextureStreamer::Init(LavaTextureDevice* textureDevice)
+{
+	device = textureDevice;
+	textures.clear();
+	stats = {};
+	frame = 0;
+}
+
+void LavaTextureStreamer::Shutdown()
+{
+	for (uint32_t texture = 0; texture < textures.size(); texture++) {
+		Unregister(texture);
+	}
+	textures.clear();
+	device = nullptr;
+}
+
+uint32_t LavaTextureStreamer::RegisterFile(const char* path)
+{
+	LAVA_PROFILE_ZONE("Texture register");
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		LAVA_PRINT("Can't open texture " << path);
+		return LAVA_INVALID_TEXTURE;
+	}
+
+	//Header and level index are all that's read up front, level data is fetched when it gets streamed in.
+	uint8_t header[ktx2HeaderSize + LAVA_MAX_TEXTURE_LEVELS * ktx2LevelSize];
+	size_t headerSize = fread(header, 1, sizeof(header), file);
+
+	LavaKtx2Info info;
+	if (!LavaParseKtx2(header, headerSize, info)) {
+		LAVA_PRINT("Unsupported KTX2 file " << path << ", expected a 2D texture without supercompression");
+		fclose(file);
+		return LAVA_INVALID_TEXTURE;
+	}
+
+	std::shared_ptr<FILE> handle(file, fclose);
+	return Register(info, [handle](uint64_t offset, uint64_t size, void* destination) {
+		FILE* source = handle.get();
+		if (fseek(source, long(offset), SEEK_SET) != 0)
+			return false;
+		return fread(destination, 1, size_t(size), source) == size;
+	});
+}
+
+uint32_t LavaTextureStreamer::Register(const LavaKtx2Info& info, LavaTextureReader reader)
+{
+	if (!device->SupportsFormat(info.format)) {
+		LAVA_PRINT("Texture format " << info.format << " isn't sampleable on this device");
+		return LAVA_INVALID_TEXTURE;
+	}
+
+	uint32_t texture = uint32_t(textures.size());
+	Texture entry = {};
+	entry.info = info;
+	entry.reader = std::move(reader);
+	entry.alive = true;
+
+	LavaTextureResidency& residency = entry.residency;
+	residency.levelCount = info.levelCount;
+	residency.requestedLevel = info.levelCount;
+	residency.residentLevel = info.levelCount;
+	residency.tailLevel = info.levelCount - 1;
+	for (uint32_t level = 0; level < info.levelCount; level++) {
+		if (std::max(LevelExtent(info.width, level), LevelExtent(info.height, level)) <= tailSize) {
+			residency.tailLevel = level;
+			break;
+		}
+	}
+	textures.push_back(std::move(entry));
+
+	//The tail is what gets sampled until anything finer arrives, it's loaded right away and doesn't count against the frame budget.
+	if (!Commit(texture, residency.tailLevel)) {
+		LAVA_PRINT("Failed to read mip tail of texture " << texture);
+		textures[texture].alive = false;
+		return LAVA_INVALID_TEXTURE;
+	}
+	return texture;
+}
+
+void LavaTextureStreamer::Unregister(uint32_t texture)
+{
+	Texture& entry = textures[texture];
+	if (!entry.alive)
+		return;
+
+	device->DestroyTexture(texture);
+	stats.residentBytes -= entry.residency.residentBytes;
+	entry.residency.residentBytes = 0;
+	entry.residency.residentLevel = entry.info.levelCount;
+	entry.reader = LavaTextureReader();
+	entry.alive = false;
+}
+
+void LavaTextureStreamer::BeginFrame(uint64_t currentFrame)
+{
+	frame = currentFrame;
+	stats.uploadedBytes = 0;
+	stats.uploadedLevels = 0;
+	stats.evictedLevels = 0;
+	stats.missingLevels = 0;
+	for (Texture& entry : textures) {
+		entry.residency.requestedLevel = entry.info.levelCount;
+	}
+}
+
+void LavaTextureStreamer::RequestLevel(uint32_t texture, float level)
+{
+	Texture& entry = textures[texture];
+	uint32_t requested = uint32_t(std::min(std::max(level, 0.f), float(entry.info.levelCount - 1)));
+	entry.residency.requestedLevel = std::min(entry.residency.requestedLevel, requested);
+}
+
+//Moves residency to [minLevel, levelCount) in one device commit, reading whatever is new from the source.
+bool LavaTextureStreamer::Commit(uint32_t texture, uint32_t minLevel)
+{
+	Texture& entry = textures[texture];
+	LavaTextureResidency& residency = entry.residency;
+
+	LavaTextureLevelData uploads[LAVA_MAX_TEXTURE_LEVELS];
+	uint32_t uploadCount = 0;
+	uint64_t readSize = 0;
+	for (uint32_t level = minLevel; level < residency.residentLevel; level++) {
+		readSize += entry.info.levels[level].size;
+	}
+	readBuffer.resize(size_t(readSize));
+
+	uint64_t offset = 0;
+	for (uint32_t level = minLevel; level < residency.residentLevel; level++) {
+		const LavaKtx2Level& source = entry.info.levels[level];
+		if (!entry.reader(source.offset, source.size, readBuffer.data() + offset))
+			return false;
+		uploads[uploadCount++] = { level, readBuffer.data() + offset, source.size };
+		offset += source.size;
+	}
+
+	device->CommitResidency(texture, entry.info, minLevel, uploads, uploadCount);
+
+	uint64_t bytes = 0;
+	for (uint32_t level = minLevel; level < entry.info.levelCount; level++) {
+		bytes += entry.info.levels[level].size;
+	}
+	stats.residentBytes = stats.residentBytes - residency.residentBytes + bytes;
+	residency.residentBytes = bytes;
+	residency.residentLevel = minLevel;
+	return true;
+}
+
+//Drops the finest level of the texture whose finest level went unused the longest. Levels requested this frame and
+//mip tails are never evicted. False when nothing can go.
+bool LavaTextureStreamer::EvictOne()
+{
+	uint32_t victim = LAVA_INVALID_TEXTURE;
+	uint64_t oldestUse = UINT64_MAX;
+	for (uint32_t texture = 0; texture < textures.size(); texture++) {
+		const Texture& entry = textures[texture];
+		const LavaTextureResidency& residency = entry.residency;
+		if (!entry.alive || residency.residentLevel >= residency.tailLevel || residency.residentLevel >= residency.requestedLevel)
+			continue;
+
+		uint64_t lastUse = residency.levelLastUsed[residency.residentLevel];
+		if (lastUse < oldestUse) {
+			oldestUse = lastUse;
+			victim = texture;
+		}
+	}
+
+	if (victim == LAVA_INVALID_TEXTURE)
+		return false;
+
+	Commit(victim, textures[victim].residency.residentLevel + 1);
+	stats.evictedLevels++;
+	return true;
+}
+
+uint64_t LavaTextureStreamer::GetEvictableBytes() const
+{
+	uint64_t bytes = 0;
+	for (const Texture& entry : textures) {
+		const LavaTextureResidency& residency = entry.residency;
+		if (!entry.alive)
+			continue;
+		for (uint32_t level = residency.residentLevel; level < std::min(residency.tailLevel, residency.requestedLevel); level++) {
+			bytes += entry.info.levels[level].size;
+		}
+	}
+	return bytes;
+}
+
+void LavaTextureStreamer::Update()
+{
+	LAVA_PROFILE_ZONE("Texture streamer update");
+	for (Texture& entry : textures) {
+		LavaTextureResidency& residency = entry.residency;
+		for (uint32_t level = residency.requestedLevel; level < entry.info.levelCount; level++) {
+			residency.levelLastUsed[level] = frame;
+		}
+	}
+
+	//A lowered budget takes effect right away.
+	while (stats.residentBytes > memoryBudget && EvictOne()) {
+	}
+
+	//Worst first: the texture furthest from what it needs gets the next level. One level per texture per round keeps
+	//a single huge texture from starving the rest, the new levels of a texture are committed together afterwards.
+	std::vector<uint32_t> candidates;
+	for (uint32_t texture = 0; texture < textures.size(); texture++) {
+		const Texture& entry = textures[texture];
+		if (entry.alive && entry.residency.requestedLevel < entry.residency.residentLevel)
+			candidates.push_back(texture);
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		const LavaTextureResidency& residencyA = textures[a].residency;
+		const LavaTextureResidency& residencyB = textures[b].residency;
+		uint32_t gapA = residencyA.residentLevel - residencyA.requestedLevel;
+		uint32_t gapB = residencyB.residentLevel - residencyB.requestedLevel;
+		return gapA != gapB ? gapA > gapB : a < b;
+	});
+
+	std::vector<uint32_t> targetLevels(candidates.size());
+	for (size_t i = 0; i < candidates.size(); i++) {
+		targetLevels[i] = textures[candidates[i]].residency.residentLevel;
+	}
+
+	uint64_t plannedBytes = 0;
+	uint64_t plannedMemory = stats.residentBytes;
+	bool budgetLeft = true;
+	while (budgetLeft) {
+		bool progress = false;
+		for (size_t i = 0; i < candidates.size() && budgetLeft; i++) {
+			const Texture& entry = textures[candidates[i]];
+			if (targetLevels[i] <= entry.residency.requestedLevel)
+				continue;
+
+			uint64_t size = entry.info.levels[targetLevels[i] - 1].size;
+			if (plannedBytes + size > uploadBudget && plannedBytes > 0) {
+				budgetLeft = false;
+				break;
+			}
+
+			//Make room first, evicting only touches levels nobody asked for this frame, never the planned ones.
+			//Nothing is dropped unless it actually makes enough room.
+			if (plannedMemory + size > memoryBudget && plannedMemory + size - GetEvictableBytes() > memoryBudget)
+				continue;
+			while (plannedMemory + size > memoryBudget) {
+				uint64_t before = stats.residentBytes;
+				if (!EvictOne())
+					break;
+				plannedMemory -= before - stats.residentBytes;
+			}
+			if (plannedMemory + size > memoryBudget)
+				continue;
+
+			targetLevels[i]--;
+			plannedBytes += size;
+			plannedMemory += size;
+			progress = true;
+		}
+		if (!progress)
+			break;
+	}
+
+	for (size_t i = 0; i < candidates.size(); i++) {
+		uint32_t texture = candidates[i];
+		uint32_t residentLevel = textures[texture].residency.residentLevel;
+		if (targetLevels[i] == residentLevel)
+			continue;
+
+		uint64_t residentBytes = stats.residentBytes;
+		if (!Commit(texture, targetLevels[i])) {
+			LAVA_PRINT("Failed to stream texture " << texture << " level " << targetLevels[i]);
+			continue;
+		}
+		stats.uploadedBytes += stats.residentBytes - residentBytes;
+		stats.uploadedLevels += residentLevel - targetLevels[i];
+	}
+
+	for (const Texture& entry : textures) {
+		if (entry.alive && entry.residency.requestedLevel < entry.residency.residentLevel)
+			stats.missingLevels += entry.residency.residentLevel - entry.residency.requestedLevel;
+	}
+}
+
+void LavaTextureStreamer::PrintResidency() const
+{
+	for (uint32_t texture = 0; texture < textures.size(); texture++) {
+		const Texture& entry = textures[texture];
+		if (!entry.alive)
+			continue;
+
+		const LavaTextureResidency& residency = entry.residency;
+		uint32_t residentSize = std::max(LevelExtent(entry.info.width, residency.residentLevel), LevelExtent(entry.info.height, residency.residentLevel));
+		std::string requested = residency.requestedLevel < residency.levelCount ? "level " + std::to_string(residency.requestedLevel) + " requested" : "unused";
+		LAVA_PRINT("Texture " << texture << ": " << entry.info.width << "x" << entry.info.height << ", level " << residency.residentLevel
+			<< " (" << residentSize << "px) resident, " << requested << ", " << residency.residentBytes / 1024 << " KB");
+	}
+	LAVA_PRINT("Texture streaming: " << stats.residentBytes / (1024 * 1024) << "/" << memoryBudget / (1024 * 1024) << " MB resident, "
+		<< stats.uploadedBytes / 1024 << " KB in " << stats.uploadedLevels << " levels uploaded, " << stats.evictedLevels << " evicted, "
+		<< stats.missingLevels << " missing");
+}
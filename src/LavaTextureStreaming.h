@@ -0,0 +1,197 @@
+#pragma once
+#include "LavaCore.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+class LavaBindlessHeap;
+
+const uint32_t LAVA_MAX_TEXTURE_LEVELS = 16;
+const uint32_t LAVA_INVALID_TEXTURE = ~0u;
+
+struct LavaKtx2Level {
+	uint64_t offset; //From the start of the file
+	uint64_t size;
+};
+
+//What the streamer needs from a KTX2 file: 2D, one layer, no supercompression, so level data is the raw
+//BCn/ASTC/uncompressed payload and can be copied straight into an image.
+struct LavaKtx2Info {
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	LavaKtx2Level levels[LAVA_MAX_TEXTURE_LEVELS]; //Level 0 is the largest
+};
+
+//Parses the header and level index, size has to cover at least those. False for anything the streamer can't use.
+bool LavaParseKtx2(const uint8_t* data, size_t size, LavaKtx2Info& info);
+
+//Reads a byte range of the texture source into destination.
+typedef std::function<bool(uint64_t offset, uint64_t size, void* destination)> LavaTextureReader;
+
+struct LavaTextureLevelData {
+	uint32_t level;
+	const void* data;
+	uint64_t size;
+};
+
+//Where resident mips live. Residency is always a contiguous range [minLevel, levelCount), each commit moves
+//minLevel: finer levels arrive with their data, evicted ones are simply dropped.
+class LavaTextureDevice {
+public:
+	virtual ~LavaTextureDevice() = default;
+	virtual bool SupportsFormat(VkFormat format) const = 0;
+	virtual void CommitResidency(uint32_t texture, const LavaKtx2Info& info, uint32_t minLevel, const LavaTextureLevelData* uploads, uint32_t uploadCount) = 0;
+	virtual void DestroyTexture(uint32_t texture) = 0;
+};
+
+//No GPU, only checks the commits are consistent and counts them. Drives the streamer in tests and benchmarks.
+//Inconsistent commits are counted and otherwise ignored, so release builds catch them too.
+class LavaSimulatedTextureDevice : public LavaTextureDevice {
+public:
+	bool SupportsFormat(VkFormat format) const override { return format != VK_FORMAT_UNDEFINED; }
+	void CommitResidency(uint32_t texture, const LavaKtx2Info& info, uint32_t minLevel, const LavaTextureLevelData* uploads, uint32_t uploadCount) override;
+	void DestroyTexture(uint32_t texture) override;
+
+	uint32_t GetMinLevel(uint32_t texture) const { return minLevels[texture]; }
+	uint64_t GetResidentBytes() const { return residentBytes; }
+	uint64_t GetUploadedBytes() const { return uploadedBytes; }
+	uint32_t GetCommitCount() const { return commitCount; }
+	uint32_t GetInvalidCommitCount() const { return invalidCommitCount; }
+
+private:
+	std::vector<uint32_t> minLevels; //LAVA_MAX_TEXTURE_LEVELS when nothing is resident
+	std::vector<uint64_t> textureBytes;
+	uint64_t residentBytes = 0;
+	uint64_t uploadedBytes = 0;
+	uint32_t commitCount = 0;
+	uint32_t invalidCommitCount = 0;
+};
+
+//Each residency change makes a new image holding just the resident levels, copies the levels it keeps from the old one
+//and uploads the new ones through a staging buffer. The new image gets a new bindless slot, so frames in flight keep
+//sampling the old one, which is destroyed once they have retired. Commits are synchronous, so call them between frames.
+class LavaVulkanTextureDevice : public LavaTextureDevice {
+public:
+	void Init(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue queue, uint32_t queueFamilyIndex, LavaBindlessHeap* bindlessHeap,
+		uint32_t framesInFlight);
+	void Destroy(); //Device has to be idle
+
+	//Frames before frame - framesInFlight are done on the GPU, their retired images get destroyed.
+	void BeginFrame(uint64_t frame);
+
+	bool SupportsFormat(VkFormat format) const override;
+	void CommitResidency(uint32_t texture, const LavaKtx2Info& info, uint32_t minLevel, const LavaTextureLevelData* uploads, uint32_t uploadCount) override;
+	void DestroyTexture(uint32_t texture) override;
+
+	uint32_t GetBindlessIndex(uint32_t texture) const { return textures[texture].bindlessIndex; } //Changes with every commit
+	uint32_t GetAllocationCount() const { return allocationCount; } //Device memory allocations so far
+
+private:
+	struct Texture {
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		uint32_t minLevel;
+		uint32_t bindlessIndex;
+	};
+
+	struct RetiredImage {
+		uint64_t frame;
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+	};
+
+	void Retire(const Texture& texture);
+	void ReserveStaging(VkDeviceSize size);
+	uint32_t SelectMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const;
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	LavaBindlessHeap* bindlessHeap = nullptr;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	void* stagingData = nullptr;
+	VkDeviceSize stagingSize = 0;
+	uint32_t allocationCount = 0;
+
+	std::vector<Texture> textures;
+	std::deque<RetiredImage> retired;
+	uint64_t currentFrame = 0;
+	uint32_t framesInFlight = 1;
+};
+
+struct LavaTextureResidency {
+	uint32_t residentLevel; //Finest resident level
+	uint32_t requestedLevel; //Finest level asked for this frame, levelCount when unused
+	uint32_t tailLevel; //This level and coarser ones are loaded on register and never evicted
+	uint32_t levelCount;
+	uint64_t residentBytes;
+	uint64_t levelLastUsed[LAVA_MAX_TEXTURE_LEVELS]; //Last frame a level was at or coarser than the request
+};
+
+struct LavaTextureStreamingStats {
+	uint64_t residentBytes;
+	uint64_t uploadedBytes; //Current frame
+	uint32_t uploadedLevels;
+	uint32_t evictedLevels;
+	uint32_t missingLevels; //Requested but not resident after the update
+};
+
+//Mip streaming driven by usage feedback. Every frame the renderer reports the finest level each texture needs
+//(from its screen size), Update() then streams missing levels coarse to fine within the per frame upload budget
+//and evicts the least recently used levels nobody currently needs when over the memory budget.
+class LavaTextureStreamer {
+public:
+	void Init(LavaTextureDevice* device);
+	void Shutdown();
+
+	uint32_t RegisterFile(const char* path);
+	uint32_t Register(const LavaKtx2Info& info, LavaTextureReader reader);
+	void Unregister(uint32_t texture);
+
+	void BeginFrame(uint64_t frame);
+	void RequestLevel(uint32_t texture, float level); //Fractional levels round down to the finer one
+	void Update();
+
+	const LavaKtx2Info& GetInfo(uint32_t texture) const { return textures[texture].info; }
+	const LavaTextureResidency& GetResidency(uint32_t texture) const { return textures[texture].residency; }
+	const LavaTextureStreamingStats& GetStats() const { return stats; }
+	void PrintResidency() const;
+
+	uint64_t uploadBudget = 8ull * 1024 * 1024; //Bytes per frame, one level is still allowed when it alone is larger
+	uint64_t memoryBudget = 256ull * 1024 * 1024;
+	uint32_t tailSize = 64; //Levels at most this many texels wide stay resident
+
+private:
+	struct Texture {
+		LavaKtx2Info info;
+		LavaTextureReader reader;
+		LavaTextureResidency residency;
+		bool alive;
+	};
+
+	bool Commit(uint32_t texture, uint32_t minLevel);
+	bool EvictOne();
+	uint64_t GetEvictableBytes() const; //Resident levels below the tail that weren't requested this frame
+
+private:
+	LavaTextureDevice* device = nullptr;
+	std::vector<Texture> textures;
+	std::vector<uint8_t> readBuffer;
+	uint64_t frame = 0;
+	LavaTextureStreamingStats stats = {};
+};
+
+//Finest level worth sampling for a texture stretched over this many screen pixels, one texel per pixel.
+float LavaTextureLevelForScreenSize(uint32_t textureSize, float screenPixels);
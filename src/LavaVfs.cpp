@@ -0,0 +1,449 @@
+#include "LavaVfs.h"
+#include "LavaJobs.h"
+#include "LavaProfiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define LAVA_VFS_URING 1
+#else
+#define LAVA_VFS_URING 0
+#endif
+
+static const uint32_t vfsRingDepth = 64; //Files in flight, and open, at once
+
+#if LAVA_VFS_URING
+//Raw io_uring through its three syscalls, liburing isn't a dependency. Only touched under the ring mutex.
+struct LavaVfsRing {
+	int fd = -1;
+	void* sqRing = MAP_FAILED;
+	void* cqRing = MAP_FAILED;
+	size_t sqRingSize = 0;
+	size_t cqRingSize = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqesSize = 0;
+
+	uint32_t* sqHead = nullptr;
+	uint32_t* sqTail = nullptr;
+	uint32_t* sqArray = nullptr;
+	uint32_t sqMask = 0;
+	uint32_t sqEntries = 0;
+	uint32_t* cqHead = nullptr;
+	uint32_t* cqTail = nullptr;
+	io_uring_cqe* cqes = nullptr;
+	uint32_t cqMask = 0;
+	uint32_t unsubmitted = 0;
+
+	~LavaVfsRing()
+	{
+		if (sqes)
+			munmap(sqes, sqesSize);
+		if (cqRing != MAP_FAILED && cqRing != sqRing)
+			munmap(cqRing, cqRingSize);
+		if (sqRing != MAP_FAILED)
+			munmap(sqRing, sqRingSize);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	//Fails with ENOSYS on old kernels and EPERM where seccomp or io_uring_disabled blocks it.
+	bool Init(uint32_t entries)
+	{
+		io_uring_params params = {};
+		fd = int(syscall(__NR_io_uring_setup, entries, &params));
+		if (fd < 0)
+			return false;
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping)
+			sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+		sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sqRing == MAP_FAILED)
+			return false;
+		cqRing = singleMapping ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED)
+			return false;
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqeMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sqeMapping == MAP_FAILED)
+			return false;
+		sqes = static_cast<io_uring_sqe*>(sqeMapping);
+
+		uint8_t* sq = static_cast<uint8_t*>(sqRing);
+		sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+		sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+		sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+		sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+		sqEntries = params.sq_entries;
+		uint8_t* cq = static_cast<uint8_t*>(cqRing);
+		cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+		cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+		return true;
+	}
+
+	//READV rather than READ, it goes back to 5.1 kernels.
+	void Push(int file, iovec* buffer, uint64_t offset, uint64_t userData)
+	{
+		uint32_t tail = *sqTail;
+		assert(tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) < sqEntries);
+		uint32_t index = tail & sqMask;
+		io_uring_sqe& sqe = sqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_READV;
+		sqe.fd = file;
+		sqe.addr = uint64_t(uintptr_t(buffer));
+		sqe.len = 1;
+		sqe.off = offset;
+		sqe.user_data = userData;
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		unsubmitted++;
+	}
+
+	//Submits everything pushed so far and blocks until at least waitCount reads completed.
+	bool Enter(uint32_t waitCount)
+	{
+		long result;
+		do {
+			result = syscall(__NR_io_uring_enter, fd, unsubmitted, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		} while (result < 0 && errno == EINTR);
+		if (result < 0)
+			return false;
+		unsubmitted -= uint32_t(result);
+		return true;
+	}
+
+	bool Pop(uint64_t& userData, int32_t& result)
+	{
+		uint32_t head = *cqHead;
+		if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+			return false;
+		const io_uring_cqe& cqe = cqes[head & cqMask];
+		userData = cqe.user_data;
+		result = cqe.res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+#else
+struct LavaVfsRing {
+};
+#endif
+
+static bool ReadFileBlocking(const std::string& path, std::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data.resize(size_t(std::max(0l, length)));
+	bool read = fread(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return read;
+}
+
+static bool FileExists(const std::string& path)
+{
+	struct stat fileStat;
+	return stat(path.c_str(), &fileStat) == 0 && (fileStat.st_mode & S_IFMT) == S_IFREG;
+}
+
+//Path below the mount point, null when the path isn't under it.
+static const char* StripMountPoint(const std::string& mountPoint, const char* path)
+{
+	if (mountPoint.empty())
+		return path;
+	size_t length = mountPoint.size();
+	if (strncmp(path, mountPoint.c_str(), length) != 0 || path[length] != '/')
+		return nullptr;
+	return path + length + 1;
+}
+
+static std::string TrimSlashes(const char* path)
+{
+	std::string trimmed = path;
+	while (!trimmed.empty() && (trimmed.back() == '/' || trimmed.back() == '\\'))
+		trimmed.pop_back();
+	return trimmed;
+}
+
+LavaVfs::LavaVfs()
+{
+}
+
+LavaVfs::~LavaVfs()
+{
+}
+
+const char* LavaVfs::GetBackendName(LavaVfsBackend backend)
+{
+	switch (backend) {
+	case LAVA_VFS_BLOCKING:
+		return "blocking";
+	case LAVA_VFS_THREADS:
+		return "threads";
+	case LAVA_VFS_IO_URING:
+		return "io_uring";
+	}
+	return "unknown";
+}
+
+void LavaVfs::Init(LavaJobSystem* jobs, LavaVfsBackend preferred)
+{
+	jobSystem = jobs;
+	ring.reset();
+	backend = preferred;
+	if (backend == LAVA_VFS_IO_URING) {
+#if LAVA_VFS_URING
+		ring.reset(new LavaVfsRing());
+		if (!ring->Init(vfsRingDepth)) {
+			ring.reset();
+			backend = LAVA_VFS_THREADS;
+		}
+#else
+		backend = LAVA_VFS_THREADS;
+#endif
+	}
+	if (backend == LAVA_VFS_THREADS && !jobSystem)
+		backend = LAVA_VFS_BLOCKING;
+}
+
+void LavaVfs::MountDirectory(const char* directory, const char* mountPoint)
+{
+	Mount mount;
+	mount.mountPoint = TrimSlashes(mountPoint);
+	mount.directory = TrimSlashes(directory);
+	if (mount.directory.empty())
+		mount.directory = ".";
+	mounts.push_back(std::move(mount));
+}
+
+bool LavaVfs::MountPack(const char* path, const char* mountPoint)
+{
+	Mount mount;
+	mount.mountPoint = TrimSlashes(mountPoint);
+	mount.pack.reset(new LavaPack());
+	if (!mount.pack->Open(path))
+		return false;
+	mounts.push_back(std::move(mount));
+	return true;
+}
+
+//Newest mount first. Packs answer from their index, a directory only needs a stat when an older mount could still
+//have the file, the last candidate is simply opened.
+bool LavaVfs::Resolve(const char* path, const LavaPack*& pack, std::string& location) const
+{
+	pack = nullptr;
+	for (size_t i = mounts.size(); i-- > 0;) {
+		const Mount& mount = mounts[i];
+		const char* relative = StripMountPoint(mount.mountPoint, path);
+		if (!relative)
+			continue;
+
+		if (mount.pack) {
+			if (!mount.pack->Contains(relative))
+				continue;
+			pack = mount.pack.get();
+			location = relative;
+			return true;
+		}
+
+		//Absolute paths only come through the root mount and aren't under its directory.
+		bool absolute = relative[0] == '/' || relative[0] == '\\' || (relative[0] && relative[1] == ':');
+		location = absolute ? std::string(relative) : mount.directory + "/" + relative;
+		bool lastCandidate = true;
+		for (size_t older = 0; older < i && lastCandidate; older++) {
+			lastCandidate = StripMountPoint(mounts[older].mountPoint, path) == nullptr;
+		}
+		if (lastCandidate || FileExists(location))
+			return true;
+	}
+	return false;
+}
+
+bool LavaVfs::Exists(const char* path) const
+{
+	const LavaPack* pack = nullptr;
+	std::string location;
+	return Resolve(path, pack, location) && (pack || FileExists(location));
+}
+
+bool LavaVfs::IsPacked(const char* path) const
+{
+	const LavaPack* pack = nullptr;
+	std::string location;
+	return Resolve(path, pack, location) && pack;
+}
+
+const void* LavaVfs::Map(const char* path, size_t* size) const
+{
+	const LavaPack* pack = nullptr;
+	std::string location;
+	if (!Resolve(path, pack, location) || !pack)
+		return nullptr;
+	const void* data = pack->Find(location.c_str(), size);
+	if (data)
+		mapCount++;
+	return data;
+}
+
+bool LavaVfs::Read(const char* path, std::vector<uint8_t>& data)
+{
+	LavaVfsRequest request = { path, 0, {}, false };
+	Read(&request, 1);
+	data.swap(request.data);
+	return request.loaded;
+}
+
+void LavaVfs::Read(LavaVfsRequest* requests, uint32_t count)
+{
+	LAVA_PROFILE_ZONE("VFS read");
+	struct PackRead {
+		LavaVfsRequest* request;
+		const LavaPack* pack;
+		std::string name;
+	};
+	std::vector<PackRead> packReads;
+	std::vector<LooseRead> looseReads;
+	for (uint32_t i = 0; i < count; i++) {
+		LavaVfsRequest& request = requests[i];
+		request.loaded = false;
+		request.data.clear();
+		const LavaPack* pack = nullptr;
+		std::string location;
+		if (!Resolve(request.path, pack, location))
+			continue;
+		if (pack)
+			packReads.push_back({ &request, pack, location });
+		else
+			looseReads.push_back({ &request, location });
+	}
+
+	//Copies out of the mapping, or LZ4 expansion for compressed entries, which is worth spreading.
+	LavaParallelFor(backend == LAVA_VFS_BLOCKING ? nullptr : jobSystem, uint32_t(packReads.size()), 16, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			packReads[i].request->loaded = packReads[i].pack->Read(packReads[i].name.c_str(), packReads[i].request->data);
+		}
+	});
+	ReadLoose(looseReads);
+
+	uint64_t bytes = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		bytes += requests[i].data.size();
+	}
+	requestCount += count;
+	packReadCount += packReads.size();
+	looseReadCount += looseReads.size();
+	byteCount += bytes;
+}
+
+void LavaVfs::ReadLoose(std::vector<LooseRead>& reads)
+{
+	if (reads.empty())
+		return;
+	std::stable_sort(reads.begin(), reads.end(), [](const LooseRead& a, const LooseRead& b) { return a.request->priority > b.request->priority; });
+	if (backend == LAVA_VFS_IO_URING) {
+		ReadRing(reads);
+		return;
+	}
+
+	//Chunks are handed out in order, so the job system starts on the high priorities too.
+	LavaParallelFor(backend == LAVA_VFS_THREADS ? jobSystem : nullptr, uint32_t(reads.size()), 4, [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			reads[i].request->loaded = ReadFileBlocking(reads[i].path, reads[i].request->data);
+		}
+	});
+}
+
+//Opens in priority order and keeps the ring full, one io_uring_enter per wave submits what was queued and waits for
+//the next completion. Short reads go back on the ring for the rest of the file.
+void LavaVfs::ReadRing(std::vector<LooseRead>& reads)
+{
+#if LAVA_VFS_URING
+	struct RingRead {
+		int file;
+		iovec buffer;
+		uint64_t offset;
+	};
+	std::vector<RingRead> ringReads(reads.size());
+	std::lock_guard<std::mutex> lock(ringMutex);
+	size_t next = 0;
+	uint32_t inFlight = 0;
+	while (next < reads.size() || inFlight) {
+		while (next < reads.size() && inFlight < ring->sqEntries) {
+			size_t index = next++;
+			LavaVfsRequest& request = *reads[index].request;
+			int file = open(reads[index].path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (file < 0)
+				continue;
+			struct stat fileStat;
+			bool statted = fstat(file, &fileStat) == 0;
+			if (!statted || fileStat.st_size == 0) {
+				request.loaded = statted;
+				close(file);
+				continue;
+			}
+			request.data.resize(size_t(fileStat.st_size));
+			ringReads[index] = { file, { request.data.data(), request.data.size() }, 0 };
+			ring->Push(file, &ringReads[index].buffer, 0, index);
+			inFlight++;
+		}
+		if (!inFlight)
+			break;
+
+		bool entered = ring->Enter(1);
+		assert(entered && "io_uring_enter failed");
+		(void)entered;
+		ringSubmitCount++;
+
+		uint64_t index;
+		int32_t result;
+		while (ring->Pop(index, result)) {
+			RingRead& read = ringReads[index];
+			LavaVfsRequest& request = *reads[index].request;
+			if (result > 0 && read.offset + uint64_t(result) < request.data.size()) {
+				read.offset += uint64_t(result);
+				read.buffer = { request.data.data() + read.offset, size_t(request.data.size() - read.offset) };
+				ring->Push(read.file, &read.buffer, read.offset, index);
+				continue;
+			}
+			request.loaded = result > 0 && read.offset + uint64_t(result) == request.data.size();
+			if (!request.loaded)
+				request.data.clear();
+			close(read.file);
+			inFlight--;
+		}
+	}
+#else
+	(void)reads;
+#endif
+}
+
+LavaVfsStats LavaVfs::GetStats() const
+{
+	LavaVfsStats stats = {};
+	stats.maps = mapCount;
+	stats.requests = requestCount;
+	stats.packReads = packReadCount;
+	stats.looseReads = looseReadCount;
+	stats.bytes = byteCount;
+	stats.ringSubmits = ringSubmitCount;
+	return stats;
+}
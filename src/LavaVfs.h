@@ -0,0 +1,96 @@
+#pragma once
+#include "LavaPack.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class LavaJobSystem;
+
+//How loose files are read. Pack entries never go through a backend, they are served from the mapping.
+enum LavaVfsBackend : uint32_t {
+	LAVA_VFS_BLOCKING, //One file after another on the calling thread
+	LAVA_VFS_THREADS, //Spread over the job system
+	LAVA_VFS_IO_URING, //Linux, every file of a batch in flight on one ring, a syscall per wave instead of per read
+};
+
+//One file of a batch. Higher priorities are opened and submitted first when the batch is larger than the queue.
+struct LavaVfsRequest {
+	const char* path;
+	uint32_t priority;
+	std::vector<uint8_t> data;
+	bool loaded;
+};
+
+struct LavaVfsStats {
+	uint64_t maps; //Pack entries used in place
+	uint64_t requests;
+	uint64_t packReads; //Served from a mounted pack
+	uint64_t looseReads; //Went through the backend
+	uint64_t bytes;
+	uint64_t ringSubmits; //io_uring_enter calls
+};
+
+struct LavaVfsRing;
+
+//Mounts directories and pack archives into one namespace of forward slash paths. Later mounts shadow earlier ones, so
+//mounting a pack over the directory it was built from serves its files from the pack and everything else from disk.
+//Mount everything first, reads are thread safe afterwards.
+class LavaVfs {
+public:
+	LavaVfs();
+	~LavaVfs();
+
+	//io_uring where the kernel and sandbox allow it, otherwise the job system, otherwise blocking reads.
+	void Init(LavaJobSystem* jobSystem, LavaVfsBackend preferred = LAVA_VFS_IO_URING);
+	LavaVfsBackend GetBackend() const { return backend; }
+	static const char* GetBackendName(LavaVfsBackend backend);
+
+	//mountPoint "" is the root, "assets" puts the entries under assets/.
+	void MountDirectory(const char* directory, const char* mountPoint = "");
+	bool MountPack(const char* path, const char* mountPoint = "");
+
+	bool Exists(const char* path) const;
+	bool IsPacked(const char* path) const; //Served by a mounted pack, Map has it in place
+	//Bytes of a pack entry, valid while the pack stays mounted. Null for loose files, read those.
+	const void* Map(const char* path, size_t* size) const;
+	bool Read(const char* path, std::vector<uint8_t>& data);
+	//Blocks until every request finished, failed ones are left with loaded false.
+	void Read(LavaVfsRequest* requests, uint32_t count);
+
+	LavaVfsStats GetStats() const;
+
+private:
+	struct Mount {
+		std::string mountPoint; //Without a trailing slash
+		std::string directory;
+		std::unique_ptr<LavaPack> pack;
+	};
+
+	struct LooseRead {
+		LavaVfsRequest* request;
+		std::string path;
+	};
+
+	//Pack and the name in it, or the file a directory mount has for the path. False when nothing can have it.
+	bool Resolve(const char* path, const LavaPack*& pack, std::string& location) const;
+	void ReadLoose(std::vector<LooseRead>& reads);
+	void ReadRing(std::vector<LooseRead>& reads);
+
+private:
+	std::vector<Mount> mounts;
+	LavaJobSystem* jobSystem = nullptr;
+	LavaVfsBackend backend = LAVA_VFS_BLOCKING;
+	std::unique_ptr<LavaVfsRing> ring;
+	std::mutex ringMutex; //One batch on the ring at a time
+
+	mutable std::atomic<uint64_t> mapCount{ 0 };
+	std::atomic<uint64_t> requestCount{ 0 };
+	std::atomic<uint64_t> packReadCount{ 0 };
+	std::atomic<uint64_t> looseReadCount{ 0 };
+	std::atomic<uint64_t> byteCount{ 0 };
+	std::atomic<uint64_t> ringSubmitCount{ 0 };
+};
@@ -1,7 +1,126 @@
 //#include "Application.h"
 #include "LavaRenderer.h"
-int main(void) {
+#include "LavaTextureCompression.h"
+#include <stdlib.h>
+
+//Offline texture compression, no window or device:
+//VulkanKata --compress-texture in.png|in.tga out.ktx2 [--format bc1|bc3|bc5|bc7] [--quality fast|normal|high] [--srgb] [--no-mips]
+static int CompressTexture(int argc, char** argv)
+{
+	LavaTextureCompressionSettings settings;
+	for (int i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			const char* format = argv[++i];
+			if (strcmp(format, "bc1") == 0)
+				settings.format = LAVA_BLOCK_BC1;
+			else if (strcmp(format, "bc3") == 0)
+				settings.format = LAVA_BLOCK_BC3;
+			else if (strcmp(format, "bc5") == 0)
+				settings.format = LAVA_BLOCK_BC5;
+			else if (strcmp(format, "bc7") == 0)
+				settings.format = LAVA_BLOCK_BC7;
+		}
+		else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc) {
+			const char* quality = argv[++i];
+			if (strcmp(quality, "fast") == 0)
+				settings.quality = LAVA_COMPRESSION_FAST;
+			else if (strcmp(quality, "normal") == 0)
+				settings.quality = LAVA_COMPRESSION_NORMAL;
+			else if (strcmp(quality, "high") == 0)
+				settings.quality = LAVA_COMPRESSION_HIGH;
+		}
+		else if (strcmp(argv[i], "--srgb") == 0)
+			settings.srgb = true;
+		else if (strcmp(argv[i], "--no-mips") == 0)
+			settings.mips = false;
+	}
+
+	LavaJobSystem jobSystem;
+	return LavaCompressTextureFile(argv[2], argv[3], settings, &jobSystem) ? 0 : 1;
+}
+
+//Usage: VulkanKata [--mesh path.obj] [--instances N] [--per-object-draws] [--gpu-driven [--validate-culling] [--async-compute]] [--cpu-culling | --bvh-culling] [--occlusion-culling] [--depth-prepass] [--reuse-command-buffers] [--animate]
+//                  [--particles N [--validate-particles]]
+//                  [--texture path.ktx2 [--texture-budget MB] [--texture-upload-budget KB]] [--profile trace.json [--profile-frames N]]
+//                  [--stats name [--stats-frames N]] [--capture frames.lcap [--capture-frames N]] [--size WxH]
+//                  [--headless [--frames N] [--output dir [--dump-every N]]] [--serial-startup] [--shaders dir]
+//e.g. "--mesh assets/monkey.obj --instances 100000" vs the same with --per-object-draws to compare CPU frame cost.
+//--headless needs no window system, dir gets timings.csv and frame_N.ppm images (the last frame, or every Nth one).
+//--serial-startup runs the startup stages on the main thread only, to compare the printed startup timelines.
+//--shaders loads the SPIR-V from another directory than the one the build compiled it to.
+//--async-compute culls on a separate compute queue a frame ahead, the printed GPU timings show how much overlaps graphics.
+//--animate sways the mesh on a procedural skeleton, blended compressed clips on the CPU and a compute skinning pass.
+//--particles runs a fountain of up to N particles on the GPU, emitted, simulated and drawn without the CPU seeing a count.
+int main(int argc, char** argv) {
+	if (argc >= 4 && strcmp(argv[1], "--compress-texture") == 0)
+		return CompressTexture(argc, argv);
+
+	LavaRendererSettings settings;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+			settings.meshPath = argv[++i];
+		else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc)
+			settings.shaderPath = argv[++i];
+		else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+			settings.instanceCount = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--per-object-draws") == 0)
+			settings.drawPerObject = true;
+		else if (strcmp(argv[i], "--gpu-driven") == 0)
+			settings.gpuDriven = true;
+		else if (strcmp(argv[i], "--validate-culling") == 0)
+			settings.validateGpuCulling = true;
+		else if (strcmp(argv[i], "--cpu-culling") == 0)
+			settings.cpuCulling = true;
+		else if (strcmp(argv[i], "--bvh-culling") == 0)
+			settings.bvhCulling = true;
+		else if (strcmp(argv[i], "--occlusion-culling") == 0)
+			settings.occlusionCulling = true;
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+			settings.depthPrepass = true;
+		else if (strcmp(argv[i], "--reuse-command-buffers") == 0)
+			settings.reuseCommandBuffers = true;
+		else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
+			settings.texturePath = argv[++i];
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+			settings.textureMemoryBudget = uint64_t(atoi(argv[++i])) * 1024 * 1024;
+		else if (strcmp(argv[i], "--texture-upload-budget") == 0 && i + 1 < argc)
+			settings.textureUploadBudget = uint64_t(atoi(argv[++i])) * 1024;
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			settings.profilePath = argv[++i];
+		else if (strcmp(argv[i], "--profile-frames") == 0 && i + 1 < argc)
+			settings.profileFrames = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+			settings.statsName = argv[++i];
+		else if (strcmp(argv[i], "--stats-frames") == 0 && i + 1 < argc)
+			settings.statsFrames = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			settings.capturePath = argv[++i];
+		else if (strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+			settings.captureFrames = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+			sscanf(argv[++i], "%ux%u", &settings.width, &settings.height);
+		else if (strcmp(argv[i], "--headless") == 0)
+			settings.headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			settings.headlessFrames = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			settings.outputPath = argv[++i];
+		else if (strcmp(argv[i], "--dump-every") == 0 && i + 1 < argc)
+			settings.dumpInterval = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--serial-startup") == 0)
+			settings.serialStartup = true;
+		else if (strcmp(argv[i], "--async-compute") == 0)
+			settings.asyncCompute = true;
+		else if (strcmp(argv[i], "--animate") == 0)
+			settings.animate = true;
+		else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+			settings.particleCount = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--validate-particles") == 0)
+			settings.validateParticles = true;
+	}
+
 	//Application app;
 	//app.Run();
-	LavaRenderer renderer;
-}
\ No newline at end of file
+	LavaRenderer renderer(settings);
+	renderer.Run();
+}
@@ -0,0 +1,92 @@
+#include "LavaTest.h"
+#include "LavaCore.h"
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct TestEntry {
+	std::string name;
+	LavaTestBody body;
+};
+
+static std::vector<TestEntry>& GetRegistry()
+{
+	static std::vector<TestEntry> registry;
+	return registry;
+}
+
+static uint32_t failedChecks = 0;
+
+void LavaRegisterTest(const char* name, LavaTestBody body)
+{
+	GetRegistry().push_back({ name, body });
+}
+
+void LavaTestFail(const char* file, int line, const char* expression)
+{
+	LAVA_PRINT("  " << file << ":" << line << ": check failed: " << expression);
+	failedChecks++;
+}
+
+void LavaTestFailEqual(const char* file, int line, const char* expression, uint64_t actual, uint64_t expected)
+{
+	LAVA_PRINT("  " << file << ":" << line << ": check failed: " << expression << " (got 0x" << std::hex << actual << ", expected 0x" << expected << std::dec << ")");
+	failedChecks++;
+}
+
+static bool MatchesFilter(const std::vector<std::string>& filters, const std::string& name)
+{
+	if (filters.empty())
+		return true;
+	for (const std::string& filter : filters) {
+		if (name.find(filter) != std::string::npos)
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> filters; //Substring match, any of them
+	bool list = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+			filters.push_back(argv[++i]);
+		else if (!strcmp(argv[i], "--list"))
+			list = true;
+		else {
+			LAVA_PRINT("Usage: lava_tests [--filter text]... [--list]");
+			return 1;
+		}
+	}
+
+	std::vector<TestEntry> entries = GetRegistry();
+	std::sort(entries.begin(), entries.end(), [](const TestEntry& a, const TestEntry& b) { return a.name < b.name; });
+
+	uint32_t runCount = 0;
+	uint32_t failedCount = 0;
+	for (const TestEntry& entry : entries) {
+		if (!MatchesFilter(filters, entry.name))
+			continue;
+		if (list) {
+			LAVA_PRINT(entry.name);
+			continue;
+		}
+
+		uint32_t checksBefore = failedChecks;
+		entry.body();
+		bool passed = failedChecks == checksBefore;
+		LAVA_PRINT((passed ? "ok      " : "FAILED  ") << entry.name);
+		runCount++;
+		failedCount += passed ? 0 : 1;
+	}
+
+	if (list)
+		return 0;
+
+	//A filter that matches nothing is a typo in the test registration, not a pass.
+	LAVA_PRINT(runCount - failedCount << "/" << runCount << " tests passed");
+	return failedCount || !runCount ? 1 : 0;
+}
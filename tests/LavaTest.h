@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+
+//One device free unit test. Checks record failures and keep going, so a run reports every broken expectation.
+typedef std::function<void()> LavaTestBody;
+
+void LavaRegisterTest(const char* name, LavaTestBody body);
+void LavaTestFail(const char* file, int line, const char* expression);
+void LavaTestFailEqual(const char* file, int line, const char* expression, uint64_t actual, uint64_t expected);
+
+struct LavaTestRegistrar {
+	LavaTestRegistrar(const char* name, LavaTestBody body) { LavaRegisterTest(name, body); }
+};
+
+#define LAVA_TEST_CONCAT_(a, b) a##b
+#define LAVA_TEST_CONCAT(a, b) LAVA_TEST_CONCAT_(a, b)
+
+//LAVA_TEST("group/name", []() { ...; LAVA_CHECK(condition); });
+#define LAVA_TEST(name, ...) static LavaTestRegistrar LAVA_TEST_CONCAT(testRegistrar, __LINE__)(name, __VA_ARGS__)
+
+#define LAVA_CHECK(condition) \
+			do { \
+				if (!(condition)) \
+					LavaTestFail(__FILE__, __LINE__, #condition); \
+			} while (0)
+
+//Integers, enums and Vulkan flags, both values get printed on failure.
+#define LAVA_CHECK_EQUAL(actual, expected) \
+			do { \
+				uint64_t actualValue = uint64_t(actual), expectedValue = uint64_t(expected); \
+				if (actualValue != expectedValue) \
+					LavaTestFailEqual(__FILE__, __LINE__, #actual " == " #expected, actualValue, expectedValue); \
+			} while (0)
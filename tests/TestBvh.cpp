@@ -0,0 +1,251 @@
+#include "LavaTest.h"
+#include "LavaBvh.h"
+
+#include <algorithm>
+#include <math.h>
+#include <gtc/matrix_transform.hpp>
+
+//Deterministic xorshift, same as the benchmarks.
+struct BvhRandom {
+	uint32_t state = 0x2545f491u;
+
+	uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	float NextFloat(float min, float max) { return min + (max - min) * float(Next() >> 8) * (1.f / 16777216.f); }
+};
+
+static LavaAabb RandomBox(BvhRandom& random)
+{
+	glm::vec3 center(random.NextFloat(-100.f, 100.f), random.NextFloat(-20.f, 20.f), random.NextFloat(-100.f, 100.f));
+	glm::vec3 extent(random.NextFloat(0.1f, 3.f), random.NextFloat(0.1f, 3.f), random.NextFloat(0.1f, 3.f));
+	LavaAabb box;
+	box.min = center - extent;
+	box.max = center + extent;
+	return box;
+}
+
+//Brute force references, one test per object with the same math the BVH uses at its leaves.
+static std::vector<uint32_t> ScanFrustum(const std::vector<LavaAabb>& boxes, const LavaFrustum& frustum)
+{
+	std::vector<uint32_t> objects;
+	for (uint32_t object = 0; object < boxes.size(); object++) {
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			glm::vec3 positive(plane.x > 0.f ? boxes[object].max.x : boxes[object].min.x, plane.y > 0.f ? boxes[object].max.y : boxes[object].min.y,
+				plane.z > 0.f ? boxes[object].max.z : boxes[object].min.z);
+			outside = plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.f;
+		}
+		if (!outside)
+			objects.push_back(object);
+	}
+	return objects;
+}
+
+static std::vector<uint32_t> ScanBox(const std::vector<LavaAabb>& boxes, const LavaAabb& box)
+{
+	std::vector<uint32_t> objects;
+	for (uint32_t object = 0; object < boxes.size(); object++) {
+		if (glm::all(glm::lessThanEqual(boxes[object].min, box.max)) && glm::all(glm::greaterThanEqual(boxes[object].max, box.min)))
+			objects.push_back(object);
+	}
+	return objects;
+}
+
+static std::vector<uint32_t> ScanSphere(const std::vector<LavaAabb>& boxes, const glm::vec3& center, float radius)
+{
+	std::vector<uint32_t> objects;
+	for (uint32_t object = 0; object < boxes.size(); object++) {
+		glm::vec3 offset = glm::clamp(center, boxes[object].min, boxes[object].max) - center;
+		if (glm::dot(offset, offset) <= radius * radius)
+			objects.push_back(object);
+	}
+	return objects;
+}
+
+static bool RayEntry(const LavaAabb& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& entry)
+{
+	glm::vec3 t0 = (box.min - origin) * inverseDirection;
+	glm::vec3 t1 = (box.max - origin) * inverseDirection;
+	glm::vec3 nearT = glm::min(t0, t1);
+	glm::vec3 farT = glm::max(t0, t1);
+	entry = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.f));
+	return entry <= std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+}
+
+static std::vector<uint32_t> Sorted(std::vector<uint32_t> objects)
+{
+	std::sort(objects.begin(), objects.end());
+	return objects;
+}
+
+//Every query kind against the scan, over a spread of random queries around the boxes.
+static void CheckQueries(const LavaBvh& bvh, const std::vector<LavaAabb>& boxes, BvhRandom& random)
+{
+	LAVA_CHECK_EQUAL(bvh.GetObjectCount(), boxes.size());
+	std::vector<uint32_t> objects;
+
+	for (int i = 0; i < 16; i++) {
+		glm::vec3 eye(random.NextFloat(-120.f, 120.f), random.NextFloat(-10.f, 10.f), random.NextFloat(-120.f, 120.f));
+		glm::vec3 target(random.NextFloat(-50.f, 50.f), 0.f, random.NextFloat(-50.f, 50.f));
+		glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(random.NextFloat(20.f, 90.f)), 16.f / 9.f, 0.1f, random.NextFloat(30.f, 300.f));
+		LavaFrustum frustum = ExtractFrustum(projection * view);
+
+		bvh.CullFrustum(frustum, objects);
+		LAVA_CHECK(Sorted(objects) == ScanFrustum(boxes, frustum));
+	}
+
+	for (int i = 0; i < 32; i++) {
+		LavaAabb box = RandomBox(random);
+		box.max += glm::vec3(random.NextFloat(0.f, 30.f));
+		bvh.QueryBox(box, objects);
+		LAVA_CHECK(Sorted(objects) == ScanBox(boxes, box));
+
+		glm::vec3 center = (box.min + box.max) * 0.5f;
+		float radius = random.NextFloat(0.5f, 25.f);
+		bvh.QuerySphere(center, radius, objects);
+		LAVA_CHECK(Sorted(objects) == ScanSphere(boxes, center, radius));
+	}
+
+	for (int i = 0; i < 64; i++) {
+		glm::vec3 origin(random.NextFloat(-150.f, 150.f), random.NextFloat(-30.f, 30.f), random.NextFloat(-150.f, 150.f));
+		glm::vec3 direction = glm::normalize(glm::vec3(random.NextFloat(-1.f, 1.f), random.NextFloat(-0.3f, 0.3f), random.NextFloat(-1.f, 1.f)));
+		float maxDistance = random.NextFloat(50.f, 400.f);
+		glm::vec3 inverseDirection = 1.f / direction;
+
+		float closest = maxDistance;
+		bool expectHit = false;
+		for (const LavaAabb& box : boxes) {
+			float entry;
+			if (RayEntry(box, origin, inverseDirection, closest, entry) && entry < closest) {
+				closest = entry;
+				expectHit = true;
+			}
+		}
+
+		//Overlapping boxes can tie on the entry distance, so the distance is what has to match.
+		LavaBvhHit hit;
+		bool hitAny = bvh.Raycast(origin, direction, maxDistance, hit);
+		LAVA_CHECK(hitAny == expectHit);
+		if (hitAny && expectHit) {
+			float entry;
+			LAVA_CHECK(hit.distance == closest);
+			LAVA_CHECK(RayEntry(boxes[hit.object], origin, inverseDirection, maxDistance, entry) && entry == hit.distance);
+		}
+	}
+}
+
+LAVA_TEST("bvh/build_matches_brute_force", []() {
+	BvhRandom random;
+	LavaJobSystem jobSystem(3);
+
+	//Single threaded and with parallel subtrees, every object ends up in exactly one leaf either way.
+	for (LavaJobSystem* buildJobSystem : { (LavaJobSystem*)nullptr, &jobSystem }) {
+		std::vector<LavaAabb> boxes(6000);
+		for (LavaAabb& box : boxes) {
+			box = RandomBox(random);
+		}
+
+		LavaBvh bvh;
+		bvh.Build(boxes.data(), uint32_t(boxes.size()), buildJobSystem);
+		LAVA_CHECK(bvh.GetNodeCount() <= boxes.size() * 2 - 1);
+		CheckQueries(bvh, boxes, random);
+	}
+
+	LavaBvh empty;
+	empty.Build(nullptr, 0, nullptr);
+	std::vector<uint32_t> objects(1, 0);
+	empty.QueryBox(RandomBox(random), objects);
+	LAVA_CHECK(objects.empty());
+	LavaBvhHit hit;
+	LAVA_CHECK(!empty.Raycast(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), 100.f, hit));
+});
+
+//Incremental path refits, full bottom up refits and background rebuilds swapped in by Refit() all have to keep
+//the queries exact while objects move.
+LAVA_TEST("bvh/refit_matches_brute_force", []() {
+	BvhRandom random;
+	LavaJobSystem jobSystem(3);
+
+	std::vector<LavaAabb> boxes(4000);
+	for (LavaAabb& box : boxes) {
+		box = RandomBox(random);
+	}
+
+	LavaBvh bvh;
+	bvh.Build(boxes.data(), uint32_t(boxes.size()), &jobSystem);
+
+	for (int round = 0; round < 12; round++) {
+		//Few movers take the per path refit, every third round moves enough to refit everything.
+		uint32_t moveCount = round % 3 == 2 ? uint32_t(boxes.size()) / 4 : 40;
+		for (uint32_t i = 0; i < moveCount; i++) {
+			uint32_t object = random.Next() % uint32_t(boxes.size());
+			boxes[object] = RandomBox(random);
+			bvh.UpdateObject(object, boxes[object]);
+		}
+		bvh.Refit();
+		CheckQueries(bvh, boxes, random);
+	}
+
+	for (uint32_t object = 0; object < boxes.size(); object += 7) {
+		boxes[object] = RandomBox(random);
+		bvh.UpdateObject(object, boxes[object]);
+	}
+	bvh.RefitAll();
+	CheckQueries(bvh, boxes, random);
+});
+
+//Exponentially spaced chains out along both ends of every axis make the binned SAH peel a few objects per level,
+//about as deep as float bounds let it get. The depth recorded at build has to fit the traversal stack and stay
+//the same through refits, which only move bounds.
+LAVA_TEST("bvh/skewed_depth_bounded", []() {
+	BvhRandom random;
+
+	std::vector<LavaAabb> boxes;
+	for (int direction = 0; direction < 6; direction++) {
+		for (int i = 0; i < 30; i++) {
+			glm::vec3 center(0.f);
+			center[direction % 3] = (direction < 3 ? 1.f : -1.f) * powf(4.f, float(i));
+			LavaAabb box;
+			box.min = center - glm::vec3(0.5f);
+			box.max = center + glm::vec3(0.5f);
+			boxes.push_back(box);
+		}
+	}
+
+	LavaBvh bvh;
+	bvh.Build(boxes.data(), uint32_t(boxes.size()), nullptr);
+	uint32_t depth = bvh.GetDepth();
+	LAVA_CHECK(depth > 16);
+	LAVA_CHECK(depth < LAVA_BVH_STACK_SIZE);
+
+	std::vector<uint32_t> objects;
+	LavaAabb box;
+	box.min = glm::vec3(-1e6f);
+	box.max = glm::vec3(1e9f, 1.f, 1.f);
+	bvh.QueryBox(box, objects);
+	LAVA_CHECK(Sorted(objects) == ScanBox(boxes, box));
+
+	bvh.QuerySphere(glm::vec3(0.f), 1e4f, objects);
+	LAVA_CHECK(Sorted(objects) == ScanSphere(boxes, glm::vec3(0.f), 1e4f));
+
+	LavaBvhHit hit;
+	LAVA_CHECK(bvh.Raycast(glm::vec3(-2e18f, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f), 1e30f, hit));
+	LAVA_CHECK(hit.object >= 90 && hit.object < 120);
+
+	for (uint32_t i = 0; i < boxes.size(); i++) {
+		boxes[i].max += glm::vec3(random.NextFloat(0.f, 2.f));
+		bvh.UpdateObject(i, boxes[i]);
+	}
+	bvh.RefitAll();
+	LAVA_CHECK_EQUAL(bvh.GetDepth(), depth);
+	bvh.QueryBox(box, objects);
+	LAVA_CHECK(Sorted(objects) == ScanBox(boxes, box));
+});
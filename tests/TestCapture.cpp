@@ -0,0 +1,115 @@
+#include "LavaTest.h"
+#include "LavaCapture.h"
+#include "LavaDrawList.h"
+
+#include <stdio.h>
+#include <vector>
+
+static const char* testCapturePath = "lava_test_capture.lcap";
+static const uint32_t testInstanceCount = 16;
+
+//One upload of every instance, then whatever the test records in the single frame.
+template<typename FrameFunction>
+static bool WriteTestCapture(LavaCaptureFileHeader header, FrameFunction writeFrame)
+{
+	LavaCaptureWriter writer;
+	if (!writer.Open(testCapturePath, header))
+		return false;
+	VkBuffer instances = (VkBuffer)(uintptr_t)1;
+	std::vector<uint8_t> instanceData(size_t(testInstanceCount) * sizeof(LavaAffineTransform));
+	writer.AddBuffer(instances, instanceData.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "instances", LAVA_CAPTURE_BUFFER_INSTANCES);
+	writer.Upload(instances, 0, instanceData.data(), instanceData.size());
+	writer.BeginFrame(0, glm::mat4(1.f));
+	writeFrame(writer, instances);
+	writer.EndFrame(1.0);
+	writer.Close();
+	return true;
+}
+
+static LavaCaptureFileHeader TestHeader()
+{
+	LavaCaptureFileHeader header = {};
+	header.passCount = 1;
+	header.instanceCount = testInstanceCount;
+	header.instanceStride = sizeof(LavaAffineTransform);
+	return header;
+}
+
+LAVA_TEST("capture/load_valid", []() {
+	const uint32_t stream[] = { 3, 0, testInstanceCount - 1 };
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer) { writer.InstanceStream(stream, 3); }));
+
+	LavaCaptureReader capture;
+	LAVA_CHECK(capture.Load(testCapturePath));
+	LAVA_CHECK_EQUAL(capture.GetFrames().size(), 1);
+	LAVA_CHECK_EQUAL(capture.GetUploads().size(), 1);
+	LAVA_CHECK_EQUAL(capture.GetInstanceStream(capture.GetFrames()[0].instanceStream).size(), 3);
+	remove(testCapturePath);
+});
+
+//Replay indexes and allocates with these straight away, a corrupted capture has to fail to load instead.
+LAVA_TEST("capture/reject_corrupted", []() {
+	LavaCaptureReader capture;
+	auto noFrame = [](LavaCaptureWriter&, VkBuffer) {};
+
+	LavaCaptureFileHeader header = TestHeader();
+	header.instanceCount = 0xffffffffu;
+	header.instanceStride = 0xffffffffu;
+	LAVA_CHECK(WriteTestCapture(header, noFrame));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+
+	header = TestHeader();
+	header.instanceStride = 4;
+	LAVA_CHECK(WriteTestCapture(header, noFrame));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+
+	const uint32_t stream[] = { 0, testInstanceCount };
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer) { writer.InstanceStream(stream, 2); }));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+
+	std::vector<uint32_t> longStream(testInstanceCount + 1, 0);
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer) {
+		writer.InstanceStream(longStream.data(), uint32_t(longStream.size()));
+	}));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+
+	const uint8_t bytes[16] = {};
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer instances) {
+		writer.Upload(instances, testInstanceCount * sizeof(LavaAffineTransform) - 8, bytes, sizeof(bytes));
+	}));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer instances) {
+		writer.Upload(instances, ~0ull - 4, bytes, sizeof(bytes));
+	}));
+	LAVA_CHECK(!capture.Load(testCapturePath));
+	remove(testCapturePath);
+});
+
+//Frames in flight draw from their own copy of the instance stream, the capture sees one buffer. Buffers added
+//after an alias still get ids in order.
+LAVA_TEST("capture/aliased_buffers", []() {
+	VkBuffer copy = (VkBuffer)(uintptr_t)2;
+	VkBuffer indices = (VkBuffer)(uintptr_t)3;
+	LAVA_CHECK(WriteTestCapture(TestHeader(), [&](LavaCaptureWriter& writer, VkBuffer instances) {
+		writer.AliasBuffer(copy, instances);
+		writer.AddBuffer(indices, 64, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "indices");
+		LavaDrawPacket packet = {};
+		packet.vertexBuffers[1] = copy;
+		packet.instanceCount = testInstanceCount;
+		LavaDrawList drawList;
+		drawList.Push(0, packet);
+		drawList.Sort(nullptr);
+		writer.DrawList(drawList);
+	}));
+
+	LavaCaptureReader capture;
+	LAVA_CHECK(capture.Load(testCapturePath));
+	LAVA_CHECK_EQUAL(capture.GetBuffers().size(), 2);
+	LAVA_CHECK(capture.GetFrames().size() == 1 && capture.GetFrames()[0].drawList != LAVA_CAPTURE_INVALID_ID);
+	if (capture.GetFrames().size() == 1 && capture.GetFrames()[0].drawList != LAVA_CAPTURE_INVALID_ID) {
+		const LavaCaptureDrawList& drawList = capture.GetDrawList(capture.GetFrames()[0].drawList);
+		LAVA_CHECK_EQUAL(drawList.packets.size(), 1);
+		LAVA_CHECK_EQUAL(drawList.packets[0].vertexBuffers[1], capture.GetBuffers()[0].desc.id);
+	}
+	remove(testCapturePath);
+});
@@ -0,0 +1,162 @@
+#include "LavaTest.h"
+#include "LavaRenderer.h"
+#include "LavaCapture.h"
+#include "LavaNullVulkan.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#ifndef LAVA_TEST_ASSET_DIR
+#define LAVA_TEST_ASSET_DIR "assets"
+#endif
+
+//The whole renderer on the null driver, headless, with the shaders the build compiled.
+static const char* testCapturePath = "lava_test_renderer.lcap";
+
+static LavaRendererSettings FixedScene()
+{
+	LavaRendererSettings settings;
+	settings.meshPath = LAVA_TEST_ASSET_DIR "/monkey.obj";
+	settings.instanceCount = 1000;
+	settings.headless = true;
+	settings.width = 256;
+	settings.height = 128;
+	return settings;
+}
+
+//Counters over a whole run. Everything the renderer created is destroyed again, and nothing is destroyed twice.
+static LavaNullVulkanStats RunRenderer(LavaRendererSettings settings, uint32_t frameCount)
+{
+	settings.headlessFrames = frameCount;
+	LavaNullVulkanStats begin = LavaNullVulkanGetStats();
+	{
+		LavaRenderer renderer(settings);
+		renderer.Run();
+	}
+	LavaNullVulkanStats end = LavaNullVulkanGetStats();
+	LAVA_CHECK_EQUAL(end.liveObjects, begin.liveObjects);
+	LAVA_CHECK_EQUAL(end.allocatedBytes, begin.allocatedBytes);
+	LAVA_CHECK_EQUAL(end.invalidHandles, begin.invalidHandles);
+
+	LavaNullVulkanStats run = {};
+	run.calls = end.calls - begin.calls;
+	run.commands = end.commands - begin.commands;
+	run.draws = end.draws - begin.draws;
+	run.dispatches = end.dispatches - begin.dispatches;
+	run.barriers = end.barriers - begin.barriers;
+	run.submits = end.submits - begin.submits;
+	return run;
+}
+
+//A static scene records the same frame every time, two runs differ only by the extra frames.
+static LavaNullVulkanStats PerFrameCounts(const LavaRendererSettings& settings)
+{
+	const uint32_t shortRun = 4, longRun = 12;
+	LavaNullVulkanStats a = RunRenderer(settings, shortRun);
+	LavaNullVulkanStats b = RunRenderer(settings, longRun);
+	const uint64_t frames = longRun - shortRun;
+	LavaNullVulkanStats frame = {};
+	frame.calls = (b.calls - a.calls) / frames;
+	frame.commands = (b.commands - a.commands) / frames;
+	frame.draws = (b.draws - a.draws) / frames;
+	frame.dispatches = (b.dispatches - a.dispatches) / frames;
+	frame.barriers = (b.barriers - a.barriers) / frames;
+	frame.submits = (b.submits - a.submits) / frames;
+	LAVA_CHECK_EQUAL((b.calls - a.calls) % frames, 0);
+	LAVA_CHECK_EQUAL((b.commands - a.commands) % frames, 0);
+	return frame;
+}
+
+//Render pass, dynamic state, bindings, timestamps and the readback copy around the draws, three barriers and one submit.
+static const uint64_t frameCommands = 20;
+
+LAVA_TEST("renderer/instanced_draw_calls", []() {
+	LavaNullVulkanStats frame = PerFrameCounts(FixedScene());
+	LAVA_CHECK_EQUAL(frame.draws, 1);
+	LAVA_CHECK_EQUAL(frame.commands, frameCommands + 1);
+	LAVA_CHECK_EQUAL(frame.calls, 28);
+	LAVA_CHECK_EQUAL(frame.barriers, 3);
+	LAVA_CHECK_EQUAL(frame.submits, 1);
+	LAVA_CHECK_EQUAL(frame.dispatches, 0);
+
+	//Culling changes what is drawn, not how
+	LavaRendererSettings settings = FixedScene();
+	settings.cpuCulling = true;
+	LavaNullVulkanStats culled = PerFrameCounts(settings);
+	LAVA_CHECK_EQUAL(culled.draws, 1);
+	LAVA_CHECK_EQUAL(culled.commands, frame.commands);
+	LAVA_CHECK_EQUAL(culled.calls, frame.calls);
+});
+
+LAVA_TEST("renderer/per_object_draw_calls", []() {
+	LavaRendererSettings settings = FixedScene();
+	settings.drawPerObject = true;
+	LavaNullVulkanStats frame = PerFrameCounts(settings);
+	LAVA_CHECK_EQUAL(frame.draws, settings.instanceCount);
+	LAVA_CHECK_EQUAL(frame.commands, frameCommands + settings.instanceCount);
+	LAVA_CHECK_EQUAL(frame.barriers, 3);
+	LAVA_CHECK_EQUAL(frame.submits, 1);
+
+	settings.cpuCulling = true;
+	LavaNullVulkanStats culled = PerFrameCounts(settings);
+	LAVA_CHECK(culled.draws > 0 && culled.draws < settings.instanceCount);
+	LAVA_CHECK_EQUAL(culled.commands, frameCommands + culled.draws);
+});
+
+//After the first frame per swapchain image and frame slot a static draw list only resubmits the recorded command
+//buffer: the wait for the slot's fence, its reset, the submit and a query readback.
+LAVA_TEST("renderer/reuse_command_buffers", []() {
+	LavaRendererSettings settings = FixedScene();
+	settings.reuseCommandBuffers = true;
+	LavaNullVulkanStats frame = PerFrameCounts(settings);
+	LAVA_CHECK_EQUAL(frame.commands, 0);
+	LAVA_CHECK_EQUAL(frame.draws, 0);
+	LAVA_CHECK_EQUAL(frame.calls, 4);
+	LAVA_CHECK_EQUAL(frame.submits, 1);
+});
+
+//The captured draw lists are the renderer's sorted draw list output: one packet per visible instance in the
+//culled per object scene, each pointing at its own slot of the instance stream, a single instanced packet otherwise.
+LAVA_TEST("renderer/draw_list_output", []() {
+	for (uint32_t perObject = 0; perObject < 2; perObject++) {
+		LavaRendererSettings settings = FixedScene();
+		settings.drawPerObject = perObject != 0;
+		settings.cpuCulling = true;
+		settings.capturePath = testCapturePath;
+		settings.captureFrames = 8;
+		RunRenderer(settings, settings.captureFrames);
+
+		LavaCaptureReader capture;
+		LAVA_CHECK(capture.Load(testCapturePath));
+		LAVA_CHECK_EQUAL(capture.GetFrames().size(), settings.captureFrames);
+		for (const LavaCaptureFrameData& frame : capture.GetFrames()) {
+			LAVA_CHECK(frame.instanceStream != LAVA_CAPTURE_INVALID_ID && frame.drawList != LAVA_CAPTURE_INVALID_ID);
+			if (frame.instanceStream == LAVA_CAPTURE_INVALID_ID || frame.drawList == LAVA_CAPTURE_INVALID_ID)
+				continue;
+			const std::vector<uint32_t>& stream = capture.GetInstanceStream(frame.instanceStream);
+			const LavaCaptureDrawList& drawList = capture.GetDrawList(frame.drawList);
+			LAVA_CHECK(!stream.empty() && stream.size() < settings.instanceCount);
+			LAVA_CHECK(std::is_sorted(drawList.keys.begin(), drawList.keys.end()));
+
+			if (!settings.drawPerObject) {
+				LAVA_CHECK_EQUAL(drawList.packets.size(), 1);
+				LAVA_CHECK_EQUAL(drawList.packets[0].instanceCount, stream.size());
+				LAVA_CHECK_EQUAL(drawList.packets[0].firstInstance, 0);
+				continue;
+			}
+			LAVA_CHECK_EQUAL(drawList.packets.size(), stream.size());
+			std::vector<uint32_t> firstInstances;
+			for (const LavaCapturePacket& packet : drawList.packets) {
+				LAVA_CHECK_EQUAL(packet.instanceCount, 1);
+				LAVA_CHECK_EQUAL(packet.pipeline, drawList.packets[0].pipeline);
+				firstInstances.push_back(packet.firstInstance);
+			}
+			std::sort(firstInstances.begin(), firstInstances.end());
+			for (uint32_t i = 0; i < firstInstances.size(); i++) {
+				LAVA_CHECK_EQUAL(firstInstances[i], i);
+			}
+		}
+	}
+	remove(testCapturePath);
+});
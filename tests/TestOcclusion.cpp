@@ -0,0 +1,97 @@
+#include "LavaTest.h"
+#include "LavaOcclusion.h"
+#include "LavaJobs.h"
+#include "LavaMesh.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#ifndef LAVA_TEST_ASSET_DIR
+#define LAVA_TEST_ASSET_DIR "assets"
+#endif
+
+//Deterministic xorshift, same as the benchmarks.
+struct TestRandom {
+	uint32_t state = 0x9e3779b9u;
+
+	uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	float NextFloat(float min, float max) { return min + (max - min) * float(Next() >> 8) * (1.f / 16777216.f); }
+};
+
+//The tiled SIMD rasterizer has to write the same depth as the scalar whole screen reference, and the pyramids
+//built from both have to cull the same boxes. 40 randomly placed full resolution monkeys per scene.
+LAVA_TEST("occlusion/tiled_matches_reference", []() {
+	Mesh mesh = LoadMesh(LAVA_TEST_ASSET_DIR "/monkey.obj");
+	LavaJobSystem jobSystem(3);
+	TestRandom random;
+
+	const uint32_t sceneCount = 6;
+	const uint32_t occluderCount = 40;
+	const uint32_t boxCount = 2000;
+	for (uint32_t scene = 0; scene < sceneCount; scene++) {
+		glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::mat4 projection = glm::perspective(glm::radians(60.f), 2.f, 0.1f, 200.f);
+		projection[1][1] *= -1.f;
+		glm::mat4 viewProjection = projection * view;
+
+		LavaOcclusionCuller tiled, reference;
+		tiled.Init(256, 128);
+		reference.Init(256, 128);
+		tiled.BeginFrame(viewProjection);
+		reference.BeginFrame(viewProjection);
+
+		std::vector<glm::mat4> worlds(occluderCount);
+		for (glm::mat4& world : worlds) {
+			glm::vec3 position(random.NextFloat(-30.f, 30.f), random.NextFloat(-15.f, 15.f), random.NextFloat(4.f, 60.f));
+			glm::vec3 axis = glm::normalize(glm::vec3(random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f), random.NextFloat(0.1f, 1.f)));
+			world = glm::rotate(glm::translate(glm::mat4(1.f), position), random.NextFloat(0.f, 6.28f), axis);
+			world = glm::scale(world, glm::vec3(random.NextFloat(0.5f, 3.f)));
+
+			LavaOccluder occluder;
+			occluder.positions = &mesh.vertices[0].Position.x;
+			occluder.positionStride = sizeof(Vertex);
+			occluder.indices = mesh.indices.data();
+			occluder.indexCount = uint32_t(mesh.indices.size());
+			occluder.world = world;
+			tiled.AddOccluder(occluder);
+			reference.AddOccluder(occluder);
+		}
+		tiled.Rasterize(&jobSystem);
+		reference.RasterizeReference();
+		LAVA_CHECK_EQUAL(tiled.GetTriangleCount(), reference.GetTriangleCount());
+
+		LavaOcclusionDiff diff = LavaOcclusionCuller::CompareDepth(tiled, reference, 1e-5f);
+		LAVA_CHECK_EQUAL(diff.mismatchedPixels, 0);
+
+		//Something has to be covered, or the comparison says nothing.
+		uint32_t coveredPixels = 0;
+		for (uint32_t i = 0; i < reference.GetWidth() * reference.GetHeight(); i++) {
+			coveredPixels += reference.GetDepth()[i] < 1.f ? 1 : 0;
+		}
+		LAVA_CHECK(coveredPixels > reference.GetWidth() * reference.GetHeight() / 20);
+
+		std::vector<LavaAabb> boxes(boxCount);
+		for (LavaAabb& box : boxes) {
+			glm::vec3 center(random.NextFloat(-40.f, 40.f), random.NextFloat(-20.f, 20.f), random.NextFloat(5.f, 120.f));
+			glm::vec3 extent(random.NextFloat(0.2f, 2.f), random.NextFloat(0.2f, 2.f), random.NextFloat(0.2f, 2.f));
+			box.min = center - extent;
+			box.max = center + extent;
+		}
+		std::vector<uint8_t> tiledVisible(boxCount), referenceVisible(boxCount);
+		tiled.TestVisibility(boxes.data(), boxCount, tiledVisible.data(), &jobSystem);
+		reference.TestVisibility(boxes.data(), boxCount, referenceVisible.data(), nullptr);
+		uint32_t visibilityMismatches = 0, occludedCount = 0;
+		for (uint32_t i = 0; i < boxCount; i++) {
+			visibilityMismatches += tiledVisible[i] != referenceVisible[i] ? 1 : 0;
+			occludedCount += referenceVisible[i] ? 0 : 1;
+		}
+		LAVA_CHECK_EQUAL(visibilityMismatches, 0);
+		LAVA_CHECK(occludedCount > 0);
+	}
+});
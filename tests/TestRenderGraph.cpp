@@ -0,0 +1,367 @@
+#include "LavaTest.h"
+#include "LavaRenderGraph.h"
+
+//Everything here runs Compile() only, the barrier, batch and allocation lists are the whole contract with Execute().
+
+static const VkImageUsageFlags colorUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+static void NoCommands(VkCommandBuffer)
+{
+}
+
+static LavaGraphImageDesc ImageDesc(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+	LavaGraphImageDesc desc = {};
+	desc.format = format;
+	desc.width = 256;
+	desc.height = 256;
+	desc.usage = usage;
+	desc.aspect = aspect;
+	return desc;
+}
+
+static LavaGraphResource CreateColor(LavaRenderGraph& graph, const char* name)
+{
+	return graph.CreateImage(name, ImageDesc(VK_FORMAT_R8G8B8A8_UNORM, colorUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+}
+
+static LavaGraphResource CreateDepth(LavaRenderGraph& graph)
+{
+	return graph.CreateImage("depth", ImageDesc(VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT));
+}
+
+static LavaGraphResource ImportSwapchain(LavaRenderGraph& graph)
+{
+	return graph.ImportImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		LAVA_GRAPH_PRESENT);
+}
+
+static const LavaGraphBatch* FindBatch(const LavaRenderGraph& graph, uint32_t pass)
+{
+	for (const LavaGraphBatch& batch : graph.GetBatches()) {
+		if (batch.pass == pass)
+			return &batch;
+	}
+	return nullptr;
+}
+
+//Barrier for a resource in the batch before a pass, LAVA_GRAPH_INVALID_RESOURCE for the final batch.
+static const LavaGraphBarrier* FindBarrier(const LavaRenderGraph& graph, uint32_t pass, LavaGraphResource resource)
+{
+	const LavaGraphBatch* batch = FindBatch(graph, pass);
+	if (!batch)
+		return nullptr;
+	for (uint32_t i = batch->firstBarrier; i < batch->firstBarrier + batch->barrierCount; i++) {
+		if (graph.GetBarriers()[i].resource == resource)
+			return &graph.GetBarriers()[i];
+	}
+	return nullptr;
+}
+
+static const LavaGraphAllocation* FindAllocation(const LavaRenderGraph& graph, LavaGraphResource resource)
+{
+	for (const LavaGraphAllocation& allocation : graph.GetAllocations()) {
+		if (allocation.resource == resource)
+			return &allocation;
+	}
+	return nullptr;
+}
+
+LAVA_TEST("graph/raw_compute_to_indirect", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource args = graph.CreateBuffer("args", { 4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT });
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	uint32_t cull = graph.AddPass("cull", NoCommands);
+	graph.Write(cull, args, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t draw = graph.AddPass("draw", NoCommands);
+	graph.Read(draw, args, LAVA_GRAPH_INDIRECT_READ);
+	graph.Write(draw, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBarrier* barrier = FindBarrier(graph, draw, args);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		LAVA_CHECK_EQUAL(barrier->srcAccess, VK_ACCESS_SHADER_WRITE_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstStages, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstAccess, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+		LAVA_CHECK_EQUAL(barrier->oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+		LAVA_CHECK_EQUAL(barrier->newLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+});
+
+//A second reader in stages that already see the write needs nothing, a reader in new stages gets its own barrier.
+LAVA_TEST("graph/raw_reads_share_visibility", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource data = graph.CreateBuffer("data", { 4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT });
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	uint32_t write = graph.AddPass("write", NoCommands);
+	graph.Write(write, data, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t firstRead = graph.AddPass("first read", NoCommands);
+	graph.Read(firstRead, data, LAVA_GRAPH_STORAGE_READ_COMPUTE);
+	graph.SetSideEffects(firstRead);
+	uint32_t secondRead = graph.AddPass("second read", NoCommands);
+	graph.Read(secondRead, data, LAVA_GRAPH_STORAGE_READ_COMPUTE);
+	graph.SetSideEffects(secondRead);
+	uint32_t vertexRead = graph.AddPass("vertex read", NoCommands);
+	graph.Read(vertexRead, data, LAVA_GRAPH_STORAGE_READ_VERTEX);
+	graph.Write(vertexRead, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	//The writer follows its own compute stage, so the first read is already visible to compute.
+	LAVA_CHECK(FindBarrier(graph, firstRead, data) == nullptr);
+	LAVA_CHECK(FindBatch(graph, secondRead) == nullptr);
+	const LavaGraphBarrier* barrier = FindBarrier(graph, vertexRead, data);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		LAVA_CHECK_EQUAL(barrier->srcAccess, VK_ACCESS_SHADER_WRITE_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstStages, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+	}
+});
+
+LAVA_TEST("graph/war_waits_for_reads", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource data = graph.CreateBuffer("data", { 4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT });
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	uint32_t write = graph.AddPass("write", NoCommands);
+	graph.Write(write, data, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t read = graph.AddPass("read", NoCommands);
+	graph.Read(read, data, LAVA_GRAPH_STORAGE_READ_VERTEX);
+	graph.Write(read, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t rewrite = graph.AddPass("rewrite", NoCommands);
+	graph.Write(rewrite, data, LAVA_GRAPH_TRANSFER_WRITE);
+	graph.SetSideEffects(rewrite);
+	graph.Compile();
+
+	const LavaGraphBarrier* barrier = FindBarrier(graph, rewrite, data);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		//Waits for the vertex read and the compute write before it.
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstStages, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstAccess, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+});
+
+LAVA_TEST("graph/waw_same_layout", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	uint32_t clear = graph.AddPass("clear", NoCommands);
+	graph.Write(clear, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t overlay = graph.AddPass("overlay", NoCommands);
+	graph.Write(overlay, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBarrier* barrier = FindBarrier(graph, overlay, swapchain);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		LAVA_CHECK_EQUAL(barrier->srcAccess, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+		LAVA_CHECK_EQUAL(barrier->oldLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		LAVA_CHECK_EQUAL(barrier->newLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+});
+
+//Swapchain from UNDEFINED to attachment to present, depth from attachment to sampled.
+LAVA_TEST("graph/layout_transitions", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource depth = CreateDepth(graph);
+	uint32_t prepass = graph.AddPass("prepass", NoCommands);
+	graph.Write(prepass, depth, LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE);
+	uint32_t shade = graph.AddPass("shade", NoCommands);
+	graph.Read(shade, depth, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(shade, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBarrier* acquire = FindBarrier(graph, shade, swapchain);
+	LAVA_CHECK(acquire != nullptr);
+	if (acquire) {
+		LAVA_CHECK_EQUAL(acquire->oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+		LAVA_CHECK_EQUAL(acquire->newLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		LAVA_CHECK_EQUAL(acquire->srcStages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	}
+
+	const LavaGraphBarrier* sample = FindBarrier(graph, shade, depth);
+	LAVA_CHECK(sample != nullptr);
+	if (sample) {
+		LAVA_CHECK_EQUAL(sample->oldLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+		LAVA_CHECK_EQUAL(sample->newLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		LAVA_CHECK_EQUAL(sample->srcStages, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+		LAVA_CHECK_EQUAL(sample->srcAccess, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+		LAVA_CHECK_EQUAL(sample->dstStages, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	const LavaGraphBarrier* present = FindBarrier(graph, LAVA_GRAPH_INVALID_RESOURCE, swapchain);
+	LAVA_CHECK(present != nullptr);
+	if (present) {
+		LAVA_CHECK_EQUAL(present->oldLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		LAVA_CHECK_EQUAL(present->newLayout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		LAVA_CHECK_EQUAL(present->srcAccess, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	}
+	//Transients have no final state.
+	LAVA_CHECK(FindBarrier(graph, LAVA_GRAPH_INVALID_RESOURCE, depth) == nullptr);
+});
+
+//Unread outputs drop their pass and everything only feeding it, side effect passes stay.
+LAVA_TEST("graph/cull_unused_passes", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource scratch = CreateColor(graph, "scratch");
+	LavaGraphResource debug = CreateColor(graph, "debug");
+	LavaGraphResource readback = graph.CreateBuffer("readback", { 256, VK_BUFFER_USAGE_TRANSFER_DST_BIT });
+
+	uint32_t feed = graph.AddPass("feed", NoCommands);
+	graph.Write(feed, scratch, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t debugView = graph.AddPass("debug view", NoCommands);
+	graph.Read(debugView, scratch, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(debugView, debug, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t main = graph.AddPass("main", NoCommands);
+	graph.Write(main, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t copy = graph.AddPass("copy", NoCommands);
+	graph.Write(copy, readback, LAVA_GRAPH_TRANSFER_WRITE);
+	graph.SetSideEffects(copy);
+	graph.Compile();
+
+	const std::vector<uint32_t>& schedule = graph.GetSchedule();
+	LAVA_CHECK_EQUAL(schedule.size(), 2);
+	if (schedule.size() == 2) {
+		LAVA_CHECK_EQUAL(schedule[0], main);
+		LAVA_CHECK_EQUAL(schedule[1], copy);
+	}
+	LAVA_CHECK(FindBatch(graph, feed) == nullptr && FindBatch(graph, debugView) == nullptr);
+	LAVA_CHECK(FindAllocation(graph, scratch) == nullptr && FindAllocation(graph, debug) == nullptr);
+	LAVA_CHECK(FindAllocation(graph, readback) != nullptr);
+});
+
+//Everything a pass waits on goes in one batch, the batch masks are the union of its barriers.
+LAVA_TEST("graph/batch_per_pass", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource color = CreateColor(graph, "color");
+	LavaGraphResource data = graph.CreateBuffer("data", { 4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT });
+	uint32_t raster = graph.AddPass("raster", NoCommands);
+	graph.Write(raster, color, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t compute = graph.AddPass("compute", NoCommands);
+	graph.Write(compute, data, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t combine = graph.AddPass("combine", NoCommands);
+	graph.Read(combine, color, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Read(combine, data, LAVA_GRAPH_STORAGE_READ_VERTEX);
+	graph.Write(combine, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBatch* batch = FindBatch(graph, combine);
+	LAVA_CHECK(batch != nullptr);
+	if (batch) {
+		LAVA_CHECK_EQUAL(batch->barrierCount, 3);
+		LAVA_CHECK(FindBarrier(graph, combine, color) && FindBarrier(graph, combine, data) && FindBarrier(graph, combine, swapchain));
+		VkPipelineStageFlags srcStages = 0, dstStages = 0;
+		for (uint32_t i = batch->firstBarrier; i < batch->firstBarrier + batch->barrierCount; i++) {
+			srcStages |= graph.GetBarriers()[i].srcStages;
+			dstStages |= graph.GetBarriers()[i].dstStages;
+		}
+		LAVA_CHECK_EQUAL(batch->srcStages, srcStages);
+		LAVA_CHECK_EQUAL(batch->dstStages, dstStages);
+		LAVA_CHECK(batch->dstStages & VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+		LAVA_CHECK(batch->dstStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	//Batches tile the barrier list in schedule order, final batch last.
+	uint32_t nextBarrier = 0;
+	for (const LavaGraphBatch& each : graph.GetBatches()) {
+		LAVA_CHECK_EQUAL(each.firstBarrier, nextBarrier);
+		LAVA_CHECK(each.barrierCount > 0);
+		nextBarrier = each.firstBarrier + each.barrierCount;
+	}
+	LAVA_CHECK_EQUAL(nextBarrier, graph.GetBarriers().size());
+	LAVA_CHECK(!graph.GetBatches().empty() && graph.GetBatches().back().pass == LAVA_GRAPH_INVALID_RESOURCE);
+});
+
+//first -> middle -> last over three same size images: first and last never live together and share memory,
+//the first use of the last one has to wait for everything done to the first one.
+LAVA_TEST("graph/alias_predecessor", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource first = CreateColor(graph, "first");
+	LavaGraphResource middle = CreateColor(graph, "middle");
+	LavaGraphResource last = CreateColor(graph, "last");
+	uint32_t passA = graph.AddPass("a", NoCommands);
+	graph.Write(passA, first, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t passB = graph.AddPass("b", NoCommands);
+	graph.Read(passB, first, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(passB, middle, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	uint32_t passC = graph.AddPass("c", NoCommands);
+	graph.Read(passC, middle, LAVA_GRAPH_SAMPLED_READ_COMPUTE);
+	graph.Write(passC, last, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t passD = graph.AddPass("d", NoCommands);
+	graph.Read(passD, last, LAVA_GRAPH_SAMPLED_READ_FRAGMENT);
+	graph.Write(passD, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphAllocation* firstAllocation = FindAllocation(graph, first);
+	const LavaGraphAllocation* middleAllocation = FindAllocation(graph, middle);
+	const LavaGraphAllocation* lastAllocation = FindAllocation(graph, last);
+	LAVA_CHECK(firstAllocation && middleAllocation && lastAllocation);
+	if (!firstAllocation || !middleAllocation || !lastAllocation)
+		return;
+	LAVA_CHECK_EQUAL(lastAllocation->offset, firstAllocation->offset);
+	LAVA_CHECK(middleAllocation->offset >= firstAllocation->offset + firstAllocation->size ||
+		middleAllocation->offset + middleAllocation->size <= firstAllocation->offset);
+	LAVA_CHECK_EQUAL(graph.GetTransientHeapSize(), firstAllocation->size + middleAllocation->size);
+
+	const LavaGraphBarrier* handover = FindBarrier(graph, passC, last);
+	LAVA_CHECK(handover != nullptr);
+	if (handover) {
+		//The sampled read in b was the last thing done to that memory, its layout transition already ordered the write.
+		LAVA_CHECK(handover->srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		LAVA_CHECK_EQUAL(handover->oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+		LAVA_CHECK_EQUAL(handover->newLayout, VK_IMAGE_LAYOUT_GENERAL);
+	}
+});
+
+//The first depth write of a frame is a WAW against last frame's depth writes to the same transient memory.
+LAVA_TEST("graph/transient_cross_frame_waw", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource depth = CreateDepth(graph);
+	uint32_t draw = graph.AddPass("draw", NoCommands);
+	graph.Write(draw, depth, LAVA_GRAPH_DEPTH_ATTACHMENT_WRITE);
+	graph.Write(draw, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBarrier* barrier = FindBarrier(graph, draw, depth);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+		LAVA_CHECK_EQUAL(barrier->srcAccess, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+		LAVA_CHECK_EQUAL(barrier->oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+		LAVA_CHECK_EQUAL(barrier->newLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+});
+
+//A shared import is written by a frame while the previous one may still draw from it, a plain import is not.
+LAVA_TEST("graph/shared_import_cross_frame_war", []() {
+	LavaRenderGraph graph;
+	LavaGraphResource swapchain = ImportSwapchain(graph);
+	LavaGraphResource shared = graph.ImportBuffer("shared", LAVA_GRAPH_VERTEX_READ, true);
+	LavaGraphResource owned = graph.ImportBuffer("owned", LAVA_GRAPH_VERTEX_READ);
+	uint32_t write = graph.AddPass("write", NoCommands);
+	graph.Write(write, shared, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	graph.Write(write, owned, LAVA_GRAPH_STORAGE_WRITE_COMPUTE);
+	uint32_t draw = graph.AddPass("draw", NoCommands);
+	graph.Read(draw, shared, LAVA_GRAPH_VERTEX_READ);
+	graph.Read(draw, owned, LAVA_GRAPH_VERTEX_READ);
+	graph.Write(draw, swapchain, LAVA_GRAPH_COLOR_ATTACHMENT_WRITE);
+	graph.Compile();
+
+	const LavaGraphBarrier* barrier = FindBarrier(graph, write, shared);
+	LAVA_CHECK(barrier != nullptr);
+	if (barrier) {
+		LAVA_CHECK_EQUAL(barrier->srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		LAVA_CHECK_EQUAL(barrier->srcAccess, VK_ACCESS_SHADER_WRITE_BIT);
+		LAVA_CHECK_EQUAL(barrier->dstStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+	LAVA_CHECK(FindBarrier(graph, write, owned) == nullptr);
+});
@@ -0,0 +1,174 @@
+#include "LavaTest.h"
+#include "LavaScene.h"
+#include "LavaJobs.h"
+
+#include <algorithm>
+#include <math.h>
+
+//Deterministic xorshift, same as the benchmarks.
+struct SceneRandom {
+	uint32_t state = 0x6c8e9cf5u;
+
+	uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	float NextFloat(float min, float max) { return min + (max - min) * float(Next() >> 8) * (1.f / 16777216.f); }
+};
+
+//The test keeps its own copy of every local transform and parent, the reference walks it from the root each time.
+struct SceneNode {
+	LavaNodeHandle parent;
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+	bool alive;
+};
+
+static glm::quat RandomRotation(SceneRandom& random)
+{
+	glm::vec3 axis = glm::normalize(glm::vec3(random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f), random.NextFloat(0.1f, 1.f)));
+	return glm::angleAxis(random.NextFloat(0.f, 6.28f), axis);
+}
+
+static void Randomize(LavaScene& scene, std::vector<SceneNode>& nodes, LavaNodeHandle handle, SceneRandom& random)
+{
+	SceneNode& node = nodes[handle];
+	node.position = glm::vec3(random.NextFloat(-2.f, 2.f), random.NextFloat(-2.f, 2.f), random.NextFloat(-2.f, 2.f));
+	node.rotation = RandomRotation(random);
+	node.scale = glm::vec3(random.NextFloat(0.8f, 1.2f));
+	scene.SetLocalTransform(handle, node.position, node.rotation, node.scale);
+}
+
+static LavaNodeHandle Create(LavaScene& scene, std::vector<SceneNode>& nodes, LavaNodeHandle parent, SceneRandom& random)
+{
+	LavaNodeHandle handle = scene.CreateNode(parent);
+	if (nodes.size() <= handle)
+		nodes.resize(handle + 1);
+	nodes[handle].parent = parent;
+	nodes[handle].alive = true;
+	Randomize(scene, nodes, handle, random);
+	return handle;
+}
+
+static LavaAffineTransform ComputeWorld(const std::vector<SceneNode>& nodes, LavaNodeHandle handle)
+{
+	const SceneNode& node = nodes[handle];
+	LavaAffineTransform local = ComposeTransform(node.position, node.rotation, node.scale);
+	return node.parent == LAVA_INVALID_NODE ? local : MultiplyTransforms(ComputeWorld(nodes, node.parent), local);
+}
+
+static bool IsInSubtree(const std::vector<SceneNode>& nodes, LavaNodeHandle handle, LavaNodeHandle root)
+{
+	for (; handle != LAVA_INVALID_NODE; handle = nodes[handle].parent) {
+		if (handle == root)
+			return true;
+	}
+	return false;
+}
+
+//Every live node against the full recompute. Chains are a few levels deep with scales near one, so the
+//tolerance only has to absorb differently fused multiply adds.
+static uint32_t CountMismatches(const LavaScene& scene, const std::vector<SceneNode>& nodes)
+{
+	uint32_t mismatches = 0;
+	for (LavaNodeHandle handle = 0; handle < nodes.size(); handle++) {
+		if (!nodes[handle].alive)
+			continue;
+
+		LavaAffineTransform expected = ComputeWorld(nodes, handle);
+		const LavaAffineTransform& world = scene.GetWorldTransform(handle);
+		for (int i = 0; i < 3; i++) {
+			glm::vec4 difference = glm::abs(world.rows[i] - expected.rows[i]);
+			if (std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) > 1e-4f)
+				mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+//Moving a subtree root updates exactly that subtree, swap removes from destroyed nodes keep every parent slot
+//pointing at the right node, and the parallel level update agrees with walking the hierarchy from the root.
+LAVA_TEST("scene/move_subtree_matches_recompute", []() {
+	SceneRandom random;
+	LavaJobSystem jobSystem(3);
+	LavaScene scene;
+	std::vector<SceneNode> nodes;
+
+	//Wide enough that the busy levels span several update chunks.
+	std::vector<LavaNodeHandle> roots;
+	for (int i = 0; i < 24; i++) {
+		roots.push_back(Create(scene, nodes, LAVA_INVALID_NODE, random));
+	}
+	std::vector<LavaNodeHandle> parents = roots;
+	for (int levelIndex = 1; levelIndex < 6; levelIndex++) {
+		std::vector<LavaNodeHandle> created;
+		for (LavaNodeHandle parent : parents) {
+			uint32_t childCount = 1 + random.Next() % 6;
+			for (uint32_t i = 0; i < childCount; i++) {
+				created.push_back(Create(scene, nodes, parent, random));
+			}
+		}
+		parents = created;
+	}
+	LAVA_CHECK_EQUAL(scene.GetLevelCount(), 6);
+	LAVA_CHECK(scene.GetNodeCount() > 10000);
+
+	scene.Update(&jobSystem);
+	LAVA_CHECK_EQUAL(CountMismatches(scene, nodes), 0);
+	LAVA_CHECK_EQUAL(scene.GetChangedNodes().size(), scene.GetNodeCount());
+
+	scene.Update(&jobSystem);
+	LAVA_CHECK(scene.GetChangedNodes().empty());
+
+	for (int round = 0; round < 8; round++) {
+		//A mid level subtree root moves, along with a node below it that its update already covers.
+		LavaNodeHandle moved;
+		do {
+			moved = random.Next() % uint32_t(nodes.size());
+		} while (!nodes[moved].alive || nodes[moved].parent == LAVA_INVALID_NODE);
+		Randomize(scene, nodes, moved, random);
+		for (LavaNodeHandle handle = 0; handle < nodes.size(); handle++) {
+			if (handle != moved && nodes[handle].alive && IsInSubtree(nodes, handle, moved)) {
+				nodes[handle].position.x += 1.f;
+				scene.SetPosition(handle, nodes[handle].position);
+				break;
+			}
+		}
+
+		scene.Update(round % 2 ? &jobSystem : nullptr);
+		LAVA_CHECK_EQUAL(CountMismatches(scene, nodes), 0);
+
+		uint32_t subtreeSize = 0;
+		for (LavaNodeHandle handle = 0; handle < nodes.size(); handle++) {
+			if (nodes[handle].alive && IsInSubtree(nodes, handle, moved))
+				subtreeSize++;
+		}
+		const std::vector<LavaNodeHandle>& changed = scene.GetChangedNodes();
+		LAVA_CHECK_EQUAL(changed.size(), subtreeSize);
+		for (LavaNodeHandle handle : changed) {
+			LAVA_CHECK(IsInSubtree(nodes, handle, moved));
+		}
+
+		//Destroy another subtree and grow a new one, which moves slots around inside the levels.
+		LavaNodeHandle destroyed;
+		do {
+			destroyed = random.Next() % uint32_t(nodes.size());
+		} while (!nodes[destroyed].alive || nodes[destroyed].parent == LAVA_INVALID_NODE || IsInSubtree(nodes, moved, destroyed));
+		for (LavaNodeHandle handle = 0; handle < nodes.size(); handle++) {
+			if (IsInSubtree(nodes, handle, destroyed))
+				nodes[handle].alive = false;
+		}
+		scene.DestroyNode(destroyed);
+
+		LavaNodeHandle grown = Create(scene, nodes, moved, random);
+		Create(scene, nodes, grown, random);
+		Randomize(scene, nodes, roots[round % roots.size()], random);
+		scene.Update(&jobSystem);
+		LAVA_CHECK_EQUAL(CountMismatches(scene, nodes), 0);
+	}
+});
@@ -0,0 +1,61 @@
+#include "LavaTest.h"
+#include "LavaTextureCompression.h"
+
+#include <math.h>
+#include <algorithm>
+
+//Gradients, hard edges, noise and flat blocks, so every encoder path and palette tie shows up.
+static void BuildTestImage(LavaImage& image, uint32_t size)
+{
+	uint32_t state = 0x9e3779b9u;
+	image.width = size;
+	image.height = size;
+	image.rgba.resize(size * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			uint8_t* pixel = &image.rgba[(y * size + x) * 4];
+			int noise = int(state % 9) - 4;
+			bool flat = (x / 16 + y / 16) % 5 == 0;
+			pixel[0] = flat ? 128 : uint8_t(std::min(255, std::max(0, int(255.f * x / size) + noise)));
+			pixel[1] = flat ? 64 : uint8_t(std::min(255, std::max(0, int(127.5f + 127.5f * sinf(y * 0.2f)) + noise)));
+			pixel[2] = ((x / 8) ^ (y / 8)) & 1 ? 220 : 30;
+			pixel[3] = uint8_t(255 - (x + y) * 255 / (2 * size));
+		}
+	}
+}
+
+//Every index search kernel the CPU runs has to produce the same bytes as the scalar one, in every format and quality.
+LAVA_TEST("texture_compression/kernels_identical", []() {
+	LavaImage image;
+	BuildTestImage(image, 64);
+
+	const LavaCompressionKernel kernels[] = { LAVA_COMPRESSION_KERNEL_SSE2, LAVA_COMPRESSION_KERNEL_AVX2 };
+	const LavaBlockFormat formats[] = { LAVA_BLOCK_BC1, LAVA_BLOCK_BC3, LAVA_BLOCK_BC5, LAVA_BLOCK_BC7 };
+	const LavaCompressionQuality qualities[] = { LAVA_COMPRESSION_FAST, LAVA_COMPRESSION_NORMAL, LAVA_COMPRESSION_HIGH };
+	LavaCompressionKernel defaultKernel = LavaGetCompressionKernel();
+	LAVA_CHECK_EQUAL(defaultKernel, LavaGetBestCompressionKernel());
+
+	for (LavaBlockFormat format : formats) {
+		for (LavaCompressionQuality quality : qualities) {
+			std::vector<uint8_t> reference;
+			LavaSetCompressionKernel(LAVA_COMPRESSION_KERNEL_SCALAR);
+			LavaCompressImage(image, format, quality, nullptr, reference);
+
+			for (LavaCompressionKernel kernel : kernels) {
+				if (!LavaIsCompressionKernelSupported(kernel))
+					continue;
+				std::vector<uint8_t> blocks;
+				LavaSetCompressionKernel(kernel);
+				LavaCompressImage(image, format, quality, nullptr, blocks);
+				bool identical = blocks == reference;
+				if (!identical)
+					LAVA_PRINT("  " << LavaBlockFormatName(format) << " quality " << quality << ": " << LavaCompressionKernelName(kernel) << " differs from scalar");
+				LAVA_CHECK(identical);
+			}
+		}
+	}
+	LavaSetCompressionKernel(defaultKernel);
+});
@@ -0,0 +1,188 @@
+#include "LavaTest.h"
+#include "LavaTextureStreaming.h"
+
+#include <string.h>
+
+//Square RGBA8 texture with a full mip chain, levels packed back to back like in a KTX2 file.
+static LavaKtx2Info SquareTexture(uint32_t size)
+{
+	LavaKtx2Info info = {};
+	info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	info.width = size;
+	info.height = size;
+	uint64_t offset = 0;
+	for (uint32_t extent = size; extent > 0; extent /= 2) {
+		info.levels[info.levelCount].offset = offset;
+		info.levels[info.levelCount].size = uint64_t(extent) * extent * 4;
+		offset += info.levels[info.levelCount].size;
+		info.levelCount++;
+	}
+	return info;
+}
+
+static LavaTextureReader ZeroReader()
+{
+	return [](uint64_t, uint64_t size, void* destination) {
+		memset(destination, 0, size_t(size));
+		return true;
+	};
+}
+
+//What the streamer reports has to be what the device was told.
+static void CheckResidencyMatchesDevice(const LavaTextureStreamer& streamer, const LavaSimulatedTextureDevice& device, uint32_t textureCount)
+{
+	LAVA_CHECK_EQUAL(device.GetInvalidCommitCount(), 0);
+	LAVA_CHECK_EQUAL(streamer.GetStats().residentBytes, device.GetResidentBytes());
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		LAVA_CHECK_EQUAL(streamer.GetResidency(texture).residentLevel, device.GetMinLevel(texture));
+	}
+}
+
+//1024^2 texture, 1MB per frame: 128px and 256px levels in the first frame, 512px alone in the second,
+//then the 4MB top level goes through on its own because a level larger than the budget is still allowed.
+LAVA_TEST("texture_streaming/upload_budget", []() {
+	LavaSimulatedTextureDevice device;
+	LavaTextureStreamer streamer;
+	streamer.Init(&device);
+	streamer.uploadBudget = 1024 * 1024;
+
+	LavaKtx2Info info = SquareTexture(1024);
+	uint32_t texture = streamer.Register(info, ZeroReader());
+	LAVA_CHECK_EQUAL(texture, 0);
+	const LavaTextureResidency& residency = streamer.GetResidency(texture);
+	LAVA_CHECK_EQUAL(residency.tailLevel, 4);
+	LAVA_CHECK_EQUAL(residency.residentLevel, 4);
+	CheckResidencyMatchesDevice(streamer, device, 1);
+
+	const uint32_t expectedLevels[] = { 2, 1, 0, 0 };
+	const uint64_t expectedUploads[] = { info.levels[3].size + info.levels[2].size, info.levels[1].size, info.levels[0].size, 0 };
+	for (uint32_t frame = 0; frame < 4; frame++) {
+		uint64_t uploadedBefore = device.GetUploadedBytes();
+		streamer.BeginFrame(frame + 1);
+		streamer.RequestLevel(texture, 0.f);
+		streamer.Update();
+
+		LAVA_CHECK_EQUAL(residency.residentLevel, expectedLevels[frame]);
+		LAVA_CHECK_EQUAL(streamer.GetStats().uploadedBytes, expectedUploads[frame]);
+		LAVA_CHECK_EQUAL(device.GetUploadedBytes() - uploadedBefore, expectedUploads[frame]);
+		LAVA_CHECK_EQUAL(streamer.GetStats().missingLevels, expectedLevels[frame]);
+		CheckResidencyMatchesDevice(streamer, device, 1);
+	}
+	streamer.Shutdown();
+	LAVA_CHECK_EQUAL(device.GetResidentBytes(), 0);
+});
+
+//Three 256^2 textures used last in frames 2, 3 and 4. Shrinking the memory budget drops the least recently
+//used level each time, never a level requested in the current frame and never the mip tail.
+LAVA_TEST("texture_streaming/lru_eviction", []() {
+	LavaSimulatedTextureDevice device;
+	LavaTextureStreamer streamer;
+	streamer.Init(&device);
+
+	LavaKtx2Info info = SquareTexture(256);
+	const uint32_t textureCount = 3;
+	for (uint32_t i = 0; i < textureCount; i++) {
+		streamer.Register(info, ZeroReader());
+	}
+
+	streamer.BeginFrame(1);
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		streamer.RequestLevel(texture, 0.f);
+	}
+	streamer.Update();
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		streamer.BeginFrame(texture + 2);
+		streamer.RequestLevel(texture, 0.f);
+		streamer.Update();
+		LAVA_CHECK_EQUAL(streamer.GetResidency(texture).residentLevel, 0);
+	}
+	CheckResidencyMatchesDevice(streamer, device, textureCount);
+
+	auto shrinkBudget = [&](uint64_t frame, uint32_t requestedTexture) {
+		streamer.memoryBudget = streamer.GetStats().residentBytes - 1;
+		streamer.BeginFrame(frame);
+		if (requestedTexture != LAVA_INVALID_TEXTURE)
+			streamer.RequestLevel(requestedTexture, 0.f);
+		streamer.Update();
+		LAVA_CHECK_EQUAL(streamer.GetStats().evictedLevels, 1);
+		LAVA_CHECK(streamer.GetStats().residentBytes <= streamer.memoryBudget);
+		CheckResidencyMatchesDevice(streamer, device, textureCount);
+	};
+
+	//Texture 0 went unused the longest, its top level and then its 128px level go first.
+	shrinkBudget(5, LAVA_INVALID_TEXTURE);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).residentLevel, 1);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(1).residentLevel, 0);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(2).residentLevel, 0);
+
+	shrinkBudget(6, LAVA_INVALID_TEXTURE);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).residentLevel, 2);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(1).residentLevel, 0);
+
+	//Texture 1 is older than texture 2 but requested now, and texture 0 is down to its tail.
+	shrinkBudget(7, 1);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).residentLevel, 2);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(1).residentLevel, 0);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(2).residentLevel, 1);
+
+	//Nothing left to drop but requested levels and tails, the budget is exceeded rather than evicting those.
+	streamer.memoryBudget = 0;
+	streamer.BeginFrame(8);
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		streamer.RequestLevel(texture, 0.f);
+	}
+	streamer.Update();
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).residentLevel, 2);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(1).residentLevel, 0);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(2).residentLevel, 1);
+	LAVA_CHECK_EQUAL(streamer.GetStats().missingLevels, 3);
+	CheckResidencyMatchesDevice(streamer, device, textureCount);
+});
+
+//Bytes and levels the streamer reports against the device, through registers, streaming and an unregister.
+LAVA_TEST("texture_streaming/reported_residency", []() {
+	LavaSimulatedTextureDevice device;
+	LavaTextureStreamer streamer;
+	streamer.Init(&device);
+
+	const uint32_t sizes[] = { 2048, 512, 64, 1024 };
+	const uint32_t textureCount = 4;
+	for (uint32_t size : sizes) {
+		streamer.Register(SquareTexture(size), ZeroReader());
+	}
+	CheckResidencyMatchesDevice(streamer, device, textureCount);
+
+	for (uint64_t frame = 1; frame <= 8; frame++) {
+		streamer.BeginFrame(frame);
+		streamer.RequestLevel(0, 1.5f); //Rounds to level 1
+		streamer.RequestLevel(1, 0.f);
+		streamer.RequestLevel(3, frame < 4 ? 0.f : 3.f);
+		streamer.Update();
+		CheckResidencyMatchesDevice(streamer, device, textureCount);
+	}
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).residentLevel, 1);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(0).requestedLevel, 1);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(1).residentLevel, 0);
+	LAVA_CHECK_EQUAL(streamer.GetResidency(2).residentLevel, 0); //64px is all tail
+	LAVA_CHECK_EQUAL(streamer.GetResidency(3).residentLevel, 0); //Unused levels stay while memory allows
+	LAVA_CHECK_EQUAL(streamer.GetStats().missingLevels, 0);
+
+	uint64_t bytes = 0;
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		const LavaTextureResidency& residency = streamer.GetResidency(texture);
+		uint64_t textureBytes = 0;
+		for (uint32_t level = residency.residentLevel; level < residency.levelCount; level++) {
+			textureBytes += streamer.GetInfo(texture).levels[level].size;
+		}
+		LAVA_CHECK_EQUAL(residency.residentBytes, textureBytes);
+		bytes += textureBytes;
+	}
+	LAVA_CHECK_EQUAL(streamer.GetStats().residentBytes, bytes);
+
+	uint64_t removedBytes = streamer.GetResidency(1).residentBytes;
+	streamer.Unregister(1);
+	LAVA_CHECK_EQUAL(streamer.GetStats().residentBytes, bytes - removedBytes);
+	LAVA_CHECK_EQUAL(device.GetResidentBytes(), bytes - removedBytes);
+	LAVA_CHECK_EQUAL(device.GetMinLevel(1), LAVA_MAX_TEXTURE_LEVELS);
+	LAVA_CHECK_EQUAL(device.GetInvalidCommitCount(), 0);
+});
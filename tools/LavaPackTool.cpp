@@ -0,0 +1,98 @@
+#include "LavaPack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+
+//Builds a pack from a directory, entries are named by their path relative to it with forward slashes.
+//Usage: lava_pack [--compress] [--extension .spv] dir output.lpk
+//       lava_pack --list pack.lpk
+//e.g. "lava_pack --extension .spv shaders shaders/shaders.lpk", which the CMake shader build runs.
+
+static bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& bytes)
+{
+	FILE* file = fopen(path.string().c_str(), "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size_t(std::max(0l, length)));
+	bool read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return read;
+}
+
+static int List(const char* path)
+{
+	LavaPack pack;
+	if (!pack.Open(path)) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return 1;
+	}
+	printf("%-40s %10s %10s %6s %16s\n", "name", "size", "stored", "codec", "content hash");
+	for (const LavaPackEntry* entry : pack.GetEntries()) {
+		printf("%-40s %10llu %10llu %6s %016llx\n", pack.GetName(*entry).c_str(), (unsigned long long)entry->size, (unsigned long long)entry->storedSize,
+			entry->compression == LAVA_PACK_LZ4 ? "lz4" : "-", (unsigned long long)entry->contentHash);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && strcmp(argv[1], "--list") == 0)
+		return List(argv[2]);
+
+	bool compress = false;
+	const char* extension = nullptr;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--compress") == 0)
+			compress = true;
+		else if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc)
+			extension = argv[++i];
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.size() != 2) {
+		fprintf(stderr, "Usage: lava_pack [--compress] [--extension .spv] dir output.lpk\n       lava_pack --list pack.lpk\n");
+		return 1;
+	}
+
+	std::filesystem::path directory = paths[0];
+	std::filesystem::path output = std::filesystem::absolute(paths[1]);
+	std::vector<std::filesystem::path> files;
+	std::error_code error;
+	for (const auto& item : std::filesystem::recursive_directory_iterator(directory, error)) {
+		if (!item.is_regular_file() || std::filesystem::absolute(item.path()) == output)
+			continue;
+		if (extension && item.path().extension() != extension)
+			continue;
+		files.push_back(item.path());
+	}
+	if (error) {
+		fprintf(stderr, "Could not list %s\n", paths[0]);
+		return 1;
+	}
+	//Sorted, the same inputs always give the same pack.
+	std::sort(files.begin(), files.end());
+
+	LavaPackWriter writer;
+	uint64_t totalSize = 0;
+	std::vector<uint8_t> bytes;
+	for (const std::filesystem::path& file : files) {
+		if (!ReadFile(file, bytes)) {
+			fprintf(stderr, "Could not read %s\n", file.string().c_str());
+			return 1;
+		}
+		writer.Add(file.lexically_relative(directory).generic_string(), bytes.data(), bytes.size(), compress);
+		totalSize += bytes.size();
+	}
+	if (!writer.Write(paths[1])) {
+		fprintf(stderr, "Could not write %s\n", paths[1]);
+		return 1;
+	}
+	printf("%s: %zu files, %llu bytes\n", paths[1], files.size(), (unsigned long long)totalSize);
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include "LavaCapture.h"
+#include "LavaDrawList.h"
+#include "LavaJobs.h"
+#include "LavaNullVulkan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+//Re-executes a VulkanKata --capture file: transform updates, instance stream gather, draw list build, sort and
+//submit, frame by frame. Recording goes to the null driver like lava_bench, so timings are the renderer's CPU
+//frame work without a driver and the same capture gives the same commands on every run.
+//Usage: lava_replay capture.lcap [--paced] [--repeat N] [--threads N] [--csv frames.csv]
+//--paced waits for each frame's capture time instead of replaying as fast as possible.
+
+struct ReplayBuffer {
+	std::vector<uint8_t> data;
+	VkBuffer handle;
+};
+
+static void ApplyUpload(std::vector<ReplayBuffer>& buffers, const LavaCaptureUpload& upload)
+{
+	std::vector<uint8_t>& data = buffers[upload.buffer].data;
+	size_t end = size_t(upload.offset) + upload.data.size();
+	if (data.size() < end)
+		data.resize(end);
+	memcpy(data.data() + upload.offset, upload.data.data(), upload.data.size());
+}
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	return values[size_t(percentile * double(values.size() - 1) + 0.5)];
+}
+
+int main(int argc, char** argv) {
+	const char* capturePath = nullptr;
+	const char* csvPath = nullptr;
+	bool paced = false;
+	uint32_t repeatCount = 1;
+	uint32_t threadCount = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--paced") == 0)
+			paced = true;
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			repeatCount = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threadCount = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (argv[i][0] != '-' && !capturePath)
+			capturePath = argv[i];
+		else {
+			printf("Usage: lava_replay capture.lcap [--paced] [--repeat N] [--threads N] [--csv frames.csv]\n");
+			return 1;
+		}
+	}
+	if (!capturePath) {
+		printf("Usage: lava_replay capture.lcap [--paced] [--repeat N] [--threads N] [--csv frames.csv]\n");
+		return 1;
+	}
+
+	LavaCaptureReader capture;
+	if (!capture.Load(capturePath)) {
+		printf("Could not read capture %s\n", capturePath);
+		return 1;
+	}
+	const LavaCaptureFileHeader& header = capture.GetHeader();
+	const std::vector<LavaCaptureFrameData>& frames = capture.GetFrames();
+
+	//Capture ids become fake handles, the stubs never look at them and the draw list only compares them.
+	std::vector<ReplayBuffer> buffers(capture.GetBuffers().size());
+	uint32_t instanceBuffer = LAVA_CAPTURE_INVALID_ID;
+	for (size_t i = 0; i < buffers.size(); i++) {
+		buffers[i].handle = (VkBuffer)(uintptr_t)(i + 1);
+		if (capture.GetBuffers()[i].desc.flags & LAVA_CAPTURE_BUFFER_INSTANCES)
+			instanceBuffer = uint32_t(i);
+	}
+	std::vector<VkPipeline> pipelines(capture.GetPipelines().size());
+	for (size_t i = 0; i < pipelines.size(); i++) {
+		pipelines[i] = (VkPipeline)(uintptr_t)(i + 1);
+	}
+
+	//The instance buffer is the draw stream, instances is every instance in node order like the renderer's copy.
+	for (const LavaCaptureUpload& upload : capture.GetUploads()) {
+		ApplyUpload(buffers, upload);
+	}
+	size_t instanceBytes = size_t(header.instanceCount) * header.instanceStride;
+	std::vector<uint8_t> instances(instanceBytes);
+	if (instanceBuffer != LAVA_CAPTURE_INVALID_ID) {
+		buffers[instanceBuffer].data.resize(std::max(buffers[instanceBuffer].data.size(), instanceBytes));
+		memcpy(instances.data(), buffers[instanceBuffer].data.data(), instanceBytes);
+	}
+
+	std::unique_ptr<LavaJobSystem> jobSystem(new LavaJobSystem(threadCount ? threadCount - 1 : ~0u));
+	LavaDrawList drawList;
+	LavaDrawListStats drawStats = {};
+	VkCommandBuffer commandBuffer = (VkCommandBuffer)(uintptr_t)1;
+	uint64_t commandsBegin = LavaNullVulkanGetStats().commands;
+	uint64_t hash = 0;
+
+	printf("%s: %zu frames, %u instances, %zu buffers, %zu pipelines, %u threads%s\n", capturePath, frames.size(), header.instanceCount,
+		buffers.size(), pipelines.size(), jobSystem->GetThreadCount(), paced ? ", paced" : "");
+
+	std::vector<double> replayMs;
+	std::vector<double> capturedMs;
+	replayMs.reserve(frames.size() * repeatCount);
+	for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+		auto replayBegin = std::chrono::steady_clock::now();
+		double firstFrameMs = frames.empty() ? 0.0 : frames[0].frame.timeMs;
+		for (const LavaCaptureFrameData& frame : frames) {
+			if (paced)
+				std::this_thread::sleep_until(replayBegin + std::chrono::duration<double, std::milli>(frame.frame.timeMs - firstFrameMs));
+			auto frameBegin = std::chrono::steady_clock::now();
+
+			for (const LavaCaptureUpload& upload : frame.uploads) {
+				ApplyUpload(buffers, upload);
+			}
+
+			//Transforms sit at the start of every instance, a full stream is updated in place as well.
+			uint8_t* streamData = instanceBuffer != LAVA_CAPTURE_INVALID_ID ? buffers[instanceBuffer].data.data() : nullptr;
+			for (const std::pair<LavaNodeHandle, LavaAffineTransform>& transform : frame.transforms) {
+				if (transform.first >= header.instanceCount)
+					continue;
+				memcpy(instances.data() + size_t(transform.first) * header.instanceStride, &transform.second, sizeof(LavaAffineTransform));
+				if (streamData && frame.instanceStream == LAVA_CAPTURE_INVALID_ID)
+					memcpy(streamData + size_t(transform.first) * header.instanceStride, &transform.second, sizeof(LavaAffineTransform));
+			}
+
+			if (streamData && frame.instanceStream != LAVA_CAPTURE_INVALID_ID) {
+				const std::vector<uint32_t>& stream = capture.GetInstanceStream(frame.instanceStream);
+				uint32_t streamCount = std::min(uint32_t(stream.size()), header.instanceCount);
+				uint32_t stride = header.instanceStride;
+				jobSystem->ParallelFor(streamCount, 4096, [&](uint32_t begin, uint32_t end, uint32_t) {
+					for (uint32_t i = begin; i < end; i++) {
+						memcpy(streamData + size_t(i) * stride, instances.data() + size_t(stream[i]) * stride, stride);
+					}
+				});
+			}
+
+			if (frame.drawList != LAVA_CAPTURE_INVALID_ID) {
+				const LavaCaptureDrawList& captured = capture.GetDrawList(frame.drawList);
+				drawList.Reset();
+				for (size_t i = 0; i < captured.packets.size(); i++) {
+					const LavaCapturePacket& capturePacket = captured.packets[i];
+					LavaDrawPacket packet = {};
+					packet.pipeline = capturePacket.pipeline < pipelines.size() ? pipelines[capturePacket.pipeline] : VK_NULL_HANDLE;
+					packet.vertexBuffers[0] = capturePacket.vertexBuffers[0] < buffers.size() ? buffers[capturePacket.vertexBuffers[0]].handle : VK_NULL_HANDLE;
+					packet.vertexBuffers[1] = capturePacket.vertexBuffers[1] < buffers.size() ? buffers[capturePacket.vertexBuffers[1]].handle : VK_NULL_HANDLE;
+					packet.indexBuffer = capturePacket.indexBuffer < buffers.size() ? buffers[capturePacket.indexBuffer].handle : VK_NULL_HANDLE;
+					packet.indexCount = capturePacket.indexCount;
+					packet.instanceCount = capturePacket.instanceCount;
+					packet.firstIndex = capturePacket.firstIndex;
+					packet.vertexOffset = capturePacket.vertexOffset;
+					packet.firstInstance = capturePacket.firstInstance;
+					drawList.Push(captured.keys[i], packet);
+				}
+				drawList.Sort(jobSystem.get());
+				if (header.flags & LAVA_CAPTURE_FLAG_CACHED_COMMAND_BUFFERS)
+					hash ^= drawList.ComputeHash();
+				for (uint32_t pass = 0; pass < header.passCount; pass++) {
+					drawList.Submit(commandBuffer, pass, drawStats);
+				}
+			}
+
+			replayMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameBegin).count());
+			capturedMs.push_back(frame.frame.cpuFrameMs);
+		}
+	}
+
+	if (replayMs.empty()) {
+		printf("No complete frames in the capture\n");
+		return 1;
+	}
+
+	double replaySum = 0.0;
+	for (double ms : replayMs) {
+		replaySum += ms;
+	}
+	printf("replay   median %.3f ms  p90 %.3f ms  max %.3f ms  mean %.3f ms\n", Percentile(replayMs, 0.5), Percentile(replayMs, 0.9),
+		Percentile(replayMs, 1.0), replaySum / double(replayMs.size()));
+	printf("captured median %.3f ms  p90 %.3f ms (whole CPU frame incl. acquire and submit)\n", Percentile(capturedMs, 0.5), Percentile(capturedMs, 0.9));
+	printf("%.1f draws, %.1f pipeline binds, %.1f commands per frame\n", double(drawStats.draws) / double(replayMs.size()),
+		double(drawStats.pipelineBinds) / double(replayMs.size()), double(LavaNullVulkanGetStats().commands - commandsBegin) / double(replayMs.size()));
+	if (header.flags & LAVA_CAPTURE_FLAG_CACHED_COMMAND_BUFFERS)
+		printf("draw list hash %016llx\n", (unsigned long long)hash);
+
+	if (csvPath) {
+		FILE* csv = fopen(csvPath, "w");
+		if (!csv) {
+			printf("Could not write %s\n", csvPath);
+			return 1;
+		}
+		fprintf(csv, "frame,captured_ms,replay_ms\n");
+		for (size_t i = 0; i < replayMs.size(); i++) {
+			fprintf(csv, "%llu,%.4f,%.4f\n", (unsigned long long)frames[i % frames.size()].frame.frameIndex, capturedMs[i], replayMs[i]);
+		}
+		fclose(csv);
+	}
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include "LavaStats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+//Reads the frame counters VulkanKata --stats publishes, from outside the renderer process.
+//Usage: lava_stats [--name lava_stats] [--interval ms] [--once [--frames N]]
+//Default prints one line of averages per interval, --once dumps the last N frames and exits.
+
+struct StatsSums {
+	uint32_t frames = 0;
+	double cpuFrameMs = 0.0;
+	double gpuFrameMs = 0.0;
+	double triangles = 0.0;
+	double uploadedBytes = 0.0;
+	double draws = 0.0;
+	double pipelineBinds = 0.0;
+	double barriers = 0.0;
+	uint64_t allocations = 0;
+	uint32_t statisticsFrames = 0;
+	double fragmentInvocations = 0.0;
+	double computeInvocations = 0.0;
+
+	void Add(const LavaFrameStats& stats)
+	{
+		frames++;
+		cpuFrameMs += stats.cpuFrameMs;
+		gpuFrameMs += stats.gpuFrameMs;
+		triangles += double(stats.triangles);
+		uploadedBytes += double(stats.uploadedBytes);
+		draws += stats.draws;
+		pipelineBinds += stats.pipelineBinds;
+		barriers += stats.barriers;
+		allocations += stats.allocations;
+		if (stats.hasPipelineStatistics) {
+			statisticsFrames++;
+			fragmentInvocations += double(stats.fragmentInvocations);
+			computeInvocations += double(stats.computeInvocations);
+		}
+	}
+};
+
+static void PrintFrame(const LavaFrameStats& stats)
+{
+	printf("%8llu %8.3f %8.3f %12llu %8u %6u %8u %10llu %6u", (unsigned long long)stats.frameIndex, stats.cpuFrameMs, stats.gpuFrameMs,
+		(unsigned long long)stats.triangles, stats.draws, stats.pipelineBinds, stats.barriers, (unsigned long long)stats.uploadedBytes, stats.allocations);
+	if (stats.hasPipelineStatistics)
+		printf(" %12llu %12llu", (unsigned long long)stats.fragmentInvocations, (unsigned long long)stats.computeInvocations);
+	printf("\n");
+}
+
+static void PrintHeader()
+{
+	printf("%8s %8s %8s %12s %8s %6s %8s %10s %6s %12s %12s\n", "frame", "cpu ms", "gpu ms", "triangles", "draws", "binds", "barriers", "upload B",
+		"allocs", "fragments", "compute");
+}
+
+static void PrintAverages(const StatsSums& sums, double seconds)
+{
+	double frames = double(sums.frames);
+	printf("%6.1f fps  cpu %.3f ms  gpu %.3f ms  %.0f triangles  %.0f draws  %.0f binds  %.0f barriers  %.1f KB uploaded  %llu allocations",
+		frames / seconds, sums.cpuFrameMs / frames, sums.gpuFrameMs / frames, sums.triangles / frames, sums.draws / frames, sums.pipelineBinds / frames,
+		sums.barriers / frames, sums.uploadedBytes / frames / 1024.0, (unsigned long long)sums.allocations);
+	if (sums.statisticsFrames)
+		printf("  %.0f fragments  %.0f compute invocations", sums.fragmentInvocations / sums.statisticsFrames, sums.computeInvocations / sums.statisticsFrames);
+	printf("\n");
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	const char* name = "lava_stats";
+	uint32_t intervalMs = 1000;
+	uint32_t frameCount = 32;
+	bool once = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+			name = argv[++i];
+		else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+			intervalMs = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frameCount = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--once") == 0)
+			once = true;
+		else {
+			printf("Usage: lava_stats [--name lava_stats] [--interval ms] [--once [--frames N]]\n");
+			return 1;
+		}
+	}
+
+	LavaStatsRing ring;
+	if (once) {
+		if (!ring.Open(name)) {
+			printf("No stats segment named %s\n", name);
+			return 1;
+		}
+		uint64_t end = ring.GetFrameCount();
+		uint64_t begin = end > frameCount ? end - frameCount : 0;
+		PrintHeader();
+		for (uint64_t frame = begin; frame < end; frame++) {
+			LavaFrameStats stats;
+			if (ring.Read(frame, stats))
+				PrintFrame(stats);
+		}
+		return 0;
+	}
+
+	//Polls the ring, a renderer that restarts recreates the segment and is picked up again.
+	uint64_t nextFrame = 0;
+	bool waiting = false;
+	auto intervalBegin = std::chrono::steady_clock::now();
+	while (true) {
+		if (!ring.IsValid()) {
+			if (!ring.Open(name)) {
+				if (!waiting)
+					printf("Waiting for stats segment %s\n", name);
+				waiting = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+				continue;
+			}
+			waiting = false;
+			nextFrame = ring.GetFrameCount();
+			intervalBegin = std::chrono::steady_clock::now();
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+		uint64_t end = ring.GetFrameCount();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - intervalBegin).count();
+		intervalBegin = std::chrono::steady_clock::now();
+		if (end < nextFrame) {
+			ring.Destroy();
+			continue;
+		}
+
+		//Frames that were already overwritten are skipped, the reader fell more than a ring behind.
+		StatsSums sums;
+		if (end - nextFrame > ring.GetCapacity())
+			nextFrame = end - ring.GetCapacity();
+		for (; nextFrame < end; nextFrame++) {
+			LavaFrameStats stats;
+			if (ring.Read(nextFrame, stats))
+				sums.Add(stats);
+		}
+		if (sums.frames)
+			PrintAverages(sums, seconds);
+		else {
+			//No new frames, the renderer may have exited and a new one created a fresh segment under the same name.
+			ring.Destroy();
+		}
+	}
+}